@@ -395,7 +395,7 @@ TextProcessor.prototype = {
     text = this._DecorateTitle(text);
     text = this._CleanUp(text);
 
-    return _EscapeJsonString(text);
+    return text;
   }
 };
 
@@ -529,7 +529,7 @@ HeadingProcessor.prototype = {
         this.processedHeading = heading;
 
         heading = this._TranslateFullWidthLatin(heading);
-        return _EscapeJsonString(heading);
+        return heading;
       } else {
         this.processedHeading = null;
         return null;
@@ -581,7 +581,7 @@ HeadingProcessor.prototype = {
           // but I'm not sure.
           tags.push(templSource.slice(0, left));
 
-          return _EscapeJsonString(tags.join(','));
+          return tags.join(',');
         } else {
           // The heading contains only a reading, so we return this reading
           // as tag.
@@ -461,7 +461,7 @@ TextProcessor.prototype = {
     text = this._DecorateTitle(text);
     text = this._StripGarbage(text);
 
-    return _EscapeJsonString(text);
+    return text;
   }
 };
 
@@ -632,7 +632,7 @@ HeadingProcessor.prototype = {
         this.processedHeading = heading;
 
         heading = this._TranslateFullWidthLatin(heading);
-        return _EscapeJsonString(heading);
+        return heading;
       } else {
         // Be 100% that we are skipping a Kanji entry. There're some headings
         // containing only 1 hiragana/katakana char and we don't want to drop
@@ -684,7 +684,7 @@ HeadingProcessor.prototype = {
         // but I'm not sure.
         tags.push(templSource.slice(0, left));
 
-        return _EscapeJsonString(tags.join(','));
+        return tags.join(',');
       } else {
         // The heading contains only a reading, so we make this reading a tag.
 
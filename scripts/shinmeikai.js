@@ -219,7 +219,7 @@ TextProcessor.prototype = {
     text = this._DecorateListNumbers(text);
     text = _LinkifyReferences(text);
 
-    return _EscapeJsonString(text);
+    return text;
   }
 };
 
@@ -336,7 +336,7 @@ HeadingProcessor.prototype = {
       this.processedHeading = heading;
 
       heading = this._TranslateFullWidthLatin(heading);
-      return _EscapeJsonString(heading);
+      return heading;
     };
   })(),
 
@@ -384,7 +384,7 @@ HeadingProcessor.prototype = {
           // but I'm not sure.
           tags.push(templSource.slice(0, left));
 
-          return _EscapeJsonString(tags.join(','));
+          return tags.join(',');
         } else {
           // The heading contains only a reading, so we return this reading
           // as tag.
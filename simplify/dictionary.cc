@@ -42,6 +42,55 @@ void Dictionary::SetName(const std::string &name)
     SaveState();
 }
 
+Likely<Dictionary::SearchResults *>
+Dictionary::Search(const char *expr, size_t limit, SearchSession *)
+{
+    return Search(expr, limit);
+}
+
+std::unique_ptr<Dictionary::SearchSession> Dictionary::NewSearchSession()
+{
+    return nullptr;
+}
+
+Likely<std::unique_ptr<char[]>>
+Dictionary::ReadText(const char *guid, size_t *text_length,
+                     std::vector<std::string> *references)
+{
+    if (references != nullptr)
+        references->clear();
+    return ReadText(guid, text_length);
+}
+
+Likely<std::shared_ptr<const std::string>>
+Dictionary::RenderGaiji(unsigned int, bool, int)
+{
+    return make_error_code(simplify_error::no_gaiji);
+}
+
+Likely<std::shared_ptr<const std::string>>
+Dictionary::RenderGaijiSheet(bool, int, GaijiSheetLayout *)
+{
+    return make_error_code(simplify_error::no_gaiji);
+}
+
+Likely<Dictionary::BinaryStream *>
+Dictionary::OpenBinary(const BinaryLocation &)
+{
+    return make_error_code(simplify_error::no_binary);
+}
+
+Likely<std::vector<std::string>> Dictionary::GetBacklinks(const char *, size_t)
+{
+    return make_error_code(simplify_error::no_backlinks);
+}
+
+Likely<std::vector<std::string>> Dictionary::SearchFullText(const char *,
+                                                            size_t)
+{
+    return make_error_code(simplify_error::no_fulltext);
+}
+
 std::shared_ptr<Repository> Dictionary::GetRepository()
 {
     return repo_.lock();
@@ -21,6 +21,7 @@
 #ifndef DICTIONARY_HH_
 #define DICTIONARY_HH_
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <system_error>
@@ -54,6 +55,71 @@ public:
         virtual Likely<std::unique_ptr<char[]>> FetchTags(size_t *size) = 0;
     };
 
+    /**
+     * What a dictionary keeps between searches of one client, e.g. one
+     * typing a word, so that a search for an expression extending the
+     * previous one filters the previous results instead of searching
+     * from scratch. A session must not be used by two searches at once.
+     */
+    class SearchSession {
+    public:
+        virtual ~SearchSession() = default;
+    };
+
+    /**
+     * Sound or graphic data of a dictionary, read in parts.
+     */
+    class BinaryStream {
+    public:
+        virtual ~BinaryStream() = default;
+
+        /// MIME type of the data.
+        virtual const char *GetContentType() const = 0;
+        /// Size of the data in bytes.
+        virtual uint64_t GetSize() const = 0;
+
+        /**
+         * Reads up to @size bytes at @offset into @buffer. Returns the
+         * number of bytes read, which is 0 past the end of the data.
+         */
+        virtual Likely<size_t> Read(uint64_t offset, char *buffer,
+                                    size_t size) = 0;
+    };
+
+    enum class BinaryType {
+        Sound,
+        ColorGraphic,
+        MonoGraphic
+    };
+
+    /**
+     * Identifies sound or graphic data within a dictionary. @start and
+     * @end are GUIDs, see @OpenBinary().
+     */
+    struct BinaryLocation {
+        BinaryType type;
+        const char *start;
+        const char *end;
+        int width;
+        int height;
+    };
+
+    /**
+     * Placement of characters in a sheet made by @RenderGaijiSheet().
+     * Character @code is drawn at
+     *
+     *   x = ((code & 0xff) - first_column) * glyph_width
+     *   y = ((code >> 8) - (start >> 8)) * glyph_height
+     */
+    struct GaijiSheetLayout {
+        int glyph_width;
+        int glyph_height;
+        unsigned int start;
+        unsigned int end;
+        unsigned int first_column;
+        unsigned int columns;
+    };
+
     explicit Dictionary(const char *name);
     explicit Dictionary(std::string name);
     virtual ~Dictionary();
@@ -70,6 +136,21 @@ public:
      */
     virtual Likely<SearchResults *> Search(const char *expr, size_t limit) = 0;
 
+    /**
+     * Same as the above, but searches within @session, see SearchSession.
+     * Results are the same as those of a search without a session. The
+     * default implementation ignores the session. @session must have been
+     * made by NewSearchSession() of the same dictionary.
+     */
+    virtual Likely<SearchResults *> Search(const char *expr, size_t limit,
+                                           SearchSession *session);
+
+    /**
+     * Returns a new session for Search(), or null if the dictionary
+     * doesn't benefit from one.
+     */
+    virtual std::unique_ptr<SearchSession> NewSearchSession();
+
     /**
      * Retrieves results from previous search. It's a good idea to specify
      * a reasonable @max_count to avoid taking up too much memory for search
@@ -118,6 +199,68 @@ public:
     virtual Likely<std::unique_ptr<char[]>> ReadText(const char *guid,
                                                      size_t *text_length) = 0;
 
+    /**
+     * Reads text like the above, and also stores GUIDs of the entities
+     * the text refers to in @references, in the order they appear and
+     * without duplicates.
+     *
+     * Dictionaries which don't know about references leave @references
+     * empty.
+     */
+    virtual Likely<std::unique_ptr<char[]>>
+        ReadText(const char *guid, size_t *text_length,
+                 std::vector<std::string> *references);
+
+    /**
+     * Renders an external character (gaiji) as a PNG image.
+     *
+     * \param code Character code of the external character.
+     * \param wide Whether it's a wide (full-width) character.
+     * \param height Font height in pixels.
+     *
+     * Images are cached, so rendering the same character again is cheap.
+     * Dictionaries without external characters fail with no_gaiji.
+     */
+    virtual Likely<std::shared_ptr<const std::string>>
+        RenderGaiji(unsigned int code, bool wide, int height);
+
+    /**
+     * Renders every external character of the given kind and size into
+     * a single PNG image, so that a page needs one request for all of
+     * them. See @GaijiSheetLayout on how to find a character in it.
+     */
+    virtual Likely<std::shared_ptr<const std::string>>
+        RenderGaijiSheet(bool wide, int height, GaijiSheetLayout *layout);
+
+    /**
+     * Opens sound or graphic data for reading.
+     *
+     * Sounds span from `start` to `end` and are returned as WAVE. Color
+     * graphics start at `start` and are returned as is (BMP or JPEG).
+     * Monochrome graphics are converted to PNG. Their size is given by
+     * `width` and `height`, or, if both are 0, `start` points to the
+     * graphic's tag in the text. Dictionaries without such data fail
+     * with no_binary.
+     */
+    virtual Likely<BinaryStream *> OpenBinary(const BinaryLocation &location);
+
+    /**
+     * Returns GUIDs of up to @limit entities which refer to the entity
+     * with the given GUID, in the order of their position. Dictionaries
+     * without an index of references fail with no_backlinks.
+     */
+    virtual Likely<std::vector<std::string>> GetBacklinks(const char *guid,
+                                                          size_t limit);
+
+    /**
+     * Returns GUIDs of up to @limit entities whose text contains the UTF-8
+     * encoded @phrase, in the order of their position. Case of ASCII
+     * letters and width of ASCII characters are ignored. Dictionaries
+     * without a full-text index fail with no_fulltext.
+     */
+    virtual Likely<std::vector<std::string>> SearchFullText(const char *phrase,
+                                                            size_t limit);
+
     /**
      * Returns dictionary name.
      */
@@ -0,0 +1,167 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#include <cstring>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <memory>
+
+#include "backlink-index.hh"
+
+namespace simplify {
+
+static const char kMagic[4] = { 'S', 'B', 'L', 'I' };
+static const uint32_t kVersion = 1;
+
+static void AppendUInt32(std::string &out, uint32_t value)
+{
+    for (int i = 0; i < 4; ++i)
+        out.push_back(static_cast<char>(value >> (i * 8)));
+}
+
+static void AppendUInt64(std::string &out, uint64_t value)
+{
+    for (int i = 0; i < 8; ++i)
+        out.push_back(static_cast<char>(value >> (i * 8)));
+}
+
+static uint32_t ReadUInt32(const unsigned char *in)
+{
+    return static_cast<uint32_t>(in[0])
+        | static_cast<uint32_t>(in[1]) << 8
+        | static_cast<uint32_t>(in[2]) << 16
+        | static_cast<uint32_t>(in[3]) << 24;
+}
+
+static uint64_t ReadUInt64(const unsigned char *in)
+{
+    return ReadUInt32(in) | static_cast<uint64_t>(ReadUInt32(in + 4)) << 32;
+}
+
+BacklinkIndex::Builder::Builder(int subbook_count)
+  : subbook_count_(subbook_count)
+{
+}
+
+void BacklinkIndex::Builder::Add(uint64_t target, uint64_t source)
+{
+    links_.emplace_back(target, source);
+}
+
+std::error_code BacklinkIndex::Builder::Write(const char *path)
+{
+    std::sort(links_.begin(), links_.end());
+    links_.erase(std::unique(links_.begin(), links_.end()), links_.end());
+
+    std::vector<uint64_t> targets;
+    std::vector<uint32_t> offsets;
+    for (size_t i = 0; i < links_.size(); ++i) {
+        if (i == 0 || links_[i].first != links_[i - 1].first) {
+            targets.push_back(links_[i].first);
+            offsets.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    offsets.push_back(static_cast<uint32_t>(links_.size()));
+
+    std::string data;
+    data.reserve(20 + targets.size() * 12 + links_.size() * 8 + 4);
+    data.append(kMagic, sizeof(kMagic));
+    AppendUInt32(data, kVersion);
+    AppendUInt32(data, static_cast<uint32_t>(subbook_count_));
+    AppendUInt32(data, static_cast<uint32_t>(targets.size()));
+    AppendUInt32(data, static_cast<uint32_t>(links_.size()));
+    for (uint64_t target : targets)
+        AppendUInt64(data, target);
+    for (uint32_t offset : offsets)
+        AppendUInt32(data, offset);
+    for (const auto &link : links_)
+        AppendUInt64(data, link.second);
+
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    if (!stream.write(data.data(), data.size()) || !stream.flush())
+        return std::make_error_code(std::errc::io_error);
+    return std::error_code();
+}
+
+Likely<BacklinkIndex *> BacklinkIndex::Load(const char *path)
+{
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream)
+        return std::make_error_code(std::errc::no_such_file_or_directory);
+
+    std::string data((std::istreambuf_iterator<char>(stream)),
+                     std::istreambuf_iterator<char>());
+    const unsigned char *in =
+        reinterpret_cast<const unsigned char *>(data.data());
+
+    if (data.size() < 20 || memcmp(in, kMagic, sizeof(kMagic)) != 0
+        || ReadUInt32(in + 4) != kVersion)
+        return make_error_code(simplify_error::bad_backlink_index);
+
+    uint64_t target_count = ReadUInt32(in + 12);
+    uint64_t source_count = ReadUInt32(in + 16);
+    if (data.size() != 20 + target_count * 12 + 4 + source_count * 8)
+        return make_error_code(simplify_error::bad_backlink_index);
+
+    std::unique_ptr<BacklinkIndex> index(new BacklinkIndex());
+    index->subbook_count_ = static_cast<int>(ReadUInt32(in + 8));
+    index->targets_.resize(target_count);
+    index->offsets_.resize(target_count + 1);
+    index->sources_.resize(source_count);
+
+    in += 20;
+    for (uint64_t i = 0; i < target_count; ++i, in += 8)
+        index->targets_[i] = ReadUInt64(in);
+    for (uint64_t i = 0; i <= target_count; ++i, in += 4)
+        index->offsets_[i] = ReadUInt32(in);
+    for (uint64_t i = 0; i < source_count; ++i, in += 8)
+        index->sources_[i] = ReadUInt64(in);
+
+    // Lookups rely on these, so check them once here.
+    if (!std::is_sorted(index->targets_.begin(), index->targets_.end())
+        || !std::is_sorted(index->offsets_.begin(), index->offsets_.end())
+        || index->offsets_.front() != 0
+        || index->offsets_.back() != source_count)
+        return make_error_code(simplify_error::bad_backlink_index);
+
+    return index.release();
+}
+
+int BacklinkIndex::GetSubBookCount() const
+{
+    return subbook_count_;
+}
+
+std::pair<const uint64_t *, const uint64_t *>
+BacklinkIndex::GetSources(uint64_t target) const
+{
+    auto it = std::lower_bound(targets_.begin(), targets_.end(), target);
+    if (it == targets_.end() || *it != target)
+        return std::make_pair(nullptr, nullptr);
+
+    size_t row = it - targets_.begin();
+    const uint64_t *sources = sources_.data();
+    return std::make_pair(sources + offsets_[row],
+                          sources + offsets_[row + 1]);
+}
+
+}  // namespace simplify
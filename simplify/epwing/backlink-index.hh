@@ -0,0 +1,107 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#ifndef SIMPLIFY_EPWING_BACKLINK_INDEX_HH_
+#define SIMPLIFY_EPWING_BACKLINK_INDEX_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <simplify/likely.hh>
+
+namespace simplify {
+
+/**
+ * Index of references between texts of a book, inverted so that it
+ * answers which texts refer to a given text.
+ *
+ * Texts are identified by keys made of sub-book index and text position,
+ * see @MakeKey(). The index is stored in compressed sparse row layout,
+ * all integers are little-endian:
+ *
+ *   char     magic[4]          "SBLI"
+ *   uint32_t version           1
+ *   uint32_t subbook_count     number of sub-books of the book
+ *   uint32_t target_count
+ *   uint32_t source_count
+ *   uint64_t targets[target_count]       keys of referenced texts, sorted
+ *   uint32_t offsets[target_count + 1]   of each target's row in sources
+ *   uint64_t sources[source_count]       keys of referring texts
+ *
+ * Sources of a target are sorted and unique.
+ */
+class BacklinkIndex {
+public:
+    /**
+     * Collects references and writes them out as an index.
+     */
+    class Builder {
+    public:
+        explicit Builder(int subbook_count);
+
+        void Add(uint64_t target, uint64_t source);
+        std::error_code Write(const char *path);
+
+    private:
+        int subbook_count_;
+        std::vector<std::pair<uint64_t, uint64_t>> links_;
+    };
+
+    static Likely<BacklinkIndex *> Load(const char *path);
+
+    /**
+     * Makes a key of the text at @page and @offset of the sub-book.
+     * Pages beyond 2^21 (4GB of text) can't be represented.
+     */
+    static uint64_t MakeKey(int subbook, int page, int offset) {
+        return static_cast<uint64_t>(subbook) << 32
+            | static_cast<uint64_t>(page) << 11
+            | static_cast<uint64_t>(offset);
+    }
+
+    static int GetSubBook(uint64_t key) { return key >> 32; }
+    static int GetPage(uint64_t key) { return (key & 0xffffffff) >> 11; }
+    static int GetOffset(uint64_t key) { return key & 0x7ff; }
+
+    int GetSubBookCount() const;
+
+    /**
+     * Returns the keys of texts which refer to @target, or an empty range
+     * if there are none.
+     */
+    std::pair<const uint64_t *, const uint64_t *>
+        GetSources(uint64_t target) const;
+
+private:
+    BacklinkIndex() = default;
+
+    int subbook_count_ = 0;
+    std::vector<uint64_t> targets_;
+    std::vector<uint32_t> offsets_;
+    std::vector<uint64_t> sources_;
+};
+
+}  // namespace simplify
+
+#endif  // SIMPLIFY_EPWING_BACKLINK_INDEX_HH_
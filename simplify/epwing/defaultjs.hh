@@ -25,16 +25,11 @@ namespace simplify {
 
 const char *g_default_js_implementation = \
 u8R"#(
-    _EscapeJsonString = (function() {
-      var matchJsonSpecialCharsRe = /["\\]/g;
-      var replaceFun = function($0) {
-        return '\\' + $0;
-      };
-
-      return function(string) {
-        return string.replace(matchJsonSpecialCharsRe, replaceFun);
-      };
-    })();
+    // Strings are escaped by the server when they're written to JSON.
+    // This is kept for scripts which still call it.
+    function _EscapeJsonString(string) {
+        return string;
+    }
 
     _LinkifyReferences = (function() {
       var matchRefRe = /〘(.+?)\|(\d+?:\d+?)〙/g;
@@ -111,16 +106,16 @@ u8R"#(
         return '';
     }
 
-    function _InsertTextGaiji() {
+    function _InsertTextGaiji(code, wide) {
         return '';
     }
 
-    function _InsertHeadingGaiji() {
+    function _InsertHeadingGaiji(code, wide) {
         return '';
     }
 
     function _ProcessHeading(heading) {
-        return _EscapeJsonString(heading);
+        return heading;
     }
 
     function _ProcessTags(heading) {
@@ -128,7 +123,7 @@ u8R"#(
     }
 
     function _ProcessText(text) {
-        return _EscapeJsonString(text);
+        return text;
     }
 )#";
 
@@ -28,11 +28,16 @@
 #include <cstdio>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <unordered_map>
 
+#include <eb/appendix.h>
+#include <eb/binary.h>
 #include <eb/eb.h>
 #include <eb/error.h>
+#include <eb/font.h>
 #include <eb/text.h>
 
 #include <v8.h>
@@ -41,9 +46,12 @@
 #include <nlohmann/json.hpp>
 
 #include <simplify/error.hh>
+#include <simplify/trace.hh>
 #include <simplify/utils.hh>
 
+#include "backlink-index.hh"
 #include "eucjp_ucs2.hh"
+#include "fulltext-index.hh"
 #include "defaultjs.hh"
 #include "epwing-dictionary.hh"
 
@@ -191,6 +199,23 @@ static const char *g_js_function_names[] = {
 static const size_t g_js_function_count = \
     sizeof(g_js_function_names) / sizeof(g_js_function_names[0]);
 
+/**
+ * Alternation texts of external characters of a sub-book converted to
+ * UCS2. Keyed by character code, with 0x10000 added for wide characters.
+ */
+typedef std::unordered_map<uint32_t, std::u16string> AltTextMap;
+
+/**
+ * Argument of the text hooks.
+ */
+struct HookContext {
+    v8::Global<v8::Function> *js_functions;
+    // Alternation texts of the current sub-book, null without appendix.
+    const AltTextMap *alt_text;
+    // Receives targets of references in the text, null if not wanted.
+    std::vector<EB_Position> *references;
+};
+
 /**
  * Initializes libeb. The function calls library initialization routine only
  * once. Subsequent calls to this function will do nothing.
@@ -378,6 +403,292 @@ static size_t PositionToGuid(const EB_Position &pos,
     return out - buffer;
 }
 
+/**
+ * Converts UTF-8 encoded search term \p term to the character encoding
+ * of a dictionary with the character code \p charset.
+ */
+static bool EncodeSearchTerm(EB_Character_Code charset,
+                             const char *term,
+                             size_t term_length,
+                             std::unique_ptr<char[]> &out,
+                             std::error_code &error)
+{
+    // FIXME: what?
+    if (charset != EB_CHARCODE_ISO8859_1) {
+        size_t buffer_size = term_length * 3 + 1;
+        out.reset(new char[buffer_size]);
+        ConvertUtf8ToEucJp(term, term_length + 1, out.get(), buffer_size,
+                           error);
+    } else {
+        size_t buffer_size = term_length + 1;
+        out.reset(new char[buffer_size]);
+        ConvertUtf8ToIso8859_1(term, term_length + 1, out.get(),
+                               buffer_size, error);
+    }
+
+    return !error;
+}
+
+/**
+ * Splits a keyword (`a & b`) or multi search (`#N: a & b`) expression
+ * into terms. Returns false if \p expr is a plain search expression.
+ * \p multi_id is set to -1 for keyword search expressions.
+ */
+static bool ParseCompoundExpression(const char *expr, int &multi_id,
+                                    std::vector<std::string> &terms)
+{
+    static const char kIdeographicSpace[] = "\xe3\x80\x80";
+    static const char kFullwidthAmpersand[] = "\xef\xbc\x86";
+
+    multi_id = -1;
+    terms.clear();
+
+    if (expr[0] == '#') {
+        char *endptr;
+        long id = strtol(expr + 1, &endptr, 10);
+        if (endptr == expr + 1 || *endptr != ':' || id < 0
+            || id >= EB_MAX_MULTI_SEARCHES)
+            return false;
+        multi_id = static_cast<int>(id);
+        expr = endptr + 1;
+    }
+
+    std::string term;
+    auto add_term = [&terms](std::string &term) {
+        size_t begin = 0;
+        size_t end = term.size();
+
+        while (true) {
+            if (begin < end && (term[begin] == ' ' || term[begin] == '\t'))
+                begin += 1;
+            else if (term.compare(begin, 3, kIdeographicSpace) == 0)
+                begin += 3;
+            else
+                break;
+        }
+        while (true) {
+            if (begin < end && (term[end - 1] == ' ' || term[end - 1] == '\t'))
+                end -= 1;
+            else if (end - begin >= 3
+                     && term.compare(end - 3, 3, kIdeographicSpace) == 0)
+                end -= 3;
+            else
+                break;
+        }
+
+        terms.push_back(term.substr(begin, end - begin));
+        term.clear();
+    };
+
+    for (const char *p = expr; *p != '\0';) {
+        if (*p == '&') {
+            add_term(term);
+            p += 1;
+        } else if (strncmp(p, kFullwidthAmpersand, 3) == 0) {
+            add_term(term);
+            p += 3;
+        } else {
+            term.push_back(*p++);
+        }
+    }
+    add_term(term);
+
+    return multi_id >= 0 || terms.size() > 1;
+}
+
+static bool HitTextLess(const EB_Hit &a, const EB_Hit &b)
+{
+    return a.text.page < b.text.page
+        || (a.text.page == b.text.page && a.text.offset < b.text.offset);
+}
+
+static bool HitTextEqual(const EB_Hit &a, const EB_Hit &b)
+{
+    return a.text.page == b.text.page && a.text.offset == b.text.offset;
+}
+
+/**
+ * Retrieves up to \p limit hits of the last search into \p hits. If
+ * \p entries is not null and the search is a word search of a loaded
+ * word index, the index entries of the hits are stored in \p entries and
+ * the start page of the index in \p index_page, which is 0 otherwise.
+ */
+static EB_Error_Code CollectHits(EB_Book *book, size_t limit,
+                                 std::vector<EB_Hit> &hits,
+                                 std::vector<int> *entries = nullptr,
+                                 int *index_page = nullptr)
+{
+    const size_t increase_step = 256;
+
+    if (entries != nullptr) {
+        entries->clear();
+        *index_page = 0;
+    }
+
+    // Since there isn't a way to know number of results in advance, we have
+    // to grow our result buffer incrementally.
+    hits.clear();
+    while (hits.size() < limit) {
+        size_t offset = hits.size();
+        int step = static_cast<int>(std::min(limit - offset, increase_step));
+        int hit_count;
+
+        hits.resize(offset + step);
+        EB_Error_Code eb_code;
+        if (entries != nullptr) {
+            TraceSpan span("eb_hit_list_word_entries", "eb");
+            entries->resize(offset + step);
+            eb_code = eb_hit_list_word_entries(book, step,
+                                               hits.data() + offset,
+                                               entries->data() + offset,
+                                               index_page, &hit_count);
+            // The search doesn't come from a loaded index, the request is
+            // still intact though.
+            if (eb_code == EB_ERR_NO_SUCH_SEARCH && offset == 0) {
+                entries->clear();
+                entries = nullptr;
+                hits.clear();
+                continue;
+            }
+            entries->resize(offset + (eb_code == EB_SUCCESS ? hit_count : 0));
+        } else {
+            TraceSpan span("eb_hit_list", "eb");
+            eb_code = eb_hit_list(book, step, hits.data() + offset,
+                                  &hit_count);
+        }
+        if (eb_code != EB_SUCCESS) {
+            hits.clear();
+            return eb_code;
+        }
+
+        // Any number of search results that is lower than *allocation step*
+        // indicates that we are done.
+        hits.resize(offset + hit_count);
+        if (hit_count < step)
+            break;
+    }
+
+    return EB_SUCCESS;
+}
+
+/**
+ * Leaves in \p hits only entries that are also in \p other. Both lists
+ * must be sorted by HitTextLess() and have no duplicates. \p other is
+ * searched by galloping from the last match, so intersecting a short list
+ * with a long one takes time proportional to the length of the short one
+ * times the logarithm of the distance between matches.
+ */
+static void IntersectHits(std::vector<EB_Hit> &hits,
+                          const std::vector<EB_Hit> &other)
+{
+    auto out = hits.begin();
+    auto first = other.begin();
+
+    for (const EB_Hit &hit : hits) {
+        // Every element before @first is less than @hit.
+        auto last = first;
+        size_t step = 1;
+        while (last != other.end() && HitTextLess(*last, hit)) {
+            first = last + 1;
+            last = static_cast<size_t>(other.end() - first) > step
+                ? first + step
+                : other.end();
+            step *= 2;
+        }
+
+        first = std::lower_bound(first, last, hit, HitTextLess);
+        if (first == other.end())
+            break;
+        if (HitTextEqual(*first, hit))
+            *out++ = hit;
+    }
+
+    hits.erase(out, hits.end());
+}
+
+/**
+ * Converts an alternation text from an appendix to UCS2. Texts of
+ * ISO 8859-1 books are Latin-1, the rest are EUC-JP.
+ */
+static std::u16string AltTextToUcs2(const char *text, EB_Character_Code charset)
+{
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(text);
+    std::u16string result;
+
+    while (*p != '\0') {
+        if (charset == EB_CHARCODE_ISO8859_1 || *p < 0x80) {
+            result.push_back(*p++);
+            continue;
+        }
+
+        ConversionEntry *entry = nullptr;
+        if (p[0] >= 0xa1 && p[0] <= 0xfe && p[1] >= 0xa1 && p[1] <= 0xfe)
+            entry = &g_eucjp_to_ucs2_codeset1_ranges[p[0] - 0xa1][p[1] - 0xa1];
+        else if (p[0] == 0x8e && p[1] >= 0xa1 && p[1] <= 0xdf)
+            entry = &g_eucjp_to_ucs2_codeset2[p[1] - 0xa1];
+
+        if (entry != nullptr && entry->ucs2 != nullptr) {
+            char16_t c;
+            memcpy(&c, entry->ucs2, sizeof(c));
+            result.push_back(c);
+            p += 2;
+        } else {
+            result.push_back(u'?');
+            p += (p[1] != '\0') ? 2 : 1;
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Returns libeb's font code for fonts @height pixels high, or
+ * EB_FONT_INVALID if there are no such fonts.
+ */
+static EB_Font_Code FontCodeForHeight(int height)
+{
+    switch (height) {
+        case EB_HEIGHT_FONT_16: return EB_FONT_16;
+        case EB_HEIGHT_FONT_24: return EB_FONT_24;
+        case EB_HEIGHT_FONT_30: return EB_FONT_30;
+        case EB_HEIGHT_FONT_48: return EB_FONT_48;
+        default: return EB_FONT_INVALID;
+    }
+}
+
+/**
+ * Makes a key for the cache of rendered external characters. Sheets of
+ * all characters use @code 0, which no character has.
+ */
+static uint64_t GaijiCacheKey(int subbook, bool wide, EB_Font_Code font_code,
+                              unsigned int code)
+{
+    return (static_cast<uint64_t>(subbook) << 32)
+        | (static_cast<uint64_t>(wide) << 24)
+        | (static_cast<uint64_t>(font_code) << 16)
+        | (code & 0xffff);
+}
+
+/**
+ * Makes a key for the caches of sound and graphic data.
+ */
+static std::string BinaryCacheKey(int subbook,
+                                  const Dictionary::BinaryLocation &location)
+{
+    char key[128];
+    snprintf(key, sizeof(key), "%d/%d/%s/%s/%dx%d", subbook,
+             static_cast<int>(location.type), location.start,
+             location.end != nullptr ? location.end : "",
+             location.width, location.height);
+    return key;
+}
+
+/**
+ * Upper bound of the memory taken by monochrome graphics converted to PNG
+ * in each dictionary.
+ */
+static const size_t kMonoPngCacheSize = 8 * 1024 * 1024;
+
 static void Print(const v8::FunctionCallbackInfo<v8::Value>& args)
 {
     for (int i = 0; i < args.Length(); i++) {
@@ -675,13 +986,16 @@ public:
      * within a v8 context (Isolate scope, Handle scope, Context scope).
      *
      * Returns the number of characters stored in the @text, or (size_t)-1
-     * in case of an error.
+     * in case of an error. Targets of references met in the text are
+     * appended to @references unless it's null.
      */
     malloc_unique_ptr<uint16_t[]> ReadUcs2Text(ReaderFn function,
                                                EB_Hookset &hookset,
                                                size_t *result_length,
                                                std::error_code &error,
-                                               size_t buffer_size_advice = 4096) {
+                                               size_t buffer_size_advice = 4096,
+                                               std::vector<EB_Position>
+                                                   *references = nullptr) {
 
         assert(buffer_size_advice > 0);
         if (result_length)
@@ -689,6 +1003,13 @@ public:
 
         size_t buffer_size = buffer_size_advice * sizeof(uint16_t);
         uint16_t *buffer = reinterpret_cast<uint16_t *>(malloc(buffer_size));
+        HookContext hook_context = {
+            js_functions_,
+            static_cast<size_t>(current_subbook_) < alt_text_.size()
+                ? &alt_text_[current_subbook_]
+                : nullptr,
+            references
+        };
         size_t growth_exponent = 2;
         ssize_t text_length = 0;
 
@@ -697,7 +1018,7 @@ public:
                 &book_,
                 NULL,
                 &hookset,
-                js_functions_,
+                &hook_context,
                 buffer_size * sizeof(uint16_t),
                 reinterpret_cast<char *>(buffer),
                 &text_length
@@ -781,22 +1102,243 @@ public:
           );
     }
 
-    malloc_unique_ptr<uint16_t[]> ReadCurrentEntryText(size_t *result_length,
-                                                       std::error_code &ec) {
+    malloc_unique_ptr<uint16_t[]> ReadCurrentEntryText(
+            size_t *result_length,
+            std::error_code &ec,
+            std::vector<EB_Position> *references = nullptr) {
         return ReadUcs2Text(
             &eb_read_text,
             text_hookset_,
             result_length,
             ec,
-            4096
+            4096,
+            references
           );
     }
 
+    /**
+     * Reads the whole narrow or wide alternation table of the current
+     * sub-book of @appendix into @alt_text.
+     */
+    bool LoadAltText(EB_Appendix &appendix, bool wide, AltTextMap &alt_text,
+                     std::error_code &error) {
+        if (wide ? !eb_have_wide_alt(&appendix) : !eb_have_narrow_alt(&appendix))
+            return true;
+
+        int code;
+        EB_Error_Code eb_code = wide
+            ? eb_wide_alt_start(&appendix, &code)
+            : eb_narrow_alt_start(&appendix, &code);
+
+        char text[EB_MAX_ALTERNATION_TEXT_LENGTH + 1];
+        while (eb_code == EB_SUCCESS) {
+            eb_code = wide
+                ? eb_wide_alt_character_text(&appendix, code, text)
+                : eb_narrow_alt_character_text(&appendix, code, text);
+            if (eb_code != EB_SUCCESS)
+                break;
+            // Texts taking the whole slot aren't terminated.
+            text[EB_MAX_ALTERNATION_TEXT_LENGTH] = '\0';
+            if (text[0] != '\0') {
+                uint32_t key = code | (wide ? 0x10000 : 0);
+                alt_text[key] = AltTextToUcs2(text, charset_);
+            }
+
+            eb_code = wide
+                ? eb_forward_wide_alt_character(&appendix, 1, &code)
+                : eb_forward_narrow_alt_character(&appendix, 1, &code);
+        }
+
+        // Stepping past the last character ends the table.
+        if (eb_code != EB_SUCCESS && eb_code != EB_ERR_NO_SUCH_CHAR_TEXT) {
+            error = make_error_code(static_cast<eb_error>(eb_code));
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Loads alternation texts of external characters from the appendix
+     * at @path. Appendix sub-books are matched to the sub-books of the
+     * dictionary by directory name. An empty @path drops the texts.
+     */
+    bool BindAppendix(const char *path, std::error_code &error) {
+        std::vector<AltTextMap> alt_text;
+
+        if (path != nullptr && path[0] != '\0') {
+            EB_Subbook_Code subbooks[EB_MAX_SUBBOOKS];
+            EB_Subbook_Code app_subbooks[EB_MAX_SUBBOOKS];
+            int subbook_count = 0;
+            int app_subbook_count = 0;
+            EB_Appendix appendix;
+            EB_Error_Code eb_code;
+
+            eb_initialize_appendix(&appendix);
+            eb_code = eb_bind_appendix(&appendix, path);
+            if (eb_code == EB_SUCCESS)
+                eb_code = eb_subbook_list(&book_, subbooks, &subbook_count);
+            if (eb_code == EB_SUCCESS) {
+                eb_code = eb_appendix_subbook_list(&appendix, app_subbooks,
+                                                   &app_subbook_count);
+            }
+
+            alt_text.resize(subbook_count);
+            for (int i = 0; i < subbook_count && eb_code == EB_SUCCESS; ++i) {
+                char directory[EB_MAX_DIRECTORY_NAME_LENGTH + 1];
+                char app_directory[EB_MAX_DIRECTORY_NAME_LENGTH + 1];
+
+                eb_code = eb_subbook_directory2(&book_, subbooks[i], directory);
+                for (int j = 0; j < app_subbook_count && eb_code == EB_SUCCESS;
+                     ++j) {
+                    eb_code = eb_appendix_subbook_directory2(
+                        &appendix, app_subbooks[j], app_directory);
+                    if (eb_code != EB_SUCCESS
+                        || strcasecmp(directory, app_directory) != 0)
+                        continue;
+
+                    eb_code = eb_set_appendix_subbook(&appendix,
+                                                      app_subbooks[j]);
+                    if (eb_code == EB_SUCCESS
+                        && (!LoadAltText(appendix, false, alt_text[i], error)
+                            || !LoadAltText(appendix, true, alt_text[i],
+                                            error))) {
+                        eb_finalize_appendix(&appendix);
+                        return false;
+                    }
+                    break;
+                }
+            }
+            eb_finalize_appendix(&appendix);
+
+            if (eb_code != EB_SUCCESS) {
+                error = make_error_code(static_cast<eb_error>(eb_code));
+                return false;
+            }
+        }
+
+        alt_text_ = std::move(alt_text);
+        appendix_path_ = path != nullptr ? path : "";
+        return true;
+    }
+
+    /**
+     * Loads the backlink index at @path and checks that it was made for
+     * this book. An empty @path drops the index.
+     */
+    bool BindBacklinks(const char *path, std::error_code &error) {
+        std::unique_ptr<BacklinkIndex> index;
+
+        if (path != nullptr && path[0] != '\0') {
+            auto likely_index = BacklinkIndex::Load(path);
+            if (likely_index.is_error()) {
+                error = likely_index.error_code();
+                return false;
+            }
+            index.reset(likely_index.value_checked());
+
+            EB_Subbook_Code subbooks[EB_MAX_SUBBOOKS];
+            int subbook_count = 0;
+            EB_Error_Code eb_code = eb_subbook_list(&book_, subbooks,
+                                                    &subbook_count);
+            if (eb_code != EB_SUCCESS) {
+                error = make_error_code(static_cast<eb_error>(eb_code));
+                return false;
+            }
+            if (index->GetSubBookCount() != subbook_count) {
+                error = make_error_code(simplify_error::bad_backlink_index);
+                return false;
+            }
+        }
+
+        backlinks_ = std::move(index);
+        backlinks_path_ = path != nullptr ? path : "";
+        return true;
+    }
+
+    /**
+     * Loads the full-text index at @path and checks that it was made for
+     * this book. An empty @path drops the index.
+     */
+    bool BindFullText(const char *path, std::error_code &error) {
+        std::unique_ptr<FullTextIndex> index;
+
+        if (path != nullptr && path[0] != '\0') {
+            auto likely_index = FullTextIndex::Load(path);
+            if (likely_index.is_error()) {
+                error = likely_index.error_code();
+                return false;
+            }
+            index.reset(likely_index.value_checked());
+
+            EB_Subbook_Code subbooks[EB_MAX_SUBBOOKS];
+            int subbook_count = 0;
+            EB_Error_Code eb_code = eb_subbook_list(&book_, subbooks,
+                                                    &subbook_count);
+            if (eb_code != EB_SUCCESS) {
+                error = make_error_code(static_cast<eb_error>(eb_code));
+                return false;
+            }
+            if (index->GetSubBookCount() != subbook_count) {
+                error = make_error_code(simplify_error::bad_fulltext_index);
+                return false;
+            }
+        }
+
+        fulltext_ = std::move(index);
+        fulltext_path_ = path != nullptr ? path : "";
+        return true;
+    }
+
+    /**
+     * Selects the narrow or wide font identified by @font_code in the
+     * current sub-book and stores its glyph width in @width. Must be
+     * called with mutex_ held.
+     */
+    bool SelectFont(EB_Font_Code font_code, bool wide, int *width,
+                    std::error_code &error) {
+        if (!eb_have_font(&book_, font_code)) {
+            error = make_error_code(simplify_error::no_gaiji);
+            return false;
+        }
+
+        EB_Error_Code eb_code = eb_set_font(&book_, font_code);
+        if (eb_code != EB_SUCCESS) {
+            error = make_error_code(static_cast<eb_error>(eb_code));
+            return false;
+        }
+
+        if (wide ? !eb_have_wide_font(&book_) : !eb_have_narrow_font(&book_)) {
+            error = make_error_code(simplify_error::no_gaiji);
+            return false;
+        }
+
+        eb_code = wide
+            ? eb_wide_font_width2(font_code, width)
+            : eb_narrow_font_width2(font_code, width);
+        if (eb_code != EB_SUCCESS) {
+            error = make_error_code(static_cast<eb_error>(eb_code));
+            return false;
+        }
+        return true;
+    }
+
+    inline EB_Error_Code ReadGlyph(bool wide, unsigned int code,
+                                   char *bitmap) {
+        return wide
+            ? eb_wide_font_character_bitmap(&book_, code, bitmap)
+            : eb_narrow_font_character_bitmap(&book_, code, bitmap);
+    }
+
     inline v8::Local<v8::Context> GetJsContext() {
       return js_context_handle_.Get(isolate_.get());
     }
 
 public:
+    // Serializes use of book_ by concurrent requests. libeb only guards
+    // single calls, while seeking and reading text take several. Always
+    // locked before the isolate.
+    std::mutex mutex_;
+
     EB_Book book_;
     EB_Character_Code charset_;
     EB_Hookset head_hookset_;
@@ -805,6 +1347,40 @@ public:
 
     int current_subbook_;
     std::string script_path_;
+    std::string appendix_path_;
+    std::string backlinks_path_;
+    std::string fulltext_path_;
+
+    // Index of references between texts, null if none is bound.
+    std::unique_ptr<BacklinkIndex> backlinks_;
+
+    // Full-text index of the book, null if none is bound.
+    std::unique_ptr<FullTextIndex> fulltext_;
+
+    // Alternation texts of external characters indexed by sub-book.
+    // Empty if there's no appendix.
+    std::vector<AltTextMap> alt_text_;
+
+    // The stream which set the book's binary context last and the offset
+    // of its next read, see EbBinaryStream. Guarded by mutex_.
+    const void *binary_owner_ = nullptr;
+    uint64_t binary_offset_ = 0;
+
+    // Sizes of color graphics which don't record their size, keyed by
+    // BinaryCacheKey(). Guarded by mutex_.
+    std::unordered_map<std::string, uint64_t> graphic_sizes_;
+
+    // Monochrome graphics converted to PNG, keyed by BinaryCacheKey().
+    // Dropped when it grows past kMonoPngCacheSize. Guarded by mutex_.
+    std::unordered_map<std::string, std::shared_ptr<const std::string>>
+        mono_png_cache_;
+    size_t mono_png_cache_size_ = 0;
+
+    // PNG images of external characters and sheets of them, see
+    // GaijiCacheKey(). Fonts are small and fixed, so this is never
+    // evicted. Guarded by mutex_.
+    std::unordered_map<uint64_t, std::shared_ptr<const std::string>>
+        gaiji_cache_;
 
     ArrayBufferAllocator array_buffer_allocator_;
     std::unique_ptr<v8::Isolate, std::function<void (v8::Isolate *)>> isolate_;
@@ -814,12 +1390,10 @@ public:
 
 class EbSearchResults : public Dictionary::SearchResults {
 public:
-    EbSearchResults(EpwingDictionary::Private *p,
-                    size_t hit_count,
-                    malloc_unique_ptr<EB_Hit[]> hits)
+    EbSearchResults(EpwingDictionary::Private *p, std::vector<EB_Hit> hits)
       : d(p),
         hit_offset_(static_cast<size_t>(-1)),
-        hit_count_(hit_count),
+        hit_count_(hits.size()),
         hits_(std::move(hits))
     {
     }
@@ -831,13 +1405,41 @@ public:
     }
 
     std::error_code SeekNext() override {
+        std::lock_guard<std::mutex> lock(d->mutex_);
+        return SeekNextLocked();
+    }
+
+    Likely<std::unique_ptr<char[]>> FetchHeading(size_t *result_size) override {
+        return FetchHelper(JsFunction::ProcessHeading, result_size);
+    }
+
+    Likely<std::unique_ptr<char[]>> FetchTags(size_t *result_size) override {
+        return FetchHelper(JsFunction::ProcessTags, result_size);
+    }
+
+    Likely<size_t> FetchGuid(char *buffer, size_t buffer_size) override {
+        std::error_code error;
+        size_t length = PositionToGuid(hits_[hit_offset_].text,
+                                       buffer, buffer_size, error);
+        if (length != (size_t) -1)
+            return length;
+        else
+            return error;
+    }
+
+private:
+    std::error_code SeekNextLocked() {
         size_t offset = hit_offset_ + 1;
         std::error_code e;
 
         if (unlikely(offset >= hit_count_))
             return make_error_code(simplify_error::no_more_results);
-        else if (unlikely(!d->SeekEntity(hits_[offset].heading, e)))
-            return e;
+
+        {
+            TraceSpan span("eb_seek_text", "eb");
+            if (unlikely(!d->SeekEntity(hits_[offset].heading, e)))
+                return e;
+        }
 
         hit_offset_ = offset;
 
@@ -852,12 +1454,13 @@ public:
 
             if (unlikely(prevText.page == thisText.page &&
                          prevText.offset == thisText.offset))
-                return SeekNext();
+                return SeekNextLocked();
         }
 
         ENTER_ISOLATE(d->isolate_.get());
         ENTER_CONTEXT(d->GetJsContext());
 
+        TraceSpan span("eb_read_heading", "eb");
         malloc_unique_ptr<uint16_t[]> result =
             d->ReadCurrentEntryTitle(&current_entry_length_, e);
         current_entry_text_.reset(result.release(), result.get_deleter());
@@ -865,27 +1468,10 @@ public:
         return e;
     }
 
-    Likely<std::unique_ptr<char[]>> FetchHeading(size_t *result_size) override {
-        return FetchHelper(JsFunction::ProcessHeading, result_size);
-    }
-
-    Likely<std::unique_ptr<char[]>> FetchTags(size_t *result_size) override {
-        return FetchHelper(JsFunction::ProcessTags, result_size);
-    }
-
-    Likely<size_t> FetchGuid(char *buffer, size_t buffer_size) override {
-        std::error_code error;
-        size_t length = PositionToGuid(hits_[hit_offset_].text,
-                                       buffer, buffer_size, error);
-        if (length != (size_t) -1)
-            return length;
-        else
-            return error;
-    }
-
-private:
     Likely<std::unique_ptr<char[]>> FetchHelper(JsFunction function,
                                                 size_t *result_size) {
+        TraceSpan span(g_js_function_names[static_cast<size_t>(function)],
+                       "js");
         ENTER_ISOLATE(d->isolate_.get());
         ENTER_CONTEXT(d->GetJsContext());
         return d->RefineDictionaryEntry(
@@ -900,20 +1486,311 @@ private:
     EpwingDictionary::Private *d;
     size_t hit_offset_;
     size_t hit_count_;
-    malloc_unique_ptr<EB_Hit[]> hits_;
+    std::vector<EB_Hit> hits_;
     size_t current_entry_length_;
     std::shared_ptr<uint16_t> current_entry_text_;
     v8::Global<v8::Object> current_this_object_;
 };
 
-EpwingDictionary::EpwingDictionary(const char *name) : Dictionary(name)
-{
-    d = new Private();
-}
+/**
+ * Hits of the last word search of a session, kept if they are all the
+ * hits of the search.
+ */
+class EbSearchSession : public Dictionary::SearchSession {
+public:
+    bool complete = false;
+    std::string expr;
+    int subbook = -1;
+    int index_page = 0;
+    std::vector<EB_Hit> hits;
+    // Word index entries of the hits.
+    std::vector<int> entries;
+};
 
-EpwingDictionary::EpwingDictionary(std::string name) : Dictionary(std::move(name))
+/**
+ * Word search for \p expr (\p conv_expr in the book's encoding) within
+ * \p session. If the session holds all hits of an expression \p expr
+ * extends, they are narrowed down in memory, otherwise the book is
+ * searched. Up to \p limit hits are stored in \p hits.
+ */
+static EB_Error_Code SearchWordInSession(EB_Book *book, int subbook,
+                                         EbSearchSession &session,
+                                         const char *expr,
+                                         const char *conv_expr,
+                                         size_t limit,
+                                         std::vector<EB_Hit> &hits)
 {
-    d = new Private();
+    EB_Error_Code eb_code;
+
+    if (session.complete && session.subbook == subbook
+        && strncmp(expr, session.expr.c_str(), session.expr.size()) == 0) {
+        int hit_count = static_cast<int>(session.hits.size());
+        {
+            TraceSpan span("eb_narrow_word_hits", "eb");
+            eb_code = eb_narrow_word_hits(book, conv_expr, session.index_page,
+                                          session.hits.data(),
+                                          session.entries.data(),
+                                          &hit_count);
+        }
+        // A longer expression may be looked up in another index, e.g.
+        // when a latin letter follows kana.
+        if (eb_code == EB_SUCCESS) {
+            session.hits.resize(hit_count);
+            session.entries.resize(hit_count);
+            session.expr = expr;
+            hits.assign(session.hits.begin(),
+                        session.hits.begin()
+                            + std::min(limit, session.hits.size()));
+            return EB_SUCCESS;
+        }
+    }
+
+    session.complete = false;
+    session.hits.clear();
+    session.entries.clear();
+
+    {
+        TraceSpan span("eb_search_word", "eb");
+        eb_code = eb_search_word(book, conv_expr);
+    }
+    if (eb_code != EB_SUCCESS)
+        return eb_code;
+
+    // Collect a hit more than needed to tell whether these are all hits.
+    size_t collect_limit = limit < static_cast<size_t>(
+                                       std::numeric_limits<int>::max())
+        ? limit + 1
+        : limit;
+    eb_code = CollectHits(book, collect_limit, hits, &session.entries,
+                          &session.index_page);
+    if (eb_code != EB_SUCCESS)
+        return eb_code;
+
+    if (session.index_page != 0 && hits.size() < collect_limit) {
+        session.complete = true;
+        session.expr = expr;
+        session.subbook = subbook;
+        session.hits = hits;
+    } else {
+        session.entries.clear();
+    }
+    if (hits.size() > limit)
+        hits.resize(limit);
+
+    return EB_SUCCESS;
+}
+
+/**
+ * Reads sound and color graphics in parts. A book has a single binary
+ * context, so a stream sets it up again if another stream has used it
+ * since the stream's last read.
+ */
+class EbBinaryStream : public Dictionary::BinaryStream {
+public:
+    EbBinaryStream(EpwingDictionary::Private *p, Dictionary::BinaryType type,
+                   const EB_Position &start, const EB_Position &end)
+      : d(p),
+        type_(type),
+        start_(start),
+        end_(end),
+        content_type_("application/octet-stream"),
+        size_(0)
+    {
+    }
+
+    ~EbBinaryStream() override {
+        std::lock_guard<std::mutex> lock(d->mutex_);
+        if (d->binary_owner_ == this)
+            d->binary_owner_ = nullptr;
+    }
+
+    /**
+     * Determines type and size of the data. Color graphics without size
+     * are JPEG images and are read until their end marker once. Must be
+     * called with mutex_ held.
+     */
+    std::error_code Open(const std::string &cache_key) {
+        EB_Error_Code eb_code = Select();
+        size_t size = 0;
+        if (eb_code == EB_SUCCESS)
+            eb_code = eb_binary_size(&d->book_, &size);
+        size_ = size;
+
+        char magic[4] = {};
+        ssize_t magic_length = 0;
+        if (eb_code == EB_SUCCESS) {
+            eb_code = eb_read_binary(&d->book_, sizeof(magic), magic,
+                                     &magic_length);
+        }
+        if (eb_code != EB_SUCCESS)
+            return make_error_code(static_cast<eb_error>(eb_code));
+
+        if (type_ == Dictionary::BinaryType::Sound)
+            content_type_ = "audio/wav";
+        else if (magic_length >= 2 && memcmp(magic, "BM", 2) == 0)
+            content_type_ = "image/bmp";
+        else if (magic_length >= 2 && memcmp(magic, "\xff\xd8", 2) == 0)
+            content_type_ = "image/jpeg";
+
+        if (size_ == 0) {
+            auto it = d->graphic_sizes_.find(cache_key);
+            if (it != d->graphic_sizes_.end()) {
+                size_ = it->second;
+            } else {
+                std::error_code ec = FindJpegEnd(magic, magic_length);
+                if (ec)
+                    return ec;
+                d->graphic_sizes_.emplace(cache_key, size_);
+            }
+        }
+
+        // The context was read past the start.
+        d->binary_owner_ = nullptr;
+        return make_error_code(simplify_error::success);
+    }
+
+    const char *GetContentType() const override {
+        return content_type_;
+    }
+
+    uint64_t GetSize() const override {
+        return size_;
+    }
+
+    Likely<size_t> Read(uint64_t offset, char *buffer, size_t size) override {
+        if (offset >= size_)
+            return static_cast<size_t>(0);
+        if (size > size_ - offset)
+            size = static_cast<size_t>(size_ - offset);
+
+        std::lock_guard<std::mutex> lock(d->mutex_);
+        EB_Error_Code eb_code = EB_SUCCESS;
+
+        if (d->binary_owner_ != this || d->binary_offset_ != offset) {
+            eb_code = Select();
+            if (eb_code == EB_SUCCESS)
+                eb_code = eb_seek_binary(&d->book_, offset);
+            if (eb_code != EB_SUCCESS) {
+                d->binary_owner_ = nullptr;
+                return make_error_code(static_cast<eb_error>(eb_code));
+            }
+            d->binary_owner_ = this;
+        }
+
+        size_t total = 0;
+        while (total < size) {
+            ssize_t length;
+            eb_code = eb_read_binary(&d->book_, size - total, buffer + total,
+                                     &length);
+            if (eb_code != EB_SUCCESS) {
+                d->binary_owner_ = nullptr;
+                return make_error_code(static_cast<eb_error>(eb_code));
+            }
+            if (length == 0)
+                break;
+            total += length;
+        }
+
+        d->binary_offset_ = offset + total;
+        return total;
+    }
+
+private:
+    EB_Error_Code Select() {
+        if (type_ == Dictionary::BinaryType::Sound)
+            return eb_set_binary_wave(&d->book_, &start_, &end_);
+        else
+            return eb_set_binary_color_graphic(&d->book_, &start_);
+    }
+
+    /**
+     * Sets size_ to the offset just past the end marker of a JPEG image.
+     * @head holds the bytes read already.
+     */
+    std::error_code FindJpegEnd(const char *head, size_t head_length) {
+        // Images of EPWING books are far smaller than this.
+        const uint64_t max_size = 16 * 1024 * 1024;
+        std::unique_ptr<char[]> buffer(new char[EB_SIZE_PAGE * 16]);
+        unsigned char last = 0;
+        uint64_t offset = 0;
+
+        memcpy(buffer.get(), head, head_length);
+        size_t length = head_length;
+        while (offset < max_size) {
+            for (size_t i = 0; i < length; ++i) {
+                unsigned char c = static_cast<unsigned char>(buffer[i]);
+                if (last == 0xff && c == 0xd9) {
+                    size_ = offset + i + 1;
+                    return make_error_code(simplify_error::success);
+                }
+                last = c;
+            }
+            offset += length;
+
+            ssize_t read_length;
+            EB_Error_Code eb_code = eb_read_binary(&d->book_,
+                                                   EB_SIZE_PAGE * 16,
+                                                   buffer.get(), &read_length);
+            if (eb_code != EB_SUCCESS)
+                return make_error_code(static_cast<eb_error>(eb_code));
+            if (read_length <= 0)
+                break;
+            length = static_cast<size_t>(read_length);
+        }
+
+        return make_error_code(static_cast<eb_error>(EB_ERR_UNEXP_BINARY));
+    }
+
+private:
+    EpwingDictionary::Private *d;
+    Dictionary::BinaryType type_;
+    EB_Position start_;
+    EB_Position end_;
+    const char *content_type_;
+    uint64_t size_;
+};
+
+/**
+ * Serves an image converted in advance.
+ */
+class EbImageStream : public Dictionary::BinaryStream {
+public:
+    EbImageStream(std::shared_ptr<const std::string> image,
+                  const char *content_type)
+      : image_(std::move(image)),
+        content_type_(content_type)
+    {
+    }
+
+    const char *GetContentType() const override {
+        return content_type_;
+    }
+
+    uint64_t GetSize() const override {
+        return image_->size();
+    }
+
+    Likely<size_t> Read(uint64_t offset, char *buffer, size_t size) override {
+        if (offset >= image_->size())
+            return static_cast<size_t>(0);
+        size = std::min(size, static_cast<size_t>(image_->size() - offset));
+        memcpy(buffer, image_->data() + offset, size);
+        return size;
+    }
+
+private:
+    std::shared_ptr<const std::string> image_;
+    const char *content_type_;
+};
+
+EpwingDictionary::EpwingDictionary(const char *name) : Dictionary(name)
+{
+    d = new Private();
+}
+
+EpwingDictionary::EpwingDictionary(std::string name) : Dictionary(std::move(name))
+{
+    d = new Private();
 }
 
 EpwingDictionary::~EpwingDictionary()
@@ -931,6 +1808,7 @@ Likely<std::vector<std::string>> EpwingDictionary::ListSubBooks() const
     EB_Subbook_Code subbook_list[EB_MAX_SUBBOOKS];
     int subbook_count;
 
+    std::lock_guard<std::mutex> lock(d->mutex_);
     int error = eb_subbook_list(&d->book_, subbook_list, &subbook_count);
     if (error != EB_SUCCESS)
         return make_error_code(static_cast<eb_error>(error));
@@ -965,10 +1843,70 @@ Likely<std::vector<std::string>> EpwingDictionary::ListSubBooks() const
     return names_list;
 }
 
+std::error_code EpwingDictionary::BindAppendix(const char *path)
+{
+    TraceSpan span("EpwingDictionary::BindAppendix", "simplify", path);
+    std::error_code error;
+    bool bound;
+
+    {
+        std::lock_guard<std::mutex> lock(d->mutex_);
+        bound = d->BindAppendix(path, error);
+    }
+
+    // Appendix path is part of permanent state.
+    if (bound)
+        this->SaveState();
+
+    return error;
+}
+
+std::error_code EpwingDictionary::BindBacklinks(const char *path)
+{
+    TraceSpan span("EpwingDictionary::BindBacklinks", "simplify", path);
+    std::error_code error;
+    bool bound;
+
+    {
+        std::lock_guard<std::mutex> lock(d->mutex_);
+        bound = d->BindBacklinks(path, error);
+    }
+
+    // Index path is part of permanent state.
+    if (bound)
+        this->SaveState();
+
+    return error;
+}
+
+std::error_code EpwingDictionary::BindFullText(const char *path)
+{
+    TraceSpan span("EpwingDictionary::BindFullText", "simplify", path);
+    std::error_code error;
+    bool bound;
+
+    {
+        std::lock_guard<std::mutex> lock(d->mutex_);
+        bound = d->BindFullText(path, error);
+    }
+
+    // Index path is part of permanent state.
+    if (bound)
+        this->SaveState();
+
+    return error;
+}
+
 std::error_code EpwingDictionary::SelectSubBook(int subbook_index) {
     std::error_code error;
+    bool selected;
 
-    if (d->SelectSubBook(subbook_index, error)) {
+    {
+        std::lock_guard<std::mutex> lock(d->mutex_);
+        selected = d->SelectSubBook(subbook_index, error);
+    }
+
+    if (selected) {
         // Currently selected sub-book is part of permanent state, so save it.
         this->SaveState();
     }
@@ -979,6 +1917,29 @@ std::error_code EpwingDictionary::SelectSubBook(int subbook_index) {
 Likely<Dictionary::SearchResults *> EpwingDictionary::Search(const char *expr,
                                                              size_t limit)
 {
+    return Search(expr, limit, nullptr);
+}
+
+Likely<Dictionary::SearchResults *>
+EpwingDictionary::Search(const char *expr, size_t limit,
+                         SearchSession *session)
+{
+    TraceSpan span("EpwingDictionary::Search", "simplify", expr);
+
+    // Keyword and multi search expressions are handled separately. In
+    // books without a keyword index '&' is looked up as is.
+    {
+        int multi_id;
+        std::vector<std::string> terms;
+
+        if (ParseCompoundExpression(expr, multi_id, terms)) {
+            auto results = SearchIntersection(multi_id, terms, limit);
+            if (results || multi_id >= 0
+                || results.error_code() != simplify_error::no_keyword_search)
+                return results;
+        }
+    }
+
     size_t expr_length = strlen(expr);
 
     // Don't try if the search expression is too long.
@@ -989,25 +1950,10 @@ Likely<Dictionary::SearchResults *> EpwingDictionary::Search(const char *expr,
     // required by the dictionary.
     std::unique_ptr<char[]> conv_expr;
     std::error_code last_error;
-
-    // FIXME: what?
-    if (d->charset_ != EB_CHARCODE_ISO8859_1) {
-        size_t buffer_size = expr_length * 3 + 1;
-        conv_expr.reset(new char[buffer_size]);
-
-        ConvertUtf8ToEucJp(
-            expr, expr_length + 1,
-            conv_expr.get(), buffer_size,
-            last_error
-          );
-    } else {
-        size_t buffer_size = expr_length + 1;
-        conv_expr.reset(new char[buffer_size]);
-        ConvertUtf8ToIso8859_1(
-            expr, expr_length + 1,
-            conv_expr.get(), buffer_size,
-            last_error
-          );
+    {
+        TraceSpan span("encode_query", "simplify");
+        EncodeSearchTerm(d->charset_, expr, expr_length, conv_expr,
+                         last_error);
     }
 
     if (last_error) return last_error;
@@ -1038,31 +1984,90 @@ Likely<Dictionary::SearchResults *> EpwingDictionary::Search(const char *expr,
     else
         return make_error_code(simplify_error::cant_search);
 
-    // Perform search using selected search method.
-    EB_Error_Code eb_code = (*search_fun)(&d->book_, conv_expr.get());
+    // Perform search using selected search method. The lock is held until
+    // hits are collected, since they come from the book's search context.
+    std::lock_guard<std::mutex> lock(d->mutex_);
+    EB_Error_Code eb_code;
+
+    if (session != nullptr && search_fun == &eb_search_word) {
+        std::vector<EB_Hit> hits;
+        eb_code = SearchWordInSession(&d->book_, d->current_subbook_,
+                                      static_cast<EbSearchSession &>(*session),
+                                      expr, conv_expr.get(), limit, hits);
+        if (eb_code != EB_SUCCESS)
+            return make_error_code(static_cast<eb_error>(eb_code));
+        return new EbSearchResults(d, std::move(hits));
+    }
+
+    {
+        TraceSpan span(search_fun == &eb_search_word
+                       ? "eb_search_word"
+                       : "eb_search_exactword", "eb");
+        eb_code = (*search_fun)(&d->book_, conv_expr.get());
+    }
     if (eb_code != EB_SUCCESS)
         return make_error_code(static_cast<eb_error>(eb_code));
 
     return GetResults(limit);
 }
 
+std::unique_ptr<Dictionary::SearchSession>
+EpwingDictionary::NewSearchSession()
+{
+    return std::unique_ptr<SearchSession>(new EbSearchSession());
+}
+
 Likely<std::unique_ptr<char[]>> EpwingDictionary::ReadText(const char *guid,
                                                            size_t *text_length)
 {
+    return ReadText(guid, text_length, nullptr);
+}
+
+Likely<std::unique_ptr<char[]>>
+EpwingDictionary::ReadText(const char *guid, size_t *text_length,
+                           std::vector<std::string> *references)
+{
+    TraceSpan span("EpwingDictionary::ReadText", "simplify", guid);
     EB_Position position;
     std::error_code ec;
 
-    if (!GuidToPosition(guid, position, ec) || !d->SeekText(position, ec))
+    if (!GuidToPosition(guid, position, ec))
         return ec;
 
+    std::lock_guard<std::mutex> lock(d->mutex_);
+    {
+        TraceSpan span("eb_seek_text", "eb");
+        if (!d->SeekText(position, ec))
+            return ec;
+    }
+
     ENTER_ISOLATE(d->isolate_.get());
     ENTER_CONTEXT(d->GetJsContext());
 
     size_t entry_length = 0;
-    malloc_unique_ptr<uint16_t[]> entry_text =
-        d->ReadCurrentEntryText(&entry_length, ec);
+    malloc_unique_ptr<uint16_t[]> entry_text(nullptr, ::free);
+    std::vector<EB_Position> positions;
+    {
+        TraceSpan span("eb_read_text", "eb");
+        entry_text = d->ReadCurrentEntryText(
+            &entry_length, ec, references != nullptr ? &positions : nullptr);
+    }
+
+    if (references != nullptr) {
+        references->clear();
+        for (const EB_Position &pos : positions) {
+            char ref_guid[32];
+            if (PositionToGuid(pos, ref_guid, sizeof(ref_guid), ec)
+                    == (size_t) -1)
+                continue;
+            if (std::find(references->begin(), references->end(), ref_guid)
+                    == references->end())
+                references->emplace_back(ref_guid);
+        }
+    }
 
     if (entry_text) {
+      TraceSpan span("ProcessText", "js");
       std::shared_ptr<uint16_t> shared_text{entry_text.release(),
                                             entry_text.get_deleter()};
       return d->RefineDictionaryEntry(
@@ -1076,46 +2081,428 @@ Likely<std::unique_ptr<char[]>> EpwingDictionary::ReadText(const char *guid,
     }
 }
 
+Likely<std::shared_ptr<const std::string>>
+EpwingDictionary::RenderGaiji(unsigned int code, bool wide, int height)
+{
+    TraceSpan span("EpwingDictionary::RenderGaiji", "simplify");
+    EB_Font_Code font_code = FontCodeForHeight(height);
+
+    if (font_code == EB_FONT_INVALID)
+        return make_error_code(simplify_error::no_gaiji);
+
+    std::lock_guard<std::mutex> lock(d->mutex_);
+    uint64_t key = GaijiCacheKey(d->current_subbook_, wide, font_code, code);
+    auto it = d->gaiji_cache_.find(key);
+    if (it != d->gaiji_cache_.end())
+        return it->second;
+
+    std::error_code ec;
+    int width;
+    if (!d->SelectFont(font_code, wide, &width, ec))
+        return ec;
+
+    char bitmap[EB_SIZE_WIDE_FONT_48];
+    EB_Error_Code eb_code = d->ReadGlyph(wide, code, bitmap);
+    if (eb_code != EB_SUCCESS)
+        return make_error_code(static_cast<eb_error>(eb_code));
+
+    char png[EB_SIZE_WIDE_FONT_48_PNG];
+    size_t png_length;
+    eb_code = eb_bitmap_to_png(bitmap, width, height, png, &png_length);
+    if (eb_code != EB_SUCCESS)
+        return make_error_code(static_cast<eb_error>(eb_code));
+
+    auto image = std::make_shared<const std::string>(png, png_length);
+    d->gaiji_cache_.emplace(key, image);
+    return image;
+}
+
+Likely<std::shared_ptr<const std::string>>
+EpwingDictionary::RenderGaijiSheet(bool wide, int height,
+                                   GaijiSheetLayout *layout)
+{
+    TraceSpan span("EpwingDictionary::RenderGaijiSheet", "simplify");
+    EB_Font_Code font_code = FontCodeForHeight(height);
+
+    if (font_code == EB_FONT_INVALID)
+        return make_error_code(simplify_error::no_gaiji);
+
+    std::lock_guard<std::mutex> lock(d->mutex_);
+    std::error_code ec;
+    int glyph_width;
+    if (!d->SelectFont(font_code, wide, &glyph_width, ec))
+        return ec;
+
+    int start, end;
+    EB_Error_Code eb_code = wide
+        ? eb_wide_font_start(&d->book_, &start)
+        : eb_narrow_font_start(&d->book_, &start);
+    if (eb_code == EB_SUCCESS) {
+        eb_code = wide
+            ? eb_wide_font_end(&d->book_, &end)
+            : eb_narrow_font_end(&d->book_, &end);
+    }
+    if (eb_code != EB_SUCCESS)
+        return make_error_code(static_cast<eb_error>(eb_code));
+
+    // Rows of the sheet are the high bytes of character codes, columns
+    // are the low bytes, the same as the code ranges of libeb.
+    GaijiSheetLayout sheet;
+    sheet.glyph_width = glyph_width;
+    sheet.glyph_height = height;
+    sheet.start = static_cast<unsigned int>(start);
+    sheet.end = static_cast<unsigned int>(end);
+    if (d->charset_ == EB_CHARCODE_ISO8859_1) {
+        sheet.first_column = 0x01;
+        sheet.columns = 0xfe;
+    } else {
+        sheet.first_column = 0x21;
+        sheet.columns = 0x7e - 0x21 + 1;
+    }
+    if (layout != nullptr)
+        *layout = sheet;
+
+    uint64_t key = GaijiCacheKey(d->current_subbook_, wide, font_code, 0);
+    auto it = d->gaiji_cache_.find(key);
+    if (it != d->gaiji_cache_.end())
+        return it->second;
+
+    // Widths of all EPWING fonts are multiples of 8, so glyphs are
+    // copied into the sheet byte by byte.
+    size_t glyph_line = glyph_width / 8;
+    size_t sheet_line = glyph_line * sheet.columns;
+    size_t rows = (sheet.end >> 8) - (sheet.start >> 8) + 1;
+    size_t sheet_size = sheet_line * height * rows;
+    std::unique_ptr<char[]> bitmap(new char[sheet_size]());
+    char glyph[EB_SIZE_WIDE_FONT_48];
+
+    for (unsigned int code = sheet.start; code <= sheet.end; ++code) {
+        unsigned int column = code & 0xff;
+        if (column < sheet.first_column
+            || column >= sheet.first_column + sheet.columns)
+            continue;
+
+        eb_code = d->ReadGlyph(wide, code, glyph);
+        if (eb_code != EB_SUCCESS)
+            return make_error_code(static_cast<eb_error>(eb_code));
+
+        size_t row = (code >> 8) - (sheet.start >> 8);
+        char *dest = bitmap.get() + row * height * sheet_line
+            + (column - sheet.first_column) * glyph_line;
+        for (int y = 0; y < height; ++y)
+            memcpy(dest + y * sheet_line, glyph + y * glyph_line, glyph_line);
+    }
+
+    // Deflate reads the bitmap plus a filter byte per line. An eighth
+    // more and 256 bytes cover its worst case and the PNG chunks around.
+    std::string png(sheet_size + rows * height + sheet_size / 8 + 256, '\0');
+    size_t png_length;
+    {
+        TraceSpan span("eb_bitmap_to_png", "eb");
+        eb_code = eb_bitmap_to_png(bitmap.get(),
+                                   static_cast<int>(sheet_line * 8),
+                                   static_cast<int>(height * rows),
+                                   &png[0], &png_length);
+    }
+    if (eb_code != EB_SUCCESS)
+        return make_error_code(static_cast<eb_error>(eb_code));
+    png.resize(png_length);
+
+    auto image = std::make_shared<const std::string>(std::move(png));
+    d->gaiji_cache_.emplace(key, image);
+    return image;
+}
+
+Likely<Dictionary::BinaryStream *>
+EpwingDictionary::OpenBinary(const BinaryLocation &location)
+{
+    TraceSpan span("EpwingDictionary::OpenBinary", "simplify", location.start);
+    EB_Position start;
+    EB_Position end = {0, 0};
+    std::error_code ec;
+
+    if (location.start == nullptr || !GuidToPosition(location.start, start, ec))
+        return ec ? ec : make_error_code(simplify_error::bad_guid);
+    if (location.type == BinaryType::Sound
+        && (location.end == nullptr || !GuidToPosition(location.end, end, ec)))
+        return ec ? ec : make_error_code(simplify_error::bad_guid);
+
+    // The destructor of a stream takes the mutex, so a stream that fails
+    // to open must outlive the lock.
+    std::unique_ptr<EbBinaryStream> stream;
+    std::lock_guard<std::mutex> lock(d->mutex_);
+    std::string key = BinaryCacheKey(d->current_subbook_, location);
+
+    if (location.type != BinaryType::MonoGraphic) {
+        stream.reset(new EbBinaryStream(d, location.type, start, end));
+        ec = stream->Open(key);
+        if (ec)
+            return ec;
+        return stream.release();
+    }
+
+    auto it = d->mono_png_cache_.find(key);
+    if (it != d->mono_png_cache_.end())
+        return new EbImageStream(it->second, "image/png");
+
+    // libeb returns monochrome graphics as BMP, which has its lines
+    // bottom-up and padded to 4 bytes. PNG wants them top-down.
+    EB_Error_Code eb_code = eb_set_binary_mono_graphic(
+        &d->book_, &start, location.width, location.height);
+    std::string bmp;
+    while (eb_code == EB_SUCCESS) {
+        char buffer[EB_SIZE_PAGE * 4];
+        ssize_t length;
+        eb_code = eb_read_binary(&d->book_, sizeof(buffer), buffer, &length);
+        if (eb_code != EB_SUCCESS || length <= 0)
+            break;
+        bmp.append(buffer, length);
+    }
+    d->binary_owner_ = nullptr;
+    if (eb_code != EB_SUCCESS)
+        return make_error_code(static_cast<eb_error>(eb_code));
+
+    const size_t bmp_header_size = 62;
+    if (bmp.size() < bmp_header_size)
+        return make_error_code(static_cast<eb_error>(EB_ERR_UNEXP_BINARY));
+
+    const unsigned char *header =
+        reinterpret_cast<const unsigned char *>(bmp.data());
+    int width = header[18] | header[19] << 8 | header[20] << 16;
+    int height = header[22] | header[23] << 8 | header[24] << 16;
+    size_t line = (width + 7) / 8;
+    size_t bmp_line = (width + 31) / 32 * 4;
+    if (width <= 0 || height <= 0
+        || bmp.size() < bmp_header_size + bmp_line * height)
+        return make_error_code(static_cast<eb_error>(EB_ERR_UNEXP_BINARY));
+
+    std::unique_ptr<char[]> bitmap(new char[line * height]);
+    for (int y = 0; y < height; ++y) {
+        memcpy(bitmap.get() + line * y,
+               bmp.data() + bmp_header_size + bmp_line * (height - 1 - y),
+               line);
+    }
+
+    // See RenderGaijiSheet() for the size of the PNG buffer.
+    size_t raw_size = (line + 1) * height;
+    std::string png(raw_size + raw_size / 8 + 256, '\0');
+    size_t png_length;
+    {
+        TraceSpan span("eb_bitmap_to_png", "eb");
+        eb_code = eb_bitmap_to_png(bitmap.get(), width, height, &png[0],
+                                   &png_length);
+    }
+    if (eb_code != EB_SUCCESS)
+        return make_error_code(static_cast<eb_error>(eb_code));
+    png.resize(png_length);
+
+    if (d->mono_png_cache_size_ + png.size() > kMonoPngCacheSize) {
+        d->mono_png_cache_.clear();
+        d->mono_png_cache_size_ = 0;
+    }
+    auto image = std::make_shared<const std::string>(std::move(png));
+    d->mono_png_cache_.emplace(key, image);
+    d->mono_png_cache_size_ += image->size();
+    return new EbImageStream(image, "image/png");
+}
+
+Likely<std::vector<std::string>>
+EpwingDictionary::GetBacklinks(const char *guid, size_t limit)
+{
+    TraceSpan span("EpwingDictionary::GetBacklinks", "simplify", guid);
+    EB_Position position;
+    std::error_code ec;
+
+    if (!GuidToPosition(guid, position, ec))
+        return ec;
+
+    std::lock_guard<std::mutex> lock(d->mutex_);
+    if (d->backlinks_ == nullptr)
+        return make_error_code(simplify_error::no_backlinks);
+
+    auto sources = d->backlinks_->GetSources(BacklinkIndex::MakeKey(
+        d->current_subbook_, position.page, position.offset));
+    const uint64_t *end = sources.first
+        + std::min(limit, static_cast<size_t>(sources.second - sources.first));
+    std::vector<std::string> guids;
+    guids.reserve(end - sources.first);
+
+    for (const uint64_t *it = sources.first; it != end; ++it) {
+        EB_Position source;
+        char source_guid[32];
+
+        source.page = BacklinkIndex::GetPage(*it);
+        source.offset = BacklinkIndex::GetOffset(*it);
+        if (PositionToGuid(source, source_guid, sizeof(source_guid), ec)
+                == (size_t) -1)
+            return ec;
+        guids.emplace_back(source_guid);
+    }
+
+    return guids;
+}
+
+Likely<std::vector<std::string>>
+EpwingDictionary::SearchFullText(const char *phrase, size_t limit)
+{
+    TraceSpan span("EpwingDictionary::SearchFullText", "simplify", phrase);
+    std::vector<uint64_t> keys;
+
+    {
+        std::lock_guard<std::mutex> lock(d->mutex_);
+        if (d->fulltext_ == nullptr)
+            return make_error_code(simplify_error::no_fulltext);
+        keys = d->fulltext_->Search(phrase, d->current_subbook_, limit);
+    }
+
+    std::vector<std::string> guids;
+    guids.reserve(keys.size());
+
+    for (uint64_t key : keys) {
+        EB_Position position;
+        char guid[32];
+        std::error_code ec;
+
+        position.page = BacklinkIndex::GetPage(key);
+        position.offset = BacklinkIndex::GetOffset(key);
+        if (PositionToGuid(position, guid, sizeof(guid), ec) == (size_t) -1)
+            return ec;
+        guids.emplace_back(guid);
+    }
+
+    return guids;
+}
+
 Likely<Dictionary::SearchResults *> EpwingDictionary::GetResults(size_t limit)
 {
-    EB_Hit *hits = nullptr;
-    EB_Error_Code eb_code;
-    int increase_step = 256;
-    int result_count = 0;
-    int adjusted_limit;
+    TraceSpan span("EpwingDictionary::GetResults", "simplify");
+    std::vector<EB_Hit> hits;
+    size_t adjusted_limit;
 
     if (limit != 0 || limit <= std::numeric_limits<int>::max())
-      adjusted_limit = static_cast<int>(limit);
+      adjusted_limit = limit;
     else
       adjusted_limit = std::numeric_limits<int>::max();
 
-    // Retrieve search results from libeb by sliding through the hit_list.
-    //
-    // Since there isn't a way to know number of results in advance, we have to
-    // grow our result buffer incrementally.
-    while (true) {
-        int hit_count;
-        int step = std::min(adjusted_limit - result_count, increase_step);
-        size_t alloc_size = (result_count + step) * sizeof(EB_Hit);
+    EB_Error_Code eb_code = CollectHits(&d->book_, adjusted_limit, hits);
+    if (eb_code != EB_SUCCESS)
+        return make_error_code(static_cast<eb_error>(eb_code));
 
-        hits = reinterpret_cast<EB_Hit *>(realloc(hits, alloc_size));
-        eb_code = eb_hit_list(&d->book_, step, hits + result_count, &hit_count);
+    return new EbSearchResults(d, std::move(hits));
+}
 
-        if (eb_code == EB_SUCCESS) {
-            result_count += hit_count;
+Likely<Dictionary::SearchResults *>
+EpwingDictionary::SearchIntersection(int multi_id,
+                                     const std::vector<std::string> &terms,
+                                     size_t limit)
+{
+    TraceSpan span("EpwingDictionary::SearchIntersection", "simplify");
+    EB_Error_Code eb_code;
 
-            // Any number of search results that is lower than *allocation step*
-            // indicates that we are done.
-            if (hit_count < step || result_count >= adjusted_limit)
-                break;
-        } else {
+    // The book's search context is used until all hits are collected.
+    std::lock_guard<std::mutex> lock(d->mutex_);
+
+    if (multi_id < 0) {
+        if (!eb_have_keyword_search(&d->book_))
+            return make_error_code(simplify_error::no_keyword_search);
+    } else {
+        EB_Multi_Search_Code multi_list[EB_MAX_MULTI_SEARCHES];
+        int multi_count;
+        int entry_count;
+
+        if (!eb_have_multi_search(&d->book_))
+            return make_error_code(simplify_error::no_multi_search);
+
+        eb_code = eb_multi_search_list(&d->book_, multi_list, &multi_count);
+        if (eb_code != EB_SUCCESS)
             return make_error_code(static_cast<eb_error>(eb_code));
+        if (multi_id >= multi_count)
+            return make_error_code(simplify_error::index_out_of_range);
+
+        eb_code = eb_multi_entry_count(&d->book_, multi_id, &entry_count);
+        if (eb_code != EB_SUCCESS)
+            return make_error_code(static_cast<eb_error>(eb_code));
+        if (terms.size() > static_cast<size_t>(entry_count))
+            return make_error_code(simplify_error::index_out_of_range);
+    }
+
+    // libeb intersects hits of several terms itself, but only within
+    // windows of a few dozen hits per term, which loses matches when the
+    // terms are common. Search for each term separately instead and
+    // intersect the complete lists.
+    std::vector<std::vector<EB_Hit>> hit_lists;
+
+    for (size_t i = 0; i < terms.size(); ++i) {
+        if (terms[i].empty())
+            continue;
+        if (terms[i].size() > EB_MAX_WORD_LENGTH)
+            return make_error_code(simplify_error::search_expr_too_long);
+
+        std::unique_ptr<char[]> term;
+        std::error_code error;
+        {
+            TraceSpan span("encode_query", "simplify");
+            if (!EncodeSearchTerm(d->charset_, terms[i].c_str(),
+                                  terms[i].size(), term, error)) {
+                return error;
+            }
+        }
+
+        {
+            TraceSpan span(multi_id < 0 ? "eb_search_keyword"
+                                        : "eb_search_multi", "eb");
+            if (multi_id < 0) {
+                const char *words[] = { term.get(), nullptr };
+                eb_code = eb_search_keyword(&d->book_, words);
+            } else {
+                std::vector<const char *> words(i + 2, "");
+                words[i] = term.get();
+                words[i + 1] = nullptr;
+                eb_code = eb_search_multi(&d->book_, multi_id, words.data());
+            }
         }
+
+        // Terms made only of characters that indexes leave out don't
+        // narrow down the results.
+        if (eb_code == EB_ERR_NO_WORD)
+            continue;
+        if (eb_code != EB_SUCCESS)
+            return make_error_code(static_cast<eb_error>(eb_code));
+
+        std::vector<EB_Hit> hits;
+        eb_code = CollectHits(&d->book_, std::numeric_limits<size_t>::max(),
+                              hits);
+        if (eb_code != EB_SUCCESS)
+            return make_error_code(static_cast<eb_error>(eb_code));
+
+        std::sort(hits.begin(), hits.end(), HitTextLess);
+        hits.erase(std::unique(hits.begin(), hits.end(), HitTextEqual),
+                   hits.end());
+        hit_lists.push_back(std::move(hits));
+
+        if (hit_lists.back().empty())
+            break;
+    }
+
+    if (hit_lists.empty())
+        return make_error_code(simplify_error::empty_string);
+
+    // Start from the shortest list, the result can't be any longer.
+    std::sort(hit_lists.begin(), hit_lists.end(),
+              [](const std::vector<EB_Hit> &a, const std::vector<EB_Hit> &b) {
+        return a.size() < b.size();
+    });
+
+    std::vector<EB_Hit> hits = std::move(hit_lists[0]);
+    {
+        TraceSpan span("intersect_hits", "simplify");
+        for (size_t i = 1; i < hit_lists.size() && !hits.empty(); ++i)
+            IntersectHits(hits, hit_lists[i]);
     }
+    if (hits.size() > limit)
+        hits.resize(limit);
 
-    return new EbSearchResults(d,
-                               static_cast<size_t>(result_count),
-                               malloc_unique_ptr<EB_Hit[]>(hits, ::free));
+    return new EbSearchResults(d, std::move(hits));
 }
 
 Likely<EpwingDictionary *> EpwingDictionary::New(const char *name,
@@ -1171,6 +2558,24 @@ std::error_code EpwingDictionary::Initialize(const char *dict_path,
                 return last_error;
         }
 
+        if (auto v = (*state)["appendix"]; v.is_string()) {
+            auto path = v.get_ref<const json::string_t &>();
+            if (!d->BindAppendix(path.c_str(), last_error))
+                return last_error;
+        }
+
+        if (auto v = (*state)["backlinks"]; v.is_string()) {
+            auto path = v.get_ref<const json::string_t &>();
+            if (!d->BindBacklinks(path.c_str(), last_error))
+                return last_error;
+        }
+
+        if (auto v = (*state)["fulltext"]; v.is_string()) {
+            auto path = v.get_ref<const json::string_t &>();
+            if (!d->BindFullText(path.c_str(), last_error))
+                return last_error;
+        }
+
         // Use path to custom script from state, but only if it wasn't
         // explicitly provided.
         if (auto v = (*state)["script"]; v.is_string() && !script_path) {
@@ -1200,7 +2605,8 @@ static EB_Error_Code WriteJs(EB_Book *book, void *hook_arg, JsFunction function,
     assert(isolate != nullptr);
 
     size_t callback_index = static_cast<size_t>(function);
-    auto callback_array = reinterpret_cast<v8::Global<v8::Function>*>(hook_arg);
+    auto callback_array =
+        reinterpret_cast<HookContext *>(hook_arg)->js_functions;
     v8::Local<v8::Function> callback_fn =
         callback_array[callback_index].Get(isolate);
 
@@ -1381,6 +2787,14 @@ static EB_Error_Code HandleEndReference(EB_Book *book, EB_Appendix *,
         v8::Uint32::NewFromUnsigned(isolate, argv[2])
     };
 
+    auto references = reinterpret_cast<HookContext *>(arg)->references;
+    if (references != nullptr) {
+        EB_Position pos;
+        pos.page = static_cast<int>(argv[1]);
+        pos.offset = static_cast<int>(argv[2]);
+        references->push_back(pos);
+    }
+
     return WriteJs(book, arg, JsFunction::EndReference,
                    sizeof(v8argv) / sizeof(v8argv[0]), v8argv);
 }
@@ -1413,12 +2827,38 @@ static EB_Error_Code HandleEndDecoration(EB_Book *book, EB_Appendix *,
     return WriteJs(book, arg, JsFunction::EndDecoration);
 }
 
+/**
+ * Returns the alternation text of an external character from the
+ * appendix, or null if the character has to be handled by the user
+ * script.
+ */
+static const std::u16string *FindAltText(void *hook_arg,
+                                         EB_Hook_Code hook_code,
+                                         unsigned int code)
+{
+    const AltTextMap *alt_text =
+        reinterpret_cast<HookContext *>(hook_arg)->alt_text;
+    if (alt_text == nullptr)
+        return nullptr;
+
+    uint32_t key = code | (hook_code == EB_HOOK_WIDE_FONT ? 0x10000 : 0);
+    auto it = alt_text->find(key);
+    return it != alt_text->end() ? &it->second : nullptr;
+}
+
 static EB_Error_Code HandleInsertHGaiji(EB_Book *book, EB_Appendix *,
-                                        void *arg, EB_Hook_Code, int argc,
-                                        const unsigned int *argv)
+                                        void *arg, EB_Hook_Code hook_code,
+                                        int argc, const unsigned int *argv)
 {
+    if (const std::u16string *text = FindAltText(arg, hook_code, argv[0])) {
+        return eb_write_text(book, reinterpret_cast<const char *>(text->data()),
+                             text->size() * sizeof(char16_t));
+    }
+
+    v8::Isolate *isolate = v8::Isolate::GetCurrent();
     v8::Local<v8::Value> v8argv[] = {
-        v8::Uint32::NewFromUnsigned(v8::Isolate::GetCurrent(), argv[0])
+        v8::Uint32::NewFromUnsigned(isolate, argv[0]),
+        v8::Boolean::New(isolate, hook_code == EB_HOOK_WIDE_FONT)
     };
 
     return WriteJs(book, arg, JsFunction::InsertHeadingGaiji,
@@ -1426,11 +2866,18 @@ static EB_Error_Code HandleInsertHGaiji(EB_Book *book, EB_Appendix *,
 }
 
 static EB_Error_Code HandleInsertTGaiji(EB_Book *book, EB_Appendix *,
-                                        void *arg, EB_Hook_Code, int argc,
-                                        const unsigned int *argv)
+                                        void *arg, EB_Hook_Code hook_code,
+                                        int argc, const unsigned int *argv)
 {
+    if (const std::u16string *text = FindAltText(arg, hook_code, argv[0])) {
+        return eb_write_text(book, reinterpret_cast<const char *>(text->data()),
+                             text->size() * sizeof(char16_t));
+    }
+
+    v8::Isolate *isolate = v8::Isolate::GetCurrent();
     v8::Local<v8::Value> v8argv[] = {
-        v8::Uint32::NewFromUnsigned(v8::Isolate::GetCurrent(), argv[0])
+        v8::Uint32::NewFromUnsigned(isolate, argv[0]),
+        v8::Boolean::New(isolate, hook_code == EB_HOOK_WIDE_FONT)
     };
 
     return WriteJs(book, arg, JsFunction::InsertTextGaiji,
@@ -1441,7 +2888,10 @@ void to_json(nlohmann::json &dst, const EpwingDictionary *dict)
 {
     dst = nlohmann::json{
         {"subbook", dict->d->current_subbook_},
-        {"script", dict->d->script_path_}
+        {"script", dict->d->script_path_},
+        {"appendix", dict->d->appendix_path_},
+        {"backlinks", dict->d->backlinks_path_},
+        {"fulltext", dict->d->fulltext_path_}
     };
 }
 
@@ -40,6 +40,31 @@ public:
      */
     std::error_code SelectSubBook(int index);
 
+    /**
+     * Loads alternation texts of external characters from an appendix
+     * (as made by ebappendix). External characters having one are then
+     * written as their text instead of being passed to the user script.
+     *
+     * \param path Path to the appendix, empty to stop using one.
+     */
+    std::error_code BindAppendix(const char *path);
+
+    /**
+     * Loads the index of references made by simplify-backlinks for this
+     * book, which GetBacklinks() answers from.
+     *
+     * \param path Path to the index, empty to stop using one.
+     */
+    std::error_code BindBacklinks(const char *path);
+
+    /**
+     * Loads the full-text index made by simplify-fulltext for this book,
+     * which SearchFullText() answers from.
+     *
+     * \param path Path to the index, empty to stop using one.
+     */
+    std::error_code BindFullText(const char *path);
+
     /**
      * Returns a list of names of each sub-book within this dictionary.
      */
@@ -68,11 +93,70 @@ public:
 public:
     DictionaryType GetType() const override;
 
+    /**
+     * Searches the current sub-book.
+     *
+     * A plain expression is looked up in the word index (or in the exact
+     * word index if the sub-book has no word index). Two more forms are
+     * recognized:
+     *
+     *  - `term & term & ...` finds entries having all the terms in the
+     *    keyword index.
+     *  - `#N: term & term & ...` uses the N-th (zero-based) multi search
+     *    of the sub-book, the terms fill its entries in order. Empty terms
+     *    leave entries blank, e.g. `#0: & Smith` only fills the second
+     *    entry.
+     *
+     * '＆' (U+FF06) may be used in place of '&'. Results of these forms
+     * are ordered by the position of entries in the book.
+     */
     Likely<SearchResults *> Search(const char *expr, size_t limit) override;
 
+    /**
+     * Same as the above. A plain expression extending the previous one
+     * is looked up among the hits of the previous one if the word index
+     * is loaded (see eb_load_word_indexes()) and the previous search had
+     * no more than @limit hits.
+     */
+    Likely<SearchResults *> Search(const char *expr, size_t limit,
+                                   SearchSession *session) override;
+    std::unique_ptr<SearchSession> NewSearchSession() override;
+
     Likely<std::unique_ptr<char[]>>
         ReadText(const char *guid, size_t *text_length) override;
 
+    Likely<std::unique_ptr<char[]>>
+        ReadText(const char *guid, size_t *text_length,
+                 std::vector<std::string> *references) override;
+
+    /**
+     * Renders an external character of the current sub-book. @height is
+     * one of 16, 24, 30 and 48, and the font of that height has to be
+     * present in the sub-book.
+     */
+    Likely<std::shared_ptr<const std::string>>
+        RenderGaiji(unsigned int code, bool wide, int height) override;
+
+    Likely<std::shared_ptr<const std::string>>
+        RenderGaijiSheet(bool wide, int height,
+                         GaijiSheetLayout *layout) override;
+
+    Likely<BinaryStream *> OpenBinary(const BinaryLocation &location) override;
+
+    /**
+     * Answers from the index bound with BindBacklinks(). Only entities of
+     * the current sub-book are returned.
+     */
+    Likely<std::vector<std::string>> GetBacklinks(const char *guid,
+                                                  size_t limit) override;
+
+    /**
+     * Answers from the index bound with BindFullText(). Only entities of
+     * the current sub-book are returned.
+     */
+    Likely<std::vector<std::string>> SearchFullText(const char *phrase,
+                                                    size_t limit) override;
+
     class Private;
 
 private:
@@ -85,6 +169,11 @@ private:
 
     Likely<SearchResults *> GetResults(size_t max_count);
 
+    Likely<SearchResults *>
+        SearchIntersection(int multi_id,
+                           const std::vector<std::string> &terms,
+                           size_t limit);
+
 private:
     friend void to_json(nlohmann::json &, const EpwingDictionary *);
     friend void to_json(nlohmann::json &, const EpwingDictionary &);
@@ -0,0 +1,499 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#ifdef SIMPLIFY_POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cstring>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <memory>
+
+#include "backlink-index.hh"
+#include "fulltext-index.hh"
+
+namespace simplify {
+
+static const char kMagic[4] = { 'S', 'F', 'T', 'I' };
+static const uint32_t kVersion = 1;
+static const size_t kHeaderSize = 24;
+
+static void AppendUInt32(std::string &out, uint32_t value)
+{
+    for (int i = 0; i < 4; ++i)
+        out.push_back(static_cast<char>(value >> (i * 8)));
+}
+
+static void AppendUInt64(std::string &out, uint64_t value)
+{
+    for (int i = 0; i < 8; ++i)
+        out.push_back(static_cast<char>(value >> (i * 8)));
+}
+
+static void AppendVarint(std::string &out, uint32_t value)
+{
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+static uint32_t ReadUInt32(const unsigned char *in)
+{
+    return static_cast<uint32_t>(in[0])
+        | static_cast<uint32_t>(in[1]) << 8
+        | static_cast<uint32_t>(in[2]) << 16
+        | static_cast<uint32_t>(in[3]) << 24;
+}
+
+static uint64_t ReadUInt64(const unsigned char *in)
+{
+    return ReadUInt32(in) | static_cast<uint64_t>(ReadUInt32(in + 4)) << 32;
+}
+
+/**
+ * Reads a varint at @in, which must be before @end. Returns false if the
+ * varint is truncated or too long.
+ */
+static bool ReadVarint(const unsigned char *&in, const unsigned char *end,
+                       uint32_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 35 && in < end; shift += 7) {
+        unsigned char byte = *in++;
+        value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * Decodes UTF-8 to UTF-16, replacing malformed sequences with U+FFFD.
+ * Characters outside of the BMP can't occur in books and are dropped.
+ */
+static std::u16string Utf8ToUtf16(const char *text)
+{
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(text);
+    std::u16string result;
+
+    while (*p != '\0') {
+        uint32_t c = *p++;
+        int continuation = 0;
+
+        if (c >= 0xf0)
+            continuation = 3, c &= 0x07;
+        else if (c >= 0xe0)
+            continuation = 2, c &= 0x0f;
+        else if (c >= 0xc0)
+            continuation = 1, c &= 0x1f;
+        else if (c >= 0x80)
+            c = 0xfffd;
+
+        for (; continuation > 0; --continuation) {
+            if ((*p & 0xc0) != 0x80) {
+                c = 0xfffd;
+                break;
+            }
+            c = c << 6 | (*p++ & 0x3f);
+        }
+
+        if (c <= 0xffff)
+            result.push_back(static_cast<char16_t>(c));
+    }
+
+    return result;
+}
+
+std::u16string FullTextIndex::Normalize(const std::u16string &text)
+{
+    std::u16string result;
+    result.reserve(text.size());
+
+    for (char16_t c : text) {
+        if (c >= 0xff01 && c <= 0xff5e)
+            c -= 0xfee0;
+        else if (c == 0x3000)
+            c = u' ';
+
+        if (c >= u'A' && c <= u'Z') {
+            c += u'a' - u'A';
+        } else if (c == u' ' || c == u'\t' || c == u'\n' || c == u'\r') {
+            if (result.empty() || result.back() == u' ')
+                continue;
+            c = u' ';
+        } else if (c < 0x20) {
+            continue;
+        }
+
+        result.push_back(c);
+    }
+
+    return result;
+}
+
+FullTextIndex::Builder::Builder(int subbook_count)
+  : subbook_count_(subbook_count)
+{
+}
+
+void FullTextIndex::Builder::AddText(uint64_t key, const std::u16string &text)
+{
+    std::u16string normalized = Normalize(text);
+    if (normalized.empty())
+        return;
+
+    uint32_t index = static_cast<uint32_t>(texts_.size());
+    texts_.push_back(key);
+
+    // Positions of each term in this text, ascending.
+    std::unordered_map<uint32_t, std::vector<uint32_t>> occurrences;
+    for (size_t i = 0; i < normalized.size(); ++i) {
+        char16_t next = i + 1 < normalized.size() ? normalized[i + 1] : 0;
+        uint32_t term = static_cast<uint32_t>(normalized[i]) << 16 | next;
+        occurrences[term].push_back(static_cast<uint32_t>(i));
+    }
+
+    for (const auto &occurrence : occurrences) {
+        Term &term = terms_[occurrence.first];
+        const std::vector<uint32_t> &positions = occurrence.second;
+
+        AppendVarint(term.postings, index - term.last_text);
+        AppendVarint(term.postings, static_cast<uint32_t>(positions.size()));
+        uint32_t last_position = 0;
+        for (uint32_t position : positions) {
+            AppendVarint(term.postings, position - last_position);
+            last_position = position;
+        }
+
+        term.text_count += 1;
+        term.last_text = index;
+    }
+}
+
+std::error_code FullTextIndex::Builder::Write(const char *path)
+{
+    std::vector<uint32_t> terms;
+    terms.reserve(terms_.size());
+    for (const auto &term : terms_)
+        terms.push_back(term.first);
+    std::sort(terms.begin(), terms.end());
+
+    std::string header;
+    header.append(kMagic, sizeof(kMagic));
+    AppendUInt32(header, kVersion);
+    AppendUInt32(header, static_cast<uint32_t>(subbook_count_));
+    AppendUInt32(header, static_cast<uint32_t>(texts_.size()));
+    AppendUInt32(header, static_cast<uint32_t>(terms.size()));
+    AppendUInt32(header, 0);
+    for (uint64_t text : texts_)
+        AppendUInt64(header, text);
+    for (uint32_t term : terms)
+        AppendUInt32(header, term);
+
+    // The number of texts goes first, it's known only now.
+    std::string postings;
+    uint64_t offset = 0;
+    for (uint32_t term : terms) {
+        const Term &t = terms_[term];
+        AppendUInt64(header, offset);
+        size_t size = postings.size();
+        AppendVarint(postings, t.text_count);
+        postings.append(t.postings);
+        offset += postings.size() - size;
+    }
+    AppendUInt64(header, offset);
+
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    if (!stream.write(header.data(), header.size())
+        || !stream.write(postings.data(), postings.size())
+        || !stream.flush())
+        return std::make_error_code(std::errc::io_error);
+    return std::error_code();
+}
+
+FullTextIndex::~FullTextIndex()
+{
+#ifdef SIMPLIFY_POSIX
+    if (mapped_)
+        munmap(const_cast<unsigned char *>(data_), size_);
+#endif
+}
+
+Likely<FullTextIndex *> FullTextIndex::Load(const char *path)
+{
+    std::unique_ptr<FullTextIndex> index(new FullTextIndex());
+
+#ifdef SIMPLIFY_POSIX
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return std::error_code(errno, std::generic_category());
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data != MAP_FAILED) {
+            index->data_ = static_cast<const unsigned char *>(data);
+            index->size_ = st.st_size;
+            index->mapped_ = true;
+        }
+    }
+    close(fd);
+#endif
+
+    if (!index->mapped_) {
+        std::ifstream stream(path, std::ios::binary);
+        if (!stream)
+            return std::make_error_code(std::errc::no_such_file_or_directory);
+
+        index->contents_.assign(std::istreambuf_iterator<char>(stream),
+                                std::istreambuf_iterator<char>());
+        index->data_ =
+            reinterpret_cast<const unsigned char *>(index->contents_.data());
+        index->size_ = index->contents_.size();
+    }
+
+    const unsigned char *in = index->data_;
+    if (index->size_ < kHeaderSize || memcmp(in, kMagic, sizeof(kMagic)) != 0
+        || ReadUInt32(in + 4) != kVersion)
+        return make_error_code(simplify_error::bad_fulltext_index);
+
+    index->subbook_count_ = static_cast<int>(ReadUInt32(in + 8));
+    index->text_count_ = ReadUInt32(in + 12);
+    index->term_count_ = ReadUInt32(in + 16);
+
+    uint64_t tables_size = uint64_t(index->text_count_) * 8
+        + uint64_t(index->term_count_) * 4
+        + (uint64_t(index->term_count_) + 1) * 8;
+    if (index->size_ < kHeaderSize + tables_size)
+        return make_error_code(simplify_error::bad_fulltext_index);
+
+    index->texts_ = in + kHeaderSize;
+    index->terms_ = index->texts_ + uint64_t(index->text_count_) * 8;
+    index->offsets_ = index->terms_ + uint64_t(index->term_count_) * 4;
+    index->postings_ = in + kHeaderSize + tables_size;
+    index->postings_size_ = index->size_ - kHeaderSize - tables_size;
+
+    // Lookups rely on offsets being in bounds, so check them once here.
+    uint64_t last_offset = 0;
+    for (uint32_t i = 0; i <= index->term_count_; ++i) {
+        uint64_t offset = ReadUInt64(index->offsets_ + uint64_t(i) * 8);
+        if (offset < last_offset || offset > index->postings_size_)
+            return make_error_code(simplify_error::bad_fulltext_index);
+        last_offset = offset;
+    }
+
+    return index.release();
+}
+
+int FullTextIndex::GetSubBookCount() const
+{
+    return subbook_count_;
+}
+
+uint32_t FullTextIndex::LowerBound(uint32_t term) const
+{
+    uint32_t low = 0;
+    uint32_t high = term_count_;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (ReadUInt32(terms_ + uint64_t(middle) * 4) < term)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+void FullTextIndex::GetPostings(uint32_t index, const unsigned char *&begin,
+                                const unsigned char *&end) const
+{
+    begin = postings_ + ReadUInt64(offsets_ + uint64_t(index) * 8);
+    end = postings_ + ReadUInt64(offsets_ + uint64_t(index + 1) * 8);
+}
+
+bool FullTextIndex::FindTerm(uint32_t term, const unsigned char *&begin,
+                             const unsigned char *&end) const
+{
+    uint32_t index = LowerBound(term);
+    if (index == term_count_
+        || ReadUInt32(terms_ + uint64_t(index) * 4) != term)
+        return false;
+
+    GetPostings(index, begin, end);
+    return true;
+}
+
+bool FullTextIndex::DecodePostings(const unsigned char *begin,
+                                   const unsigned char *end,
+                                   std::vector<Posting> &postings) const
+{
+    uint32_t text_count;
+    if (!ReadVarint(begin, end, text_count))
+        return false;
+
+    postings.clear();
+    postings.reserve(std::min<size_t>(text_count, end - begin));
+    uint32_t text = 0;
+    for (uint32_t i = 0; i < text_count; ++i) {
+        uint32_t delta, count;
+        if (!ReadVarint(begin, end, delta) || !ReadVarint(begin, end, count)
+            || count > static_cast<size_t>(end - begin))
+            return false;
+        text += delta;
+        if (text >= text_count_)
+            return false;
+
+        postings.emplace_back();
+        Posting &posting = postings.back();
+        posting.text = text;
+        posting.positions.resize(count);
+
+        uint32_t position = 0;
+        for (uint32_t j = 0; j < count; ++j) {
+            if (!ReadVarint(begin, end, delta))
+                return false;
+            position += delta;
+            posting.positions[j] = position;
+        }
+    }
+
+    return true;
+}
+
+std::vector<uint64_t> FullTextIndex::Search(const char *phrase, int subbook,
+                                            size_t limit) const
+{
+    std::vector<uint64_t> result;
+    std::u16string query = Normalize(Utf8ToUtf16(phrase));
+
+    while (!query.empty() && query.back() == u' ')
+        query.pop_back();
+    if (query.empty() || limit == 0)
+        return result;
+
+    // Texts of a sub-book are contiguous because keys start with the
+    // sub-book index.
+    uint64_t first_key = BacklinkIndex::MakeKey(subbook, 0, 0);
+    uint64_t last_key = BacklinkIndex::MakeKey(subbook + 1, 0, 0);
+    auto in_subbook = [&](uint32_t text) {
+        uint64_t key = ReadUInt64(texts_ + uint64_t(text) * 8);
+        return key >= first_key && key < last_key;
+    };
+
+    std::vector<Posting> postings;
+
+    if (query.size() == 1) {
+        // Every character starts a term, so the texts containing it are
+        // those of the terms starting with it. Terms are sorted, those
+        // are next to each other.
+        uint32_t first = static_cast<uint32_t>(query[0]);
+        std::vector<uint32_t> texts;
+        const unsigned char *begin, *end;
+
+        for (uint32_t i = LowerBound(first << 16); i < term_count_; ++i) {
+            if (ReadUInt32(terms_ + uint64_t(i) * 4) >> 16 != first)
+                break;
+            GetPostings(i, begin, end);
+            if (!DecodePostings(begin, end, postings))
+                return result;
+            for (const Posting &posting : postings)
+                texts.push_back(posting.text);
+        }
+
+        std::sort(texts.begin(), texts.end());
+        texts.erase(std::unique(texts.begin(), texts.end()), texts.end());
+        for (uint32_t text : texts) {
+            if (result.size() >= limit)
+                break;
+            if (in_subbook(text))
+                result.push_back(ReadUInt64(texts_ + uint64_t(text) * 8));
+        }
+        return result;
+    }
+
+    // Postings of each bigram of the query, the one at offset i of the
+    // query first.
+    std::vector<std::vector<Posting>> lists(query.size() - 1);
+    size_t rarest = 0;
+    for (size_t i = 0; i < lists.size(); ++i) {
+        uint32_t term = static_cast<uint32_t>(query[i]) << 16 | query[i + 1];
+        const unsigned char *begin, *end;
+
+        if (!FindTerm(term, begin, end) || !DecodePostings(begin, end, lists[i]))
+            return result;
+        if (lists[i].size() < lists[rarest].size())
+            rarest = i;
+    }
+
+    auto find_text = [](const std::vector<Posting> &list, uint32_t text) {
+        auto it = std::lower_bound(list.begin(), list.end(), text,
+            [](const Posting &p, uint32_t t) { return p.text < t; });
+        return it != list.end() && it->text == text ? &*it : nullptr;
+    };
+
+    for (const Posting &candidate : lists[rarest]) {
+        if (result.size() >= limit)
+            break;
+        if (!in_subbook(candidate.text))
+            continue;
+
+        std::vector<const Posting *> rows(lists.size());
+        bool has_all = true;
+        for (size_t i = 0; i < lists.size() && has_all; ++i) {
+            rows[i] = find_text(lists[i], candidate.text);
+            has_all = rows[i] != nullptr;
+        }
+        if (!has_all)
+            continue;
+
+        // The phrase occurs at @start if every bigram occurs at its
+        // offset from there.
+        for (uint32_t position : candidate.positions) {
+            if (position < rarest)
+                continue;
+            uint32_t start = position - static_cast<uint32_t>(rarest);
+            bool matches = true;
+
+            for (size_t i = 0; i < rows.size() && matches; ++i) {
+                const std::vector<uint32_t> &positions = rows[i]->positions;
+                matches = std::binary_search(positions.begin(),
+                                             positions.end(),
+                                             start + static_cast<uint32_t>(i));
+            }
+            if (matches) {
+                result.push_back(
+                    ReadUInt64(texts_ + uint64_t(candidate.text) * 8));
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+}  // namespace simplify
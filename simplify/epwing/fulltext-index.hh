@@ -0,0 +1,140 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#ifndef SIMPLIFY_EPWING_FULLTEXT_INDEX_HH_
+#define SIMPLIFY_EPWING_FULLTEXT_INDEX_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include <simplify/likely.hh>
+
+namespace simplify {
+
+/**
+ * Inverted index of character bigrams of the texts of a book, for finding
+ * texts which contain a phrase.
+ *
+ * Texts are normalized (see @Normalize()) and every pair of adjacent
+ * characters is a term, the last character paired with 0. Texts are
+ * identified by the keys of BacklinkIndex. All integers are little-endian:
+ *
+ *   char     magic[4]          "SFTI"
+ *   uint32_t version           1
+ *   uint32_t subbook_count     number of sub-books of the book
+ *   uint32_t text_count
+ *   uint32_t term_count
+ *   uint32_t reserved
+ *   uint64_t texts[text_count]             keys of texts in book order
+ *   uint32_t terms[term_count]             first << 16 | second, sorted
+ *   uint64_t offsets[term_count + 1]       of each term's postings
+ *   uint8_t  postings[]
+ *
+ * Postings of a term are varints: the number of texts containing the
+ * term, then for each of them the difference of its index in texts from
+ * the previous one, the number of occurrences and the differences of
+ * character positions of the occurrences.
+ *
+ * The file is mapped into memory where possible.
+ */
+class FullTextIndex {
+public:
+    /**
+     * Collects texts and writes them out as an index. Texts must be added
+     * in book order.
+     */
+    class Builder {
+    public:
+        explicit Builder(int subbook_count);
+
+        void AddText(uint64_t key, const std::u16string &text);
+        std::error_code Write(const char *path);
+
+    private:
+        struct Term {
+            uint32_t text_count = 0;
+            uint32_t last_text = 0;
+            std::string postings;
+        };
+
+        int subbook_count_;
+        std::vector<uint64_t> texts_;
+        std::unordered_map<uint32_t, Term> terms_;
+    };
+
+    ~FullTextIndex();
+
+    static Likely<FullTextIndex *> Load(const char *path);
+
+    /**
+     * Folds full-width ASCII to ASCII and upper case ASCII letters to
+     * lower case, turns runs of white space into one space and drops
+     * other control characters.
+     */
+    static std::u16string Normalize(const std::u16string &text);
+
+    int GetSubBookCount() const;
+
+    /**
+     * Returns keys of up to @limit texts of the sub-book which contain
+     * the UTF-8 encoded @phrase, in book order.
+     */
+    std::vector<uint64_t> Search(const char *phrase, int subbook,
+                                 size_t limit) const;
+
+private:
+    struct Posting {
+        uint32_t text;
+        std::vector<uint32_t> positions;
+    };
+
+    FullTextIndex() = default;
+
+    uint32_t LowerBound(uint32_t term) const;
+    void GetPostings(uint32_t index, const unsigned char *&begin,
+                     const unsigned char *&end) const;
+    bool FindTerm(uint32_t term, const unsigned char *&begin,
+                  const unsigned char *&end) const;
+    bool DecodePostings(const unsigned char *begin, const unsigned char *end,
+                        std::vector<Posting> &postings) const;
+
+    // The whole file, either mapped or read into @contents_.
+    const unsigned char *data_ = nullptr;
+    size_t size_ = 0;
+    bool mapped_ = false;
+    std::string contents_;
+
+    int subbook_count_ = 0;
+    uint32_t text_count_ = 0;
+    uint32_t term_count_ = 0;
+    const unsigned char *texts_ = nullptr;
+    const unsigned char *terms_ = nullptr;
+    const unsigned char *offsets_ = nullptr;
+    const unsigned char *postings_ = nullptr;
+    uint64_t postings_size_ = 0;
+};
+
+}  // namespace simplify
+
+#endif  // SIMPLIFY_EPWING_FULLTEXT_INDEX_HH_
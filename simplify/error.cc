@@ -75,6 +75,22 @@ public:
             return "Unexpected result type";
         case simplify_error::no_more_results:
             return "No more results";
+        case simplify_error::no_keyword_search:
+            return "Keyword search is not supported by the dictionary";
+        case simplify_error::no_multi_search:
+            return "Multi search is not supported by the dictionary";
+        case simplify_error::no_gaiji:
+            return "Dictionary has no external characters of the requested size";
+        case simplify_error::no_binary:
+            return "Dictionary has no such sound or graphic data";
+        case simplify_error::no_backlinks:
+            return "Dictionary has no backlink index";
+        case simplify_error::bad_backlink_index:
+            return "Backlink index is corrupt or doesn't match the dictionary";
+        case simplify_error::no_fulltext:
+            return "Dictionary has no full-text index";
+        case simplify_error::bad_fulltext_index:
+            return "Full-text index is corrupt or doesn't match the dictionary";
         default:
             return "Unkown Simplify error";
         }
@@ -48,6 +48,18 @@ enum simplify_error {
     unexpected_result_type = 19,
     no_more_results        = 20,
     unsupported_dictionary = 21,
+    no_keyword_search      = 22,
+    no_multi_search        = 23,
+    no_gaiji               = 24,
+    no_binary              = 25,
+    no_backlinks           = 26,
+    bad_backlink_index     = 27,
+    no_fulltext            = 28,
+    bad_fulltext_index     = 29,
+
+    // Not an error, the number of the errors above. New errors go above
+    // this line.
+    simplify_error_count
 };
 
 /*
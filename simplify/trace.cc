@@ -0,0 +1,132 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#include <string.h>
+
+#include <algorithm>
+#include <cstdio>
+
+#include "trace.hh"
+
+namespace simplify {
+
+static thread_local Trace *g_current_trace = nullptr;
+
+Trace::Scope::Scope(Trace *trace)
+  : previous_(g_current_trace)
+{
+    g_current_trace = trace;
+}
+
+Trace::Scope::~Scope()
+{
+    g_current_trace = previous_;
+}
+
+Trace::Trace(size_t max_events)
+  : epoch_(Clock::now()),
+    max_events_(max_events),
+    dropped_events_(0)
+{
+    spans_.reserve(std::min<size_t>(max_events, 256));
+}
+
+Trace *Trace::GetCurrent()
+{
+    return g_current_trace;
+}
+
+void Trace::AddSpan(const char *name, const char *category,
+                    Clock::time_point start, Clock::time_point end,
+                    std::string detail)
+{
+    if (spans_.size() < max_events_) {
+        spans_.push_back(
+            Span{name, category, start - epoch_, end - start, std::move(detail)});
+    } else {
+        ++dropped_events_;
+    }
+}
+
+static void AppendJsonString(std::string &out, const char *s, size_t length)
+{
+    out.append(1, '"');
+    for (size_t i = 0; i < length; ++i) {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+
+        if (c == '"' || c == '\\') {
+            out.append(1, '\\').append(1, c);
+        } else if (c < 0x20) {
+            char tmp[8];
+            snprintf(tmp, sizeof(tmp), "\\u%04x", c);
+            out.append(tmp);
+        } else {
+            out.append(1, c);
+        }
+    }
+    out.append(1, '"');
+}
+
+static void AppendMicroseconds(std::string &out, Trace::Clock::duration d)
+{
+    char tmp[32];
+    double us = std::chrono::duration<double, std::micro>(d).count();
+    int length = snprintf(tmp, sizeof(tmp), "%.3f", us);
+    out.append(tmp, length);
+}
+
+void Trace::WriteJson(std::string &out) const
+{
+    out.append("{\"traceEvents\":[");
+
+    for (size_t i = 0; i < spans_.size(); ++i) {
+        const Span &span = spans_[i];
+
+        if (i > 0)
+            out.append(1, ',');
+
+        // Complete events ('X') carry both start time and duration, so
+        // nesting is reconstructed by the viewer.
+        out.append("{\"name\":");
+        AppendJsonString(out, span.name, strlen(span.name));
+        out.append(",\"cat\":");
+        AppendJsonString(out, span.category, strlen(span.category));
+        out.append(",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":");
+        AppendMicroseconds(out, span.start);
+        out.append(",\"dur\":");
+        AppendMicroseconds(out, span.duration);
+
+        if (!span.detail.empty()) {
+            out.append(",\"args\":{\"detail\":");
+            AppendJsonString(out, span.detail.data(), span.detail.size());
+            out.append("}");
+        }
+
+        out.append("}");
+    }
+
+    char tmp[24];
+    snprintf(tmp, sizeof(tmp), "%zu", dropped_events_);
+    out.append("],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped\":")
+       .append(tmp)
+       .append("}}");
+}
+
+}  // namespace simplify
@@ -0,0 +1,144 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#ifndef LIBSIMPLIFY_TRACE_HH_
+#define LIBSIMPLIFY_TRACE_HH_
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace simplify {
+
+/**
+ * Collects timed spans of a single request.
+ *
+ * A trace is bound to the thread that activates it with Trace::Scope and
+ * must not be shared between threads. Spans created on a thread that has
+ * no active trace cost one thread-local load and nothing else.
+ */
+class Trace {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    /**
+     * Makes @trace the active trace of the calling thread for the lifetime
+     * of the scope object. Null traces are allowed and disable tracing.
+     */
+    class Scope {
+    public:
+        explicit Scope(Trace *trace);
+        ~Scope();
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        Trace *previous_;
+    };
+
+    /**
+     * \param max_events Maximum number of spans to keep. Spans beyond this
+     *  limit are counted but not recorded.
+     */
+    explicit Trace(size_t max_events = 50000);
+
+    /**
+     * Returns the active trace of the calling thread, or null.
+     */
+    static Trace *GetCurrent();
+
+    /**
+     * Records a completed span. @name and @category must point to strings
+     * with static storage duration.
+     */
+    void AddSpan(const char *name, const char *category,
+                 Clock::time_point start, Clock::time_point end,
+                 std::string detail);
+
+    /**
+     * Appends the trace to @out in the Chrome trace event format, which
+     * can be loaded into chrome://tracing or Perfetto.
+     */
+    void WriteJson(std::string &out) const;
+
+private:
+    struct Span {
+        const char *name;
+        const char *category;
+        Clock::duration start;
+        Clock::duration duration;
+        std::string detail;
+    };
+
+    Clock::time_point epoch_;
+    size_t max_events_;
+    size_t dropped_events_;
+    std::vector<Span> spans_;
+};
+
+/**
+ * Measures the lifetime of the object and records it as a span of the
+ * active trace.
+ */
+class TraceSpan {
+public:
+    explicit TraceSpan(const char *name, const char *category = "simplify")
+      : trace_(Trace::GetCurrent()),
+        name_(name),
+        category_(category)
+    {
+        if (trace_ != nullptr)
+            start_ = Trace::Clock::now();
+    }
+
+    /**
+     * \param detail Free-form text attached to the span, e.g. a dictionary
+     *  name. It's copied only if tracing is active.
+     */
+    TraceSpan(const char *name, const char *category, const char *detail)
+      : TraceSpan(name, category)
+    {
+        if (trace_ != nullptr && detail != nullptr)
+            detail_ = detail;
+    }
+
+    ~TraceSpan()
+    {
+        if (trace_ != nullptr) {
+            trace_->AddSpan(name_, category_, start_, Trace::Clock::now(),
+                            std::move(detail_));
+        }
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+    Trace *trace_;
+    const char *name_;
+    const char *category_;
+    std::string detail_;
+    Trace::Clock::time_point start_;
+};
+
+}  // namespace simplify
+
+#endif  // LIBSIMPLIFY_TRACE_HH_
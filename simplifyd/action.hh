@@ -34,6 +34,11 @@ public:
     virtual ~Action() {};
     virtual void Handle(simplify::Repository &repository,
                         HttpQuery &query, HttpResponse &response) = 0;
+
+    /**
+     * Whether requests are traced when tracing of all requests is on.
+     */
+    virtual bool IsTraced() const { return true; }
 };
 
 }  // namespace simplifyd
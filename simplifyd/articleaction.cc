@@ -20,54 +20,101 @@
 
 #include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include <simplify/dictionary.hh>
 #include <simplify/repository.hh>
+#include <simplify/trace.hh>
 #include <simplify/utils.hh>
 
+#include "articlecache.hh"
+#include "articleprefetcher.hh"
 #include "httpquery.hh"
 #include "httpresponse.hh"
+#include "jsonwriter.hh"
+#include "metrics.hh"
 #include "articleaction.hh"
 
 namespace simplifyd {
 
+ArticleAction::ArticleAction(ArticleCache *cache,
+                             ArticlePrefetcher *prefetcher,
+                             size_t prefetch_count)
+  : cache_(cache),
+    prefetcher_(prefetcher),
+    prefetch_count_(prefetch_count)
+{
+}
+
 void ArticleAction::Handle(simplify::Repository &repository,
                            HttpQuery &query,
                            HttpResponse &response)
 {
     const char *dict_id = query.GetParamValue("id");
     const char *guid = query.GetParamValue("guid");
-    std::string &body = response.GetBody();
+    JsonWriter json(response.GetBody());
 
     response.AddHeader("Content-Type", "application/json; charset=utf-8");
 
     if (dict_id == nullptr) {
-        body.append("{\"error\":\"No dictionary ID specified\"}");
+        json.Error("No dictionary ID specified");
         return;
     } else if (guid == nullptr) {
-        body.append("{\"error\":\"No article GUID specified\"}");
+        json.Error("No article GUID specified");
         return;
     }
 
-    auto dict = repository.GetDictionary(strtol(dict_id, NULL, 10));
+    size_t dict_index = strtol(dict_id, NULL, 10);
+    auto dict = repository.GetDictionary(dict_index);
 
     if (dict == nullptr) {
-        body.append("{\"error\":\"Invalid dictionary index specified\"}");
+        json.Error("Invalid dictionary index specified");
         return;
     }
 
+    std::shared_ptr<const std::string> cached_text;
+    if (cache_ != nullptr)
+        cached_text = cache_->GetOrClaim(dict_index, guid);
+
+    Metrics &metrics = Metrics::Instance();
+    DictionaryMetrics *dict_metrics = metrics.GetDictionaryMetrics(dict.get());
     size_t text_length = 0;
-    simplify::Likely<std::unique_ptr<char[]>> likely_text =
-        dict->ReadText(guid, &text_length);
-    if (!likely_text.is_error()) {
-      body.append("{\"article\":\"")
-          .append(likely_text.value_checked().get(), text_length)
-          .append("\"}");
+    simplify::Likely<std::unique_ptr<char[]>> likely_text;
+    std::vector<std::string> references;
+    bool want_references = prefetcher_ != nullptr && prefetch_count_ > 0;
+    if (cached_text == nullptr) {
+        ScopedTimer timer(dict_metrics ? &dict_metrics->article : nullptr);
+        likely_text = dict->ReadText(guid, &text_length,
+                                     want_references ? &references : nullptr);
+        if (cache_ != nullptr && !likely_text.is_error()) {
+            cache_->Put(dict_index, guid,
+                        std::make_shared<const std::string>(
+                            likely_text.value_checked().get(), text_length));
+        }
+        if (cache_ != nullptr)
+            cache_->Release(dict_index, guid);
+    }
+    if (cached_text != nullptr) {
+      simplify::TraceSpan span("ArticleAction::FormatArticle", "simplifyd");
+      json.BeginObject().Key("article").String(*cached_text).EndObject();
+    } else if (!likely_text.is_error()) {
+      simplify::TraceSpan span("ArticleAction::FormatArticle", "simplifyd");
+      const char *text = likely_text.value_checked().get();
+      json.BeginObject()
+          .Key("article").String(text, text_length)
+          .EndObject();
+
+      if (!references.empty()) {
+          if (references.size() > prefetch_count_)
+              references.resize(prefetch_count_);
+          prefetcher_->Schedule(dict, dict_index, references);
+      }
     } else {
-      body.append("{\"error\":\"An error occurred while retrieving "
-                  "article data from the dictionary: ")
-          .append(likely_text.error_code().message())
-          .append("\"}");
+      metrics.CountError(likely_text.error_code());
+      json.Error("An error occurred while retrieving article data from "
+                 "the dictionary: " + likely_text.error_code().message());
       return;
     }
 
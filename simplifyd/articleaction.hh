@@ -21,14 +21,33 @@
 #ifndef SIMPLIFYD_ARTICLEACTION_HH_
 #define SIMPLIFYD_ARTICLEACTION_HH_
 
+#include <cstddef>
+
 #include "action.hh"
 
 namespace simplifyd {
 
+class ArticleCache;
+class ArticlePrefetcher;
+
 class ArticleAction : public Action
 {
 public:
+    /**
+     * Articles are looked up in @cache first if it's not null. After an
+     * article is read from the dictionary, up to @prefetch_count of the
+     * articles it refers to are handed to @prefetcher, unless it's null.
+     */
+    ArticleAction(ArticleCache *cache = nullptr,
+                  ArticlePrefetcher *prefetcher = nullptr,
+                  size_t prefetch_count = 0);
+
     void Handle(simplify::Repository &, HttpQuery &, HttpResponse &);
+
+private:
+    ArticleCache *cache_;
+    ArticlePrefetcher *prefetcher_;
+    size_t prefetch_count_;
 };
 
 }  // namespace simplifyd
@@ -0,0 +1,163 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#include <utility>
+
+#include "articlecache.hh"
+
+namespace simplifyd {
+
+ArticleCache::ArticleCache(size_t capacity)
+  : capacity_(capacity),
+    size_(0),
+    hits_(0),
+    misses_(0)
+{
+}
+
+std::string ArticleCache::MakeKey(size_t dict_index, const char *guid)
+{
+    return std::to_string(dict_index).append(1, '/').append(guid);
+}
+
+std::shared_ptr<const std::string> ArticleCache::Get(size_t dict_index,
+                                                     const char *guid,
+                                                     bool count_lookup)
+{
+    std::string key = MakeKey(dict_index, guid);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+
+    if (it == entries_.end()) {
+        if (count_lookup)
+            ++misses_;
+        return nullptr;
+    }
+
+    if (count_lookup)
+        ++hits_;
+    lru_.splice(lru_.begin(), lru_, it->second.lru_position);
+    return it->second.article;
+}
+
+bool ArticleCache::Contains(size_t dict_index, const char *guid)
+{
+    std::string key = MakeKey(dict_index, guid);
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.find(key) != entries_.end();
+}
+
+std::shared_ptr<const std::string> ArticleCache::GetOrClaim(size_t dict_index,
+                                                            const char *guid)
+{
+    std::string key = MakeKey(dict_index, guid);
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (true) {
+        auto it = entries_.find(key);
+        if (it != entries_.end()) {
+            ++hits_;
+            lru_.splice(lru_.begin(), lru_, it->second.lru_position);
+            return it->second.article;
+        }
+
+        // If the thread which claimed the article fails to render it, the
+        // next waiter claims it in turn.
+        if (claimed_.insert(key).second) {
+            ++misses_;
+            return nullptr;
+        }
+        released_.wait(lock);
+    }
+}
+
+void ArticleCache::Release(size_t dict_index, const char *guid)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        claimed_.erase(MakeKey(dict_index, guid));
+    }
+    released_.notify_all();
+}
+
+bool ArticleCache::IsMissing(size_t dict_index, const char *guid)
+{
+    std::string key = MakeKey(dict_index, guid);
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.find(key) == entries_.end()
+        && claimed_.find(key) == claimed_.end();
+}
+
+void ArticleCache::Put(size_t dict_index, const char *guid,
+                       std::shared_ptr<const std::string> article)
+{
+    if (article->size() > capacity_)
+        return;
+
+    std::string key = MakeKey(dict_index, guid);
+    std::lock_guard<std::mutex> lock(mutex_);
+    PutLocked(std::move(key), std::move(article));
+}
+
+void ArticleCache::PutIfAbsent(size_t dict_index, const char *guid,
+                               std::shared_ptr<const std::string> article)
+{
+    if (article->size() > capacity_)
+        return;
+
+    std::string key = MakeKey(dict_index, guid);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (entries_.find(key) == entries_.end())
+        PutLocked(std::move(key), std::move(article));
+}
+
+void ArticleCache::PutLocked(std::string key,
+                             std::shared_ptr<const std::string> article)
+{
+    auto it = entries_.find(key);
+
+    if (it != entries_.end()) {
+        size_ -= it->second.article->size();
+        size_ += article->size();
+        it->second.article = std::move(article);
+        lru_.splice(lru_.begin(), lru_, it->second.lru_position);
+    } else {
+        size_ += article->size();
+        lru_.push_front(key);
+        entries_.emplace(std::move(key),
+                         Entry{std::move(article), lru_.begin()});
+    }
+
+    while (size_ > capacity_) {
+        auto victim = entries_.find(lru_.back());
+        size_ -= victim->second.article->size();
+        entries_.erase(victim);
+        lru_.pop_back();
+    }
+}
+
+void ArticleCache::GetStatistics(uint64_t *hits, uint64_t *misses)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    *hits = hits_;
+    *misses = misses_;
+}
+
+}  // namespace simplifyd
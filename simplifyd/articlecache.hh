@@ -0,0 +1,110 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#ifndef SIMPLIFYD_ARTICLECACHE_HH_
+#define SIMPLIFYD_ARTICLECACHE_HH_
+
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace simplifyd {
+
+/**
+ * Rendered articles keyed by dictionary index and GUID. The least
+ * recently used articles are evicted once the total size of articles
+ * exceeds the capacity.
+ */
+class ArticleCache
+{
+public:
+    explicit ArticleCache(size_t capacity);
+
+    /**
+     * Returns the article, or null if it's not cached. Lookups with
+     * @count_lookup set are reflected in statistics.
+     */
+    std::shared_ptr<const std::string> Get(size_t dict_index,
+                                           const char *guid,
+                                           bool count_lookup = true);
+    bool Contains(size_t dict_index, const char *guid);
+
+    /**
+     * Returns the article if it's cached. Otherwise claims rendering of
+     * the article for the caller, which must then Put() it (if it could
+     * be rendered) and Release() it, and returns null. If another thread
+     * has claimed the article, waits for it to be released first, so
+     * that concurrent requests for an article render it only once.
+     */
+    std::shared_ptr<const std::string> GetOrClaim(size_t dict_index,
+                                                  const char *guid);
+    void Release(size_t dict_index, const char *guid);
+
+    /**
+     * Whether the article is neither cached nor claimed. Isn't reflected
+     * in statistics.
+     */
+    bool IsMissing(size_t dict_index, const char *guid);
+
+    void Put(size_t dict_index, const char *guid,
+             std::shared_ptr<const std::string> article);
+
+    /**
+     * Same as Put() unless the article is cached already, in which case
+     * the cached one is kept.
+     */
+    void PutIfAbsent(size_t dict_index, const char *guid,
+                     std::shared_ptr<const std::string> article);
+
+    void GetStatistics(uint64_t *hits, uint64_t *misses);
+
+private:
+    typedef std::list<std::string> LruList;
+
+    struct Entry {
+        std::shared_ptr<const std::string> article;
+        LruList::iterator lru_position;
+    };
+
+    static std::string MakeKey(size_t dict_index, const char *guid);
+    void PutLocked(std::string key,
+                   std::shared_ptr<const std::string> article);
+
+    std::mutex mutex_;
+    size_t capacity_;
+    size_t size_;
+    std::unordered_map<std::string, Entry> entries_;
+    // Keys of entries_, the most recently used first.
+    LruList lru_;
+    // Keys of articles being rendered.
+    std::unordered_set<std::string> claimed_;
+    std::condition_variable released_;
+    uint64_t hits_;
+    uint64_t misses_;
+};
+
+}  // namespace simplifyd
+
+#endif  // SIMPLIFYD_ARTICLECACHE_HH_
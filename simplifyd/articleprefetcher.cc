@@ -0,0 +1,172 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#ifdef SIMPLIFY_POSIX
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <chrono>
+#include <utility>
+
+#include <simplify/dictionary.hh>
+#include <simplify/trace.hh>
+
+#include "articlecache.hh"
+#include "articleprefetcher.hh"
+#include "metrics.hh"
+
+namespace simplifyd {
+
+ArticlePrefetcher::ArticlePrefetcher(ArticleCache &cache, size_t budget)
+  : cache_(cache),
+    budget_(budget),
+    search_jobs_(0),
+    search_generation_(0),
+    stop_(false),
+    thread_(&ArticlePrefetcher::Run, this)
+{
+}
+
+ArticlePrefetcher::~ArticlePrefetcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wakeup_.notify_one();
+    thread_.join();
+}
+
+void ArticlePrefetcher::Schedule(std::shared_ptr<simplify::Dictionary> dict,
+                                 size_t dict_index,
+                                 const std::vector<std::string> &guids)
+{
+    size_t queued = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const std::string &guid : guids) {
+            if (jobs_.size() >= budget_)
+                break;
+            if (cache_.Contains(dict_index, guid.c_str()))
+                continue;
+            jobs_.push_back(Job{dict, dict_index, guid});
+            ++queued;
+        }
+    }
+
+    if (queued > 0)
+        wakeup_.notify_one();
+}
+
+void ArticlePrefetcher::ScheduleSearchResults(std::vector<Job> results)
+{
+    size_t queued = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.erase(jobs_.begin(), jobs_.begin() + search_jobs_);
+        search_jobs_ = 0;
+        ++search_generation_;
+
+        // Make room for the results by dropping the references queued
+        // last.
+        if (results.size() > budget_)
+            results.resize(budget_);
+        while (jobs_.size() + results.size() > budget_)
+            jobs_.pop_back();
+
+        for (auto it = results.rbegin(); it != results.rend(); ++it) {
+            if (cache_.Contains(it->dict_index, it->guid.c_str()))
+                continue;
+            jobs_.push_front(std::move(*it));
+            ++queued;
+        }
+        search_jobs_ = queued;
+    }
+
+    if (queued > 0)
+        wakeup_.notify_one();
+}
+
+void ArticlePrefetcher::WaitForIdleServer()
+{
+    // Don't compete with requests for dictionaries, but don't starve
+    // either: a busy server still gets its articles prefetched, just
+    // later.
+    Gauge &in_flight = Metrics::Instance().GetInFlightRequests();
+    for (int i = 0; i < 50 && in_flight.Value() > 0; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+}
+
+void ArticlePrefetcher::Run()
+{
+#if defined(SIMPLIFY_POSIX) && defined(SYS_gettid)
+    // On Linux the nice value is per thread.
+    setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+#endif
+
+    while (true) {
+        Job job;
+        uint64_t generation = 0;
+        bool search_result;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wakeup_.wait(lock, [this]() { return stop_ || !jobs_.empty(); });
+            if (stop_)
+                return;
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+            search_result = search_jobs_ > 0;
+            if (search_result) {
+                --search_jobs_;
+                generation = search_generation_;
+            }
+        }
+
+        WaitForIdleServer();
+        if (search_result) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (generation != search_generation_)
+                continue;
+        }
+
+        // Leave the article alone if it's cached or a request is
+        // rendering it right now. The article isn't claimed while it's
+        // rendered here, a request for it renders it itself instead of
+        // waiting for this low priority thread.
+        if (!cache_.IsMissing(job.dict_index, job.guid.c_str()))
+            continue;
+
+        simplify::TraceSpan span("ArticlePrefetcher::Render", "simplifyd",
+                                 job.guid.c_str());
+        size_t text_length = 0;
+        auto likely_text = job.dict->ReadText(job.guid.c_str(),
+                                              &text_length);
+        if (!likely_text.is_error()) {
+            cache_.PutIfAbsent(job.dict_index, job.guid.c_str(),
+                               std::make_shared<const std::string>(
+                                   likely_text.value_checked().get(),
+                                   text_length));
+        }
+    }
+}
+
+}  // namespace simplifyd
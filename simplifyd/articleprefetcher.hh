@@ -0,0 +1,101 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#ifndef SIMPLIFYD_ARTICLEPREFETCHER_HH_
+#define SIMPLIFYD_ARTICLEPREFETCHER_HH_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace simplify { class Dictionary; }
+namespace simplifyd {
+
+class ArticleCache;
+
+/**
+ * Renders articles the user is likely to open next into the article cache
+ * on a background thread: the articles a served article refers to, and
+ * the top results of a search.
+ *
+ * The thread runs at the lowest scheduling priority and waits for the
+ * server to go idle before rendering. At most @budget articles wait to
+ * be rendered at a time, the rest are dropped, and so are articles which
+ * are cached by the time their turn comes. Nothing is coordinated with
+ * requests beyond that: a request may render an article while it's being
+ * prefetched, and whichever finishes first is cached. Rendering an
+ * article holds the dictionary locked throughout, so requests to the same
+ * dictionary wait for the prefetcher to finish the article.
+ */
+class ArticlePrefetcher
+{
+public:
+    struct Job {
+        std::shared_ptr<simplify::Dictionary> dict;
+        size_t dict_index;
+        std::string guid;
+    };
+
+    ArticlePrefetcher(ArticleCache &cache, size_t budget);
+    ~ArticlePrefetcher();
+
+    /**
+     * Queues the given articles of the dictionary for rendering unless
+     * they're cached already.
+     */
+    void Schedule(std::shared_ptr<simplify::Dictionary> dict,
+                  size_t dict_index,
+                  const std::vector<std::string> &guids);
+
+    /**
+     * Queues the top results of a search ahead of everything else. The
+     * results of the previous search which are still waiting are dropped,
+     * the user has moved on from them.
+     */
+    void ScheduleSearchResults(std::vector<Job> results);
+
+private:
+    void Run();
+    void WaitForIdleServer();
+
+    ArticleCache &cache_;
+    size_t budget_;
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::deque<Job> jobs_;
+    // Number of search results at the front of jobs_.
+    size_t search_jobs_;
+    // Incremented by every search, so that a search result taken off the
+    // queue can tell whether it has been superseded while waiting for
+    // the server to go idle.
+    uint64_t search_generation_;
+    bool stop_;
+    std::thread thread_;
+};
+
+}  // namespace simplifyd
+
+#endif  // SIMPLIFYD_ARTICLEPREFETCHER_HH_
@@ -0,0 +1,90 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <simplify/dictionary.hh>
+#include <simplify/repository.hh>
+
+#include "backlinksaction.hh"
+#include "httpquery.hh"
+#include "httpresponse.hh"
+#include "jsonwriter.hh"
+#include "metrics.hh"
+
+namespace simplifyd {
+
+/*
+ * Lists articles which refer to the given article.
+ *
+ *   /backlinks?id=DICT&guid=GUID[&limit=100]
+ *
+ * Answers {"limit":N,"results":[GUID,...]} from the dictionary's backlink
+ * index, see EpwingDictionary::BindBacklinks().
+ */
+void BacklinksAction::Handle(simplify::Repository &repository,
+                             HttpQuery &query,
+                             HttpResponse &response)
+{
+    const char *dict_id = query.GetParamValue("id");
+    const char *guid = query.GetParamValue("guid");
+    const char *limit = query.GetParamValue("limit");
+    JsonWriter json(response.GetBody());
+
+    response.AddHeader("Content-Type", "application/json; charset=utf-8");
+
+    if (dict_id == nullptr) {
+        json.Error("No dictionary ID specified");
+        return;
+    } else if (guid == nullptr) {
+        json.Error("No article GUID specified");
+        return;
+    }
+
+    auto dict = repository.GetDictionary(strtol(dict_id, NULL, 10));
+
+    if (dict == nullptr) {
+        json.Error("Invalid dictionary index specified");
+        return;
+    }
+
+    size_t result_limit = limit != nullptr ? strtoul(limit, NULL, 10) : 100;
+    auto likely_guids = dict->GetBacklinks(guid, result_limit);
+
+    if (likely_guids.is_error()) {
+        Metrics::Instance().CountError(likely_guids.error_code());
+        json.Error("An error occurred while retrieving backlinks: "
+                   + likely_guids.error_code().message());
+        return;
+    }
+
+    json.BeginObject()
+        .Key("limit").UInt(result_limit)
+        .Key("results").BeginArray();
+    for (const std::string &result_guid : likely_guids.value_checked())
+        json.String(result_guid);
+    json.EndArray().EndObject();
+
+    response.AddHeader("Cache-Control", "max-age=3600,public");
+}
+
+}  // namespace simplifyd
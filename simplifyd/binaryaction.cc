@@ -0,0 +1,242 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <memory>
+#include <string>
+
+#include <simplify/dictionary.hh>
+#include <simplify/repository.hh>
+
+#include "binaryaction.hh"
+#include "hash.hh"
+#include "httpquery.hh"
+#include "httpresponse.hh"
+#include "jsonwriter.hh"
+#include "metrics.hh"
+
+namespace simplifyd {
+
+static void SetErrorBody(HttpResponse &response, const std::string &message)
+{
+    response.AddHeader("Content-Type", "application/json; charset=utf-8");
+    JsonWriter(response.GetBody()).Error(message);
+}
+
+/*
+ * Parses a Range header with a single byte range. Returns false if the
+ * header can't be parsed, in which case it must be ignored. Otherwise
+ * sets @satisfiable, and @first and @last if the range is satisfiable.
+ */
+static bool ParseRange(const char *range, uint64_t size, uint64_t &first,
+                       uint64_t &last, bool &satisfiable)
+{
+    if (strncmp(range, "bytes=", 6) != 0)
+        return false;
+    range += 6;
+
+    char *endptr;
+    if (*range == '-') {
+        // Suffix range: the last N bytes.
+        uint64_t suffix = strtoull(range + 1, &endptr, 10);
+        if (endptr == range + 1 || *endptr != '\0')
+            return false;
+        satisfiable = suffix > 0 && size > 0;
+        first = suffix < size ? size - suffix : 0;
+        last = size - 1;
+        return true;
+    }
+
+    first = strtoull(range, &endptr, 10);
+    if (endptr == range || *endptr != '-')
+        return false;
+    range = endptr + 1;
+
+    if (*range == '\0') {
+        last = size - 1;
+    } else {
+        last = strtoull(range, &endptr, 10);
+        if (*endptr != '\0' || last < first)
+            return false;
+        if (last >= size)
+            last = size - 1;
+    }
+    satisfiable = first < size;
+    return true;
+}
+
+/*
+ * Streams sound and graphic data of dictionaries.
+ *
+ *   /binary?id=DICT&type=wave&pos=GUID&end=GUID
+ *       A sound between @pos and @end.
+ *   /binary?id=DICT&type=color&pos=GUID
+ *       A color graphic (BMP or JPEG).
+ *   /binary?id=DICT&type=mono&pos=GUID&width=W&height=H
+ *       A monochrome graphic converted to PNG.
+ *
+ * The data is read from the dictionary as it's written to the client.
+ * Single byte ranges and conditional requests are supported.
+ */
+void BinaryAction::Handle(simplify::Repository &repository,
+                          HttpQuery &query,
+                          HttpResponse &response)
+{
+    typedef simplify::Dictionary::BinaryType BinaryType;
+
+    const char *dict_id = query.GetParamValue("id");
+    const char *type = query.GetParamValue("type");
+    const char *pos = query.GetParamValue("pos");
+    const char *end = query.GetParamValue("end");
+    const char *width = query.GetParamValue("width");
+    const char *height = query.GetParamValue("height");
+    simplify::Dictionary::BinaryLocation location;
+
+    if (dict_id == nullptr) {
+        SetErrorBody(response, "No dictionary ID specified");
+        return;
+    } else if (type == nullptr) {
+        SetErrorBody(response, "No data type specified");
+        return;
+    } else if (pos == nullptr) {
+        SetErrorBody(response, "No position specified");
+        return;
+    }
+
+    if (strcmp(type, "wave") == 0) {
+        location.type = BinaryType::Sound;
+    } else if (strcmp(type, "color") == 0) {
+        location.type = BinaryType::ColorGraphic;
+    } else if (strcmp(type, "mono") == 0) {
+        location.type = BinaryType::MonoGraphic;
+    } else {
+        SetErrorBody(response, "Invalid data type specified");
+        return;
+    }
+    location.start = pos;
+    location.end = end;
+    location.width = width != nullptr ? strtol(width, NULL, 10) : 0;
+    location.height = height != nullptr ? strtol(height, NULL, 10) : 0;
+
+    auto dict = repository.GetDictionary(strtol(dict_id, NULL, 10));
+
+    if (dict == nullptr) {
+        SetErrorBody(response, "Invalid dictionary index specified");
+        return;
+    }
+
+    auto likely_stream = dict->OpenBinary(location);
+
+    if (likely_stream.is_error()) {
+        Metrics::Instance().CountError(likely_stream.error_code());
+        SetErrorBody(response, "An error occurred while reading data: "
+                               + likely_stream.error_code().message());
+        return;
+    }
+
+    std::shared_ptr<simplify::Dictionary::BinaryStream> stream(
+        likely_stream.value_checked());
+    uint64_t size = stream->GetSize();
+
+    // The data of a dictionary never changes, so its location and size
+    // identify it.
+    char etag[64];
+    {
+        char key[256];
+        int key_length = snprintf(key, sizeof(key), "%s/%s/%s/%s/%s/%dx%d",
+                                  dict->GetName(), dict_id, type, pos,
+                                  end != nullptr ? end : "",
+                                  location.width, location.height);
+        snprintf(etag, sizeof(etag), "\"%08x-%" PRIx64 "\"",
+                 MurmurHash2(key, key_length, 0), size);
+    }
+
+    response.AddHeader("Content-Type", stream->GetContentType());
+    response.AddHeader("Accept-Ranges", "bytes");
+    response.AddHeader("ETag", etag);
+    response.AddHeader("Cache-Control", "max-age=3600,public");
+
+    const char *if_none_match = query.GetHeaderValue("If-None-Match");
+    if (if_none_match != nullptr
+        && (strstr(if_none_match, etag) != nullptr
+            || strcmp(if_none_match, "*") == 0)) {
+        response.SetStatus(HttpStatusCode::NotModified);
+        return;
+    }
+
+    uint64_t first = 0;
+    uint64_t last = size - 1;
+    const char *range = query.GetHeaderValue("Range");
+    const char *if_range = query.GetHeaderValue("If-Range");
+    bool satisfiable;
+
+    if (range != nullptr
+        && (if_range == nullptr || strcmp(if_range, etag) == 0)
+        && ParseRange(range, size, first, last, satisfiable)) {
+        char content_range[80];
+
+        if (!satisfiable) {
+            snprintf(content_range, sizeof(content_range),
+                     "bytes */%" PRIu64, size);
+            response.SetStatus(HttpStatusCode::RangeNotSatisfiable);
+            response.AddHeader("Content-Range", content_range);
+            return;
+        }
+
+        snprintf(content_range, sizeof(content_range),
+                 "bytes %" PRIu64 "-%" PRIu64 "/%" PRIu64,
+                 first, last, size);
+        response.SetStatus(HttpStatusCode::PartialContent);
+        response.AddHeader("Content-Range", content_range);
+    } else if (size == 0) {
+        return;
+    }
+
+    // The reader outlives this call, so it keeps the dictionary open.
+    uint64_t offset = first;
+    uint64_t remaining = last - first + 1;
+    response.SetBodyReader(remaining,
+        [dict, stream, offset, remaining](char *buffer,
+                                          size_t buffer_size) mutable
+                -> ssize_t {
+            if (remaining == 0)
+                return 0;
+            if (buffer_size > remaining)
+                buffer_size = static_cast<size_t>(remaining);
+
+            auto likely_length = stream->Read(offset, buffer, buffer_size);
+            if (likely_length.is_error()) {
+                Metrics::Instance().CountError(likely_length.error_code());
+                return -1;
+            }
+
+            size_t length = likely_length.value_checked();
+            offset += length;
+            remaining -= length;
+            return length;
+        }
+    );
+}
+
+}  // namespace simplifyd
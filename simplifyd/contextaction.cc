@@ -20,10 +20,10 @@
 
 #include <simplify/dictionary.hh>
 #include <simplify/repository.hh>
-#include <simplify/utils.hh>
 
 #include "httpquery.hh"
 #include "httpresponse.hh"
+#include "jsonwriter.hh"
 #include "contextaction.hh"
 
 namespace simplifyd {
@@ -35,35 +35,19 @@ void ContextAction::Handle(simplify::Repository &repository,
     response.AddHeader("Content-Type", "application/json; charset=utf-8");
     response.AddHeader("Cache-Control", "no-cache");
 
-    std::string &body = response.GetBody();
-    body.append("{\"dicts\":[");
+    JsonWriter json(response.GetBody());
+    json.BeginObject().Key("dicts").BeginArray();
 
     for (size_t i = 0; i < repository.GetDictionaryCount(); ++i) {
         auto dict = repository.GetDictionary(i);
 
-        // Append the name.
-        {
-          body.append("{\"name\":\"").append(dict->GetName()).append("\",");
-        }
-
-        // Append the id.
-        {
-          char text[24];
-          size_t text_length = simplify::UIntToAlpha10(i, text);
-
-          body.append("\"id\":").append(text, text_length).append(",");
-        }
-
-        // Erase trailing comma.
-        body.erase(body.size() - 1);
-        body.append("},");
+        json.BeginObject()
+            .Key("name").String(dict->GetName())
+            .Key("id").UInt(i)
+            .EndObject();
     }
 
-    // Erase trailing comma only if there were some dictionaries.
-    if (repository.GetDictionaryCount() > 0)
-        body.erase(body.size() - 1);
-
-    body.append("]}");
+    json.EndArray().EndObject();
 }
 
 }  // namespace simplifyd
@@ -0,0 +1,128 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <simplify/dictionary.hh>
+#include <simplify/repository.hh>
+
+#include "httpquery.hh"
+#include "httpresponse.hh"
+#include "jsonwriter.hh"
+#include "metrics.hh"
+#include "gaijiaction.hh"
+
+namespace simplifyd {
+
+static void SetHexHeader(HttpResponse &response, const char *name,
+                         unsigned int value)
+{
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%04X", value);
+    response.AddHeader(name, buffer);
+}
+
+static void SetIntHeader(HttpResponse &response, const char *name,
+                         unsigned int value)
+{
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%u", value);
+    response.AddHeader(name, buffer);
+}
+
+/*
+ * Serves images of external characters.
+ *
+ *   /gaiji?id=DICT&code=A121[&size=16][&wide=0]
+ *       A single character, @code is hexadecimal.
+ *   /gaiji?id=DICT&sprite=1[&size=16][&wide=0]
+ *       All characters of the font in one image. Its layout is returned
+ *       in the X-Gaiji-* headers, see Dictionary::GaijiSheetLayout.
+ *
+ * Characters are wide unless wide=0 is given.
+ */
+void GaijiAction::Handle(simplify::Repository &repository,
+                         HttpQuery &query,
+                         HttpResponse &response)
+{
+    const char *dict_id = query.GetParamValue("id");
+    const char *code = query.GetParamValue("code");
+    const char *size = query.GetParamValue("size");
+    const char *wide = query.GetParamValue("wide");
+    const char *sprite = query.GetParamValue("sprite");
+    bool want_sprite = sprite != nullptr && strcmp(sprite, "0") != 0;
+    std::string &body = response.GetBody();
+    JsonWriter json(body);
+
+    if (dict_id == nullptr) {
+        response.AddHeader("Content-Type", "application/json; charset=utf-8");
+        json.Error("No dictionary ID specified");
+        return;
+    } else if (code == nullptr && !want_sprite) {
+        response.AddHeader("Content-Type", "application/json; charset=utf-8");
+        json.Error("No character code specified");
+        return;
+    }
+
+    auto dict = repository.GetDictionary(strtol(dict_id, NULL, 10));
+
+    if (dict == nullptr) {
+        response.AddHeader("Content-Type", "application/json; charset=utf-8");
+        json.Error("Invalid dictionary index specified");
+        return;
+    }
+
+    int height = size != nullptr ? strtol(size, NULL, 10) : 16;
+    bool is_wide = wide == nullptr || strcmp(wide, "0") != 0;
+    simplify::Dictionary::GaijiSheetLayout layout;
+    simplify::Likely<std::shared_ptr<const std::string>> likely_image;
+
+    if (want_sprite) {
+        likely_image = dict->RenderGaijiSheet(is_wide, height, &layout);
+    } else {
+        likely_image = dict->RenderGaiji(strtoul(code, NULL, 16), is_wide,
+                                         height);
+    }
+
+    if (likely_image.is_error()) {
+        Metrics::Instance().CountError(likely_image.error_code());
+        response.AddHeader("Content-Type", "application/json; charset=utf-8");
+        json.Error("An error occurred while rendering external character: "
+                   + likely_image.error_code().message());
+        return;
+    }
+
+    response.AddHeader("Content-Type", "image/png");
+    if (want_sprite) {
+        SetIntHeader(response, "X-Gaiji-Width", layout.glyph_width);
+        SetIntHeader(response, "X-Gaiji-Height", layout.glyph_height);
+        SetHexHeader(response, "X-Gaiji-Start", layout.start);
+        SetHexHeader(response, "X-Gaiji-End", layout.end);
+        SetHexHeader(response, "X-Gaiji-First-Column", layout.first_column);
+        SetIntHeader(response, "X-Gaiji-Columns", layout.columns);
+    }
+    body.assign(*likely_image.value_checked());
+
+    response.AddHeader("Cache-Control", "max-age=3600,public");
+}
+
+}  // namespace simplifyd
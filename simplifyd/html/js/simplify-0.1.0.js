@@ -205,6 +205,9 @@ ResultsContainer.prototype = {
  */
 function SearchAgent() {
   this._lastSearchId = null;
+  // Lets the server narrow down results of the previous search when the
+  // query is being typed.
+  this._session = Math.random().toString(36).substr(2);
 }
 
 SearchAgent.prototype = {
@@ -247,7 +250,8 @@ SearchAgent.prototype = {
     var searchId = this._lastSearchId = Math.random();
 
     $.ajax({
-      url: 'search?id=' + context.id + '&q=' + encodeURIComponent(query),
+      url: 'search?id=' + context.id + '&q=' + encodeURIComponent(query) +
+           '&session=' + this._session,
       success: function(re) {
         self._handleAjaxSuccess(context, searchId, re, onSuccess, onFailure);
       },
@@ -20,6 +20,7 @@
 
 #include <ctype.h>
 #include <string.h>
+#include <strings.h>
 
 #include <algorithm>
 #include <cassert>
@@ -68,6 +69,16 @@ const char *HttpQuery::GetParamValue(const char *name, size_t &value_size) const
     }
 }
 
+const char *HttpQuery::GetHeaderValue(const char *name) const
+{
+    for (int i = 0; i < request_info_.num_headers; ++i) {
+        if (strcasecmp(request_info_.http_headers[i].name, name) == 0)
+            return request_info_.http_headers[i].value;
+    }
+
+    return NULL;
+}
+
 const char *HttpQuery::GetCookieValue(const char *name) const
 {
     assert(!"HttpQuery::GetCookieValue() not implemented");
@@ -34,6 +34,7 @@ public:
 
     const char *GetParamValue(const char *name) const;
     const char *GetParamValue(const char *name, size_t &value_size) const;
+    const char *GetHeaderValue(const char *name) const;
     const char *GetCookieValue(const char *name) const;
     const char *GetCookieValue(const char *name, size_t &value_size) const;
 
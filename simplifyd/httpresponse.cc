@@ -22,6 +22,7 @@
 
 #include <cassert>
 #include <algorithm>
+#include <utility>
 
 #include "httpresponse.hh"
 
@@ -64,6 +65,12 @@ static const char *GetStatusCodeText(HttpStatusCode status_code)
     switch (status_code) {
         case HttpStatusCode::Ok:
             return "OK";
+        case HttpStatusCode::PartialContent:
+            return "Partial Content";
+        case HttpStatusCode::NotModified:
+            return "Not Modified";
+        case HttpStatusCode::RangeNotSatisfiable:
+            return "Range Not Satisfiable";
         default:
             return "Invalid Status Code";
     }
@@ -79,7 +86,10 @@ static size_t Uitoa10(size_t v, char *buffer)
 
 HttpResponse::HttpResponse()
   : http_version_(HttpVersion::Http1_1),
-    status_code_(HttpStatusCode::Ok)
+    status_code_(HttpStatusCode::Ok),
+    body_reader_length_(0),
+    streaming_(false),
+    client_gone_(false)
 {
     headers_.reserve(6);
     body_.reserve(128 * 1024);
@@ -147,12 +157,92 @@ const std::string &HttpResponse::GetBody() const
     return body_;
 }
 
-std::string HttpResponse::ProduceResponse() const
+void HttpResponse::SetBodyReader(uint64_t length, BodyReader reader)
+{
+    body_reader_ = std::move(reader);
+    body_reader_length_ = length;
+}
+
+const HttpResponse::BodyReader &HttpResponse::GetBodyReader() const
+{
+    return body_reader_;
+}
+
+void HttpResponse::EnableChunkedWrites(Writer writer)
+{
+    writer_ = std::move(writer);
+}
+
+bool HttpResponse::Flush()
+{
+    if (!writer_ || body_reader_)
+        return true;
+    if (client_gone_)
+        return false;
+
+    if (!streaming_) {
+        std::string head = ProduceHead(true);
+        streaming_ = true;
+        if (!writer_(head.data(), head.size())) {
+            client_gone_ = true;
+            return false;
+        }
+    }
+
+    return WriteChunk();
+}
+
+bool HttpResponse::IsStreaming() const
+{
+    return streaming_;
+}
+
+bool HttpResponse::FinishChunks()
+{
+    if (!WriteChunk())
+        return false;
+    if (!writer_("0\r\n\r\n", 5)) {
+        client_gone_ = true;
+        return false;
+    }
+    return true;
+}
+
+bool HttpResponse::WriteChunk()
+{
+    static const char kHexDigits[] = "0123456789abcdef";
+
+    if (client_gone_)
+        return false;
+    if (body_.empty())
+        return true;
+
+    // Chunk size in hex followed by CRLF. The CRLF after the data goes
+    // into the body, so that the data is written in one go.
+    char prefix[24];
+    char *out = prefix;
+    size_t size = body_.size();
+    do *out++ = kHexDigits[size & 15]; while (size >>= 4);
+    std::reverse(prefix, out);
+    *out++ = '\r';
+    *out++ = '\n';
+
+    body_.append("\r\n", 2);
+    if (!writer_(prefix, out - prefix)
+        || !writer_(body_.data(), body_.size())) {
+        client_gone_ = true;
+        return false;
+    }
+    body_.clear();
+    return true;
+}
+
+std::string HttpResponse::ProduceHead(bool chunked) const
 {
     char number_buffer[30];
     size_t number_length;
     std::string response;
-    response.reserve(headers_.size() * 32 + body_.size());
+    response.reserve(headers_.size() * 32 + 64);
 
     // Format the Status-Line.
     //
@@ -181,14 +271,33 @@ std::string HttpResponse::ProduceResponse() const
                 .append((*it)->value).append("\r\n");
     }
 
-    // Append the Content-Length header.
-    number_length = Uitoa10(body_.size(), number_buffer);
+    // Append the Content-Length header, or say that the length will be
+    // known at the end.
+    if (chunked) {
+        response.append("Transfer-Encoding: chunked\r\n\r\n");
+        return response;
+    }
+
+    if (body_reader_)
+        number_length = Uitoa10(body_reader_length_, number_buffer);
+    else
+        number_length = Uitoa10(body_.size(), number_buffer);
     response.append("Content-Length: ") \
             .append(number_buffer, number_length) \
             .append("\r\n\r\n");
 
-    // Append body.
-    response.append(body_);
+    return response;
+}
+
+std::string HttpResponse::ProduceResponse() const
+{
+    std::string response = ProduceHead(false);
+
+    // Append body. The server reads it from body_reader_ if there's one.
+    if (!body_reader_) {
+        response.reserve(response.size() + body_.size());
+        response.append(body_);
+    }
 
     return response;
 }
@@ -21,13 +21,20 @@
 #ifndef SIMPLIFYD_HTTPRESPONSE_HH_
 #define SIMPLIFYD_HTTPRESPONSE_HH_
 
+#include <sys/types.h>
+
+#include <cstdint>
+#include <functional>
 #include <vector>
 #include <string>
 
 namespace simplifyd {
 
 enum class HttpStatusCode {
-    Ok = 200
+    Ok = 200,
+    PartialContent = 206,
+    NotModified = 304,
+    RangeNotSatisfiable = 416
 };
 
 enum class HttpVersion {
@@ -50,13 +57,72 @@ public:
     std::string &GetBody();
     const std::string &GetBody() const;
 
+    /**
+     * Reads the next part of a body into @buffer of @size bytes. Returns
+     * the number of bytes read, 0 at the end or -1 on error.
+     */
+    typedef std::function<ssize_t(char *buffer, size_t size)> BodyReader;
+
+    /**
+     * Makes the response send a body of @length bytes produced by @reader
+     * instead of GetBody(). The server writes the body in parts as it is
+     * read, so it's never kept in memory as a whole.
+     */
+    void SetBodyReader(uint64_t length, BodyReader reader);
+    const BodyReader &GetBodyReader() const;
+
+    /**
+     * Writes @length bytes of @data to the client. Returns false if the
+     * client is gone.
+     */
+    typedef std::function<bool(const char *data, size_t length)> Writer;
+
+    /**
+     * Lets Flush() send the response in parts through @writer, with
+     * chunked transfer encoding.
+     */
+    void EnableChunkedWrites(Writer writer);
+
+    /**
+     * Sends the body produced so far as a chunk and empties it. The first
+     * flush sends the Status-Line and headers, headers added after it are
+     * ignored. Does nothing unless chunked writes are enabled or if a body
+     * reader is set. Returns false if the client is gone, in which case
+     * the action may as well stop.
+     */
+    bool Flush();
+
+    /**
+     * Whether Flush() has sent the headers. The response is then finished
+     * by FinishChunks() rather than sent by ProduceResponse().
+     */
+    bool IsStreaming() const;
+
+    /**
+     * Sends the rest of the body and the last chunk of a streamed
+     * response.
+     */
+    bool FinishChunks();
+
+    /**
+     * Formats the Status-Line and headers followed by the body, unless
+     * a body reader is set.
+     */
     std::string ProduceResponse() const;
 
 private:
+    std::string ProduceHead(bool chunked) const;
+    bool WriteChunk();
+
     HttpVersion http_version_;
     HttpStatusCode status_code_;
     std::vector<HttpHeader *> headers_;
     std::string body_;
+    BodyReader body_reader_;
+    uint64_t body_reader_length_;
+    Writer writer_;
+    bool streaming_;
+    bool client_gone_;
 };
 
 }  // namespace simplifyd
@@ -0,0 +1,252 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#include <cstring>
+
+#include <simplify/utils.hh>
+
+#include "jsonwriter.hh"
+
+// Text is scanned for characters to escape 16 bytes at a time with SSE2
+// and 32 bytes at a time with AVX2 if the CPU supports it.
+#ifdef __SSE2__
+#define SIMPLIFYD_JSON_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMPLIFYD_JSON_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+namespace simplifyd {
+
+static inline bool NeedsEscape(unsigned char c)
+{
+    return c < 0x20 || c == '"' || c == '\\';
+}
+
+#ifdef SIMPLIFYD_JSON_SSE2
+/**
+ * Returns a bit mask of the bytes of @block that need escaping.
+ */
+static inline unsigned int EscapeMaskSse2(__m128i block)
+{
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control_max = _mm_set1_epi8(0x1f);
+
+    // A byte is a control character if it's its minimum with 0x1f.
+    __m128i special = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(block, quote),
+                     _mm_cmpeq_epi8(block, backslash)),
+        _mm_cmpeq_epi8(_mm_min_epu8(block, control_max), block));
+    return static_cast<unsigned int>(_mm_movemask_epi8(special));
+}
+#endif
+
+#ifdef SIMPLIFYD_JSON_AVX2
+__attribute__((target("avx2")))
+static size_t FindEscapeAvx2(const char *text, size_t length)
+{
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i control_max = _mm256_set1_epi8(0x1f);
+    size_t i = 0;
+
+    for (; i + 32 <= length; i += 32) {
+        __m256i block =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + i));
+        __m256i special = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(block, quote),
+                            _mm256_cmpeq_epi8(block, backslash)),
+            _mm256_cmpeq_epi8(_mm256_min_epu8(block, control_max), block));
+        unsigned int mask =
+            static_cast<unsigned int>(_mm256_movemask_epi8(special));
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+
+    return i;
+}
+
+static const bool g_have_avx2 = []() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+}();
+#endif
+
+/**
+ * Returns the offset of the first byte of @text that needs escaping, or
+ * @length if there's none.
+ */
+static size_t FindEscape(const char *text, size_t length)
+{
+    size_t i = 0;
+
+#ifdef SIMPLIFYD_JSON_AVX2
+    if (g_have_avx2 && length >= 32) {
+        i = FindEscapeAvx2(text, length);
+        if (i + 32 <= length)
+            return i;
+    }
+#endif
+#ifdef SIMPLIFYD_JSON_SSE2
+    for (; i + 16 <= length; i += 16) {
+        unsigned int mask = EscapeMaskSse2(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i)));
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+#endif
+
+    for (; i < length; ++i) {
+        if (NeedsEscape(static_cast<unsigned char>(text[i])))
+            return i;
+    }
+
+    return length;
+}
+
+void JsonWriter::AppendEscaped(std::string &out, const char *value,
+                               size_t length)
+{
+    static const char kHexDigits[] = "0123456789abcdef";
+
+    while (true) {
+        size_t run = FindEscape(value, length);
+        out.append(value, run);
+        if (run == length)
+            break;
+
+        unsigned char c = static_cast<unsigned char>(value[run]);
+        switch (c) {
+            case '"': out.append("\\\"", 2); break;
+            case '\\': out.append("\\\\", 2); break;
+            case '\b': out.append("\\b", 2); break;
+            case '\f': out.append("\\f", 2); break;
+            case '\n': out.append("\\n", 2); break;
+            case '\r': out.append("\\r", 2); break;
+            case '\t': out.append("\\t", 2); break;
+            default: {
+                char escape[6] = {
+                    '\\', 'u', '0', '0', kHexDigits[c >> 4], kHexDigits[c & 15]
+                };
+                out.append(escape, sizeof(escape));
+                break;
+            }
+        }
+
+        value += run + 1;
+        length -= run + 1;
+    }
+}
+
+JsonWriter::JsonWriter(std::string &out)
+  : out_(out),
+    after_key_(false)
+{
+}
+
+void JsonWriter::BeginValue()
+{
+    if (after_key_) {
+        after_key_ = false;
+    } else if (!has_items_.empty()) {
+        if (has_items_.back())
+            out_.append(1, ',');
+        has_items_.back() = true;
+    }
+}
+
+JsonWriter &JsonWriter::BeginObject()
+{
+    BeginValue();
+    out_.append(1, '{');
+    has_items_.push_back(false);
+    return *this;
+}
+
+JsonWriter &JsonWriter::EndObject()
+{
+    out_.append(1, '}');
+    has_items_.pop_back();
+    return *this;
+}
+
+JsonWriter &JsonWriter::BeginArray()
+{
+    BeginValue();
+    out_.append(1, '[');
+    has_items_.push_back(false);
+    return *this;
+}
+
+JsonWriter &JsonWriter::EndArray()
+{
+    out_.append(1, ']');
+    has_items_.pop_back();
+    return *this;
+}
+
+JsonWriter &JsonWriter::Key(const char *key)
+{
+    BeginValue();
+    out_.append(1, '"');
+    AppendEscaped(out_, key, strlen(key));
+    out_.append("\":", 2);
+    after_key_ = true;
+    return *this;
+}
+
+JsonWriter &JsonWriter::String(const char *value)
+{
+    return String(value, strlen(value));
+}
+
+JsonWriter &JsonWriter::String(const char *value, size_t length)
+{
+    BeginValue();
+    out_.append(1, '"');
+    AppendEscaped(out_, value, length);
+    out_.append(1, '"');
+    return *this;
+}
+
+JsonWriter &JsonWriter::String(const std::string &value)
+{
+    return String(value.data(), value.size());
+}
+
+JsonWriter &JsonWriter::UInt(size_t value)
+{
+    char text[24];
+    size_t length = simplify::UIntToAlpha10(value, text);
+
+    BeginValue();
+    out_.append(text, length);
+    return *this;
+}
+
+JsonWriter &JsonWriter::Error(const std::string &message)
+{
+    return BeginObject().Key("error").String(message).EndObject();
+}
+
+}  // namespace simplifyd
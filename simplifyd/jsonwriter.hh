@@ -0,0 +1,78 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#ifndef SIMPLIFYD_JSONWRITER_HH_
+#define SIMPLIFYD_JSONWRITER_HH_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace simplifyd {
+
+/**
+ * Appends JSON to a string. Strings are escaped as they're written and
+ * commas between members and elements are inserted automatically:
+ *
+ *   JsonWriter json(response.GetBody());
+ *   json.BeginObject().Key("limit").UInt(100).Key("results").BeginArray();
+ */
+class JsonWriter
+{
+public:
+    explicit JsonWriter(std::string &out);
+
+    JsonWriter &BeginObject();
+    JsonWriter &EndObject();
+    JsonWriter &BeginArray();
+    JsonWriter &EndArray();
+
+    /// Writes the name of the next member of the current object.
+    JsonWriter &Key(const char *key);
+
+    JsonWriter &String(const char *value);
+    JsonWriter &String(const char *value, size_t length);
+    JsonWriter &String(const std::string &value);
+    JsonWriter &UInt(size_t value);
+
+    /**
+     * Writes {"error":"@message"} as the next value.
+     */
+    JsonWriter &Error(const std::string &message);
+
+    /**
+     * Appends UTF-8 text as the contents of a JSON string: quotes,
+     * backslashes and control characters are escaped.
+     */
+    static void AppendEscaped(std::string &out, const char *value,
+                              size_t length);
+
+private:
+    void BeginValue();
+
+    std::string &out_;
+    // Whether each open object or array has a member or element already.
+    std::vector<bool> has_items_;
+    bool after_key_;
+};
+
+}  // namespace simplifyd
+
+#endif  // SIMPLIFYD_JSONWRITER_HH_
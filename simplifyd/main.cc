@@ -28,23 +28,45 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <iostream>
+#include <memory>
 #include <string>
 
 #include <simplify/simplify.hh>
 #include <simplify/repository.hh>
 #include <simplify/epwing/epwing-dictionary.hh>
 
+#include <eb/eb.h>
+#include <eb/error.h>
+
 #include "articleaction.hh"
+#include "articlecache.hh"
+#include "articleprefetcher.hh"
+#include "backlinksaction.hh"
+#include "binaryaction.hh"
 #include "contextaction.hh"
+#include "fulltextaction.hh"
+#include "gaijiaction.hh"
+#include "metrics.hh"
+#include "metricsaction.hh"
 #include "options.hh"
 #include "searchaction.hh"
+#include "searchsessions.hh"
 #include "server.hh"
 
 
 namespace simplifyd {
 
+// Number of articles that may wait to be prefetched at a time, across all
+// dictionaries.
+static const size_t kArticlePrefetchBudget = 64;
+
+// Number of clients whose search sessions are kept.
+static const size_t kSearchSessionCount = 256;
+
 static void PrintHelpAndExit()
 {
     Options default_options{};
@@ -66,6 +88,60 @@ Simplify server daemon.
       Directory containing program's assets.
       Default: )#" << default_options.GetRepositoryConfigPath() << R"#(
 
+  -t TRACE-DIR, --trace-dir TRACE-DIR
+      Record a trace of every request and save it to TRACE-DIR in the
+      Chrome trace event format. The path of the trace is returned in
+      the X-Simplify-Trace-File header. /metrics is traced only if the
+      request carries the X-Simplify-Trace header. Without this option
+      nothing is traced.
+
+  -c MEGABYTES, --cache-size MEGABYTES
+      Keep up to MEGABYTES of decompressed slices of EBZIP and EPWING
+      compressed dictionaries in memory. Default: )#"
+        << default_options.GetCacheSize() << R"#(.
+
+  -i, --preload-index
+      Decode word search indexes of dictionaries into memory when they
+      are opened, so that searches don't read index pages from disk.
+      Default: )#"
+        << (default_options.GetPreloadIndex()
+            ? "Preload indexes"
+            : "Read indexes from disk")
+        << R"#(.
+
+  -m, --mmap
+      Map dictionary files into memory instead of reading them with
+      system calls. Has no effect on dictionaries opened through ebnet.
+      Default: )#"
+        << (default_options.GetMapFiles()
+            ? "Map files"
+            : "Read files")
+        << R"#(.
+
+  -f SLICES, --prefetch SLICES
+      When an article or an index of an EBZIP compressed dictionary is
+      read sequentially, decompress up to SLICES slices ahead of the
+      reader on background threads. 0 disables prefetching. Default: )#"
+        << default_options.GetPrefetchSlices() << R"#(.
+
+  -a MEGABYTES, --article-cache MEGABYTES
+      Keep up to MEGABYTES of rendered articles in memory. 0 disables
+      the cache. Default: )#"
+        << default_options.GetArticleCacheSize() << R"#(.
+
+  -x COUNT, --prefetch-references COUNT
+      After serving an article, render up to COUNT of the articles it
+      refers to into the article cache on a low priority thread. 0
+      disables prefetching. Default: )#"
+        << default_options.GetPrefetchReferences() << R"#(.
+
+  -k COUNT, --prefetch-results COUNT
+      After a search, render the articles of its first COUNT results
+      into the article cache on a low priority thread. Requests for an
+      article being rendered wait for it instead of rendering it again.
+      0 disables prefetching. Default: )#"
+        << default_options.GetPrefetchResults() << R"#(.
+
   -b, --background
       Detach and run in background. Default: )#"
         << (default_options.GetDaemonize()
@@ -85,6 +161,14 @@ static bool ParseCommandLine(int argc, char *argv[], Options &options)
         { "port", 1, 0, 'p' },
         { "repository", 1, 0, 'r' },
         { "html-dir", 1, 0, 'd' },
+        { "trace-dir", 1, 0, 't' },
+        { "cache-size", 1, 0, 'c' },
+        { "preload-index", 0, 0, 'i' },
+        { "mmap", 0, 0, 'm' },
+        { "prefetch", 1, 0, 'f' },
+        { "article-cache", 1, 0, 'a' },
+        { "prefetch-references", 1, 0, 'x' },
+        { "prefetch-results", 1, 0, 'k' },
         { "daemonize", 0, 0, 'b' },
         { "help", 0, 0, 'h' },
         { 0, 0, 0, 0 }
@@ -93,7 +177,7 @@ static bool ParseCommandLine(int argc, char *argv[], Options &options)
     while (true) {
         int argv_index;
         int c = getopt_long(argc, argv,
-                            "p:r:d:bh",
+                            "p:r:d:t:c:imf:a:x:k:bh",
                             g_daemon_options,
                             &argv_index);
         if (c == -1)
@@ -119,6 +203,81 @@ static bool ParseCommandLine(int argc, char *argv[], Options &options)
                 options.SetHtmlDir(optarg);
                 break;
             }
+            case 't': {
+                options.SetTraceDir(optarg);
+                break;
+            }
+            case 'c': {
+                char *endptr;
+                long megabytes = strtol(optarg, &endptr, 10);
+                if (*endptr == '\0' && megabytes >= 0
+                    && static_cast<size_t>(megabytes)
+                        <= SIZE_MAX / (1024 * 1024)) {
+                    options.SetCacheSize(megabytes);
+                } else {
+                    std::cout << "Cache size is invalid." << std::endl;
+                    return false;
+                }
+                break;
+            }
+            case 'i': {
+                options.SetPreloadIndex(true);
+                break;
+            }
+            case 'm': {
+                options.SetMapFiles(true);
+                break;
+            }
+            case 'f': {
+                char *endptr;
+                long slices = strtol(optarg, &endptr, 10);
+                if (*endptr == '\0' && slices >= 0 && slices <= 64) {
+                    options.SetPrefetchSlices(slices);
+                } else {
+                    std::cout << "Number of prefetched slices is invalid."
+                              << std::endl;
+                    return false;
+                }
+                break;
+            }
+            case 'a': {
+                char *endptr;
+                long megabytes = strtol(optarg, &endptr, 10);
+                if (*endptr == '\0' && megabytes >= 0
+                    && static_cast<size_t>(megabytes)
+                        <= SIZE_MAX / (1024 * 1024)) {
+                    options.SetArticleCacheSize(megabytes);
+                } else {
+                    std::cout << "Article cache size is invalid."
+                              << std::endl;
+                    return false;
+                }
+                break;
+            }
+            case 'x': {
+                char *endptr;
+                long references = strtol(optarg, &endptr, 10);
+                if (*endptr == '\0' && references >= 0 && references <= 64) {
+                    options.SetPrefetchReferences(references);
+                } else {
+                    std::cout << "Number of prefetched references is invalid."
+                              << std::endl;
+                    return false;
+                }
+                break;
+            }
+            case 'k': {
+                char *endptr;
+                long results = strtol(optarg, &endptr, 10);
+                if (*endptr == '\0' && results >= 0 && results <= 64) {
+                    options.SetPrefetchResults(results);
+                } else {
+                    std::cout << "Number of prefetched results is invalid."
+                              << std::endl;
+                    return false;
+                }
+                break;
+            }
             case 'b': {
                 options.SetDaemonize(true);
                 break;
@@ -171,15 +330,82 @@ int main(int argc, char *argv[])
         }
     }
 
+    if (eb_set_cache_size(options.GetCacheSize() * 1024 * 1024)
+            != EB_SUCCESS) {
+        std::cerr << "Failed to resize slice cache." << std::endl;
+        return 1;
+    }
+    eb_set_word_index_preload(options.GetPreloadIndex());
+    eb_set_mmap(options.GetMapFiles());
+    // Decompressing a slice takes well under a millisecond, so a few
+    // threads keep up with any reasonable prefetch depth.
+    if (eb_set_prefetch(std::min(options.GetPrefetchSlices(), 4),
+                        options.GetPrefetchSlices()) != EB_SUCCESS) {
+        std::cerr << "Failed to start prefetch threads." << std::endl;
+        return 1;
+    }
+
     int return_code;
     auto likely_r = simplify::Repository::New(options.GetRepositoryConfigPath());
 
     // Start the web server if we've successfully opened repository.
     if (likely_r) {
+        simplify::Repository &repository = *likely_r.value_checked();
+        simplifyd::Metrics &metrics = simplifyd::Metrics::Instance();
+
+        for (auto it = repository.Begin(); it != repository.End(); ++it)
+            metrics.AddDictionary(&**it);
+        metrics.AddCacheProbe("slice", [](uint64_t *hits, uint64_t *misses) {
+            unsigned long eb_hits, eb_misses;
+            eb_cache_statistics(&eb_hits, &eb_misses);
+            *hits = eb_hits;
+            *misses = eb_misses;
+        });
+        // Prefetched slices which have been read count as hits, the rest
+        // (including those still in flight) as misses.
+        metrics.AddCacheProbe("prefetch",
+                              [](uint64_t *hits, uint64_t *misses) {
+            unsigned long issued, used;
+            eb_prefetch_statistics(&issued, &used);
+            *hits = used;
+            *misses = issued > used ? issued - used : 0;
+        });
+
+        std::unique_ptr<simplifyd::ArticleCache> article_cache;
+        std::unique_ptr<simplifyd::ArticlePrefetcher> prefetcher;
+        if (options.GetArticleCacheSize() > 0) {
+            article_cache.reset(new simplifyd::ArticleCache(
+                options.GetArticleCacheSize() * 1024 * 1024));
+            metrics.AddCacheProbe("article",
+                                  [&article_cache](uint64_t *hits,
+                                                   uint64_t *misses) {
+                article_cache->GetStatistics(hits, misses);
+            });
+            if (options.GetPrefetchReferences() > 0
+                || options.GetPrefetchResults() > 0) {
+                prefetcher.reset(new simplifyd::ArticlePrefetcher(
+                    *article_cache, simplifyd::kArticlePrefetchBudget));
+            }
+        }
+
+        simplifyd::SearchSessions search_sessions(
+            simplifyd::kSearchSessionCount);
+
         simplifyd::Server server(likely_r);
         server.AddRoute("/context", new simplifyd::ContextAction());
-        server.AddRoute("/search", new simplifyd::SearchAction());
-        server.AddRoute("/article", new simplifyd::ArticleAction());
+        server.AddRoute("/search",
+                        new simplifyd::SearchAction(
+                            &search_sessions, prefetcher.get(),
+                            options.GetPrefetchResults()));
+        server.AddRoute("/article",
+                        new simplifyd::ArticleAction(
+                            article_cache.get(), prefetcher.get(),
+                            options.GetPrefetchReferences()));
+        server.AddRoute("/gaiji", new simplifyd::GaijiAction());
+        server.AddRoute("/binary", new simplifyd::BinaryAction());
+        server.AddRoute("/backlinks", new simplifyd::BacklinksAction());
+        server.AddRoute("/fulltext", new simplifyd::FullTextAction());
+        server.AddRoute("/metrics", new simplifyd::MetricsAction());
 
         return_code = server.Start(options) ? 0 : 1;
     } else {
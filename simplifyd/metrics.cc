@@ -0,0 +1,376 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#include <stdio.h>
+
+#include <algorithm>
+
+#include <eb/error.h>
+
+#include <simplify/dictionary.hh>
+#include <simplify/error.hh>
+#include <simplify/utils.hh>
+
+#include "metrics.hh"
+
+namespace simplifyd {
+
+namespace metrics_internal {
+
+size_t ShardIndex()
+{
+    static std::atomic<size_t> next_index{0};
+    thread_local size_t index =
+        next_index.fetch_add(1, std::memory_order_relaxed) % kShardCount;
+    return index;
+}
+
+}  // namespace metrics_internal
+
+static const size_t kSimplifyErrorCount =
+    simplify::simplify_error::simplify_error_count;
+
+uint64_t Counter::Value() const
+{
+    uint64_t total = 0;
+    for (const Shard &shard : shards_)
+        total += shard.value.load(std::memory_order_relaxed);
+    return total;
+}
+
+int64_t Gauge::Value() const
+{
+    int64_t total = 0;
+    for (const Shard &shard : shards_)
+        total += shard.value.load(std::memory_order_relaxed);
+    return total;
+}
+
+static size_t GetBucketIndex(uint64_t us)
+{
+    if (us < 2)
+        return us;
+
+    // Each power of two is split into two buckets: the bit that follows
+    // the most significant one selects the lower or the upper half.
+    size_t msb = 63 - __builtin_clzll(us);
+    size_t index = msb * 2 + ((us >> (msb - 1)) & 1);
+
+    return index < Histogram::kBucketCount
+        ? index
+        : Histogram::kBucketCount - 1;
+}
+
+uint64_t Histogram::BucketUpperBound(size_t index)
+{
+    if (index < 2)
+        return index + 1;
+
+    return (2 + (index & 1) + 1) << (index / 2 - 1);
+}
+
+void Histogram::Observe(std::chrono::steady_clock::duration elapsed)
+{
+    uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(
+        elapsed).count();
+    Shard &shard = shards_[metrics_internal::ShardIndex()];
+
+    shard.buckets[GetBucketIndex(us)].fetch_add(1, std::memory_order_relaxed);
+    shard.count.fetch_add(1, std::memory_order_relaxed);
+    shard.sum_us.fetch_add(us, std::memory_order_relaxed);
+}
+
+void Histogram::Collect(uint64_t *buckets, uint64_t *count,
+                        uint64_t *sum_us) const
+{
+    std::fill(buckets, buckets + kBucketCount, 0);
+    *count = 0;
+    *sum_us = 0;
+
+    for (const Shard &shard : shards_) {
+        for (size_t i = 0; i < kBucketCount; ++i)
+            buckets[i] += shard.buckets[i].load(std::memory_order_relaxed);
+        *count += shard.count.load(std::memory_order_relaxed);
+        *sum_us += shard.sum_us.load(std::memory_order_relaxed);
+    }
+}
+
+Metrics::Metrics()
+  : simplify_errors_(new std::atomic<uint64_t>[kSimplifyErrorCount]),
+    eb_errors_(new std::atomic<uint64_t>[EB_NUMBER_OF_ERRORS]),
+    other_errors_(0)
+{
+    for (size_t i = 0; i < kSimplifyErrorCount; ++i)
+        simplify_errors_[i] = 0;
+    for (size_t i = 0; i < EB_NUMBER_OF_ERRORS; ++i)
+        eb_errors_[i] = 0;
+}
+
+Metrics &Metrics::Instance()
+{
+    static Metrics metrics;
+    return metrics;
+}
+
+RouteMetrics *Metrics::AddRoute(const char *route)
+{
+    routes_.push_back(Route{route, std::make_unique<RouteMetrics>()});
+    return routes_.back().metrics.get();
+}
+
+void Metrics::AddDictionary(const simplify::Dictionary *dict)
+{
+    if (dict_index_.find(dict) != dict_index_.end())
+        return;
+
+    dicts_.push_back(
+        Dictionary{dict->GetName(), std::make_unique<DictionaryMetrics>()});
+    dict_index_[dict] = dicts_.back().metrics.get();
+}
+
+void Metrics::AddCacheProbe(const char *name, CacheProbe probe)
+{
+    caches_.push_back(Cache{name, std::move(probe)});
+}
+
+DictionaryMetrics *Metrics::GetDictionaryMetrics(
+    const simplify::Dictionary *dict)
+{
+    auto it = dict_index_.find(dict);
+    return it != dict_index_.end() ? it->second : nullptr;
+}
+
+void Metrics::CountError(const std::error_code &error)
+{
+    int value = error.value();
+
+    if (error.category() == simplify::simplify_category()
+        && value >= 0 && static_cast<size_t>(value) < kSimplifyErrorCount) {
+        simplify_errors_[value].fetch_add(1, std::memory_order_relaxed);
+    } else if (error.category() == simplify::eb_category()
+               && value >= 0 && value < EB_NUMBER_OF_ERRORS) {
+        eb_errors_[value].fetch_add(1, std::memory_order_relaxed);
+    } else {
+        other_errors_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+Gauge &Metrics::GetInFlightRequests()
+{
+    return in_flight_;
+}
+
+/**
+ * Appends a label value escaped according to the text exposition format.
+ */
+static void AppendLabelValue(std::string &out, const std::string &value)
+{
+    for (char c : value) {
+        switch (c) {
+            case '\\': out.append("\\\\"); break;
+            case '"': out.append("\\\""); break;
+            case '\n': out.append("\\n"); break;
+            default: out.append(1, c); break;
+        }
+    }
+}
+
+static void AppendUInt(std::string &out, uint64_t v)
+{
+    char tmp[24];
+    out.append(tmp, simplify::UIntToAlpha10(v, tmp));
+}
+
+static void AppendSeconds(std::string &out, uint64_t us)
+{
+    char tmp[32];
+    int length = snprintf(tmp, sizeof(tmp), "%.6f", us / 1e6);
+    out.append(tmp, length);
+}
+
+static void AppendHeader(std::string &out, const char *name,
+                         const char *type, const char *help)
+{
+    out.append("# HELP ").append(name).append(1, ' ')
+       .append(help).append(1, '\n');
+    out.append("# TYPE ").append(name).append(1, ' ')
+       .append(type).append(1, '\n');
+}
+
+/**
+ * Appends samples of a histogram. The @labels string must contain
+ * complete label pairs without the enclosing braces.
+ */
+static void AppendHistogram(std::string &out, const char *name,
+                            const std::string &labels,
+                            const Histogram &histogram)
+{
+    uint64_t buckets[Histogram::kBucketCount];
+    uint64_t count;
+    uint64_t sum_us;
+    uint64_t cumulative = 0;
+
+    histogram.Collect(buckets, &count, &sum_us);
+
+    // The last bucket collects all overflowing values and is reported as
+    // +Inf only.
+    for (size_t i = 0; i + 1 < Histogram::kBucketCount; ++i) {
+        cumulative += buckets[i];
+        out.append(name).append("_bucket{").append(labels)
+           .append(",le=\"");
+        AppendSeconds(out, Histogram::BucketUpperBound(i));
+        out.append("\"} ");
+        AppendUInt(out, cumulative);
+        out.append(1, '\n');
+    }
+
+    out.append(name).append("_bucket{").append(labels)
+       .append(",le=\"+Inf\"} ");
+    AppendUInt(out, count);
+    out.append(1, '\n');
+
+    out.append(name).append("_sum{").append(labels).append("} ");
+    AppendSeconds(out, sum_us);
+    out.append(1, '\n');
+
+    out.append(name).append("_count{").append(labels).append("} ");
+    AppendUInt(out, count);
+    out.append(1, '\n');
+}
+
+void Metrics::Render(std::string &out) const
+{
+    static const struct {
+        const char *name;
+        const char *help;
+        Histogram DictionaryMetrics::*histogram;
+    } dict_histograms[] = {
+        { "simplifyd_dictionary_search_seconds",
+          "Time spent searching a dictionary.",
+          &DictionaryMetrics::search },
+        { "simplifyd_dictionary_heading_seconds",
+          "Time spent seeking to a search result and reading its heading.",
+          &DictionaryMetrics::heading },
+        { "simplifyd_dictionary_script_seconds",
+          "Time spent in heading and tag scripts.",
+          &DictionaryMetrics::script },
+        { "simplifyd_dictionary_article_seconds",
+          "Time spent reading and formatting an article.",
+          &DictionaryMetrics::article },
+    };
+
+    AppendHeader(out, "simplifyd_in_flight_requests", "gauge",
+                 "Number of requests currently being processed.");
+    out.append("simplifyd_in_flight_requests ");
+    {
+        int64_t in_flight = in_flight_.Value();
+        AppendUInt(out, in_flight > 0 ? in_flight : 0);
+    }
+    out.append(1, '\n');
+
+    AppendHeader(out, "simplifyd_request_duration_seconds", "histogram",
+                 "Request latency by route.");
+    for (const Route &route : routes_) {
+        std::string labels = "route=\"";
+        AppendLabelValue(labels, route.name);
+        labels.append(1, '"');
+        AppendHistogram(out, "simplifyd_request_duration_seconds", labels,
+                        route.metrics->latency);
+    }
+
+    for (const auto &h : dict_histograms) {
+        AppendHeader(out, h.name, "histogram", h.help);
+        for (const Dictionary &dict : dicts_) {
+            std::string labels = "dictionary=\"";
+            AppendLabelValue(labels, dict.name);
+            labels.append(1, '"');
+            AppendHistogram(out, h.name, labels,
+                            (*dict.metrics).*h.histogram);
+        }
+    }
+
+    AppendHeader(out, "simplifyd_dictionary_hits_total", "counter",
+                 "Number of search results returned to clients.");
+    for (const Dictionary &dict : dicts_) {
+        out.append("simplifyd_dictionary_hits_total{dictionary=\"");
+        AppendLabelValue(out, dict.name);
+        out.append("\"} ");
+        AppendUInt(out, dict.metrics->hits.Value());
+        out.append(1, '\n');
+    }
+
+    AppendHeader(out, "simplifyd_errors_total", "counter",
+                 "Number of errors by category and code.");
+    for (size_t i = 0; i < kSimplifyErrorCount; ++i) {
+        uint64_t n = simplify_errors_[i].load(std::memory_order_relaxed);
+        if (n == 0)
+            continue;
+        out.append("simplifyd_errors_total{category=\"simplify\",code=\"");
+        AppendUInt(out, i);
+        out.append("\"} ");
+        AppendUInt(out, n);
+        out.append(1, '\n');
+    }
+    for (int i = 0; i < EB_NUMBER_OF_ERRORS; ++i) {
+        uint64_t n = eb_errors_[i].load(std::memory_order_relaxed);
+        if (n == 0)
+            continue;
+        out.append("simplifyd_errors_total{category=\"eb\",code=\"")
+           .append(eb_error_string(i))
+           .append("\"} ");
+        AppendUInt(out, n);
+        out.append(1, '\n');
+    }
+    {
+        uint64_t n = other_errors_.load(std::memory_order_relaxed);
+        if (n > 0) {
+            out.append("simplifyd_errors_total{category=\"other\",code=\"\"} ");
+            AppendUInt(out, n);
+            out.append(1, '\n');
+        }
+    }
+
+    std::vector<uint64_t> hits(caches_.size());
+    std::vector<uint64_t> misses(caches_.size());
+    for (size_t i = 0; i < caches_.size(); ++i)
+        caches_[i].probe(&hits[i], &misses[i]);
+
+    AppendHeader(out, "simplifyd_cache_hits_total", "counter",
+                 "Number of cache lookups that found the requested item.");
+    for (size_t i = 0; i < caches_.size(); ++i) {
+        out.append("simplifyd_cache_hits_total{cache=\"");
+        AppendLabelValue(out, caches_[i].name);
+        out.append("\"} ");
+        AppendUInt(out, hits[i]);
+        out.append(1, '\n');
+    }
+
+    AppendHeader(out, "simplifyd_cache_misses_total", "counter",
+                 "Number of cache lookups that missed.");
+    for (size_t i = 0; i < caches_.size(); ++i) {
+        out.append("simplifyd_cache_misses_total{cache=\"");
+        AppendLabelValue(out, caches_[i].name);
+        out.append("\"} ");
+        AppendUInt(out, misses[i]);
+        out.append(1, '\n');
+    }
+}
+
+}  // namespace simplifyd
@@ -0,0 +1,268 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#ifndef SIMPLIFYD_METRICS_HH_
+#define SIMPLIFYD_METRICS_HH_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+namespace simplify { class Dictionary; }
+namespace simplifyd {
+
+namespace metrics_internal {
+
+/**
+ * Number of per-thread slots each metric is split into. Every server
+ * thread gets its own slot, so updates on the hot path never contend
+ * for a cache line.
+ */
+const size_t kShardCount = 16;
+
+/**
+ * Returns the slot index of the calling thread.
+ */
+size_t ShardIndex();
+
+}  // namespace metrics_internal
+
+/**
+ * Monotonically increasing counter.
+ */
+class Counter {
+public:
+    void Increment(uint64_t n = 1)
+    {
+        shards_[metrics_internal::ShardIndex()].value.fetch_add(
+            n, std::memory_order_relaxed);
+    }
+
+    uint64_t Value() const;
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> value{0};
+    };
+
+    Shard shards_[metrics_internal::kShardCount];
+};
+
+/**
+ * A value that can go up and down, e.g. the number of requests that are
+ * currently being processed.
+ */
+class Gauge {
+public:
+    void Add(int64_t n)
+    {
+        shards_[metrics_internal::ShardIndex()].value.fetch_add(
+            n, std::memory_order_relaxed);
+    }
+
+    int64_t Value() const;
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<int64_t> value{0};
+    };
+
+    Shard shards_[metrics_internal::kShardCount];
+};
+
+/**
+ * Latency histogram with log-linear buckets (two buckets per power of
+ * two) covering the range from 1 microsecond to about 3 minutes. The
+ * relative error of any bucket boundary is below 50%, which is plenty
+ * for latency percentiles.
+ */
+class Histogram {
+public:
+    static const size_t kBucketCount = 56;
+
+    void Observe(std::chrono::steady_clock::duration elapsed);
+
+    /**
+     * Returns the upper bound of the bucket with the given index in
+     * microseconds.
+     */
+    static uint64_t BucketUpperBound(size_t index);
+
+    /**
+     * Adds up per-thread buckets. The @buckets array must hold at least
+     * @kBucketCount items.
+     */
+    void Collect(uint64_t *buckets, uint64_t *count, uint64_t *sum_us) const;
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> buckets[kBucketCount] = {};
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> sum_us{0};
+    };
+
+    Shard shards_[metrics_internal::kShardCount];
+};
+
+/**
+ * Observes time elapsed between construction and destruction of the
+ * object in the given histogram. Null histograms are allowed and are
+ * ignored.
+ */
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Histogram *histogram)
+      : histogram_(histogram),
+        start_(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~ScopedTimer()
+    {
+        if (histogram_ != nullptr)
+            histogram_->Observe(std::chrono::steady_clock::now() - start_);
+    }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+    Histogram *histogram_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+/**
+ * Adds one to a gauge for the lifetime of the object.
+ */
+class ScopedGauge {
+public:
+    explicit ScopedGauge(Gauge *gauge)
+      : gauge_(gauge)
+    {
+        gauge_->Add(1);
+    }
+
+    ~ScopedGauge()
+    {
+        gauge_->Add(-1);
+    }
+
+    ScopedGauge(const ScopedGauge &) = delete;
+    ScopedGauge &operator=(const ScopedGauge &) = delete;
+
+private:
+    Gauge *gauge_;
+};
+
+struct RouteMetrics {
+    Histogram latency;
+};
+
+struct DictionaryMetrics {
+    /// Time spent in Dictionary::Search().
+    Histogram search;
+    /// Time spent seeking to a search result and reading its heading.
+    Histogram heading;
+    /// Time spent in heading and tag scripts.
+    Histogram script;
+    /// Time spent in Dictionary::ReadText().
+    Histogram article;
+    /// Number of search results returned to clients.
+    Counter hits;
+};
+
+/**
+ * Process-wide metric registry.
+ *
+ * Routes, dictionaries and cache probes must be registered before the
+ * server starts accepting requests; after that the registry is only read
+ * so no locking is required to look metrics up.
+ */
+class Metrics {
+public:
+    /**
+     * Returns hit and miss counters of a cache.
+     */
+    typedef std::function<void(uint64_t *hits, uint64_t *misses)>
+        CacheProbe;
+
+    static Metrics &Instance();
+
+    RouteMetrics *AddRoute(const char *route);
+    void AddDictionary(const simplify::Dictionary *dict);
+    void AddCacheProbe(const char *name, CacheProbe probe);
+
+    /**
+     * Returns metrics of the given dictionary, or null if the dictionary
+     * has not been registered.
+     */
+    DictionaryMetrics *GetDictionaryMetrics(const simplify::Dictionary *dict);
+
+    /**
+     * Counts an error by its category and value.
+     */
+    void CountError(const std::error_code &error);
+
+    Gauge &GetInFlightRequests();
+
+    /**
+     * Appends all metrics to @out in the Prometheus text exposition
+     * format.
+     */
+    void Render(std::string &out) const;
+
+private:
+    Metrics();
+
+    struct Route {
+        std::string name;
+        std::unique_ptr<RouteMetrics> metrics;
+    };
+
+    struct Dictionary {
+        std::string name;
+        std::unique_ptr<DictionaryMetrics> metrics;
+    };
+
+    struct Cache {
+        std::string name;
+        CacheProbe probe;
+    };
+
+    std::vector<Route> routes_;
+    std::vector<Dictionary> dicts_;
+    std::unordered_map<const simplify::Dictionary *, DictionaryMetrics *>
+        dict_index_;
+    std::vector<Cache> caches_;
+    Gauge in_flight_;
+    std::unique_ptr<std::atomic<uint64_t>[]> simplify_errors_;
+    std::unique_ptr<std::atomic<uint64_t>[]> eb_errors_;
+    std::atomic<uint64_t> other_errors_;
+};
+
+}  // namespace simplifyd
+
+#endif  // SIMPLIFYD_METRICS_HH_
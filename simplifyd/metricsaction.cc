@@ -0,0 +1,37 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#include "httpresponse.hh"
+#include "metrics.hh"
+#include "metricsaction.hh"
+
+namespace simplifyd {
+
+void MetricsAction::Handle(simplify::Repository &repository,
+                           HttpQuery &query,
+                           HttpResponse &response)
+{
+    response.AddHeader("Content-Type", "text/plain; version=0.0.4");
+    response.AddHeader("Cache-Control", "no-cache");
+
+    Metrics::Instance().Render(response.GetBody());
+}
+
+}  // namespace simplifyd
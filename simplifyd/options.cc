@@ -32,6 +32,13 @@ namespace simplifyd
 Options::Options()
     : port_(8000),
       html_dir_(SIMPLIFY_WWWROOT),
+      cache_size_(8),
+      preload_index_(false),
+      map_files_(false),
+      prefetch_slices_(0),
+      article_cache_size_(16),
+      prefetch_references_(4),
+      prefetch_results_(0),
       daemonize_(false)
 {
     std::filesystem::path config_dir_path;
@@ -93,6 +100,46 @@ void Options::SetHtmlDir(const char *path)
     html_dir_ = path;
 }
 
+void Options::SetTraceDir(const char *path)
+{
+    trace_dir_ = path;
+}
+
+void Options::SetCacheSize(size_t megabytes)
+{
+    cache_size_ = megabytes;
+}
+
+void Options::SetPreloadIndex(bool preload)
+{
+    preload_index_ = preload;
+}
+
+void Options::SetMapFiles(bool map)
+{
+    map_files_ = map;
+}
+
+void Options::SetPrefetchSlices(int slices)
+{
+    prefetch_slices_ = slices;
+}
+
+void Options::SetArticleCacheSize(size_t megabytes)
+{
+    article_cache_size_ = megabytes;
+}
+
+void Options::SetPrefetchReferences(int references)
+{
+    prefetch_references_ = references;
+}
+
+void Options::SetPrefetchResults(int results)
+{
+    prefetch_results_ = results;
+}
+
 void Options::SetDaemonize(bool daemonize)
 {
     daemonize_ = daemonize;
@@ -123,4 +170,44 @@ bool Options::GetDaemonize() const
     return daemonize_;
 }
 
+const char *Options::GetTraceDir() const
+{
+    return trace_dir_.c_str();
+}
+
+size_t Options::GetCacheSize() const
+{
+    return cache_size_;
+}
+
+bool Options::GetPreloadIndex() const
+{
+    return preload_index_;
+}
+
+bool Options::GetMapFiles() const
+{
+    return map_files_;
+}
+
+int Options::GetPrefetchSlices() const
+{
+    return prefetch_slices_;
+}
+
+size_t Options::GetArticleCacheSize() const
+{
+    return article_cache_size_;
+}
+
+int Options::GetPrefetchReferences() const
+{
+    return prefetch_references_;
+}
+
+int Options::GetPrefetchResults() const
+{
+    return prefetch_results_;
+}
+
 }  // namespace simplifyd
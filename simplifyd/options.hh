@@ -21,6 +21,7 @@
 #ifndef SIMPLIFYD_OPTIONS_HH_
 #define SIMPLIFYD_OPTIONS_HH_
 
+#include <cstddef>
 #include <string>
 
 namespace simplifyd {
@@ -35,18 +36,42 @@ public:
     void SetRepositoryConfigPath(const char *path);
     void SetDaemonize(bool daemonize);
     void SetHtmlDir(const char *path);
+    void SetTraceDir(const char *path);
+    void SetCacheSize(size_t megabytes);
+    void SetPreloadIndex(bool preload);
+    void SetMapFiles(bool map);
+    void SetPrefetchSlices(int slices);
+    void SetArticleCacheSize(size_t megabytes);
+    void SetPrefetchReferences(int references);
+    void SetPrefetchResults(int results);
 
     int GetPort() const;
     const char *GetConfigDir() const;
     const char *GetHtmlDir() const;
     const char *GetRepositoryConfigPath() const;
     bool GetDaemonize() const;
+    const char *GetTraceDir() const;
+    size_t GetCacheSize() const;
+    bool GetPreloadIndex() const;
+    bool GetMapFiles() const;
+    int GetPrefetchSlices() const;
+    size_t GetArticleCacheSize() const;
+    int GetPrefetchReferences() const;
+    int GetPrefetchResults() const;
 
 private:
     int port_;
     std::string config_dir_;
     std::string repository_config_;
     std::string html_dir_;
+    std::string trace_dir_;
+    size_t cache_size_;
+    bool preload_index_;
+    bool map_files_;
+    int prefetch_slices_;
+    size_t article_cache_size_;
+    int prefetch_references_;
+    int prefetch_results_;
     bool daemonize_;
 };
 
@@ -19,92 +19,133 @@
 */
 
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <mutex>
 #include <system_error>
 
 #include <simplify/dictionary.hh>
 #include <simplify/repository.hh>
-#include <simplify/utils.hh>
+#include <simplify/trace.hh>
 
 #include "httpresponse.hh"
+#include "jsonwriter.hh"
+#include "metrics.hh"
 #include "server.hh"
 #include "searchaction.hh"
 
 namespace simplifyd {
 
+// Longer session tokens are ignored.
+static const size_t kMaxSessionTokenLength = 64;
+
+// Results are sent to the client whenever this much of them is pending,
+// so a search never holds more than about that much of its response.
+static const size_t kFlushThreshold = 32 * 1024;
+
+SearchAction::SearchAction(SearchSessions *sessions,
+                           ArticlePrefetcher *prefetcher,
+                           size_t prefetch_count)
+  : sessions_(sessions),
+    prefetcher_(prefetcher),
+    prefetch_count_(prefetcher != nullptr ? prefetch_count : 0)
+{
+}
+
 void SearchAction::Handle(simplify::Repository &repository,
                           HttpQuery &query,
                           HttpResponse &response)
 {
-    std::string &body = response.GetBody();
+    JsonWriter json(response.GetBody());
     const char *dict_id = query.GetParamValue("id");
     const char *expr = query.GetParamValue("q");
+    const char *token = query.GetParamValue("session");
 
     response.AddHeader("Content-Type", "application/json; charset=utf-8");
     response.AddHeader("Cache-Control", "no-cache");
 
     if (expr == NULL) {
-        body.append("{\"error\":\"Empty search expression\"}");
+        json.Error("Empty search expression");
         return;
     }
 
-    body.append("{");
+    TopResults top_results;
+
+    // Searches of a session are serialized, they share its state.
+    std::shared_ptr<SearchSessions::Session> session;
+    std::unique_lock<std::mutex> session_lock;
+    if (sessions_ != nullptr && token != nullptr
+        && strlen(token) <= kMaxSessionTokenLength) {
+        session = sessions_->Get(token);
+        session_lock = std::unique_lock<std::mutex>(session->GetMutex());
+    }
 
     // Decide which method of search to use.
     // If the dictionary ID is specified we search only the dictionary with
     //  the given ID.
     // If the dictionary ID is missing we search all dictionaries.
     if (dict_id != NULL) {
-        auto dict = repository.GetDictionary(strtol(dict_id, NULL, 10));
+        size_t dict_index = strtol(dict_id, NULL, 10);
+        auto dict = repository.GetDictionary(dict_index);
 
         if (dict != NULL) {
-            body.append("\"").append(dict->GetName()).append("\":");
-            SearchDict(repository, *dict, expr, response);
+            json.BeginObject().Key(dict->GetName());
+            SearchDict(dict, dict_index, expr, session.get(), response, json,
+                       top_results);
+            json.EndObject();
         } else {
-            body.append("{\"error\":\"Invalid dictionary id:\"}");
+            json.Error("Invalid dictionary id");
             return;
         }
     } else {
-        SearchAll(repository, expr, response);
+        json.BeginObject();
+        SearchAll(repository, expr, session.get(), response, json,
+                  top_results);
+        json.EndObject();
     }
 
-    body.append("}");
+    // The user is about to open one of the first results, render them
+    // while the results are being displayed.
+    if (!top_results.empty())
+        prefetcher_->ScheduleSearchResults(std::move(top_results));
 }
 
-void SearchAction::SearchDict(simplify::Repository &repository,
-                              simplify::Dictionary &dict,
+bool SearchAction::SearchDict(std::shared_ptr<simplify::Dictionary> dict_ptr,
+                              size_t dict_index,
                               const char *expr,
-                              HttpResponse &response)
+                              SearchSessions::Session *session,
+                              HttpResponse &response,
+                              JsonWriter &json,
+                              TopResults &top_results)
 {
+    simplify::Dictionary &dict = *dict_ptr;
+
     // TODO: Make the limit tweakable.
     size_t result_limit = 800;
 
-    simplify::Likely<simplify::Dictionary::SearchResults *> likely_results =
-        dict.Search(expr, result_limit);
-    std::string &body = response.GetBody();
+    simplify::TraceSpan span("SearchAction::SearchDict", "simplifyd",
+                             dict.GetName());
 
-    if (!likely_results) {
-        body.append("{\"error\":\"") \
-            .append(likely_results.error_code().message()) \
-            .append("\"}");
-        return;
-    }
-
-    // Format the 'limit' JSON entry which contains the maximum number of
-    // search results and open the 'results' array.
+    Metrics &metrics = Metrics::Instance();
+    DictionaryMetrics *dict_metrics = metrics.GetDictionaryMetrics(&dict);
+    simplify::Likely<simplify::Dictionary::SearchResults *> likely_results;
     {
-        char tmp[64];
-        size_t length = simplify::UIntToAlpha10(result_limit, tmp);
-
-        // Add the 'limit' integer.
-        body.append("{\"limit\":")
-            .append(tmp, length)
-            .append(1, ',');
+        ScopedTimer timer(dict_metrics ? &dict_metrics->search : nullptr);
+        likely_results = dict.Search(
+            expr, result_limit,
+            session ? session->ForDictionary(dict_index, dict) : nullptr);
+    }
 
-        // Open the 'results' array.
-        body.append("\"results\":[");
+    if (!likely_results) {
+        metrics.CountError(likely_results.error_code());
+        json.Error(likely_results.error_code().message());
+        return true;
     }
 
+    json.BeginObject()
+        .Key("limit").UInt(result_limit)
+        .Key("results").BeginArray();
+
     simplify::Dictionary::SearchResults *results = likely_results;
 
     // 4K is ought to be enough for a search result name or GUID.
@@ -112,37 +153,42 @@ void SearchAction::SearchDict(simplify::Repository &repository,
     char text_buffer[4 * 1024];
     size_t accepted_results_count = 0;
     std::error_code seek_error;
+    bool client_alive = true;
+
+    while (true) {
+        {
+            ScopedTimer timer(dict_metrics ? &dict_metrics->heading : nullptr);
+            seek_error = results->SeekNext();
+        }
+        if (seek_error)
+            break;
 
-    while (!(seek_error = results->SeekNext())) {
-        // Integer containing an offset in the body where the current
-        // result starts. We use the value of this variable to erase
-        // result's text in case anything goes wrong to avoid producing
-        // malformed JSON.
-        size_t result_start = body.length();
-        size_t length = 0;
+        // Time spent in this span, but not in any of its children, is the
+        // time spent formatting the result.
+        simplify::TraceSpan result_span("SearchAction::FormatResult",
+                                        "simplifyd");
 
+        // Everything about the result is fetched before it's written, so
+        // that a result which fails half way leaves nothing behind.
         simplify::Likely<size_t> likely_length =
             results->FetchGuid(text_buffer, sizeof(text_buffer));
 
-        if (likely_length) {
-            body.append("[\"")
-                .append(text_buffer, likely_length)
-                .append("\",");
-        } else {
+        if (!likely_length) {
+            metrics.CountError(likely_length.error_code());
             std::cout << "An error occurred while retrieving article GUID "
                       << "from " << dict.GetName() << ": "
                       << likely_length.error_code().message() << std::endl;
-            body.erase(result_start);
             continue;
         }
 
-        auto maybe_heading = results->FetchHeading(&length);
-        if (maybe_heading) {
-            body.append("\"")
-                .append(maybe_heading.value_checked().get(), length)
-                .append("\",");
-        } else {
+        ScopedTimer script_timer(
+            dict_metrics ? &dict_metrics->script : nullptr);
+
+        size_t heading_length = 0;
+        auto maybe_heading = results->FetchHeading(&heading_length);
+        if (!maybe_heading) {
             std::error_code &e = maybe_heading.error_code();
+            metrics.CountError(e);
 
             // Do not log things if the dictionary returned an unexpected
             // result type error. Actually, this is quite legitimate
@@ -157,57 +203,70 @@ void SearchAction::SearchDict(simplify::Repository &repository,
                           << maybe_heading.error_code().message()
                           << std::endl;
             }
-
-            body.erase(result_start);
             continue;
         }
 
-        auto maybe_tags = results->FetchTags(&length);
-        if (maybe_tags) {
-            // Only append tags if the string is not empty.
-            if (length > 0) {
-                body.append("\"")
-                    .append(maybe_tags.value_checked().get(), length)
-                    .append("\",");
-            }
-        } else {
+        size_t tags_length = 0;
+        auto maybe_tags = results->FetchTags(&tags_length);
+        if (!maybe_tags) {
+            metrics.CountError(maybe_tags.error_code());
             std::cout << "An error occurred while retrieving tags for a "
                       << "search entry with GUID " << text_buffer
                       << " from " << dict.GetName() << ": "
                       << maybe_tags.error_code().message() << std::endl;
-            body.erase(result_start);
+            continue;
         }
 
-        // Erase last comma.
-        body.erase(body.size() - 1);
-        body.append("],");
+        json.BeginArray()
+            .String(text_buffer, likely_length)
+            .String(maybe_heading.value_checked().get(), heading_length);
+        // Only append tags if the string is not empty.
+        if (tags_length > 0)
+            json.String(maybe_tags.value_checked().get(), tags_length);
+        json.EndArray();
 
         ++accepted_results_count;
+        if (top_results.size() < prefetch_count_) {
+            top_results.push_back(ArticlePrefetcher::Job{
+                dict_ptr, dict_index, std::string(text_buffer, likely_length)});
+        }
+
+        if (response.GetBody().size() >= kFlushThreshold
+            && !(client_alive = response.Flush())) {
+            break;
+        }
     }
 
     delete results;
 
-    // Erase last comma if we have at least one result. There will be no
-    // comma if there are no results.
-    if (accepted_results_count > 0)
-        body.erase(body.size() - 1);
+    if (client_alive && seek_error != simplify::simplify_error::no_more_results)
+        metrics.CountError(seek_error);
+    if (dict_metrics != nullptr)
+        dict_metrics->hits.Increment(accepted_results_count);
 
-    body.append("]}");
+    json.EndArray().EndObject();
+    return client_alive;
 }
 
 void SearchAction::SearchAll(simplify::Repository &repository,
                              const char *expr,
-                             HttpResponse &response)
+                             SearchSessions::Session *session,
+                             HttpResponse &response,
+                             JsonWriter &json,
+                             TopResults &top_results)
 {
-    std::string &body = response.GetBody();
+    size_t dict_index = 0;
 
+    // Every dictionary's results are sent as soon as they're ready, so the
+    // client doesn't wait for the slowest dictionary to show the others.
     for (auto it = repository.Begin(); it != repository.End(); ++it) {
-        body.append("\"").append((*it)->GetName()).append("\":");
-        SearchDict(repository, **it, expr, response);
-        body.append(",");
+        json.Key((*it)->GetName());
+        if (!SearchDict(*it, dict_index++, expr, session, response, json,
+                        top_results)
+            || !response.Flush()) {
+            break;
+        }
     }
-
-    body.erase(body.size() - 1);
 }
 
 }  // namespace simplifyd
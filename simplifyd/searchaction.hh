@@ -21,22 +21,54 @@
 #ifndef SIMPLIFYD_SEARCHACTION_HH_
 #define SIMPLIFYD_SEARCHACTION_HH_
 
+#include <cstddef>
+#include <memory>
+#include <vector>
+
 #include "action.hh"
+#include "articleprefetcher.hh"
+#include "searchsessions.hh"
 
 namespace simplifyd {
 
+class JsonWriter;
+
 class SearchAction : public Action
 {
 public:
+    /**
+     * Searches carrying a `session` token are done within the session of
+     * @sessions with that token, unless @sessions is null. Articles of the
+     * first @prefetch_count results of every search are handed to
+     * @prefetcher, unless it's null.
+     */
+    SearchAction(SearchSessions *sessions = nullptr,
+                 ArticlePrefetcher *prefetcher = nullptr,
+                 size_t prefetch_count = 0);
+
     void Handle(simplify::Repository &, HttpQuery &, HttpResponse &);
 
 private:
-    void SearchDict(simplify::Repository &,
-                    simplify::Dictionary &,
+    typedef std::vector<ArticlePrefetcher::Job> TopResults;
+
+    bool SearchDict(std::shared_ptr<simplify::Dictionary>,
+                    size_t,
                     const char *,
-                    HttpResponse &);
+                    SearchSessions::Session *,
+                    HttpResponse &,
+                    JsonWriter &,
+                    TopResults &);
+
+    void SearchAll(simplify::Repository &,
+                   const char *,
+                   SearchSessions::Session *,
+                   HttpResponse &,
+                   JsonWriter &,
+                   TopResults &);
 
-    void SearchAll(simplify::Repository &, const char *, HttpResponse &);
+    SearchSessions *sessions_;
+    ArticlePrefetcher *prefetcher_;
+    size_t prefetch_count_;
 };
 
 }  // namespace simplifyd
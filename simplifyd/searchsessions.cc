@@ -0,0 +1,78 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#include <utility>
+
+#include "searchsessions.hh"
+
+namespace simplifyd {
+
+simplify::Dictionary::SearchSession *
+SearchSessions::Session::ForDictionary(size_t dict_index,
+                                       simplify::Dictionary &dict)
+{
+    if (dict_index >= dict_sessions_.size()) {
+        dict_sessions_.resize(dict_index + 1);
+        made_.resize(dict_index + 1, false);
+    }
+    if (!made_[dict_index]) {
+        dict_sessions_[dict_index] = dict.NewSearchSession();
+        made_[dict_index] = true;
+    }
+
+    return dict_sessions_[dict_index].get();
+}
+
+std::mutex &SearchSessions::Session::GetMutex()
+{
+    return mutex_;
+}
+
+SearchSessions::SearchSessions(size_t capacity)
+  : capacity_(capacity)
+{
+}
+
+std::shared_ptr<SearchSessions::Session>
+SearchSessions::Get(const char *token)
+{
+    std::string key(token);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+
+    if (it != entries_.end()) {
+        lru_.splice(lru_.begin(), lru_, it->second.lru_position);
+        return it->second.session;
+    }
+
+    // A session in use by a request lives on until the request is done.
+    auto session = std::make_shared<Session>();
+    lru_.push_front(key);
+    entries_.emplace(std::move(key), Entry{session, lru_.begin()});
+
+    while (entries_.size() > capacity_) {
+        entries_.erase(lru_.back());
+        lru_.pop_back();
+    }
+
+    return session;
+}
+
+}  // namespace simplifyd
@@ -0,0 +1,89 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#ifndef SIMPLIFYD_SEARCHSESSIONS_HH_
+#define SIMPLIFYD_SEARCHSESSIONS_HH_
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <simplify/dictionary.hh>
+
+namespace simplifyd {
+
+/**
+ * Search sessions of clients keyed by a token the client chooses. The
+ * least recently used sessions are dropped once there are more than
+ * @capacity of them.
+ */
+class SearchSessions
+{
+public:
+    class Session
+    {
+    public:
+        /**
+         * Returns the session of the dictionary, which is made on first
+         * use, or null if the dictionary doesn't use sessions. The mutex
+         * of the session must be held.
+         */
+        simplify::Dictionary::SearchSession *
+            ForDictionary(size_t dict_index, simplify::Dictionary &dict);
+
+        std::mutex &GetMutex();
+
+    private:
+        std::mutex mutex_;
+        std::vector<std::unique_ptr<simplify::Dictionary::SearchSession>>
+            dict_sessions_;
+        std::vector<bool> made_;
+    };
+
+    explicit SearchSessions(size_t capacity);
+
+    /**
+     * Returns the session with the given token, which is made if there's
+     * no such session.
+     */
+    std::shared_ptr<Session> Get(const char *token);
+
+private:
+    typedef std::list<std::string> LruList;
+
+    struct Entry {
+        std::shared_ptr<Session> session;
+        LruList::iterator lru_position;
+    };
+
+    std::mutex mutex_;
+    size_t capacity_;
+    std::unordered_map<std::string, Entry> entries_;
+    // Keys of entries_, the most recently used first.
+    LruList lru_;
+};
+
+}  // namespace simplifyd
+
+#endif  // SIMPLIFYD_SEARCHSESSIONS_HH_
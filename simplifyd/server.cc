@@ -21,16 +21,23 @@
 #include <string.h>
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cstdlib>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <memory>
 #include <utility>
 
 #include <simplify/repository.hh>
+#include <simplify/trace.hh>
 
 #include "action.hh"
 #include "httpquery.hh"
 #include "httpresponse.hh"
+#include "metrics.hh"
 #include "options.hh"
 #include "server.hh"
 
@@ -39,6 +46,9 @@ namespace simplifyd {
 
 static Server *g_server_instance = NULL;
 
+// Size of the parts in which streamed response bodies are written.
+static const size_t kBodyBufferSize = 64 * 1024;
+
 Server::Server(std::shared_ptr<simplify::Repository> repository) :
     srv_(NULL),
     repository_(repository),
@@ -49,7 +59,7 @@ Server::Server(std::shared_ptr<simplify::Repository> repository) :
 Server::~Server()
 {
     std::for_each(routes_.begin(), routes_.end(), [](RouteMap::value_type &v) {
-        delete v.second;
+        delete v.second.action;
     });
 }
 
@@ -57,7 +67,8 @@ void Server::AddRoute(const char *name, Action *action)
 {
     auto it = routes_.find(name);
     if (it == routes_.end()) {
-        routes_.insert(std::make_pair(name, action));
+        Route route = { action, Metrics::Instance().AddRoute(name) };
+        routes_.insert(std::make_pair(name, route));
     } else {
         // TODO: Warn that route with the given name already exists.
     }
@@ -67,7 +78,7 @@ void Server::DeleteRoute(const char *name)
 {
     auto it = routes_.find(name);
     if (it != routes_.end()) {
-        delete (*it).second;
+        delete (*it).second.action;
         routes_.erase(it);
     }
 }
@@ -87,6 +98,8 @@ bool Server::Start(const Options &options)
         NULL
     };
 
+    trace_dir_ = options.GetTraceDir();
+
     // Start receiving requests.
     g_server_instance = this;
     srv_ = mg_start(&Server::Trampoline, mg_options);
@@ -112,17 +125,100 @@ bool Server::Dispatch(mg_event event, mg_connection *conn,
     // that's associated with the route handle the event.
     auto it = routes_.find(req->uri);
     if (it != routes_.end()) {
+        ScopedTimer timer(&(*it).second.metrics->latency);
         HttpQuery query(*req);
         HttpResponse response;
 
-        (*it).second->Handle(*repository_, query, response);
-
-        std::string text = response.ProduceResponse();
-        mg_write(conn, text.data(), text.size());
+        // Traces are only saved if the operator has chosen where. Requests
+        // are traced unless their action opts out, which the client may
+        // override.
+        // The path of the trace is known in advance, so that it's among
+        // the headers even if the action sends them early.
+        std::unique_ptr<simplify::Trace> trace;
+        std::string trace_path;
+        if (!trace_dir_.empty()
+            && ((*it).second.action->IsTraced()
+                || query.GetHeaderValue("X-Simplify-Trace") != nullptr)) {
+            trace_path = MakeTracePath(req->uri);
+            trace.reset(new simplify::Trace());
+            response.AddHeader("X-Simplify-Trace-File", trace_path.c_str());
+        }
+
+        // Actions may send the response in parts to HTTP/1.1 clients.
+        if (strcmp(req->http_version, "1.1") == 0) {
+            response.EnableChunkedWrites(
+                [conn](const char *data, size_t length) {
+                    return mg_write(conn, data, length)
+                        == static_cast<int>(length);
+                });
+        }
+
+        ScopedGauge in_flight(&Metrics::Instance().GetInFlightRequests());
+        {
+            simplify::Trace::Scope trace_scope(trace.get());
+            simplify::TraceSpan span("Action::Handle", "simplifyd", req->uri);
+            (*it).second.action->Handle(*repository_, query, response);
+        }
+
+        if (trace)
+            SaveTrace(*trace, trace_path);
+
+        if (response.IsStreaming()) {
+            // The action has sent the headers and a part of the body.
+            response.FinishChunks();
+        } else {
+            std::string text = response.ProduceResponse();
+            mg_write(conn, text.data(), text.size());
+
+            // Stream the body if the action didn't produce it in advance.
+            // If reading fails midway the client gets a short body, which
+            // it can tell by Content-Length.
+            if (response.GetBodyReader()) {
+                std::unique_ptr<char[]> buffer(new char[kBodyBufferSize]);
+                ssize_t length;
+
+                while ((length = response.GetBodyReader()(
+                            buffer.get(), kBodyBufferSize)) > 0) {
+                    if (mg_write(conn, buffer.get(), length) != length)
+                        break;
+                }
+            }
+        }
         return true;
     } else {
         return false;
     }
 }
 
+std::string Server::MakeTracePath(const char *uri)
+{
+    // A trace is too big for a header, only its path is returned.
+    std::filesystem::path path(trace_dir_);
+
+    static std::atomic<unsigned> sequence{0};
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    char filename[128];
+
+    // Route names start with a slash, skip it.
+    snprintf(filename, sizeof(filename), "%lld-%u-%s.json",
+             static_cast<long long>(
+                 std::chrono::duration_cast<std::chrono::milliseconds>(
+                     now).count()),
+             sequence.fetch_add(1, std::memory_order_relaxed),
+             uri[0] == '/' ? uri + 1 : uri);
+
+    path.append(filename);
+    return path.string();
+}
+
+void Server::SaveTrace(const simplify::Trace &trace, const std::string &path)
+{
+    std::string json;
+    trace.WriteJson(json);
+
+    std::ofstream stream(path);
+    if (!stream || !stream.write(json.data(), json.size()))
+        std::cerr << "Failed to save trace to " << path << std::endl;
+}
+
 }  // namespace simplifyd
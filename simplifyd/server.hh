@@ -23,6 +23,7 @@
 
 #include <cstring>
 #include <memory>
+#include <string>
 #include <system_error>
 #include <unordered_map>
 
@@ -32,8 +33,10 @@
 
 struct mg_context;
 namespace simplify { class Repository; }
+namespace simplify { class Trace; }
 namespace simplifyd { class Action; }
 namespace simplifyd { class Options; }
+namespace simplifyd { struct RouteMetrics; }
 namespace simplifyd {
 
 struct QueryParam {
@@ -53,14 +56,22 @@ public:
 private:
     static void *Trampoline(mg_event, mg_connection *, mg_request_info *);
     bool Dispatch(mg_event, mg_connection *, mg_request_info *);
+    std::string MakeTracePath(const char *);
+    void SaveTrace(const simplify::Trace &, const std::string &);
 
 private:
-    typedef std::unordered_map<const char *, Action *, CharHashFun, CharEqFun>
+    struct Route {
+        Action *action;
+        RouteMetrics *metrics;
+    };
+
+    typedef std::unordered_map<const char *, Route, CharHashFun, CharEqFun>
         RouteMap;
 
     mg_context *srv_;
     std::shared_ptr<simplify::Repository> repository_;
     RouteMap routes_;
+    std::string trace_dir_;
 };
 
 }  // namespace simplifyd
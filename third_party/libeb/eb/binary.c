@@ -675,6 +675,7 @@ end_position={%d,%d})",
 	    context->size -= 32;
 	else
 	    context->size = 0;
+	context->location += 32;
     } else {
 	if (zio_lseek(context->zio,
 	    ((off_t) book->subbook_current->sound.start_page - 1)
@@ -1386,6 +1387,130 @@ eb_read_binary_gray_graphic(EB_Book *book, size_t binary_max_length,
 }
 
 
+/*
+ * Length of the WAVE header composed by eb_set_binary_wave().
+ */
+#define EB_WAVE_HEADER_LENGTH	44
+
+/*
+ * Get the number of bytes eb_read_binary() returns for the current
+ * binary data.  `*size' is set to 0 if it isn't known in advance.
+ * Only sound and color graphics have a known size.
+ */
+EB_Error_Code
+eb_binary_size(EB_Book *book, size_t *size)
+{
+    EB_Error_Code error_code;
+    EB_Binary_Context *context;
+
+    eb_lock(&book->lock);
+    LOG(("in: eb_binary_size(book=%d)", (int)book->code));
+
+    context = &book->binary_context;
+    switch (context->code) {
+    case EB_BINARY_WAVE:
+	*size = context->size + EB_WAVE_HEADER_LENGTH;
+	break;
+    case EB_BINARY_COLOR_GRAPHIC:
+    case EB_BINARY_MPEG:
+	*size = context->size;
+	break;
+    case EB_BINARY_MONO_GRAPHIC:
+    case EB_BINARY_GRAY_GRAPHIC:
+	*size = 0;
+	break;
+    default:
+	error_code = EB_ERR_NO_CUR_BINARY;
+	goto failed;
+    }
+
+    LOG(("out: eb_binary_size(size=%ld) = %s", (long)*size,
+	eb_error_string(EB_SUCCESS)));
+    eb_unlock(&book->lock);
+
+    return EB_SUCCESS;
+
+    /*
+     * An error occurs...
+     */
+  failed:
+    *size = 0;
+    LOG(("out: eb_binary_size() = %s", eb_error_string(error_code)));
+    eb_unlock(&book->lock);
+    return error_code;
+}
+
+
+/*
+ * Make the next eb_read_binary() start `offset' bytes into the current
+ * binary data, so that it can be read in parts by several readers
+ * which set the binary in turn.  Monochrome and gray scale graphics
+ * are converted while they are read and can't be seeked.
+ */
+EB_Error_Code
+eb_seek_binary(EB_Book *book, off_t offset)
+{
+    EB_Error_Code error_code;
+    EB_Binary_Context *context;
+    off_t data_offset;
+
+    eb_lock(&book->lock);
+    LOG(("in: eb_seek_binary(book=%d, offset=%ld)", (int)book->code,
+	(long)offset));
+
+    context = &book->binary_context;
+    if (context->code == EB_BINARY_INVALID) {
+	error_code = EB_ERR_NO_CUR_BINARY;
+	goto failed;
+    }
+    if (offset < 0 || (context->code != EB_BINARY_WAVE
+	&& context->code != EB_BINARY_COLOR_GRAPHIC
+	&& context->code != EB_BINARY_MPEG)) {
+	error_code = EB_ERR_FAIL_SEEK_BINARY;
+	goto failed;
+    }
+
+    /*
+     * The WAVE header is kept in the cache buffer during the whole
+     * read, only its length is reset once it's been copied.
+     */
+    data_offset = offset;
+    if (context->code == EB_BINARY_WAVE) {
+	if (offset < EB_WAVE_HEADER_LENGTH) {
+	    context->cache_length = EB_WAVE_HEADER_LENGTH;
+	    context->cache_offset = offset;
+	    data_offset = 0;
+	} else {
+	    context->cache_length = 0;
+	    context->cache_offset = 0;
+	    data_offset = offset - EB_WAVE_HEADER_LENGTH;
+	}
+    }
+
+    if (0 < context->size && context->size < (size_t)data_offset)
+	data_offset = context->size;
+    if (zio_lseek(context->zio, context->location + data_offset, SEEK_SET)
+	< 0) {
+	error_code = EB_ERR_FAIL_SEEK_BINARY;
+	goto failed;
+    }
+    context->offset = data_offset;
+
+    LOG(("out: eb_seek_binary() = %s", eb_error_string(EB_SUCCESS)));
+    eb_unlock(&book->lock);
+
+    return EB_SUCCESS;
+
+    /*
+     * An error occurs...
+     */
+  failed:
+    LOG(("out: eb_seek_binary() = %s", eb_error_string(error_code)));
+    eb_unlock(&book->lock);
+    return error_code;
+}
+
+
 /*
  * Unset current binary.
  */
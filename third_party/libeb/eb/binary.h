@@ -57,6 +57,8 @@ EB_Error_Code eb_set_binary_mpeg(EB_Book *book, const unsigned int *argv);
 EB_Error_Code eb_read_binary(EB_Book *book, size_t binary_max_length,
     char *binary, ssize_t *binary_length);
 void eb_unset_binary(EB_Book *book);
+EB_Error_Code eb_binary_size(EB_Book *book, size_t *size);
+EB_Error_Code eb_seek_binary(EB_Book *book, off_t offset);
 
 /* filename.c */
 EB_Error_Code eb_compose_movie_file_name(const unsigned int *argv,
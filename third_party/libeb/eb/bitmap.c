@@ -1138,17 +1138,17 @@ png_compress(const char *src, int width, int height, char *dest,
     z.zalloc = Z_NULL;
     z.zfree = Z_NULL;
     z.opaque = Z_NULL;
-    z_result = deflateInit(&z, Z_NO_COMPRESSION);
+    z_result = deflateInit(&z, Z_BEST_COMPRESSION);
     if (z_result != Z_OK)
 	return z_result;
 
     /*
-     * Exactly to say, `z.avail_out' must be:
-     *     avail_out > (sizeof(src) + 12) * 1.001
-     * but we use an approximation here.
+     * Deflate never emits more than storing the data would, so the
+     * fixed size buffers for font images are large enough.  Larger
+     * images must provide deflateBound() bytes.
      */
     z.next_out = (unsigned char *)dest;
-    z.avail_out = (line_size + 1) * height + 12 + 256;
+    z.avail_out = deflateBound(&z, (uLong)(line_size + 1) * height);
     for (i = 0; i < height - 1; i++) {
 	z.next_in = &byte_zero;
 	z.avail_in = 1;
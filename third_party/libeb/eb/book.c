@@ -82,6 +82,8 @@ eb_initialize_book(EB_Book *book)
     eb_initialize_binary_context(book);
     eb_initialize_search_contexts(book);
     eb_initialize_binary_context(book);
+    book->text_cache.subbook_code = EB_SUBBOOK_INVALID;
+    book->search_cache.subbook_code = EB_SUBBOOK_INVALID;
     eb_initialize_lock(&book->lock);
 
     LOG(("out: eb_initialize_book()"));
@@ -116,6 +116,21 @@
 #define EB_ARRANGE_VARIABLE		1
 #define EB_ARRANGE_INVALID		-1
 
+/*
+ * Types of entries in an in-memory word index.
+ */
+#define EB_WORD_INDEX_ENTRY_PLAIN	0
+#define EB_WORD_INDEX_ENTRY_SINGLE	1
+#define EB_WORD_INDEX_ENTRY_GROUP	2
+#define EB_WORD_INDEX_ENTRY_ELEMENT	3
+
+/*
+ * Vector code used to compare index keys.
+ */
+#define EB_MATCH_LEVEL_SCALAR		0
+#define EB_MATCH_LEVEL_SSE2		1
+#define EB_MATCH_LEVEL_AVX2		2
+
 /*
  * Binary data types.
  */
@@ -207,6 +222,9 @@ extern int eb_log_flag;
 /* hook.c */
 extern EB_Hookset eb_default_hookset;
 
+/* wordindex.c */
+extern int eb_word_index_preload;
+
 /*
  * Function declarations.
  */
@@ -289,6 +307,8 @@ const char *eb_quoted_stream(const char *stream, size_t stream_length);
 const char *eb_quoted_string(const char *string);
 
 /* match.c */
+void eb_initialize_match(void);
+int eb_set_match_level(int level);
 int eb_match_word(const char *word, const char *pattern, size_t length);
 int eb_pre_match_word(const char *word, const char *pattern, size_t length);
 int eb_exact_match_word_jis(const char *word, const char *pattern,
@@ -354,11 +374,24 @@ void eb_reset_text_context(EB_Book *book);
 void eb_invalidate_text_context(EB_Book *book);
 EB_Error_Code eb_forward_heading(EB_Book *book);
 
+/* word.c */
+EB_Error_Code eb_set_word_search_context(EB_Book *book,
+    EB_Search_Context *context, EB_Word_Code word_code);
+
 /* widefont.c */
 EB_Error_Code eb_open_wide_font_file(EB_Book *book, EB_Font_Code font_code);
 EB_Error_Code eb_load_wide_font_header(EB_Book *book, EB_Font_Code font_code);
 EB_Error_Code eb_load_wide_font_glyphs(EB_Book *book, EB_Font_Code font_code);
 
+/* wordindex.c */
+void eb_finalize_word_index(EB_Search *search);
+EB_Word_Index *eb_word_index_of_context(EB_Book *book,
+    EB_Search_Context *context);
+void eb_presearch_word_index(EB_Search_Context *context,
+    EB_Word_Index *word_index);
+void eb_hit_list_word_index(EB_Search_Context *context, int max_hit_count,
+    EB_Hit *hit_list, int *entry_list, int *hit_count);
+
 /* strcasecmp.c */
 int eb_strcasecmp(const char *string1, const char *string2);
 int eb_strncasecmp(const char *string1, const char *string2, size_t n);
@@ -213,12 +213,14 @@ typedef struct EB_Alternation_Cache_Struct EB_Alternation_Cache;
 typedef struct EB_Appendix_Subbook_Struct  EB_Appendix_Subbook;
 typedef struct EB_Appendix_Struct          EB_Appendix;
 typedef struct EB_Font_Struct              EB_Font;
+typedef struct EB_Word_Index_Struct        EB_Word_Index;
 typedef struct EB_Search_Struct            EB_Search;
 typedef struct EB_Multi_Search_Struct      EB_Multi_Search;
 typedef struct EB_Subbook_Struct           EB_Subbook;
 typedef struct EB_Text_Context_Struct      EB_Text_Context;
 typedef struct EB_Binary_Context_Struct    EB_Binary_Context;
 typedef struct EB_Search_Context_Struct    EB_Search_Context;
+typedef struct EB_Page_Cache_Struct        EB_Page_Cache;
 typedef struct EB_Book_Struct              EB_Book;
 typedef struct EB_Hit_Struct               EB_Hit;
 typedef struct EB_Hook_Struct              EB_Hook;
@@ -232,17 +234,12 @@ typedef struct EB_BookList                 EB_BookList;
 #ifdef EB_ENABLE_PTHREAD
 struct EB_Lock_Struct {
     /*
-     * Lock count.  (For emulating recursive lock).
+     * Lock count of the thread holding the lock.
      */
     int lock_count;
 
     /*
-     * Mutex for `lock_count'.
-     */
-    pthread_mutex_t lock_count_mutex;
-
-    /*
-     * Mutex for struct entity.
+     * Recursive mutex for struct entity.
      */
     pthread_mutex_t entity_mutex;
 };
@@ -446,6 +443,41 @@ struct EB_Font_Struct {
     Zio zio;
 };
 
+/*
+ * Leaf entries of a word index decoded into memory.
+ */
+struct EB_Word_Index_Struct {
+    /*
+     * The number of entries.
+     */
+    int entry_count;
+
+    /*
+     * Keys of all entries, one after another.  The key of the entry
+     * `i' starts at `keys + key_offsets[i]' and ends at
+     * `keys + key_offsets[i + 1]'.
+     */
+    char *keys;
+    int *key_offsets;
+
+    /*
+     * Type of each entry.  (EB_WORD_INDEX_ENTRY_*)
+     */
+    unsigned char *entry_types;
+
+    /*
+     * Heading and text positions of each entry.
+     */
+    EB_Hit *hits;
+
+    /*
+     * Entries other than elements of group entries, in index order.
+     * A search binary-searches these and scans forward from there.
+     */
+    int *heads;
+    int head_count;
+};
+
 /*
  * Search methods in a subbook.
  */
@@ -486,6 +518,12 @@ struct EB_Search_Struct {
      * Label. (for an entry in multi search)
      */
     char label[EB_MAX_MULTI_LABEL_LENGTH + 1];
+
+    /*
+     * Leaf entries of the index loaded by eb_load_word_indexes().
+     * (NULL if the index has not been loaded.)
+     */
+    EB_Word_Index *word_index;
 };
 
 /*
@@ -857,6 +895,39 @@ struct EB_Search_Context_Struct {
      * Current heading position (for keyword search).
      */
     EB_Position keyword_heading;
+
+    /*
+     * In-memory index being searched, or NULL if the index pages are
+     * read from the text file.  `entry_index' is an index into it.
+     */
+    EB_Word_Index *word_index;
+};
+
+/*
+ * Data read from the text file of the current subbook, kept to save
+ * subsequent reads of the same page.
+ */
+struct EB_Page_Cache_Struct {
+    /*
+     * Subbook which the data belongs to.  (EB_SUBBOOK_INVALID if the
+     * cache is empty.)
+     */
+    EB_Subbook_Code subbook_code;
+
+    /*
+     * Location of the data in the text file.
+     */
+    off_t location;
+
+    /*
+     * Length of the data.
+     */
+    size_t length;
+
+    /*
+     * Cached data.
+     */
+    char buffer[EB_SIZE_PAGE];
 };
 
 /*
@@ -918,6 +989,12 @@ struct EB_Book_Struct {
      */
     EB_Search_Context search_contexts[EB_NUMBER_OF_SEARCH_CONTEXTS];
 
+    /*
+     * Page caches for text reading and for word search.
+     */
+    EB_Page_Cache text_cache;
+    EB_Page_Cache search_cache;
+
     /*
      * ebnet socket file. 
      */
@@ -48,6 +48,7 @@ eb_initialize_library(void)
     LOG(("aux: EB Library version %s", EB_VERSION_STRING));
 
     eb_initialize_default_hookset();
+    eb_initialize_match();
 #ifdef ENABLE_NLS
     bindtextdomain(EB_TEXT_DOMAIN_NAME, EB_LOCALEDIR);
 #endif
@@ -87,3 +88,100 @@ eb_finalize_library(void)
 
     LOG(("out: eb_finalize_library()"));
 }
+
+
+/*
+ * Set the maximum number of bytes held by the uncompressed slice cache
+ * shared by all books.  The function may be called before the library
+ * is initialized.
+ */
+EB_Error_Code
+eb_set_cache_size(size_t size)
+{
+    EB_Error_Code error_code;
+
+    LOG(("in: eb_set_cache_size(size=%ld)", (long)size));
+
+    if (zio_set_cache_size(size) < 0) {
+	error_code = EB_ERR_MEMORY_EXHAUSTED;
+	goto failed;
+    }
+
+    LOG(("out: eb_set_cache_size() = %s", eb_error_string(EB_SUCCESS)));
+    return EB_SUCCESS;
+
+    /*
+     * An error occurs...
+     */
+  failed:
+    LOG(("out: eb_set_cache_size() = %s", eb_error_string(error_code)));
+    return error_code;
+}
+
+
+/*
+ * Get the number of hits and misses of the uncompressed slice cache
+ * shared by all books.
+ */
+void
+eb_cache_statistics(unsigned long *hits, unsigned long *misses)
+{
+    zio_cache_statistics(hits, misses);
+}
+
+
+/*
+ * Enable or disable mapping of book files on local disk into memory.
+ * Mapped files are read without system calls.  The setting applies to
+ * files opened after the call.
+ */
+void
+eb_set_mmap(int enable)
+{
+    LOG(("in: eb_set_mmap(enable=%d)", enable));
+
+    zio_set_mmap(enable);
+
+    LOG(("out: eb_set_mmap()"));
+}
+
+
+/*
+ * Decompress up to `slice_count' slices of EBZIP compressed books ahead
+ * of sequential reads on `thread_count' background threads.  Passing 0
+ * for either count disables prefetching.  It requires thread support.
+ */
+EB_Error_Code
+eb_set_prefetch(int thread_count, int slice_count)
+{
+    EB_Error_Code error_code;
+
+    LOG(("in: eb_set_prefetch(thread_count=%d, slice_count=%d)",
+	thread_count, slice_count));
+
+    if (zio_set_prefetch(thread_count, slice_count) < 0) {
+	error_code = EB_ERR_MEMORY_EXHAUSTED;
+	goto failed;
+    }
+
+    LOG(("out: eb_set_prefetch() = %s", eb_error_string(EB_SUCCESS)));
+    return EB_SUCCESS;
+
+    /*
+     * An error occurs...
+     */
+  failed:
+    LOG(("out: eb_set_prefetch() = %s", eb_error_string(error_code)));
+    return error_code;
+}
+
+
+/*
+ * Get the number of slices queued for prefetching, and the number of
+ * them which have been read.
+ */
+void
+eb_prefetch_statistics(unsigned long *issued, unsigned long *used)
+{
+    zio_prefetch_statistics(issued, used);
+}
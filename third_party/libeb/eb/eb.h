@@ -66,6 +66,11 @@ int eb_have_cross_search(EB_Book *book);
 /* eb.c */
 EB_Error_Code eb_initialize_library(void);
 void eb_finalize_library(void);
+EB_Error_Code eb_set_cache_size(size_t size);
+void eb_cache_statistics(unsigned long *hits, unsigned long *misses);
+void eb_set_mmap(int enable);
+EB_Error_Code eb_set_prefetch(int thread_count, int slice_count);
+void eb_prefetch_statistics(unsigned long *issued, unsigned long *used);
 
 /* endword.c */
 int eb_have_endword_search(EB_Book *book);
@@ -144,6 +149,14 @@ void eb_unset_subbook(EB_Book *book);
 int eb_have_word_search(EB_Book *book);
 EB_Error_Code eb_search_word(EB_Book *book, const char *input_word);
 
+/* wordindex.c */
+void eb_set_word_index_preload(int preload);
+EB_Error_Code eb_load_word_indexes(EB_Book *book);
+EB_Error_Code eb_hit_list_word_entries(EB_Book *book, int max_hit_count,
+    EB_Hit *hit_list, int *entry_list, int *index_page, int *hit_count);
+EB_Error_Code eb_narrow_word_hits(EB_Book *book, const char *input_word,
+    int index_page, EB_Hit *hit_list, int *entry_list, int *hit_count);
+
 /* for backward compatibility */
 #define eb_suspend eb_unset_subbook
 #define eb_initialize_all_subbooks eb_load_all_subbooks
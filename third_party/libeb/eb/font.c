@@ -305,6 +305,7 @@ eb_set_font(EB_Book *book, EB_Font_Code font_code)
   failed:
     eb_unset_font(book);
     LOG(("out: eb_set_font() = %s", eb_error_string(error_code)));
+    eb_unlock(&book->lock);
     return error_code;
 }
 
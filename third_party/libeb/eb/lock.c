@@ -55,8 +55,12 @@ eb_pthread_enabled(void)
 void
 eb_initialize_lock(EB_Lock *lock)
 {
-    pthread_mutex_init(&lock->lock_count_mutex, NULL);
-    pthread_mutex_init(&lock->entity_mutex, NULL);
+    pthread_mutexattr_t attributes;
+
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&lock->entity_mutex, &attributes);
+    pthread_mutexattr_destroy(&attributes);
     lock->lock_count = 0;
 }
 
@@ -72,16 +76,13 @@ eb_finalize_lock(EB_Lock *lock)
 
 
 /*
- * Lock an entity.
+ * Lock an entity.  The thread holding the lock may lock it again.
  */
 void
 eb_lock(EB_Lock *lock)
 {
-    pthread_mutex_lock(&lock->lock_count_mutex);
-    if (lock->lock_count == 0)
-	pthread_mutex_lock(&lock->entity_mutex);
+    pthread_mutex_lock(&lock->entity_mutex);
     lock->lock_count++;
-    pthread_mutex_unlock(&lock->lock_count_mutex);
 }
 
 
@@ -91,13 +92,10 @@ eb_lock(EB_Lock *lock)
 void
 eb_unlock(EB_Lock *lock)
 {
-    pthread_mutex_lock(&lock->lock_count_mutex);
     if (0 < lock->lock_count) {
 	lock->lock_count--;
-	if (lock->lock_count == 0)
-	    pthread_mutex_unlock(&lock->entity_mutex);
+	pthread_mutex_unlock(&lock->entity_mutex);
     }
-    pthread_mutex_unlock(&lock->lock_count_mutex);
 }
 
 #endif /* ENABLE_PTHREAD */
@@ -30,6 +30,225 @@
 #include "eb.h"
 #include "build-post.h"
 
+/*
+ * Index keys are compared 16 bytes at a time with SSE2 and 32 bytes at a
+ * time with AVX2 if the CPU supports it.  The vector code only skips the
+ * leading part of a key which the byte-by-byte loops below would walk
+ * over anyway, so the loops alone decide the result.
+ */
+#ifdef __SSE2__
+#define EB_MATCH_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define EB_MATCH_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+/*
+ * Keys shorter than this are compared by the loops only.
+ */
+#define EB_MATCH_MIN_VECTOR_LENGTH	16
+
+/*
+ * Unexported functions.
+ */
+static size_t eb_match_prefix_length(const unsigned char *word,
+    const unsigned char *pattern, size_t length, int kana);
+#ifdef EB_MATCH_SSE2
+static size_t eb_match_prefix_length_sse2(const unsigned char *word,
+    const unsigned char *pattern, size_t length, int kana);
+#endif
+#ifdef EB_MATCH_AVX2
+static size_t eb_match_prefix_length_avx2(const unsigned char *word,
+    const unsigned char *pattern, size_t length, int kana)
+    __attribute__((target("avx2")));
+#endif
+
+/*
+ * The best vector code this CPU supports, set by eb_initialize_match(),
+ * and the vector code in use.
+ */
+#ifdef EB_MATCH_SSE2
+static int eb_match_max_level = EB_MATCH_LEVEL_SSE2;
+static int eb_match_level = EB_MATCH_LEVEL_SSE2;
+#else
+static int eb_match_max_level = EB_MATCH_LEVEL_SCALAR;
+static int eb_match_level = EB_MATCH_LEVEL_SCALAR;
+#endif
+
+
+/*
+ * Choose the vector implementation of key comparison for this CPU.
+ */
+void
+eb_initialize_match(void)
+{
+#ifdef EB_MATCH_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+	eb_match_max_level = EB_MATCH_LEVEL_AVX2;
+#endif
+    eb_match_level = eb_match_max_level;
+}
+
+
+/*
+ * Use vector code up to `level' in key comparison, for comparing the
+ * implementations with each other.  Return the level actually used,
+ * which is lower if the CPU doesn't support `level'.  Must not be called
+ * while books are searched.
+ */
+int
+eb_set_match_level(int level)
+{
+    if (eb_match_max_level < level)
+	level = eb_match_max_level;
+    if (level < EB_MATCH_LEVEL_SCALAR)
+	level = EB_MATCH_LEVEL_SCALAR;
+    eb_match_level = level;
+    return level;
+}
+
+
+/*
+ * Return the length of the leading part of `word' and `pattern' which
+ * the comparison loops would skip: bytes before the end of `word' and
+ * within `length' that are equal.  If `kana' is set, the length is
+ * counted in characters of JIS X 0208, and kana characters which differ
+ * only in hiragana and katakana are regarded as equal.
+ *
+ * The result may be smaller than the actual length of the common part,
+ * the loops compare the rest.
+ */
+static size_t
+eb_match_prefix_length(const unsigned char *word,
+    const unsigned char *pattern, size_t length, int kana)
+{
+#ifdef EB_MATCH_SSE2
+    const unsigned char *nul;
+
+    if (eb_match_level == EB_MATCH_LEVEL_SCALAR
+	|| length < EB_MATCH_MIN_VECTOR_LENGTH)
+	return 0;
+
+    nul = memchr(word, '\0', length);
+    if (nul != NULL)
+	length = nul - word;
+    if (kana)
+	length &= ~(size_t)1;
+
+#ifdef EB_MATCH_AVX2
+    /*
+     * The AVX2 version doesn't fall back to SSE2 for short keys, since
+     * mixing the two costs more than it saves.
+     */
+    if (eb_match_level == EB_MATCH_LEVEL_AVX2 && 32 <= length)
+	return eb_match_prefix_length_avx2(word, pattern, length, kana);
+#endif
+    return eb_match_prefix_length_sse2(word, pattern, length, kana);
+#else /* not EB_MATCH_SSE2 */
+    return 0;
+#endif /* not EB_MATCH_SSE2 */
+}
+
+
+#ifdef EB_MATCH_SSE2
+/*
+ * SSE2 version of eb_match_prefix_length().  `word' has no `\0' in the
+ * first `length' bytes, and `length' is even if `kana' is set.
+ *
+ * If `length' is not a multiple of 16, the last block overlaps the
+ * previous one.  Bytes in the overlapping part are known to be equal.
+ */
+static size_t
+eb_match_prefix_length_sse2(const unsigned char *word,
+    const unsigned char *pattern, size_t length, int kana)
+{
+    const __m128i kana_bit = _mm_set1_epi8(0x01);
+    const __m128i kana_row = _mm_set1_epi8(0x25);
+    const __m128i even = _mm_set1_epi16(0x00ff);
+    __m128i w, p, equal, kana_pair;
+    unsigned int mask;
+    size_t i = 0;
+
+    if (length < 16)
+	return 0;
+
+    for (;;) {
+	if (length < i + 16)
+	    i = length - 16;
+	w = _mm_loadu_si128((const __m128i *)(word + i));
+	p = _mm_loadu_si128((const __m128i *)(pattern + i));
+	equal = _mm_cmpeq_epi8(w, p);
+	if (kana) {
+	    /*
+	     * The first bytes of hiragana (0x24) and katakana (0x25)
+	     * are regarded as equal.
+	     */
+	    kana_pair = _mm_and_si128(
+		_mm_cmpeq_epi8(_mm_or_si128(w, kana_bit), kana_row),
+		_mm_cmpeq_epi8(_mm_or_si128(p, kana_bit), kana_row));
+	    equal = _mm_or_si128(equal, _mm_and_si128(kana_pair, even));
+	}
+	mask = (unsigned int)_mm_movemask_epi8(equal);
+	if (mask != 0xffff) {
+	    i += __builtin_ctz(~mask);
+	    if (kana)
+		i &= ~(size_t)1;
+	    return i;
+	}
+	if (i + 16 == length)
+	    return length;
+	i += 16;
+    }
+}
+#endif /* EB_MATCH_SSE2 */
+
+
+#ifdef EB_MATCH_AVX2
+/*
+ * AVX2 version of eb_match_prefix_length().  The same as the SSE2 one
+ * with 32 byte blocks.  `length' must be 32 or more.
+ */
+static size_t
+eb_match_prefix_length_avx2(const unsigned char *word,
+    const unsigned char *pattern, size_t length, int kana)
+{
+    const __m256i kana_bit = _mm256_set1_epi8(0x01);
+    const __m256i kana_row = _mm256_set1_epi8(0x25);
+    const __m256i even = _mm256_set1_epi16(0x00ff);
+    __m256i w, p, equal, kana_pair;
+    unsigned int mask;
+    size_t i = 0;
+
+    for (;;) {
+	if (length < i + 32)
+	    i = length - 32;
+	w = _mm256_loadu_si256((const __m256i *)(word + i));
+	p = _mm256_loadu_si256((const __m256i *)(pattern + i));
+	equal = _mm256_cmpeq_epi8(w, p);
+	if (kana) {
+	    kana_pair = _mm256_and_si256(
+		_mm256_cmpeq_epi8(_mm256_or_si256(w, kana_bit), kana_row),
+		_mm256_cmpeq_epi8(_mm256_or_si256(p, kana_bit), kana_row));
+	    equal = _mm256_or_si256(equal, _mm256_and_si256(kana_pair, even));
+	}
+	mask = (unsigned int)_mm256_movemask_epi8(equal);
+	if (mask != 0xffffffff) {
+	    i += __builtin_ctz(~mask);
+	    if (kana)
+		i &= ~(size_t)1;
+	    return i;
+	}
+	if (i + 32 == length)
+	    return length;
+	i += 32;
+    }
+}
+#endif /* EB_MATCH_AVX2 */
+
+
 /*
  * Compare `word' and `pattern'.
  * `word' must be terminated by `\0' and `pattern' is assumed to be
@@ -51,6 +270,10 @@ eb_match_word(const char *word, const char *pattern, size_t length)
 	eb_quoted_stream(word, EB_MAX_WORD_LENGTH),
 	eb_quoted_stream(pattern, length)));
 
+    i = eb_match_prefix_length(word_p, pattern_p, length, 0);
+    word_p += i;
+    pattern_p += i;
+
     for (;;) {
 	if (length <= i) {
 	    result = *word_p;
@@ -97,6 +320,10 @@ eb_pre_match_word(const char *word, const char *pattern, size_t length)
 	eb_quoted_stream(word, EB_MAX_WORD_LENGTH),
 	eb_quoted_stream(pattern, length)));
 
+    i = eb_match_prefix_length(word_p, pattern_p, length, 0);
+    word_p += i;
+    pattern_p += i;
+
     for (;;) {
 	if (length <= i) {
 	    result = 0;
@@ -143,6 +370,10 @@ eb_exact_match_word_jis(const char *word, const char *pattern, size_t length)
 	eb_quoted_stream(word, EB_MAX_WORD_LENGTH),
 	eb_quoted_stream(pattern, length)));
 
+    i = eb_match_prefix_length(word_p, pattern_p, length, 0);
+    word_p += i;
+    pattern_p += i;
+
     for (;;) {
 	if (length <= i) {
 	    result = *word_p;
@@ -194,6 +425,10 @@ eb_exact_pre_match_word_jis(const char *word, const char *pattern,
 	eb_quoted_stream(word, EB_MAX_WORD_LENGTH),
 	eb_quoted_stream(pattern, length)));
 
+    i = eb_match_prefix_length(word_p, pattern_p, length, 0);
+    word_p += i;
+    pattern_p += i;
+
     for (;;) {
 	if (length <= i) {
 	    result = 0;
@@ -244,6 +479,10 @@ eb_exact_match_word_latin(const char *word, const char *pattern, size_t length)
 	eb_quoted_stream(word, EB_MAX_WORD_LENGTH),
 	eb_quoted_stream(pattern, length)));
 
+    i = eb_match_prefix_length(word_p, pattern_p, length, 0);
+    word_p += i;
+    pattern_p += i;
+
     for (;;) {
 	if (length <= i) {
 	    result = *word_p;
@@ -295,6 +534,10 @@ eb_exact_pre_match_word_latin(const char *word, const char *pattern,
 	eb_quoted_stream(word, EB_MAX_WORD_LENGTH),
 	eb_quoted_stream(pattern, length)));
 
+    i = eb_match_prefix_length(word_p, pattern_p, length, 0);
+    word_p += i;
+    pattern_p += i;
+
     for (;;) {
 	if (length <= i) {
 	    result = 0;
@@ -349,6 +592,10 @@ eb_match_word_kana_group(const char *word, const char *pattern, size_t length)
 	eb_quoted_stream(word, EB_MAX_WORD_LENGTH),
 	eb_quoted_stream(pattern, length)));
 
+    i = eb_match_prefix_length(word_p, pattern_p, length, 1);
+    word_p += i;
+    pattern_p += i;
+
     for (;;) {
 	if (length <= i) {
 	    result = *word_p;
@@ -414,6 +661,10 @@ eb_match_word_kana_single(const char *word, const char *pattern, size_t length)
 	eb_quoted_stream(word, EB_MAX_WORD_LENGTH),
 	eb_quoted_stream(pattern, length)));
 
+    i = eb_match_prefix_length(word_p, pattern_p, length, 1);
+    word_p += i;
+    pattern_p += i;
+
     for (;;) {
 	if (length <= i) {
 	    result = *word_p;
@@ -479,6 +730,10 @@ eb_exact_match_word_kana_group(const char *word, const char *pattern,
 	eb_quoted_stream(word, EB_MAX_WORD_LENGTH),
 	eb_quoted_stream(pattern, length)));
 
+    i = eb_match_prefix_length(word_p, pattern_p, length, 1);
+    word_p += i;
+    pattern_p += i;
+
     for (;;) {
 	if (length <= i) {
 	    result = *word_p;
@@ -544,6 +799,10 @@ eb_exact_match_word_kana_single(const char *word, const char *pattern,
 	eb_quoted_stream(word, EB_MAX_WORD_LENGTH),
 	eb_quoted_stream(pattern, length)));
 
+    i = eb_match_prefix_length(word_p, pattern_p, length, 1);
+    word_p += i;
+    pattern_p += i;
+
     for (;;) {
 	if (length <= i) {
 	    result = *word_p;
@@ -47,38 +47,11 @@
  */
 #define SKIP_CODE_NONE  -1
 
-/*
- * Cache data buffer.
- */
-static char cache_buffer[EB_SIZE_PAGE];
-
-/*
- * Book code of which `cache_buffer' records data.
- */
-static EB_Book_Code cache_book_code = EB_BOOK_NONE;
-
-/*
- * Location of cache data loaded in `cache_buffer'.
- */
-static off_t cache_location;
-
-/*
- * Length of cache data loaded in `cache_buffer'.
- */
-static size_t cache_length;
-
 /*
  * Null hook.
  */
 static const EB_Hook null_hook = {EB_HOOK_NULL, NULL};
 
-/*
- * Mutex for cache variables.
- */
-#ifdef ENABLE_PTHREAD
-static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
-#endif
-
 /*
  * Unexported functions.
  */
@@ -188,7 +161,6 @@ eb_seek_text(EB_Book *book, const EB_Position *position)
 {
     EB_Error_Code error_code;
 
-    pthread_mutex_lock(&cache_mutex);
     eb_lock(&book->lock);
     LOG(("in: eb_seek_text(book=%d, position={%d,%d})", (int)book->code,
 	position->page, position->offset));
@@ -219,11 +191,10 @@ eb_seek_text(EB_Book *book, const EB_Position *position)
 	+ position->offset;
 
     /*
-     * Unlock cache data and the book.
+     * Unlock the book.
      */
     LOG(("out: eb_seek_text() = %s", eb_error_string(EB_SUCCESS)));
     eb_unlock(&book->lock);
-    pthread_mutex_unlock(&cache_mutex);
 
     return EB_SUCCESS;
 
@@ -234,7 +205,6 @@ eb_seek_text(EB_Book *book, const EB_Position *position)
     eb_invalidate_text_context(book);
     LOG(("out: eb_seek_text() = %s", eb_error_string(error_code)));
     eb_unlock(&book->lock);
-    pthread_mutex_unlock(&cache_mutex);
     return error_code;
 }
 
@@ -555,6 +525,7 @@ eb_read_text_internal(EB_Book *book, EB_Appendix *appendix,
 {
     EB_Error_Code error_code;
     EB_Text_Context *context;
+    EB_Page_Cache *cache;
     unsigned char c1, c2;
     char *cache_p;
     const EB_Hook *hook;
@@ -565,7 +536,6 @@ eb_read_text_internal(EB_Book *book, EB_Appendix *appendix,
     unsigned int argv[EB_MAX_ARGV];
     int argc;
 
-    pthread_mutex_lock(&cache_mutex);
     LOG(("in: eb_read_text_internal(book=%d, appendix=%d, \
 text_max_length=%ld, forward=%d)",
 	(int)book->code, (appendix != NULL) ? (int)appendix->code : 0,
@@ -575,6 +545,7 @@ text_max_length=%ld, forward=%d)",
      * Initialize variables.
      */
     context = &book->text_context;
+    cache = &book->text_cache;
     context->out = text;
     context->out_rest_length = text_max_length;
     if (context->is_candidate) {
@@ -613,16 +584,16 @@ text_max_length=%ld, forward=%d)",
      * Check for cache data.
      * If cache data is not what we need, discard it.
      */
-    if (book->code == cache_book_code
-	&& cache_location <= context->location
-	&& context->location < cache_location + cache_length) {
-	cache_p = cache_buffer + (context->location - cache_location);
-	cache_rest_length = cache_length
-	    - (context->location - cache_location);
+    if (cache->subbook_code == book->subbook_current->code
+	&& cache->location <= context->location
+	&& context->location < cache->location + cache->length) {
+	cache_p = cache->buffer + (context->location - cache->location);
+	cache_rest_length = cache->length
+	    - (context->location - cache->location);
     } else {
-	cache_book_code = EB_BOOK_NONE;
-	cache_p = cache_buffer;
-	cache_length = 0;
+	cache->subbook_code = EB_SUBBOOK_INVALID;
+	cache_p = cache->buffer;
+	cache->length = 0;
 	cache_rest_length = 0;
     }
 
@@ -640,7 +611,7 @@ text_max_length=%ld, forward=%d)",
 	    ssize_t read_result;
 
 	    if (0 < cache_rest_length)
-		memmove(cache_buffer, cache_p, cache_rest_length);
+		memmove(cache->buffer, cache_p, cache_rest_length);
 	    if (zio_lseek(&book->subbook_current->text_zio,
 		context->location + cache_rest_length, SEEK_SET) == -1) {
 		error_code = EB_ERR_FAIL_SEEK_TEXT;
@@ -648,7 +619,7 @@ text_max_length=%ld, forward=%d)",
 	    }
 
 	    read_result = zio_read(&book->subbook_current->text_zio,
-		cache_buffer + cache_rest_length,
+		cache->buffer + cache_rest_length,
 		EB_SIZE_PAGE - cache_rest_length);
 	    if (read_result < 0) {
 		error_code = EB_ERR_FAIL_READ_TEXT;
@@ -656,11 +627,11 @@ text_max_length=%ld, forward=%d)",
 	    } else if (read_result != EB_SIZE_PAGE - cache_rest_length)
 		context->file_end_flag = 1;
 
-	    cache_book_code = book->code;
-	    cache_location = context->location;
-	    cache_length = cache_rest_length + read_result;
-	    cache_p = cache_buffer;
-	    cache_rest_length = cache_length;
+	    cache->subbook_code = book->subbook_current->code;
+	    cache->location = context->location;
+	    cache->length = cache_rest_length + read_result;
+	    cache_p = cache->buffer;
+	    cache_rest_length = cache->length;
 	}
 
 	/*
@@ -1508,7 +1479,6 @@ text_max_length=%ld, forward=%d)",
     LOG(("out: eb_read_text_internal(text_length=%ld) = %s",
 	(text_length == NULL) ? 0L : (long)*text_length,
 	eb_error_string(EB_SUCCESS)));
-    pthread_mutex_unlock(&cache_mutex);
 
     return EB_SUCCESS;
 
@@ -1522,9 +1492,8 @@ text_max_length=%ld, forward=%d)",
 	*text = '\0';
     }
     if (error_code == EB_ERR_FAIL_READ_TEXT)
-	cache_book_code = EB_BOOK_NONE;
+	cache->subbook_code = EB_SUBBOOK_INVALID;
     LOG(("out: eb_read_text_internal() = %s", eb_error_string(error_code)));
-    pthread_mutex_unlock(&cache_mutex);
     return error_code;
 }
 
@@ -1560,7 +1529,7 @@ eb_is_text_stopped(EB_Book *book)
 {
     int is_stopped = 0;
 
-    eb_lock(book);
+    eb_lock(&book->lock);
     LOG(("in: eb_is_text_stopped(book=%d)", (int)book->code));
 
     if (book->subbook_current != NULL) {
@@ -1575,6 +1544,7 @@ eb_is_text_stopped(EB_Book *book)
     }
 
     LOG(("out: eb_is_text_stopped() = %d", is_stopped));
+    eb_unlock(&book->lock);
     return is_stopped;
 }
 
@@ -47,26 +47,26 @@
 #define EB_TMP_MAX_HITS		64
 
 /*
- * Book-code of the book in which you want to search a word.
+ * Test whether the search page cache of `book' holds `page' of the
+ * current subbook.
  */
-static EB_Book_Code cache_book_code = EB_BOOK_NONE;
+#define eb_search_cache_has_page(book, page) \
+	((book)->search_cache.subbook_code == (book)->subbook_current->code \
+	    && (book)->search_cache.location \
+		== ((off_t) (page) - 1) * EB_SIZE_PAGE)
 
 /*
- * Cache buffer for the current page.
+ * Record that the search page cache of `book' holds `page' of the
+ * current subbook.
  */
-static char cache_buffer[EB_SIZE_PAGE];
-
-/*
- * Cache buffer for the current page.
- */
-static int cache_page;
-
-/*
- * Mutex for cache variables.
- */
-#ifdef ENABLE_PTHREAD
-static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
-#endif
+#define eb_search_cache_set_page(book, page) \
+	do { \
+	    (book)->search_cache.subbook_code \
+		= (book)->subbook_current->code; \
+	    (book)->search_cache.location \
+		= ((off_t) (page) - 1) * EB_SIZE_PAGE; \
+	    (book)->search_cache.length = EB_SIZE_PAGE; \
+	} while (0)
 
 /*
  * Unexported functions.
@@ -116,6 +116,7 @@ eb_initialize_search_contexts(EB_Book *book)
 	context->in_group_entry = 0;
 	context->keyword_heading.page = 0;
 	context->keyword_heading.offset = 0;
+	context->word_index = NULL;
     }
 
     LOG(("out: eb_initialize_search_context()"));
@@ -169,6 +170,7 @@ eb_initialize_search(EB_Search *search)
     search->p_sound = EB_INDEX_STYLE_CONVERT;
     search->space = EB_INDEX_STYLE_DELETE;
     search->label[0] = '\0';
+    search->word_index = NULL;
 }
 
 
@@ -178,7 +180,7 @@ eb_initialize_search(EB_Search *search)
 void
 eb_finalize_search(EB_Search *search)
 {
-    /* nothing to be done */
+    eb_finalize_word_index(search);
 }
 
 
@@ -278,17 +280,27 @@ EB_Error_Code
 eb_presearch_word(EB_Book *book, EB_Search_Context *context)
 {
     EB_Error_Code error_code;
+    EB_Word_Index *word_index;
     int next_page;
     int index_depth;
+    char *cache_buffer = book->search_cache.buffer;
     char *cache_p;
 
-    pthread_mutex_lock(&cache_mutex);
     LOG(("in: eb_presearch_word(book=%d)", (int)book->code));
 
+    /*
+     * Search the in-memory index instead, if it has been loaded.
+     */
+    word_index = eb_word_index_of_context(book, context);
+    if (word_index != NULL) {
+	eb_presearch_word_index(context, word_index);
+	goto succeeded;
+    }
+
     /*
      * Discard cache data.
      */
-    cache_book_code = EB_BOOK_NONE;
+    book->search_cache.subbook_code = EB_SUBBOOK_INVALID;
 
     /*
      * Search the word in intermediate indexes.
@@ -302,13 +314,13 @@ eb_presearch_word(EB_Book *book, EB_Search_Context *context)
 	 */
 	if (zio_lseek(&book->subbook_current->text_zio,
 	    ((off_t) context->page - 1) * EB_SIZE_PAGE, SEEK_SET) < 0) {
-	    cache_book_code = EB_BOOK_NONE;
+	    book->search_cache.subbook_code = EB_SUBBOOK_INVALID;
 	    error_code = EB_ERR_FAIL_SEEK_TEXT;
 	    goto failed;
 	}
 	if (zio_read(&book->subbook_current->text_zio, cache_buffer,
 	    EB_SIZE_PAGE) != EB_SIZE_PAGE) {
-	    cache_book_code = EB_BOOK_NONE;
+	    book->search_cache.subbook_code = EB_SUBBOOK_INVALID;
 	    error_code = EB_ERR_FAIL_READ_TEXT;
 	    goto failed;
 	}
@@ -377,12 +389,10 @@ entry_length=%d, entry_arrangement=%d, entry_count=%d)",
     context->entry_index = 0;
     context->comparison_result = 1;
     context->in_group_entry = 0;
-    cache_book_code = book->code;
-    cache_page = context->page;
+    eb_search_cache_set_page(book, context->page);
 
   succeeded:
     LOG(("out: eb_presearch_word() = %s", eb_error_string(EB_SUCCESS)));
-    pthread_mutex_unlock(&cache_mutex);
     return EB_SUCCESS;
 
     /*
@@ -390,7 +400,6 @@ entry_length=%d, entry_arrangement=%d, entry_count=%d)",
      */
   failed:
     LOG(("out: eb_presearch_word() = %s", eb_error_string(error_code)));
-    pthread_mutex_unlock(&cache_mutex);
     return error_code;
 }
 
@@ -408,9 +417,8 @@ eb_hit_list(EB_Book *book, int max_hit_count, EB_Hit *hit_list, int *hit_count)
     int i;
 
     /*
-     * Lock cache data and the book.
+     * Lock the book.
      */
-    pthread_mutex_lock(&cache_mutex);
     eb_lock(&book->lock);
     LOG(("in: eb_hit_list(book=%d, max_hit_count=%d)", (int)book->code,
 	max_hit_count));
@@ -544,13 +552,12 @@ eb_hit_list(EB_Book *book, int max_hit_count, EB_Hit *hit_list, int *hit_count)
     }
 
     /*
-     * Unlock cache data and the book.
+     * Unlock the book.
      */
   succeeded:
     LOG(("out: eb_hit_list(hit_count=%d) = %s",
 	*hit_count, eb_error_string(EB_SUCCESS)));
     eb_unlock(&book->lock);
-    pthread_mutex_unlock(&cache_mutex);
     return EB_SUCCESS;
 
     /*
@@ -560,7 +567,6 @@ eb_hit_list(EB_Book *book, int max_hit_count, EB_Hit *hit_list, int *hit_count)
     *hit_count = 0;
     LOG(("out: eb_hit_list() = %s", eb_error_string(error_code)));
     eb_unlock(&book->lock);
-    pthread_mutex_unlock(&cache_mutex);
     return error_code;
 }
 
@@ -575,6 +581,7 @@ eb_hit_list_word(EB_Book *book, EB_Search_Context *context, int max_hit_count,
     EB_Error_Code error_code;
     EB_Hit *hit;
     int group_id;
+    char *cache_buffer = book->search_cache.buffer;
     char *cache_p;
 
     LOG(("in: eb_hit_list_word(book=%d, max_hit_count=%d)", (int)book->code,
@@ -590,6 +597,12 @@ eb_hit_list_word(EB_Book *book, EB_Search_Context *context, int max_hit_count,
     if (context->comparison_result < 0 || max_hit_count <= 0)
 	goto succeeded;
 
+    if (context->word_index != NULL) {
+	eb_hit_list_word_index(context, max_hit_count, hit_list, NULL,
+	    hit_count);
+	goto succeeded;
+    }
+
     for (;;) {
 	/*
 	 * Read a page to search, if the page is not on the cache buffer.
@@ -603,7 +616,7 @@ eb_hit_list_word(EB_Book *book, EB_Search_Context *context, int max_hit_count,
 	 * the search context.  At the case of 2. it reads the page but
 	 * must not update the context!
 	 */
-	if (cache_book_code != book->code || cache_page != context->page) {
+	if (!eb_search_cache_has_page(book, context->page)) {
 	    if (zio_lseek(&book->subbook_current->text_zio,
 		((off_t) context->page - 1) * EB_SIZE_PAGE, SEEK_SET) < 0) {
 		error_code = EB_ERR_FAIL_SEEK_TEXT;
@@ -630,8 +643,7 @@ eb_hit_list_word(EB_Book *book, EB_Search_Context *context, int max_hit_count,
 		context->offset = 4;
 	    }
 
-	    cache_book_code = book->code;
-	    cache_page = context->page;
+	    eb_search_cache_set_page(book, context->page);
 	}
 
 	cache_p = cache_buffer + context->offset;
@@ -869,7 +881,7 @@ entry_length=%d, entry_arrangement=%d, entry_count=%d)",
      */
   failed:
     if (error_code == EB_ERR_FAIL_READ_TEXT)
-	cache_book_code = EB_BOOK_NONE;
+	book->search_cache.subbook_code = EB_SUBBOOK_INVALID;
     *hit_count = 0;
     LOG(("out: eb_hit_list_word() = %s", eb_error_string(error_code)));
     return error_code;
@@ -887,6 +899,7 @@ eb_hit_list_keyword(EB_Book *book, EB_Search_Context *context,
     EB_Text_Context text_context;
     EB_Hit *hit;
     int group_id;
+    char *cache_buffer = book->search_cache.buffer;
     char *cache_p;
 
     LOG(("in: eb_hit_list_keyword(book=%d, max_hit_count=%d)",
@@ -929,7 +942,7 @@ eb_hit_list_keyword(EB_Book *book, EB_Search_Context *context,
 	 * the search context.  At the case of 2. it reads the page but
 	 * must not update the context!
 	 */
-	if (cache_book_code != book->code || cache_page != context->page) {
+	if (!eb_search_cache_has_page(book, context->page)) {
 	    if (zio_lseek(&book->subbook_current->text_zio,
 		((off_t) context->page - 1) * EB_SIZE_PAGE, SEEK_SET) < 0) {
 		error_code = EB_ERR_FAIL_SEEK_TEXT;
@@ -956,8 +969,7 @@ eb_hit_list_keyword(EB_Book *book, EB_Search_Context *context,
 		context->offset = 4;
 	    }
 
-	    cache_book_code = book->code;
-	    cache_page = context->page;
+	    eb_search_cache_set_page(book, context->page);
 	}
 
 	cache_p = cache_buffer + context->offset;
@@ -1215,7 +1227,7 @@ entry_length=%d, entry_arrangement=%d, entry_count=%d)",
      */
   failed:
     if (error_code == EB_ERR_FAIL_READ_TEXT)
-	cache_book_code = EB_BOOK_NONE;
+	book->search_cache.subbook_code = EB_SUBBOOK_INVALID;
     *hit_count = 0;
     memcpy(&book->text_context, &text_context, sizeof(EB_Text_Context));
     LOG(("out: eb_hit_list_keyword() = %s", eb_error_string(error_code)));
@@ -1233,6 +1245,7 @@ eb_hit_list_multi(EB_Book *book, EB_Search_Context *context, int max_hit_count,
     EB_Error_Code error_code;
     EB_Hit *hit;
     int group_id;
+    char *cache_buffer = book->search_cache.buffer;
     char *cache_p;
 
     LOG(("in: eb_hit_list_multi(book=%d, max_hit_count=%d)", (int)book->code,
@@ -1261,7 +1274,7 @@ eb_hit_list_multi(EB_Book *book, EB_Search_Context *context, int max_hit_count,
 	 * the search context.  At the case of 2. it reads the page but
 	 * must not update the context!
 	 */
-	if (cache_book_code != book->code || cache_page != context->page) {
+	if (!eb_search_cache_has_page(book, context->page)) {
 	    if (zio_lseek(&book->subbook_current->text_zio,
 		((off_t) context->page - 1) * EB_SIZE_PAGE, SEEK_SET) < 0) {
 		error_code = EB_ERR_FAIL_SEEK_TEXT;
@@ -1288,8 +1301,7 @@ eb_hit_list_multi(EB_Book *book, EB_Search_Context *context, int max_hit_count,
 		context->offset = 4;
 	    }
 
-	    cache_book_code = book->code;
-	    cache_page = context->page;
+	    eb_search_cache_set_page(book, context->page);
 	}
 
 	cache_p = cache_buffer + context->offset;
@@ -1519,7 +1531,7 @@ entry_length=%d, entry_arrangement=%d, entry_count=%d)",
      */
   failed:
     if (error_code == EB_ERR_FAIL_READ_TEXT)
-	cache_book_code = EB_BOOK_NONE;
+	book->search_cache.subbook_code = EB_SUBBOOK_INVALID;
     *hit_count = 0;
     LOG(("out: eb_hit_list_multi() = %s", eb_error_string(error_code)));
     return error_code;
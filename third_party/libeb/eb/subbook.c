@@ -865,6 +865,13 @@ eb_set_subbook(EB_Book *book, EB_Subbook_Code subbook_code)
      */
     eb_load_font_headers(book);
 
+    /*
+     * Load word indexes into memory, if requested.  Searches fall back
+     * to the index pages of the text file if it fails.
+     */
+    if (eb_word_index_preload)
+	eb_load_word_indexes(book);
+
   succeeded:
     book->subbook_current->initialized = 1;
     LOG(("out: eb_set_subbook() = %s", eb_error_string(EB_SUCCESS)));
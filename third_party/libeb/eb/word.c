@@ -105,6 +105,41 @@ eb_search_word(EB_Book *book, const char *input_word)
     if (error_code != EB_SUCCESS)
 	goto failed;
 
+    error_code = eb_set_word_search_context(book, context, word_code);
+    if (error_code != EB_SUCCESS)
+	goto failed;
+
+    /*
+     * Pre-search.
+     */
+    error_code = eb_presearch_word(book, context);
+    if (error_code != EB_SUCCESS)
+	goto failed;
+
+    LOG(("out: eb_search_word() = %s", eb_error_string(EB_SUCCESS)));
+    eb_unlock(&book->lock);
+
+    return EB_SUCCESS;
+
+    /*
+     * An error occurs...
+     */
+  failed:
+    eb_reset_search_contexts(book);
+    LOG(("out: eb_search_word() = %s", eb_error_string(error_code)));
+    eb_unlock(&book->lock);
+    return error_code;
+}
+
+
+/*
+ * Choose the index page and the comparison functions of a word search
+ * for a word whose code is `word_code'.
+ */
+EB_Error_Code
+eb_set_word_search_context(EB_Book *book, EB_Search_Context *context,
+    EB_Word_Code word_code)
+{
     /*
      * Get a page number.
      */
@@ -114,10 +149,8 @@ eb_search_word(EB_Book *book, const char *input_word)
 	    context->page = book->subbook_current->word_alphabet.start_page;
 	else if (book->subbook_current->word_asis.start_page != 0)
 	    context->page = book->subbook_current->word_asis.start_page;
-	else {
-	    error_code = EB_ERR_NO_SUCH_SEARCH;
-	    goto failed;
-	}
+	else
+	    return EB_ERR_NO_SUCH_SEARCH;
 	break;
 
     case EB_WORD_KANA:
@@ -125,24 +158,19 @@ eb_search_word(EB_Book *book, const char *input_word)
 	    context->page = book->subbook_current->word_kana.start_page;
 	else if (book->subbook_current->word_asis.start_page != 0)
 	    context->page = book->subbook_current->word_asis.start_page;
-	else {
-	    error_code = EB_ERR_NO_SUCH_SEARCH;
-	    goto failed;
-	}
+	else
+	    return EB_ERR_NO_SUCH_SEARCH;
 	break;
 
     case EB_WORD_OTHER:
 	if (book->subbook_current->word_asis.start_page != 0)
 	    context->page = book->subbook_current->word_asis.start_page;
-	else {
-	    error_code = EB_ERR_NO_SUCH_SEARCH;
-	    goto failed;
-	}
+	else
+	    return EB_ERR_NO_SUCH_SEARCH;
 	break;
 
     default:
-	error_code = EB_ERR_NO_SUCH_SEARCH;
-	goto failed;
+	return EB_ERR_NO_SUCH_SEARCH;
     }
 
     /*
@@ -162,24 +190,5 @@ eb_search_word(EB_Book *book, const char *input_word)
 	context->compare_group  = eb_match_word_kana_group;
     }
 
-    /*
-     * Pre-search.
-     */
-    error_code = eb_presearch_word(book, context);
-    if (error_code != EB_SUCCESS)
-	goto failed;
-
-    LOG(("out: eb_search_word() = %s", eb_error_string(EB_SUCCESS)));
-    eb_unlock(&book->lock);
-
     return EB_SUCCESS;
-
-    /*
-     * An error occurs...
-     */
-  failed:
-    eb_reset_search_contexts(book);
-    LOG(("out: eb_search_word() = %s", eb_error_string(error_code)));
-    eb_unlock(&book->lock);
-    return error_code;
 }
@@ -0,0 +1,804 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "build-pre.h"
+#include "eb.h"
+#include "error.h"
+#include "build-post.h"
+
+/*
+ * Page-ID macros.
+ */
+#define PAGE_ID_IS_LEAF_LAYER(page_id)		(((page_id) & 0x80) == 0x80)
+#define PAGE_ID_IS_LAYER_END(page_id)		(((page_id) & 0x20) == 0x20)
+#define PAGE_ID_HAVE_GROUP_ENTRY(page_id)	(((page_id) & 0x10) == 0x10)
+
+/*
+ * Initial sizes of the entry arrays and the key arena of a word index.
+ */
+#define EB_WORD_INDEX_INITIAL_ENTRIES	1024
+#define EB_WORD_INDEX_INITIAL_KEYS	16384
+
+/*
+ * Unexported functions.
+ */
+static EB_Error_Code eb_load_word_index(EB_Book *book, EB_Search *search);
+static EB_Error_Code eb_read_word_index_page(EB_Book *book, int page,
+    char *page_buffer);
+static int eb_add_word_index_entry(EB_Word_Index *word_index,
+    int *entry_capacity, int *key_capacity, int entry_type, const char *key,
+    int key_length, const char *positions);
+static void eb_free_word_index(EB_Word_Index *word_index);
+static int eb_compare_word_index_entry(EB_Search_Context *context,
+    EB_Word_Index *word_index, int entry_index);
+
+/*
+ * Whether eb_set_subbook() loads word indexes of a subbook.
+ */
+int eb_word_index_preload = 0;
+
+
+/*
+ * Make eb_set_subbook() load word indexes of every subbook it sets,
+ * as eb_load_word_indexes() does.  It should be called before books
+ * are used.
+ */
+void
+eb_set_word_index_preload(int preload)
+{
+    eb_word_index_preload = preload;
+}
+
+
+/*
+ * Decode the word and endword indexes of the current subbook into
+ * memory.  Subsequent exactword, word and endword searches look up the
+ * decoded entries instead of reading index pages from the text file.
+ * Indexes stay loaded until the book is finalized.
+ */
+EB_Error_Code
+eb_load_word_indexes(EB_Book *book)
+{
+    EB_Error_Code error_code;
+    EB_Subbook *subbook;
+
+    eb_lock(&book->lock);
+    LOG(("in: eb_load_word_indexes(book=%d)", (int)book->code));
+
+    /*
+     * Current subbook must have been set.
+     */
+    subbook = book->subbook_current;
+    if (subbook == NULL) {
+	error_code = EB_ERR_NO_CUR_SUB;
+	goto failed;
+    }
+
+    error_code = eb_load_word_index(book, &subbook->word_alphabet);
+    if (error_code != EB_SUCCESS)
+	goto failed;
+    error_code = eb_load_word_index(book, &subbook->word_asis);
+    if (error_code != EB_SUCCESS)
+	goto failed;
+    error_code = eb_load_word_index(book, &subbook->word_kana);
+    if (error_code != EB_SUCCESS)
+	goto failed;
+    error_code = eb_load_word_index(book, &subbook->endword_alphabet);
+    if (error_code != EB_SUCCESS)
+	goto failed;
+    error_code = eb_load_word_index(book, &subbook->endword_asis);
+    if (error_code != EB_SUCCESS)
+	goto failed;
+    error_code = eb_load_word_index(book, &subbook->endword_kana);
+    if (error_code != EB_SUCCESS)
+	goto failed;
+
+    LOG(("out: eb_load_word_indexes() = %s", eb_error_string(EB_SUCCESS)));
+    eb_unlock(&book->lock);
+
+    return EB_SUCCESS;
+
+    /*
+     * An error occurs...
+     */
+  failed:
+    LOG(("out: eb_load_word_indexes() = %s", eb_error_string(error_code)));
+    eb_unlock(&book->lock);
+    return error_code;
+}
+
+
+/*
+ * Decode leaf pages of the index `search' into memory.
+ * It is not an error if the subbook doesn't have the index.
+ */
+static EB_Error_Code
+eb_load_word_index(EB_Book *book, EB_Search *search)
+{
+    EB_Error_Code error_code;
+    EB_Word_Index *word_index = NULL;
+    char page_buffer[EB_SIZE_PAGE];
+    char *page_p;
+    int entry_capacity = 0;
+    int key_capacity = 0;
+    int page;
+    int page_id;
+    int entry_length;
+    int entry_count;
+    int entry_index;
+    int index_depth;
+    int key_length;
+    int group_id;
+    int offset;
+    int result;
+
+    LOG(("in: eb_load_word_index(book=%d, start_page=%d)", (int)book->code,
+	search->start_page));
+
+    if (search->start_page == 0 || search->word_index != NULL)
+	goto succeeded;
+
+    word_index = (EB_Word_Index *)malloc(sizeof(EB_Word_Index));
+    if (word_index == NULL) {
+	error_code = EB_ERR_MEMORY_EXHAUSTED;
+	goto failed;
+    }
+    word_index->entry_count = 0;
+    word_index->keys = NULL;
+    word_index->key_offsets = NULL;
+    word_index->entry_types = NULL;
+    word_index->hits = NULL;
+    word_index->heads = NULL;
+    word_index->head_count = 0;
+
+    /*
+     * Descend the first entries of intermediate indexes to reach the
+     * first leaf page.
+     */
+    page = search->start_page;
+    for (index_depth = 0; index_depth < EB_MAX_INDEX_DEPTH; index_depth++) {
+	error_code = eb_read_word_index_page(book, page, page_buffer);
+	if (error_code != EB_SUCCESS)
+	    goto failed;
+
+	page_id = eb_uint1(page_buffer);
+	if (PAGE_ID_IS_LEAF_LAYER(page_id))
+	    break;
+
+	entry_length = eb_uint1(page_buffer + 1);
+	entry_count = eb_uint2(page_buffer + 2);
+	if (entry_count == 0)
+	    goto loaded;
+	if (EB_SIZE_PAGE < 4 + entry_length + 4) {
+	    error_code = EB_ERR_UNEXP_TEXT;
+	    goto failed;
+	}
+	page = eb_uint4(page_buffer + 4 + entry_length);
+    }
+
+    if (index_depth == EB_MAX_INDEX_DEPTH) {
+	error_code = EB_ERR_UNEXP_TEXT;
+	goto failed;
+    }
+
+    /*
+     * Decode leaf pages up to the end of the leaf layer.
+     */
+    for (;;) {
+	page_id = eb_uint1(page_buffer);
+	entry_length = eb_uint1(page_buffer + 1);
+	entry_count = eb_uint2(page_buffer + 2);
+	offset = 4;
+
+	LOG(("aux: eb_load_word_index(page=%d, page_id=0x%02x, \
+entry_length=%d, entry_count=%d)", page, page_id, entry_length, entry_count));
+
+	if (!PAGE_ID_IS_LEAF_LAYER(page_id)) {
+	    error_code = EB_ERR_UNEXP_TEXT;
+	    goto failed;
+	}
+
+	for (entry_index = 0; entry_index < entry_count; entry_index++) {
+	    page_p = page_buffer + offset;
+
+	    if (!PAGE_ID_HAVE_GROUP_ENTRY(page_id) && entry_length != 0) {
+		/*
+		 * Fixed length entry.
+		 */
+		if (EB_SIZE_PAGE < offset + entry_length + 12) {
+		    error_code = EB_ERR_UNEXP_TEXT;
+		    goto failed;
+		}
+		result = eb_add_word_index_entry(word_index, &entry_capacity,
+		    &key_capacity, EB_WORD_INDEX_ENTRY_PLAIN, page_p,
+		    entry_length, page_p + entry_length);
+		offset += entry_length + 12;
+
+	    } else if (!PAGE_ID_HAVE_GROUP_ENTRY(page_id)) {
+		/*
+		 * Variable length entry.
+		 */
+		if (EB_SIZE_PAGE < offset + 1) {
+		    error_code = EB_ERR_UNEXP_TEXT;
+		    goto failed;
+		}
+		key_length = eb_uint1(page_p);
+		if (EB_SIZE_PAGE < offset + key_length + 13) {
+		    error_code = EB_ERR_UNEXP_TEXT;
+		    goto failed;
+		}
+		result = eb_add_word_index_entry(word_index, &entry_capacity,
+		    &key_capacity, EB_WORD_INDEX_ENTRY_PLAIN, page_p + 1,
+		    key_length, page_p + 1 + key_length);
+		offset += key_length + 13;
+
+	    } else {
+		if (EB_SIZE_PAGE < offset + 2) {
+		    error_code = EB_ERR_UNEXP_TEXT;
+		    goto failed;
+		}
+		group_id = eb_uint1(page_p);
+		key_length = eb_uint1(page_p + 1);
+
+		if (group_id == 0x00) {
+		    /*
+		     * 0x00 -- Single entry.
+		     */
+		    if (EB_SIZE_PAGE < offset + key_length + 14) {
+			error_code = EB_ERR_UNEXP_TEXT;
+			goto failed;
+		    }
+		    result = eb_add_word_index_entry(word_index,
+			&entry_capacity, &key_capacity,
+			EB_WORD_INDEX_ENTRY_SINGLE, page_p + 2, key_length,
+			page_p + 2 + key_length);
+		    offset += key_length + 14;
+
+		} else if (group_id == 0x80) {
+		    /*
+		     * 0x80 -- Start of group entry.
+		     */
+		    if (EB_SIZE_PAGE < offset + key_length + 4) {
+			error_code = EB_ERR_UNEXP_TEXT;
+			goto failed;
+		    }
+		    result = eb_add_word_index_entry(word_index,
+			&entry_capacity, &key_capacity,
+			EB_WORD_INDEX_ENTRY_GROUP, page_p + 4, key_length,
+			NULL);
+		    offset += key_length + 4;
+
+		} else if (group_id == 0xc0) {
+		    /*
+		     * 0xc0 -- Element of the group entry.
+		     */
+		    if (EB_SIZE_PAGE < offset + key_length + 14) {
+			error_code = EB_ERR_UNEXP_TEXT;
+			goto failed;
+		    }
+		    result = eb_add_word_index_entry(word_index,
+			&entry_capacity, &key_capacity,
+			EB_WORD_INDEX_ENTRY_ELEMENT, page_p + 2, key_length,
+			page_p + 2 + key_length);
+		    offset += key_length + 14;
+
+		} else {
+		    error_code = EB_ERR_UNEXP_TEXT;
+		    goto failed;
+		}
+	    }
+
+	    if (result < 0) {
+		error_code = EB_ERR_MEMORY_EXHAUSTED;
+		goto failed;
+	    }
+	}
+
+	if (PAGE_ID_IS_LAYER_END(page_id))
+	    break;
+
+	page++;
+	error_code = eb_read_word_index_page(book, page, page_buffer);
+	if (error_code != EB_SUCCESS)
+	    goto failed;
+    }
+
+  loaded:
+    search->word_index = word_index;
+
+  succeeded:
+    LOG(("out: eb_load_word_index(entry_count=%d) = %s",
+	(search->word_index != NULL) ? search->word_index->entry_count : 0,
+	eb_error_string(EB_SUCCESS)));
+    return EB_SUCCESS;
+
+    /*
+     * An error occurs...
+     */
+  failed:
+    if (word_index != NULL)
+	eb_free_word_index(word_index);
+    LOG(("out: eb_load_word_index() = %s", eb_error_string(error_code)));
+    return error_code;
+}
+
+
+/*
+ * Read the index page `page' of the current subbook into `page_buffer'.
+ */
+static EB_Error_Code
+eb_read_word_index_page(EB_Book *book, int page, char *page_buffer)
+{
+    if (zio_lseek(&book->subbook_current->text_zio,
+	((off_t) page - 1) * EB_SIZE_PAGE, SEEK_SET) < 0)
+	return EB_ERR_FAIL_SEEK_TEXT;
+    if (zio_read(&book->subbook_current->text_zio, page_buffer,
+	EB_SIZE_PAGE) != EB_SIZE_PAGE)
+	return EB_ERR_FAIL_READ_TEXT;
+
+    return EB_SUCCESS;
+}
+
+
+/*
+ * Append an entry to `word_index', growing its arrays as needed.
+ * `positions' points to the text and heading positions of the entry
+ * as they are stored in an index page, or is NULL for the start of a
+ * group entry.
+ * If succeeded, 0 is returned.  Otherwise -1 is returned.
+ */
+static int
+eb_add_word_index_entry(EB_Word_Index *word_index, int *entry_capacity,
+    int *key_capacity, int entry_type, const char *key, int key_length,
+    const char *positions)
+{
+    EB_Hit *hit;
+    void *new_array;
+    int key_offset;
+    int new_capacity;
+
+    if (*entry_capacity <= word_index->entry_count + 1) {
+	new_capacity = (*entry_capacity == 0)
+	    ? EB_WORD_INDEX_INITIAL_ENTRIES : *entry_capacity * 2;
+
+	new_array = realloc(word_index->key_offsets,
+	    sizeof(int) * new_capacity);
+	if (new_array == NULL)
+	    return -1;
+	word_index->key_offsets = (int *)new_array;
+	if (*entry_capacity == 0)
+	    word_index->key_offsets[0] = 0;
+
+	new_array = realloc(word_index->entry_types, new_capacity);
+	if (new_array == NULL)
+	    return -1;
+	word_index->entry_types = (unsigned char *)new_array;
+
+	new_array = realloc(word_index->hits, sizeof(EB_Hit) * new_capacity);
+	if (new_array == NULL)
+	    return -1;
+	word_index->hits = (EB_Hit *)new_array;
+
+	new_array = realloc(word_index->heads, sizeof(int) * new_capacity);
+	if (new_array == NULL)
+	    return -1;
+	word_index->heads = (int *)new_array;
+
+	*entry_capacity = new_capacity;
+    }
+
+    key_offset = word_index->key_offsets[word_index->entry_count];
+    if (*key_capacity < key_offset + key_length) {
+	new_capacity = (*key_capacity == 0)
+	    ? EB_WORD_INDEX_INITIAL_KEYS : *key_capacity * 2;
+	while (new_capacity < key_offset + key_length)
+	    new_capacity *= 2;
+	new_array = realloc(word_index->keys, new_capacity);
+	if (new_array == NULL)
+	    return -1;
+	word_index->keys = (char *)new_array;
+	*key_capacity = new_capacity;
+    }
+    memcpy(word_index->keys + key_offset, key, key_length);
+
+    hit = word_index->hits + word_index->entry_count;
+    if (positions != NULL) {
+	hit->text.page = eb_uint4(positions);
+	hit->text.offset = eb_uint2(positions + 4);
+	hit->heading.page = eb_uint4(positions + 6);
+	hit->heading.offset = eb_uint2(positions + 10);
+    } else {
+	hit->text.page = 0;
+	hit->text.offset = 0;
+	hit->heading.page = 0;
+	hit->heading.offset = 0;
+    }
+
+    if (entry_type != EB_WORD_INDEX_ENTRY_ELEMENT)
+	word_index->heads[word_index->head_count++] = word_index->entry_count;
+    word_index->entry_types[word_index->entry_count] = entry_type;
+    word_index->entry_count++;
+    word_index->key_offsets[word_index->entry_count] = key_offset + key_length;
+
+    return 0;
+}
+
+
+/*
+ * Free the in-memory index `word_index'.
+ */
+static void
+eb_free_word_index(EB_Word_Index *word_index)
+{
+    if (word_index->keys != NULL)
+	free(word_index->keys);
+    if (word_index->key_offsets != NULL)
+	free(word_index->key_offsets);
+    if (word_index->entry_types != NULL)
+	free(word_index->entry_types);
+    if (word_index->hits != NULL)
+	free(word_index->hits);
+    if (word_index->heads != NULL)
+	free(word_index->heads);
+    free(word_index);
+}
+
+
+/*
+ * Free the in-memory index of `search', if it has been loaded.
+ */
+void
+eb_finalize_word_index(EB_Search *search)
+{
+    if (search->word_index != NULL) {
+	eb_free_word_index(search->word_index);
+	search->word_index = NULL;
+    }
+}
+
+
+/*
+ * Return the in-memory index to be searched for `context', or NULL if
+ * the index of the context has not been loaded.
+ */
+EB_Word_Index *
+eb_word_index_of_context(EB_Book *book, EB_Search_Context *context)
+{
+    EB_Subbook *subbook = book->subbook_current;
+
+    if (context->code != EB_SEARCH_EXACTWORD
+	&& context->code != EB_SEARCH_WORD
+	&& context->code != EB_SEARCH_ENDWORD)
+	return NULL;
+
+    if (context->page == subbook->word_alphabet.start_page)
+	return subbook->word_alphabet.word_index;
+    if (context->page == subbook->word_asis.start_page)
+	return subbook->word_asis.word_index;
+    if (context->page == subbook->word_kana.start_page)
+	return subbook->word_kana.word_index;
+    if (context->page == subbook->endword_alphabet.start_page)
+	return subbook->endword_alphabet.word_index;
+    if (context->page == subbook->endword_asis.start_page)
+	return subbook->endword_asis.word_index;
+    if (context->page == subbook->endword_kana.start_page)
+	return subbook->endword_kana.word_index;
+
+    return NULL;
+}
+
+
+/*
+ * Compare the word of `context' with the key of the entry `entry_index'
+ * the same way as eb_hit_list_word() does for an index page.
+ */
+static int
+eb_compare_word_index_entry(EB_Search_Context *context,
+    EB_Word_Index *word_index, int entry_index)
+{
+    const char *key;
+    size_t key_length;
+
+    key = word_index->keys + word_index->key_offsets[entry_index];
+    key_length = word_index->key_offsets[entry_index + 1]
+	- word_index->key_offsets[entry_index];
+
+    switch (word_index->entry_types[entry_index]) {
+    case EB_WORD_INDEX_ENTRY_PLAIN:
+	return context->compare_single(context->word, key, key_length);
+    case EB_WORD_INDEX_ENTRY_SINGLE:
+    case EB_WORD_INDEX_ENTRY_GROUP:
+	return context->compare_single(context->canonicalized_word, key,
+	    key_length);
+    default:
+	return context->compare_group(context->word, key, key_length);
+    }
+}
+
+
+/*
+ * In-memory counterpart of eb_presearch_word().
+ * Find the first entry which is not less than the word by binary search
+ * and start the search there.
+ */
+void
+eb_presearch_word_index(EB_Search_Context *context,
+    EB_Word_Index *word_index)
+{
+    int low;
+    int high;
+    int middle;
+
+    LOG(("in: eb_presearch_word_index(entry_count=%d)",
+	word_index->entry_count));
+
+    low = 0;
+    high = word_index->head_count;
+    while (low < high) {
+	middle = low + (high - low) / 2;
+	if (eb_compare_word_index_entry(context, word_index,
+	    word_index->heads[middle]) > 0)
+	    low = middle + 1;
+	else
+	    high = middle;
+    }
+
+    context->word_index = word_index;
+    if (low < word_index->head_count)
+	context->entry_index = word_index->heads[low];
+    else
+	context->entry_index = word_index->entry_count;
+    context->comparison_result = 1;
+    context->in_group_entry = 0;
+
+    LOG(("out: eb_presearch_word_index(entry_index=%d)",
+	context->entry_index));
+}
+
+
+/*
+ * In-memory counterpart of eb_hit_list_word().
+ * If `entry_list' is not NULL, the index of the entry each hit comes
+ * from is stored in it.
+ */
+void
+eb_hit_list_word_index(EB_Search_Context *context, int max_hit_count,
+    EB_Hit *hit_list, int *entry_list, int *hit_count)
+{
+    EB_Word_Index *word_index = context->word_index;
+    EB_Hit *hit;
+    int entry_type;
+    int result;
+
+    LOG(("in: eb_hit_list_word_index(entry_index=%d, max_hit_count=%d)",
+	context->entry_index, max_hit_count));
+
+    hit = hit_list;
+    *hit_count = 0;
+
+    if (context->comparison_result < 0 || max_hit_count <= 0)
+	goto succeeded;
+
+    while (context->entry_index < word_index->entry_count) {
+	entry_type = word_index->entry_types[context->entry_index];
+
+	if (entry_type == EB_WORD_INDEX_ENTRY_ELEMENT) {
+	    /*
+	     * An element matches only if its group entry has matched.
+	     */
+	    if (context->comparison_result == 0
+		&& context->in_group_entry
+		&& eb_compare_word_index_entry(context, word_index,
+		    context->entry_index) == 0) {
+		*hit = word_index->hits[context->entry_index];
+		hit++;
+		if (entry_list != NULL)
+		    entry_list[*hit_count] = context->entry_index;
+		*hit_count += 1;
+	    }
+	} else {
+	    result = eb_compare_word_index_entry(context, word_index,
+		context->entry_index);
+	    context->comparison_result = result;
+	    context->in_group_entry
+		= (entry_type == EB_WORD_INDEX_ENTRY_GROUP);
+	    if (result == 0 && entry_type != EB_WORD_INDEX_ENTRY_GROUP) {
+		*hit = word_index->hits[context->entry_index];
+		hit++;
+		if (entry_list != NULL)
+		    entry_list[*hit_count] = context->entry_index;
+		*hit_count += 1;
+	    }
+	}
+	context->entry_index++;
+
+	if (context->comparison_result < 0 || max_hit_count <= *hit_count)
+	    goto succeeded;
+    }
+    context->comparison_result = -1;
+
+  succeeded:
+    LOG(("out: eb_hit_list_word_index(hit_count=%d)", *hit_count));
+}
+
+
+/*
+ * Get hit entries of a submitted word search request like eb_hit_list(),
+ * together with the index of the in-memory index entry each hit comes
+ * from and the start page of the index.  They let eb_narrow_word_hits()
+ * narrow the hits down for a longer word later.
+ * It is EB_ERR_NO_SUCH_SEARCH if the request is not a word search or
+ * its index has not been loaded, and the request is left intact then.
+ */
+EB_Error_Code
+eb_hit_list_word_entries(EB_Book *book, int max_hit_count, EB_Hit *hit_list,
+    int *entry_list, int *index_page, int *hit_count)
+{
+    EB_Error_Code error_code;
+    EB_Search_Context *context;
+
+    eb_lock(&book->lock);
+    LOG(("in: eb_hit_list_word_entries(book=%d, max_hit_count=%d)",
+	(int)book->code, max_hit_count));
+
+    *hit_count = 0;
+
+    if (book->subbook_current == NULL) {
+	error_code = EB_ERR_NO_CUR_SUB;
+	goto failed;
+    }
+
+    context = book->search_contexts;
+    if (context->code != EB_SEARCH_WORD || context->word_index == NULL) {
+	error_code = EB_ERR_NO_SUCH_SEARCH;
+	goto failed;
+    }
+
+    eb_hit_list_word_index(context, max_hit_count, hit_list, entry_list,
+	hit_count);
+    *index_page = context->page;
+
+    LOG(("out: eb_hit_list_word_entries(hit_count=%d) = %s", *hit_count,
+	eb_error_string(EB_SUCCESS)));
+    eb_unlock(&book->lock);
+
+    return EB_SUCCESS;
+
+    /*
+     * An error occurs...
+     */
+  failed:
+    LOG(("out: eb_hit_list_word_entries() = %s",
+	eb_error_string(error_code)));
+    eb_unlock(&book->lock);
+    return error_code;
+}
+
+
+/*
+ * Leave in `hit_list' and `entry_list', as returned by
+ * eb_hit_list_word_entries() for the index starting at `index_page',
+ * only the hits a word search for `input_word' would return.  Nothing
+ * is read from the text file.
+ * The result is the same as that of a new search only if the hits are
+ * all the hits of a search for a word `input_word' starts with.  It is
+ * EB_ERR_NO_SUCH_SEARCH if `input_word' is looked up in another index,
+ * and the lists are left intact then.
+ */
+EB_Error_Code
+eb_narrow_word_hits(EB_Book *book, const char *input_word, int index_page,
+    EB_Hit *hit_list, int *entry_list, int *hit_count)
+{
+    EB_Error_Code error_code;
+    EB_Search_Context context;
+    EB_Word_Index *word_index;
+    EB_Word_Code word_code;
+    int entry_index;
+    int group_index;
+    int matched_count;
+    int i;
+
+    eb_lock(&book->lock);
+    LOG(("in: eb_narrow_word_hits(book=%d, input_word=%s, hit_count=%d)",
+	(int)book->code, eb_quoted_string(input_word), *hit_count));
+
+    if (book->subbook_current == NULL) {
+	error_code = EB_ERR_NO_CUR_SUB;
+	goto failed;
+    }
+
+    memset(&context, 0, sizeof(EB_Search_Context));
+    context.code = EB_SEARCH_WORD;
+    error_code = eb_set_word(book, input_word, context.word,
+	context.canonicalized_word, &word_code);
+    if (error_code != EB_SUCCESS)
+	goto failed;
+    error_code = eb_set_word_search_context(book, &context, word_code);
+    if (error_code != EB_SUCCESS)
+	goto failed;
+
+    word_index = eb_word_index_of_context(book, &context);
+    if (context.page != index_page || word_index == NULL) {
+	error_code = EB_ERR_NO_SUCH_SEARCH;
+	goto failed;
+    }
+
+    for (i = 0; i < *hit_count; i++) {
+	if (entry_list[i] < 0 || word_index->entry_count <= entry_list[i]) {
+	    error_code = EB_ERR_NO_SUCH_SEARCH;
+	    goto failed;
+	}
+    }
+
+    /*
+     * Match entries the way eb_hit_list_word_index() does.  An element
+     * matches only if its group entry, the closest entry before it which
+     * is not an element, matches too.
+     */
+    matched_count = 0;
+    for (i = 0; i < *hit_count; i++) {
+	entry_index = entry_list[i];
+	if (word_index->entry_types[entry_index]
+	    == EB_WORD_INDEX_ENTRY_ELEMENT) {
+	    group_index = entry_index - 1;
+	    while (0 <= group_index && word_index->entry_types[group_index]
+		== EB_WORD_INDEX_ENTRY_ELEMENT)
+		group_index--;
+	    if (group_index < 0
+		|| word_index->entry_types[group_index]
+		!= EB_WORD_INDEX_ENTRY_GROUP
+		|| eb_compare_word_index_entry(&context, word_index,
+		    group_index) != 0)
+		continue;
+	} else if (word_index->entry_types[entry_index]
+	    == EB_WORD_INDEX_ENTRY_GROUP) {
+	    continue;
+	}
+
+	if (eb_compare_word_index_entry(&context, word_index, entry_index)
+	    != 0)
+	    continue;
+
+	hit_list[matched_count] = hit_list[i];
+	entry_list[matched_count] = entry_index;
+	matched_count++;
+    }
+    *hit_count = matched_count;
+
+    LOG(("out: eb_narrow_word_hits(hit_count=%d) = %s", *hit_count,
+	eb_error_string(EB_SUCCESS)));
+    eb_unlock(&book->lock);
+
+    return EB_SUCCESS;
+
+    /*
+     * An error occurs...
+     */
+  failed:
+    LOG(("out: eb_narrow_word_hits() = %s", eb_error_string(error_code)));
+    eb_unlock(&book->lock);
+    return error_code;
+}
@@ -32,6 +32,7 @@
 
 #include <stdio.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <errno.h>
 #include <string.h>
 #include <stdlib.h>
@@ -39,6 +40,10 @@
 #include <unistd.h>
 #include <fcntl.h>
 
+#ifdef ENABLE_MMAP
+#include <sys/mman.h>
+#endif
+
 #ifdef ENABLE_PTHREAD
 #include <pthread.h>
 #endif
@@ -127,33 +132,220 @@ extern void eb_log(const char *, ...);
 #define ZIO_SIZE_PAGE			2048
 
 /*
- * Size of a cache buffer.
- * It must be large enough to memory an uncompressed slice.
- *
- * (In EBZIP and EPWING compressions, the size of uncompressed slice
- * is 2048.  In S-EBXA compression, the size is 4096.)
+ * NULL Zio ID.
  */
-#define ZIO_CACHE_BUFFER_SIZE (ZIO_SIZE_PAGE << ZIO_MAX_EBZIP_LEVEL)
+#define ZIO_ID_NONE			-1
 
 /*
- * NULL Zio ID.
+ * The number of bits decoded at once with the decode table of the root
+ * of a Huffman tree, and with tables of its deeper subtrees.
  */
-#define ZIO_ID_NONE			-1
+#define ZIO_HUFFMAN_TABLE_BITS		10
+#define ZIO_HUFFMAN_SUBTABLE_BITS	6
+
+/*
+ * Input of a Huffman decoder.  Bits are consumed from the most
+ * significant bit of `bits'.
+ */
+typedef struct Zio_Bit_Reader_Struct Zio_Bit_Reader;
+
+struct Zio_Bit_Reader_Struct {
+    /*
+     * Compressed data read from the file, and the unread part of it.
+     */
+    unsigned char buffer[ZIO_SIZE_PAGE];
+    unsigned char *buffer_p;
+    unsigned char *buffer_end;
+
+    /*
+     * Whether the end of the file (or an error) has been met.
+     */
+    int eof;
+
+    /*
+     * Bit buffer, and the number of valid bits in it.  Bits below the
+     * valid ones are zero.
+     */
+    unsigned long long bits;
+    int bit_count;
+};
+
+/*
+ * Width of `bits' in Zio_Bit_Reader.
+ */
+#define ZIO_BIT_BUFFER_WIDTH	((int) sizeof(unsigned long long) * 8)
+
+/*
+ * An uncompressed slice held in the slice cache.
+ */
+typedef struct Zio_Cache_Entry_Struct Zio_Cache_Entry;
+
+struct Zio_Cache_Entry_Struct {
+    /*
+     * ID of the zio the slice belongs to.
+     */
+    int zio_id;
+
+    /*
+     * Offset of the beginning of the slice in the uncompressed file.
+     */
+    off_t location;
+
+    /*
+     * Size of `buffer'.  (2048 << level in EBZIP compression, 2048 in
+     * EPWING compressions and 4096 in S-EBXA compression.)
+     */
+    size_t size;
+
+    /*
+     * Uncompressed data.
+     */
+    char *buffer;
+
+    /*
+     * Whether the slice has been uncompressed by a prefetch worker and
+     * not read yet.
+     */
+    int prefetched;
+
+    /*
+     * Next entry in the same hash bucket.
+     */
+    Zio_Cache_Entry *hash_next;
+
+    /*
+     * Neighbours in the LRU list.
+     */
+    Zio_Cache_Entry *lru_prev;
+    Zio_Cache_Entry *lru_next;
+};
+
+/*
+ * Default size of the slice cache.
+ */
+#define ZIO_DEFAULT_CACHE_SIZE		(8 * 1024 * 1024)
+
+/*
+ * The number of independently locked shards of the slice cache.  It
+ * must be a power of two.
+ */
+#define ZIO_CACHE_SHARD_COUNT		16
+
+/*
+ * The minimum number of hash buckets in a shard of the slice cache.
+ */
+#define ZIO_MIN_CACHE_BUCKETS		64
+
+/*
+ * A shard of the slice cache.  Slices are spread over shards by their
+ * hash, so that threads reading different books rarely wait for each
+ * other.
+ */
+typedef struct Zio_Cache_Shard_Struct Zio_Cache_Shard;
+
+struct Zio_Cache_Shard_Struct {
+    /*
+     * The maximum and the current number of bytes held by the shard.
+     * At least one slice is always kept, even if it exceeds the limit.
+     */
+    size_t size_limit;
+    size_t size;
+
+    /*
+     * Hash table of cached slices keyed by zio ID and slice location.
+     * The number of buckets is a power of two.
+     */
+    Zio_Cache_Entry **buckets;
+    size_t bucket_count;
+
+    /*
+     * Cached slices ordered from the most to the least recently used.
+     */
+    Zio_Cache_Entry *lru_head;
+    Zio_Cache_Entry *lru_tail;
+
+    /*
+     * The number of reads served from the shard and the number of
+     * slices uncompressed into it.
+     */
+    unsigned long hits;
+    unsigned long misses;
+
+    /*
+     * The number of prefetched slices read from the shard.
+     */
+    unsigned long prefetch_used;
+
+    /*
+     * Mutex for the shard.
+     */
+#ifdef ENABLE_PTHREAD
+    pthread_mutex_t mutex;
+#endif
+};
+
+/*
+ * The maximum number of bytes held by the slice cache.  The limit is
+ * split evenly between shards.
+ */
+static size_t cache_size_limit = ZIO_DEFAULT_CACHE_SIZE;
+
+/*
+ * Shards of the slice cache, and whether they have been initialized.
+ */
+static Zio_Cache_Shard cache_shards[ZIO_CACHE_SHARD_COUNT];
+static int cache_initialized = 0;
 
 /*
- * Buffer for caching uncompressed data.
+ * The number of Huffman trees kept for reuse after all zios using them
+ * have been closed.
  */
-static char *cache_buffer = NULL;
+#define ZIO_MAX_UNUSED_HUFFMAN_TREES	8
+
+/*
+ * A Huffman tree with its decode tables, made for an EPWING compression
+ * file.  Zios opening the same file share one tree, so that the tree is
+ * not made again when a book or subbook is reopened.
+ */
+struct Zio_Huffman_Tree_Struct {
+    /*
+     * The file the tree was made for.
+     */
+    dev_t device;
+    ino_t inode;
+    off_t size;
+    time_t mtime;
+    Zio_Code code;
+    off_t frequencies_location;
+    size_t frequencies_length;
+
+    /*
+     * Nodes, the root node and decode tables of the tree.
+     */
+    Zio_Huffman_Node *nodes;
+    Zio_Huffman_Node *root;
+    Zio_Huffman_Entry *tables;
+
+    /*
+     * The number of zios using the tree.
+     */
+    int reference_count;
+
+    /*
+     * Next tree in the list.
+     */
+    Zio_Huffman_Tree *next;
+};
 
 /*
- * Zio ID which caches data in `cache_buffer'.
+ * Huffman trees, the most recently used first.
  */
-static int cache_zio_id = ZIO_ID_NONE;
+static Zio_Huffman_Tree *huffman_trees = NULL;
 
 /*
- * Offset of the beginning of the cached data `cache_buffer'.
+ * Whether local files are mapped into memory when they are opened.
  */
-static off_t cache_location;
+static int mmap_enabled = 0;
 
 /*
  * Zio object counter.
@@ -161,12 +353,79 @@ static off_t cache_location;
 static int zio_counter = 0;
 
 /*
- * Mutex for cache variables.
+ * Mutex for `zio_counter', `cache_size_limit', `huffman_trees' and
+ * `mmap_enabled'.
+ * Slices are guarded by mutexes of their shards, and a zio itself must
+ * be guarded by its owner.
  */
 #ifdef ENABLE_PTHREAD
 static pthread_mutex_t zio_mutex = PTHREAD_MUTEX_INITIALIZER;
 #endif
 
+/*
+ * The maximum number of slices prefetched ahead of a sequential read,
+ * and the maximum number of slices waiting for prefetch workers.
+ */
+#define ZIO_MAX_PREFETCH_SLICES		64
+#define ZIO_MAX_PREFETCH_JOBS		256
+
+#ifdef ENABLE_PTHREAD
+/*
+ * A compressed EBZIP slice to be uncompressed by a prefetch worker.
+ */
+typedef struct Zio_Prefetch_Job_Struct Zio_Prefetch_Job;
+
+struct Zio_Prefetch_Job_Struct {
+    /*
+     * ID of the zio the slice belongs to, and offset of the beginning
+     * of the slice in the uncompressed file.
+     */
+    int zio_id;
+    off_t location;
+
+    /*
+     * Size of the uncompressed slice, and the compressed slice itself.
+     */
+    size_t slice_size;
+    size_t zipped_slice_size;
+    char *zipped_buffer;
+
+    /*
+     * Whether a worker is uncompressing the slice.
+     */
+    int running;
+
+    /*
+     * Next job in the list.
+     */
+    Zio_Prefetch_Job *next;
+};
+
+/*
+ * Prefetch workers, their jobs in the order they have been queued, and
+ * the number of slices queued and the number of slices taken over by
+ * readers before a worker started on them.  Running jobs stay in the
+ * list, so that readers of the same slice can wait for them.
+ * All of them are guarded by `prefetch_mutex'.
+ */
+static pthread_t *prefetch_threads = NULL;
+static int prefetch_thread_count = 0;
+static int prefetch_slice_count = 0;
+static int prefetch_quit = 0;
+static Zio_Prefetch_Job *prefetch_jobs = NULL;
+static int prefetch_job_count = 0;
+static unsigned long prefetch_issued = 0;
+static unsigned long prefetch_taken = 0;
+
+static pthread_mutex_t prefetch_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Signaled when a job is queued, and when a job is finished.
+ */
+static pthread_cond_t prefetch_queued = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t prefetch_finished = PTHREAD_COND_INITIALIZER;
+#endif /* ENABLE_PTHREAD */
+
 /*
  * Test whether `off_t' represents a large integer.
  */
@@ -182,11 +441,48 @@ static int zio_open_ebzip(Zio *zio, const char *file_name);
 static int zio_open_epwing(Zio *zio, const char *file_name);
 static int zio_open_epwing6(Zio *zio, const char *file_name);
 static int zio_make_epwing_huffman_tree(Zio *zio, int leaf_count);
+static int zio_huffman_tournament_winner(Zio_Huffman_Node *nodes, int left,
+    int right);
+static void zio_update_huffman_tournament(Zio_Huffman_Node *nodes,
+    int *tournament, int width, int index);
+static void zio_push_huffman_heap(Zio_Huffman_Node *nodes, int *heap,
+    int *heap_count, int index);
+static int zio_pop_huffman_heap(Zio_Huffman_Node *nodes, int *heap,
+    int *heap_count);
+static int zio_make_epwing_huffman_tables(Zio *zio);
+static int zio_attach_huffman_tree(Zio *zio);
+static void zio_register_huffman_tree(Zio *zio);
+static void zio_release_huffman_tree(Zio *zio);
+static int zio_match_huffman_tree(Zio *zio, const struct stat *status,
+    Zio_Huffman_Tree *tree);
+static void zio_trim_huffman_trees(void);
+static int zio_huffman_tree_height(Zio_Huffman_Node *node);
+static int zio_make_huffman_table(Zio_Huffman_Node *node, int table_bits,
+    Zio_Huffman_Entry *entries, size_t *used);
+static int zio_fill_huffman_table(Zio_Huffman_Entry *table, int table_bits,
+    Zio_Huffman_Node *node, int depth, unsigned int code,
+    Zio_Huffman_Entry *entries, size_t *used);
+static void zio_initialize_bit_reader(Zio_Bit_Reader *reader);
+static void zio_fill_bit_reader(Zio *zio, Zio_Bit_Reader *reader);
+static Zio_Huffman_Node *zio_decode_huffman(Zio *zio,
+    Zio_Bit_Reader *reader);
 static ssize_t zio_read_ebzip(Zio *zio, char *buffer, size_t length);
+static off_t zio_ebzip_index_entry(Zio *zio, const char *index_p);
+static void zio_prefetch_ebzip(Zio *zio, off_t location);
+static int zio_read_prefetched_ebzip(Zio *zio, off_t location,
+    size_t offset, char *buffer, size_t length);
+static void zio_cancel_prefetch(int zio_id);
+#ifdef ENABLE_PTHREAD
+static void *zio_prefetch_worker(void *argument);
+static void zio_stop_prefetch_workers(void);
+static void zio_unlink_prefetch_job(Zio_Prefetch_Job *job);
+#endif
 static ssize_t zio_read_epwing(Zio *zio, char *buffer, size_t length);
 static ssize_t zio_read_sebxa(Zio *zio, char *buffer, size_t length);
 static int zio_unzip_slice_ebzip1(Zio *zio, char *out_buffer,
     size_t zipped_slice_size);
+static int zio_inflate_slice_ebzip1(const char *in_buffer,
+    size_t zipped_slice_size, char *out_buffer, size_t slice_size);
 static int zio_unzip_slice_epwing(Zio *zio, char *out_buffer);
 static int zio_unzip_slice_epwing6(Zio *zio, char *out_buffer);
 static int zio_unzip_slice_sebxa(Zio *zio, char *out_buffer);
@@ -194,24 +490,68 @@ static int zio_open_raw(Zio *zio, const char *file_name);
 static void zio_close_raw(Zio *zio);
 static off_t zio_lseek_raw(Zio *zio, off_t offset, int whence);
 static ssize_t zio_read_raw(Zio *zio, void *buffer, size_t length);
+static const char *zio_map_raw(Zio *zio, size_t length);
+static size_t zio_cache_hash(int zio_id, off_t location);
+static int zio_cache_resize_buckets(Zio_Cache_Shard *shard);
+static Zio_Cache_Entry *zio_cache_find(Zio_Cache_Shard *shard, size_t hash,
+    int zio_id, off_t location);
+static int zio_cache_contains(int zio_id, off_t location);
+static int zio_cache_read(int zio_id, off_t location, size_t offset,
+    char *buffer, size_t length);
+static Zio_Cache_Entry *zio_cache_allocate(size_t size);
+static void zio_cache_insert(Zio_Cache_Entry *entry, int zio_id,
+    off_t location);
+static void zio_cache_remove(Zio_Cache_Shard *shard,
+    Zio_Cache_Entry *entry);
+static void zio_cache_evict(Zio_Cache_Shard *shard, size_t size_limit);
+static void zio_cache_purge(int zio_id);
 
 
 /*
- * Initialize cache buffer.
+ * Initialize the slice cache.
  */
 int
 zio_initialize_library(void)
 {
+    Zio_Cache_Shard *shard;
+    int i;
+
     pthread_mutex_lock(&zio_mutex);
     LOG(("in: zio_initialize_library()"));
 
     /*
-     * Allocate memory for cache buffer.
+     * Initialize shards of the slice cache.
+     */
+    if (!cache_initialized) {
+	for (i = 0, shard = cache_shards; i < ZIO_CACHE_SHARD_COUNT;
+	     i++, shard++) {
+	    shard->size = 0;
+	    shard->buckets = NULL;
+	    shard->bucket_count = 0;
+	    shard->lru_head = NULL;
+	    shard->lru_tail = NULL;
+	    shard->hits = 0;
+	    shard->misses = 0;
+	    shard->prefetch_used = 0;
+#ifdef ENABLE_PTHREAD
+	    pthread_mutex_init(&shard->mutex, NULL);
+#endif
+	}
+	cache_initialized = 1;
+    }
+
+    /*
+     * Allocate hash buckets of the slice cache.
      */
-    if (cache_buffer == NULL) {
-	cache_buffer = (char *) malloc(ZIO_CACHE_BUFFER_SIZE);
-	if (cache_buffer == NULL)
+    for (i = 0, shard = cache_shards; i < ZIO_CACHE_SHARD_COUNT;
+	 i++, shard++) {
+	pthread_mutex_lock(&shard->mutex);
+	shard->size_limit = cache_size_limit / ZIO_CACHE_SHARD_COUNT;
+	if (shard->buckets == NULL && zio_cache_resize_buckets(shard) < 0) {
+	    pthread_mutex_unlock(&shard->mutex);
 	    goto failed;
+	}
+	pthread_mutex_unlock(&shard->mutex);
     }
 
     LOG(("out: zio_initialize_library() = %d", 0));
@@ -229,24 +569,236 @@ zio_initialize_library(void)
 
 
 /*
- * Clear cache buffer.
+ * Clear the slice cache.
  */
 void
 zio_finalize_library(void)
 {
+    Zio_Cache_Shard *shard;
+    Zio_Huffman_Tree **tree_p;
+    Zio_Huffman_Tree *tree;
+    int i;
+
+#ifdef ENABLE_PTHREAD
+    zio_stop_prefetch_workers();
+#endif
+
     pthread_mutex_lock(&zio_mutex);
     LOG(("in: zio_finalize_library()"));
 
-    if (cache_buffer != NULL)
-	free(cache_buffer);
-    cache_buffer = NULL;
-    cache_zio_id = ZIO_ID_NONE;
+    if (cache_initialized) {
+	for (i = 0, shard = cache_shards; i < ZIO_CACHE_SHARD_COUNT;
+	     i++, shard++) {
+	    pthread_mutex_lock(&shard->mutex);
+	    zio_cache_evict(shard, 0);
+	    if (shard->buckets != NULL)
+		free(shard->buckets);
+	    shard->buckets = NULL;
+	    shard->bucket_count = 0;
+	    pthread_mutex_unlock(&shard->mutex);
+	}
+    }
+
+    /*
+     * Free Huffman trees no longer used.
+     */
+    for (tree_p = &huffman_trees; *tree_p != NULL; ) {
+	tree = *tree_p;
+	if (0 < tree->reference_count) {
+	    tree_p = &tree->next;
+	    continue;
+	}
+	*tree_p = tree->next;
+	free(tree->nodes);
+	free(tree->tables);
+	free(tree);
+    }
 
     LOG(("out: zio_finalize_library()"));
     pthread_mutex_unlock(&zio_mutex);
 }
 
 
+/*
+ * Set the maximum number of bytes held by the slice cache.  Slices
+ * exceeding the new limit are discarded immediately.
+ */
+int
+zio_set_cache_size(size_t size)
+{
+    Zio_Cache_Shard *shard;
+    int i;
+
+    pthread_mutex_lock(&zio_mutex);
+    LOG(("in: zio_set_cache_size(size=%ld)", (long)size));
+
+    cache_size_limit = size;
+    if (!cache_initialized)
+	goto succeeded;
+
+    for (i = 0, shard = cache_shards; i < ZIO_CACHE_SHARD_COUNT;
+	 i++, shard++) {
+	pthread_mutex_lock(&shard->mutex);
+	shard->size_limit = size / ZIO_CACHE_SHARD_COUNT;
+	zio_cache_evict(shard, shard->size_limit);
+	if (shard->buckets != NULL && zio_cache_resize_buckets(shard) < 0) {
+	    pthread_mutex_unlock(&shard->mutex);
+	    goto failed;
+	}
+	pthread_mutex_unlock(&shard->mutex);
+    }
+
+  succeeded:
+    LOG(("out: zio_set_cache_size() = %d", 0));
+    pthread_mutex_unlock(&zio_mutex);
+    return 0;
+
+    /*
+     * An error occurs...
+     */
+  failed:
+    LOG(("out: zio_set_cache_size() = %d", -1));
+    pthread_mutex_unlock(&zio_mutex);
+    return -1;
+}
+
+
+/*
+ * Get the number of hits and misses of the slice cache.
+ */
+void
+zio_cache_statistics(unsigned long *hits, unsigned long *misses)
+{
+    Zio_Cache_Shard *shard;
+    int i;
+
+    *hits = 0;
+    *misses = 0;
+    if (!cache_initialized)
+	return;
+
+    for (i = 0, shard = cache_shards; i < ZIO_CACHE_SHARD_COUNT;
+	 i++, shard++) {
+	pthread_mutex_lock(&shard->mutex);
+	*hits += shard->hits;
+	*misses += shard->misses;
+	pthread_mutex_unlock(&shard->mutex);
+    }
+}
+
+
+/*
+ * Start `thread_count' prefetch workers, which uncompress up to
+ * `slice_count' EBZIP slices ahead of a sequential read into the slice
+ * cache.  Workers started before are stopped first.  If either count
+ * is 0, prefetching is disabled.
+ * If succeeded, 0 is returned.  Otherwise -1 is returned.
+ */
+int
+zio_set_prefetch(int thread_count, int slice_count)
+{
+#ifdef ENABLE_PTHREAD
+    int i;
+
+    LOG(("in: zio_set_prefetch(thread_count=%d, slice_count=%d)",
+	thread_count, slice_count));
+
+    zio_stop_prefetch_workers();
+
+    if (thread_count <= 0 || slice_count <= 0)
+	goto succeeded;
+    if (ZIO_MAX_PREFETCH_SLICES < slice_count)
+	slice_count = ZIO_MAX_PREFETCH_SLICES;
+
+    pthread_mutex_lock(&prefetch_mutex);
+    prefetch_threads = (pthread_t *) malloc(sizeof(pthread_t)
+	* thread_count);
+    if (prefetch_threads == NULL) {
+	pthread_mutex_unlock(&prefetch_mutex);
+	goto failed;
+    }
+    prefetch_quit = 0;
+    for (i = 0; i < thread_count; i++) {
+	if (pthread_create(prefetch_threads + i, NULL, zio_prefetch_worker,
+	    NULL) != 0)
+	    break;
+    }
+    prefetch_thread_count = i;
+    prefetch_slice_count = slice_count;
+    pthread_mutex_unlock(&prefetch_mutex);
+    if (prefetch_thread_count < thread_count) {
+	zio_stop_prefetch_workers();
+	goto failed;
+    }
+
+  succeeded:
+    LOG(("out: zio_set_prefetch() = %d", 0));
+    return 0;
+
+    /*
+     * An error occurs...
+     */
+  failed:
+    LOG(("out: zio_set_prefetch() = %d", -1));
+    return -1;
+#else /* not ENABLE_PTHREAD */
+    if (thread_count <= 0 || slice_count <= 0)
+	return 0;
+    return -1;
+#endif /* not ENABLE_PTHREAD */
+}
+
+
+/*
+ * Get the number of slices queued for prefetch workers, and the number
+ * of them which have been read.
+ */
+void
+zio_prefetch_statistics(unsigned long *issued, unsigned long *used)
+{
+    Zio_Cache_Shard *shard;
+    int i;
+
+    *issued = 0;
+    *used = 0;
+
+#ifdef ENABLE_PTHREAD
+    pthread_mutex_lock(&prefetch_mutex);
+    *issued = prefetch_issued;
+    *used = prefetch_taken;
+    pthread_mutex_unlock(&prefetch_mutex);
+#endif
+
+    if (!cache_initialized)
+	return;
+
+    for (i = 0, shard = cache_shards; i < ZIO_CACHE_SHARD_COUNT;
+	 i++, shard++) {
+	pthread_mutex_lock(&shard->mutex);
+	*used += shard->prefetch_used;
+	pthread_mutex_unlock(&shard->mutex);
+    }
+}
+
+
+/*
+ * Enable or disable mapping of local files into memory.  Mapped files
+ * are read without system calls.  The setting applies to files opened
+ * after the call.
+ */
+void
+zio_set_mmap(int enable)
+{
+    pthread_mutex_lock(&zio_mutex);
+    LOG(("in: zio_set_mmap(enable=%d)", enable));
+
+    mmap_enabled = enable;
+
+    LOG(("out: zio_set_mmap()"));
+    pthread_mutex_unlock(&zio_mutex);
+}
+
+
 /*
  * Initialize `zio'.
  */
@@ -259,9 +811,12 @@ zio_initialize(Zio *zio)
     zio->file = -1;
     zio->huffman_nodes = NULL;
     zio->huffman_root = NULL;
+    zio->huffman_tables = NULL;
+    zio->huffman_tree = NULL;
     zio->code = ZIO_INVALID;
     zio->file_size = 0;
     zio->is_ebnet = 0;
+    zio->mapping = NULL;
 
     LOG(("out: zio_initialize()"));
 }
@@ -276,12 +831,9 @@ zio_finalize(Zio *zio)
     LOG(("in: zio_finalize(zio=%d)", (int)zio->id));
 
     zio_close(zio);
-    if (zio->huffman_nodes != NULL)
-	free(zio->huffman_nodes);
+    zio_release_huffman_tree(zio);
 
     zio->id = -1;
-    zio->huffman_nodes = NULL;
-    zio->huffman_root = NULL;
     zio->code = ZIO_INVALID;
 
     LOG(("out: zio_finalize()"));
@@ -471,6 +1023,8 @@ zio_open_ebzip(Zio *zio, const char *file_name)
     zio->crc = zio_uint4(header + 14);
     zio->mtime = zio_uint4(header + 18);
     zio->location = 0;
+    zio->prefetch_last_location = -1;
+    zio->prefetch_end_location = 0;
 
     if (zio->file_size      < (off_t) 1 << 16)
 	zio->index_width = 2;
@@ -543,6 +1097,8 @@ zio_open_epwing(Zio *zio, const char *file_name)
 
     zio->code = ZIO_EPWING;
     zio->huffman_nodes = NULL;
+    zio->huffman_tables = NULL;
+    zio->huffman_tree = NULL;
 
     /*
      * Open `HONMON2'.
@@ -587,6 +1143,13 @@ zio_open_epwing(Zio *zio, const char *file_name)
     }
     zio->file_size -= ZIO_SIZE_PAGE * (16 - i);
 
+    /*
+     * Use the huffman tree of the same file if it has been made
+     * already.
+     */
+    if (zio_attach_huffman_tree(zio) == 0)
+	goto tree_made;
+
     /*
      * Allocate memory for huffman nodes.
      */
@@ -654,7 +1217,11 @@ zio_open_epwing(Zio *zio, const char *file_name)
      */
     if (zio_make_epwing_huffman_tree(zio, leaf_count) < 0)
 	goto failed;
+    if (zio_make_epwing_huffman_tables(zio) < 0)
+	goto failed;
+    zio_register_huffman_tree(zio);
 
+  tree_made:
     /*
      * Assign ID.
      */
@@ -671,11 +1238,8 @@ zio_open_epwing(Zio *zio, const char *file_name)
   failed:
     if (0 <= zio->file)
 	zio_close_raw(zio);
-    if (zio->huffman_nodes != NULL)
-	free(zio->huffman_nodes);
+    zio_release_huffman_tree(zio);
     zio->file = -1;
-    zio->huffman_nodes = NULL;
-    zio->huffman_root = NULL;
     zio->code = ZIO_INVALID;
 
     LOG(("out: zio_open_epwing() = %d", -1));
@@ -703,6 +1267,8 @@ zio_open_epwing6(Zio *zio, const char *file_name)
 
     zio->code = ZIO_EPWING6;
     zio->huffman_nodes = NULL;
+    zio->huffman_tables = NULL;
+    zio->huffman_tree = NULL;
 
     /*
      * Open `HONMON2'.
@@ -749,6 +1315,13 @@ zio_open_epwing6(Zio *zio, const char *file_name)
     }
     zio->file_size -= ZIO_SIZE_PAGE * (16 - i);
 
+    /*
+     * Use the huffman tree of the same file if it has been made
+     * already.
+     */
+    if (zio_attach_huffman_tree(zio) == 0)
+	goto tree_made;
+
     /*
      * Allocate memory for huffman nodes.
      */
@@ -842,7 +1415,11 @@ zio_open_epwing6(Zio *zio, const char *file_name)
      */
     if (zio_make_epwing_huffman_tree(zio, leaf_count) < 0)
 	goto failed;
+    if (zio_make_epwing_huffman_tables(zio) < 0)
+	goto failed;
+    zio_register_huffman_tree(zio);
 
+  tree_made:
     /*
      * Assign ID.
      */
@@ -859,11 +1436,8 @@ zio_open_epwing6(Zio *zio, const char *file_name)
   failed:
     if (0 <= zio->file)
 	zio_close_raw(zio);
-    if (zio->huffman_nodes != NULL)
-	free(zio->huffman_nodes);
+    zio_release_huffman_tree(zio);
     zio->file = -1;
-    zio->huffman_nodes = NULL;
-    zio->huffman_root = NULL;
     zio->code = ZIO_INVALID;
 
     LOG(("out: zio_open_epwing6() = %d", -1));
@@ -873,56 +1447,86 @@ zio_open_epwing6(Zio *zio, const char *file_name)
 
 /*
  * Make a huffman tree for decompressing EPWING compression data.
+ *
+ * The tree must be exactly the one the data was compressed with, so
+ * ties between nodes of the same frequency are broken as the original
+ * algorithm does: leaf nodes are put in the order a selection sort
+ * (which picks the first most frequent node) leaves them, and the least
+ * frequent node is the last one in `huffman_nodes' among equals.  Both
+ * steps are done in O(n log n) time: the selection sort by a tournament
+ * tree, and the search for least frequent nodes by a binary heap.
  */
 static int
 zio_make_epwing_huffman_tree(Zio *zio, int leaf_count)
 {
-    Zio_Huffman_Node *target_node;
-    Zio_Huffman_Node *most_node;
-    Zio_Huffman_Node *node_p;
+    Zio_Huffman_Node *nodes = zio->huffman_nodes;
     Zio_Huffman_Node temporary_node;
-    Zio_Huffman_Node *least_node_p;
     Zio_Huffman_Node *tail_node_p;
+    int *tournament = NULL;
+    int *heap = NULL;
+    int heap_count;
+    int width;
+    int least;
     int i;
     int j;
 
     LOG(("in: zio_make_epwing_huffman_tree(zio=%d, leaf_count=%d)",
 	(int)zio->id, leaf_count));
 
-    tail_node_p = zio->huffman_nodes + leaf_count;
+    for (width = 1; width < leaf_count; width <<= 1)
+	;
+    tournament = (int *) malloc(sizeof(int) * width * 2);
+    heap = (int *) malloc(sizeof(int) * leaf_count);
+    if (tournament == NULL || heap == NULL)
+	goto failed;
 
     /*
      * Sort the leaf nodes in frequency order.
+     * tournament[1] is the index of the first most frequent node among
+     * nodes not placed yet, and tournament[width + i] is `i' itself, or
+     * -1 after the node at `i' has been placed.
      */
+    for (i = 0; i < width; i++)
+	tournament[width + i] = (i < leaf_count) ? i : -1;
+    for (i = width - 1; 1 <= i; i--) {
+	tournament[i] = zio_huffman_tournament_winner(nodes,
+	    tournament[i * 2], tournament[i * 2 + 1]);
+    }
+
     for (i = 0; i < leaf_count - 1; i++) {
-        target_node = zio->huffman_nodes + i;
-        most_node = target_node;
-        node_p = zio->huffman_nodes + i + 1;
+	j = tournament[1];
 
-        for (j = i + 1; j < leaf_count; j++) {
-            if (most_node->frequency < node_p->frequency)
-                most_node = node_p;
-            node_p++;
-        }
+	temporary_node.type = nodes[j].type;
+	temporary_node.value = nodes[j].value;
+	temporary_node.frequency = nodes[j].frequency;
 
-        temporary_node.type = most_node->type;
-        temporary_node.value = most_node->value;
-        temporary_node.frequency = most_node->frequency;
+	nodes[j].type = nodes[i].type;
+	nodes[j].value = nodes[i].value;
+	nodes[j].frequency = nodes[i].frequency;
 
-        most_node->type = target_node->type;
-        most_node->value = target_node->value;
-        most_node->frequency = target_node->frequency;
+	nodes[i].type = temporary_node.type;
+	nodes[i].value = temporary_node.value;
+	nodes[i].frequency = temporary_node.frequency;
 
-        target_node->type = temporary_node.type;
-        target_node->value = temporary_node.value;
-        target_node->frequency = temporary_node.frequency;
+	tournament[width + i] = -1;
+	zio_update_huffman_tournament(nodes, tournament, width, i);
+	if (j != i)
+	    zio_update_huffman_tournament(nodes, tournament, width, j);
     }
 
     /*
      * Make intermediate nodes of the huffman tree.
      * The number of intermediate nodes of the tree is <the number of
-     * leaf nodes> - 1.
+     * leaf nodes> - 1.  Nodes with frequency 0 are out of the game, as
+     * are nodes which already have a parent.
      */
+    heap_count = 0;
+    for (i = 0; i < leaf_count; i++) {
+	if (nodes[i].frequency != 0)
+	    zio_push_huffman_heap(nodes, heap, &heap_count, i);
+    }
+
+    tail_node_p = nodes + leaf_count;
     for (i = 1; i < leaf_count; i++) {
 	/*
 	 * Initialize a new intermediate node.
@@ -930,43 +1534,32 @@ zio_make_epwing_huffman_tree(Zio *zio, int leaf_count)
 	tail_node_p->type = ZIO_HUFFMAN_NODE_INTERMEDIATE;
 	tail_node_p->left = NULL;
 	tail_node_p->right = NULL;
+	tail_node_p->table = NULL;
+	tail_node_p->table_bits = 0;
 
 	/*
-	 * Find for a least frequent node.
-	 * That node becomes a left child of the new intermediate node.
+	 * The least frequent node becomes a left child of the new
+	 * intermediate node, and the next least frequent node becomes
+	 * a right child.
 	 */
-	least_node_p = NULL;
-	for (node_p = zio->huffman_nodes; node_p < tail_node_p; node_p++) {
-	    if (node_p->frequency == 0)
-		continue;
-	    if (least_node_p == NULL
-		|| node_p->frequency <= least_node_p->frequency)
-		least_node_p = node_p;
-	}
-	if (least_node_p == NULL)
+	least = zio_pop_huffman_heap(nodes, heap, &heap_count);
+	if (least < 0)
 	    goto failed;
-	tail_node_p->left = least_node_p;
-	tail_node_p->frequency = least_node_p->frequency;
-	least_node_p->frequency = 0;
+	tail_node_p->left = nodes + least;
+	tail_node_p->frequency = nodes[least].frequency;
+	nodes[least].frequency = 0;
 
-	/*
-	 * Find for a next least frequent node.
-	 * That node becomes a right child of the new intermediate node.
-	 */
-	least_node_p = NULL;
-	for (node_p = zio->huffman_nodes; node_p < tail_node_p; node_p++) {
-	    if (node_p->frequency == 0)
-		continue;
-	    if (least_node_p == NULL
-		|| node_p->frequency <= least_node_p->frequency)
-		least_node_p = node_p;
-	}
-	if (least_node_p == NULL)
+	least = zio_pop_huffman_heap(nodes, heap, &heap_count);
+	if (least < 0)
 	    goto failed;
-	tail_node_p->right = least_node_p;
-	tail_node_p->frequency += least_node_p->frequency;
-	least_node_p->frequency = 0;
+	tail_node_p->right = nodes + least;
+	tail_node_p->frequency += nodes[least].frequency;
+	nodes[least].frequency = 0;
 
+	if (tail_node_p->frequency != 0) {
+	    zio_push_huffman_heap(nodes, heap, &heap_count,
+		tail_node_p - nodes);
+	}
 	tail_node_p++;
     }
 
@@ -975,6 +1568,8 @@ zio_make_epwing_huffman_tree(Zio *zio, int leaf_count)
      */
     zio->huffman_root = tail_node_p - 1;
 
+    free(tournament);
+    free(heap);
     LOG(("out: zio_make_epwing_huffman_tree() = %d", 0));
     return 0;
 
@@ -982,29 +1577,486 @@ zio_make_epwing_huffman_tree(Zio *zio, int leaf_count)
      * An error occurs...
      */
   failed:
+    if (tournament != NULL)
+	free(tournament);
+    if (heap != NULL)
+	free(heap);
     LOG(("out: zio_make_epwing_huffman_tree() = %d", -1));
     return -1;
 }
 
 
+/*
+ * Return the winner of a match between the leaf nodes `nodes[left]'
+ * and `nodes[right]' in the tournament tree of
+ * zio_make_epwing_huffman_tree(): the more frequent node, or `left'
+ * if they are equally frequent.  -1 stands for no node.
+ */
+static int
+zio_huffman_tournament_winner(Zio_Huffman_Node *nodes, int left, int right)
+{
+    if (right < 0)
+	return left;
+    if (left < 0)
+	return right;
+    if (nodes[left].frequency < nodes[right].frequency)
+	return right;
+    return left;
+}
+
+
+/*
+ * Replay matches of the tournament tree from the leaf node
+ * `nodes[index]' up to the top.
+ */
+static void
+zio_update_huffman_tournament(Zio_Huffman_Node *nodes, int *tournament,
+    int width, int index)
+{
+    int i;
+
+    for (i = (width + index) / 2; 1 <= i; i /= 2) {
+	tournament[i] = zio_huffman_tournament_winner(nodes,
+	    tournament[i * 2], tournament[i * 2 + 1]);
+    }
+}
+
+
+/*
+ * Test whether the node `nodes[a]' is taken before `nodes[b]' when
+ * making the huffman tree: it is less frequent, or it is equally
+ * frequent and comes after `nodes[b]'.
+ */
+#define zio_huffman_heap_before(nodes, a, b) \
+	((nodes)[a].frequency < (nodes)[b].frequency \
+	 || ((nodes)[a].frequency == (nodes)[b].frequency && (b) < (a)))
+
+/*
+ * Add the node `nodes[index]' to the heap.
+ */
+static void
+zio_push_huffman_heap(Zio_Huffman_Node *nodes, int *heap, int *heap_count,
+    int index)
+{
+    int i;
+    int parent;
+
+    i = (*heap_count)++;
+    while (0 < i) {
+	parent = (i - 1) / 2;
+	if (!zio_huffman_heap_before(nodes, index, heap[parent]))
+	    break;
+	heap[i] = heap[parent];
+	i = parent;
+    }
+    heap[i] = index;
+}
+
+
+/*
+ * Remove the node to be taken next from the heap, and return its index.
+ * If the heap is empty, -1 is returned.
+ */
+static int
+zio_pop_huffman_heap(Zio_Huffman_Node *nodes, int *heap, int *heap_count)
+{
+    int top;
+    int last;
+    int child;
+    int i;
+
+    if (*heap_count == 0)
+	return -1;
+
+    top = heap[0];
+    last = heap[--(*heap_count)];
+    i = 0;
+    for (;;) {
+	child = i * 2 + 1;
+	if (*heap_count <= child)
+	    break;
+	if (child + 1 < *heap_count
+	    && zio_huffman_heap_before(nodes, heap[child + 1], heap[child]))
+	    child++;
+	if (!zio_huffman_heap_before(nodes, heap[child], last))
+	    break;
+	heap[i] = heap[child];
+	i = child;
+    }
+    heap[i] = last;
+
+    return top;
+}
+
+
+/*
+ * Make decode tables of the Huffman tree of `zio'.
+ * The root table decodes codes of up to ZIO_HUFFMAN_TABLE_BITS bits in
+ * one lookup.  Longer codes continue in tables of the intermediate
+ * nodes reached after that many bits, and so on.
+ */
+static int
+zio_make_epwing_huffman_tables(Zio *zio)
+{
+    size_t entry_count;
+
+    LOG(("in: zio_make_epwing_huffman_tables(zio=%d)", (int)zio->id));
+
+    /*
+     * Count entries of all tables, and then fill them.
+     */
+    entry_count = 0;
+    if (zio_make_huffman_table(zio->huffman_root, ZIO_HUFFMAN_TABLE_BITS,
+	NULL, &entry_count) < 0)
+	goto failed;
+
+    zio->huffman_tables = (Zio_Huffman_Entry *) malloc(
+	sizeof(Zio_Huffman_Entry) * entry_count);
+    if (zio->huffman_tables == NULL)
+	goto failed;
+
+    entry_count = 0;
+    if (zio_make_huffman_table(zio->huffman_root, ZIO_HUFFMAN_TABLE_BITS,
+	zio->huffman_tables, &entry_count) < 0)
+	goto failed;
+
+    LOG(("out: zio_make_epwing_huffman_tables(entry_count=%ld) = %d",
+	(long)entry_count, 0));
+    return 0;
+
+    /*
+     * An error occurs...
+     */
+  failed:
+    LOG(("out: zio_make_epwing_huffman_tables() = %d", -1));
+    return -1;
+}
+
+
+/*
+ * Share the huffman tree made for the file of `zio' by another zio, if
+ * any.
+ * If succeeded, 0 is returned.  Otherwise -1 is returned.
+ */
+static int
+zio_attach_huffman_tree(Zio *zio)
+{
+    struct stat status;
+    Zio_Huffman_Tree **tree_p;
+    Zio_Huffman_Tree *tree;
+
+    LOG(("in: zio_attach_huffman_tree(zio=%d)", (int)zio->id));
+
+    if (zio->is_ebnet || fstat(zio->file, &status) < 0)
+	goto failed;
+
+    pthread_mutex_lock(&zio_mutex);
+    for (tree_p = &huffman_trees; *tree_p != NULL; tree_p = &(*tree_p)->next) {
+	if (zio_match_huffman_tree(zio, &status, *tree_p))
+	    break;
+    }
+    tree = *tree_p;
+    if (tree == NULL) {
+	pthread_mutex_unlock(&zio_mutex);
+	goto failed;
+    }
+
+    /*
+     * Move the tree to the head of the list.
+     */
+    *tree_p = tree->next;
+    tree->next = huffman_trees;
+    huffman_trees = tree;
+
+    tree->reference_count++;
+    zio->huffman_tree = tree;
+    zio->huffman_nodes = tree->nodes;
+    zio->huffman_root = tree->root;
+    zio->huffman_tables = tree->tables;
+    pthread_mutex_unlock(&zio_mutex);
+
+    LOG(("out: zio_attach_huffman_tree() = %d", 0));
+    return 0;
+
+    /*
+     * An error occurs...
+     */
+  failed:
+    LOG(("out: zio_attach_huffman_tree() = %d", -1));
+    return -1;
+}
+
+
+/*
+ * Make the huffman tree of `zio' available to other zios opening the
+ * same file.  On failure, the tree simply remains private to `zio'.
+ */
+static void
+zio_register_huffman_tree(Zio *zio)
+{
+    struct stat status;
+    Zio_Huffman_Tree *tree;
+
+    LOG(("in: zio_register_huffman_tree(zio=%d)", (int)zio->id));
+
+    if (zio->is_ebnet || fstat(zio->file, &status) < 0)
+	goto failed;
+
+    pthread_mutex_lock(&zio_mutex);
+
+    /*
+     * Another zio may have registered a tree for the file while we
+     * were making ours.  Use that one then.
+     */
+    for (tree = huffman_trees; tree != NULL; tree = tree->next) {
+	if (zio_match_huffman_tree(zio, &status, tree))
+	    break;
+    }
+    if (tree != NULL) {
+	free(zio->huffman_nodes);
+	free(zio->huffman_tables);
+	tree->reference_count++;
+	zio->huffman_tree = tree;
+	zio->huffman_nodes = tree->nodes;
+	zio->huffman_root = tree->root;
+	zio->huffman_tables = tree->tables;
+	pthread_mutex_unlock(&zio_mutex);
+	goto succeeded;
+    }
+
+    tree = (Zio_Huffman_Tree *) malloc(sizeof(Zio_Huffman_Tree));
+    if (tree == NULL) {
+	pthread_mutex_unlock(&zio_mutex);
+	goto failed;
+    }
+    tree->device = status.st_dev;
+    tree->inode = status.st_ino;
+    tree->size = status.st_size;
+    tree->mtime = status.st_mtime;
+    tree->code = zio->code;
+    tree->frequencies_location = zio->frequencies_location;
+    tree->frequencies_length = zio->frequencies_length;
+    tree->nodes = zio->huffman_nodes;
+    tree->root = zio->huffman_root;
+    tree->tables = zio->huffman_tables;
+    tree->reference_count = 1;
+    tree->next = huffman_trees;
+    huffman_trees = tree;
+    zio->huffman_tree = tree;
+
+    zio_trim_huffman_trees();
+    pthread_mutex_unlock(&zio_mutex);
+
+  succeeded:
+    LOG(("out: zio_register_huffman_tree()"));
+    return;
+
+    /*
+     * An error occurs...
+     */
+  failed:
+    LOG(("out: zio_register_huffman_tree()"));
+}
+
+
+/*
+ * Stop using the huffman tree of `zio'.  A shared tree is kept for
+ * reuse, and a private one is freed.
+ */
+static void
+zio_release_huffman_tree(Zio *zio)
+{
+    LOG(("in: zio_release_huffman_tree(zio=%d)", (int)zio->id));
+
+    if (zio->huffman_tree != NULL) {
+	pthread_mutex_lock(&zio_mutex);
+	zio->huffman_tree->reference_count--;
+	zio_trim_huffman_trees();
+	pthread_mutex_unlock(&zio_mutex);
+    } else {
+	if (zio->huffman_nodes != NULL)
+	    free(zio->huffman_nodes);
+	if (zio->huffman_tables != NULL)
+	    free(zio->huffman_tables);
+    }
+
+    zio->huffman_tree = NULL;
+    zio->huffman_nodes = NULL;
+    zio->huffman_root = NULL;
+    zio->huffman_tables = NULL;
+
+    LOG(("out: zio_release_huffman_tree()"));
+}
+
+
+/*
+ * Test whether `tree' has been made for the file of `zio', whose
+ * status is `status'.
+ */
+static int
+zio_match_huffman_tree(Zio *zio, const struct stat *status,
+    Zio_Huffman_Tree *tree)
+{
+    return tree->device == status->st_dev
+	&& tree->inode == status->st_ino
+	&& tree->size == status->st_size
+	&& tree->mtime == status->st_mtime
+	&& tree->code == zio->code
+	&& tree->frequencies_location == zio->frequencies_location
+	&& tree->frequencies_length == zio->frequencies_length;
+}
+
+
+/*
+ * Free unused huffman trees exceeding ZIO_MAX_UNUSED_HUFFMAN_TREES,
+ * the least recently used first.  `zio_mutex' must be locked.
+ */
+static void
+zio_trim_huffman_trees(void)
+{
+    Zio_Huffman_Tree **tree_p;
+    Zio_Huffman_Tree *tree;
+    int unused_count = 0;
+
+    for (tree_p = &huffman_trees; *tree_p != NULL; ) {
+	tree = *tree_p;
+	if (0 < tree->reference_count
+	    || ++unused_count <= ZIO_MAX_UNUSED_HUFFMAN_TREES) {
+	    tree_p = &tree->next;
+	    continue;
+	}
+	*tree_p = tree->next;
+	free(tree->nodes);
+	free(tree->tables);
+	free(tree);
+    }
+}
+
+
+/*
+ * Return the height of the Huffman subtree `node'.
+ */
+static int
+zio_huffman_tree_height(Zio_Huffman_Node *node)
+{
+    int left_height;
+    int right_height;
+
+    if (node->type != ZIO_HUFFMAN_NODE_INTERMEDIATE)
+	return 0;
+
+    left_height = zio_huffman_tree_height(node->left);
+    right_height = zio_huffman_tree_height(node->right);
+    if (left_height < right_height)
+	return right_height + 1;
+    return left_height + 1;
+}
+
+
+/*
+ * Make the decode table of the intermediate node `node' with
+ * `table_bits' bits (or less if the subtree is not so deep), and tables
+ * of its deeper subtrees.  Tables are placed in `entries' from the
+ * entry `*used' on, and `*used' is advanced past them.  If `entries' is
+ * NULL, the entries are only counted.
+ * If succeeded, 0 is returned.  Otherwise -1 is returned.
+ */
+static int
+zio_make_huffman_table(Zio_Huffman_Node *node, int table_bits,
+    Zio_Huffman_Entry *entries, size_t *used)
+{
+    Zio_Huffman_Entry *table = NULL;
+    int height;
+
+    height = zio_huffman_tree_height(node);
+    if (height < table_bits)
+	table_bits = height;
+
+    if (entries != NULL) {
+	table = entries + *used;
+	node->table = table;
+	node->table_bits = table_bits;
+    }
+    *used += (size_t)1 << table_bits;
+
+    if (zio_fill_huffman_table(table, table_bits, node->left, 1, 1,
+	entries, used) < 0)
+	return -1;
+    if (zio_fill_huffman_table(table, table_bits, node->right, 1, 0,
+	entries, used) < 0)
+	return -1;
+
+    return 0;
+}
+
+
+/*
+ * Fill entries of `table' for the subtree `node', which is reached from
+ * the node of the table by `depth' bits of `code'.  `table' is NULL if
+ * the entries are only counted.
+ * If succeeded, 0 is returned.  Otherwise -1 is returned.
+ */
+static int
+zio_fill_huffman_table(Zio_Huffman_Entry *table, int table_bits,
+    Zio_Huffman_Node *node, int depth, unsigned int code,
+    Zio_Huffman_Entry *entries, size_t *used)
+{
+    Zio_Huffman_Entry *entry;
+    int i;
+
+    if (node == NULL)
+	return -1;
+
+    if (node->type == ZIO_HUFFMAN_NODE_INTERMEDIATE && depth < table_bits) {
+	if (zio_fill_huffman_table(table, table_bits, node->left, depth + 1,
+	    (code << 1) | 1, entries, used) < 0)
+	    return -1;
+	return zio_fill_huffman_table(table, table_bits, node->right,
+	    depth + 1, code << 1, entries, used);
+    }
+
+    /*
+     * A leaf, or an intermediate node which continues in its own table.
+     * Every index starting with the code refers to the node.
+     */
+    if (node->type == ZIO_HUFFMAN_NODE_INTERMEDIATE) {
+	if (zio_make_huffman_table(node, ZIO_HUFFMAN_SUBTABLE_BITS, entries,
+	    used) < 0)
+	    return -1;
+    }
+    if (table != NULL) {
+	entry = table + (code << (table_bits - depth));
+	for (i = 0; i < 1 << (table_bits - depth); i++, entry++) {
+	    entry->node = node;
+	    entry->length = depth;
+	}
+    }
+
+    return 0;
+}
+
+
 /*
  * Close `zio'.
  */
 void
 zio_close(Zio *zio)
 {
-    pthread_mutex_lock(&zio_mutex);
     LOG(("in: zio_close(zio=%d)", (int)zio->id));
 
     /*
      * If contents of the file is cached, clear the cache.
      */
-    if (0 <= zio->file)
+    if (0 <= zio->file) {
 	zio_close_raw(zio);
+	if (zio->code == ZIO_EBZIP1)
+	    zio_cancel_prefetch(zio->id);
+	if (zio->code != ZIO_PLAIN)
+	    zio_cache_purge(zio->id);
+    }
     zio->file = -1;
 
     LOG(("out: zio_close()"));
-    pthread_mutex_unlock(&zio_mutex);
 }
 
 
@@ -1107,7 +2159,6 @@ zio_read(Zio *zio, char *buffer, size_t length)
 {
     ssize_t read_length;
 
-    pthread_mutex_lock(&zio_mutex);
     LOG(("in: zio_read(zio=%d, length=%ld)", (int)zio->id, (long)length));
 
     /*
@@ -1135,7 +2186,6 @@ zio_read(Zio *zio, char *buffer, size_t length)
     }
 
     LOG(("out: zio_read() = %ld", (long)read_length));
-    pthread_mutex_unlock(&zio_mutex);
 
     return read_length;
 
@@ -1155,11 +2205,14 @@ zio_read(Zio *zio, char *buffer, size_t length)
 static ssize_t
 zio_read_ebzip(Zio *zio, char *buffer, size_t length)
 {
-    char temporary_buffer[8];
+    char temporary_buffer[10];
+    const char *index_p;
     ssize_t read_length = 0;
     size_t zipped_slice_size;
     off_t slice_location;
     off_t next_slice_location;
+    off_t cache_location;
+    Zio_Cache_Entry *new_entry = NULL;
     int n;
 
     LOG(("in: zio_read_ebzip(zio=%d, length=%ld)", (int)zio->id,
@@ -1172,16 +2225,32 @@ zio_read_ebzip(Zio *zio, char *buffer, size_t length)
 	if (zio->file_size <= zio->location)
 	    goto succeeded;
 
+	cache_location = zio->location - (zio->location % zio->slice_size);
+	n = zio->slice_size - (zio->location - cache_location);
+	if (length - read_length < n)
+	    n = length - read_length;
+	if (zio->file_size - zio->location < n)
+	    n = zio->file_size - zio->location;
+
 	/*
-	 * If data in `cache_buffer' is out of range, read data from
-	 * `zio->file'.
+	 * When the read moves on to the next slice, prefetch the slices
+	 * following it.
 	 */
-	if (cache_zio_id != zio->id
-	    || zio->location < cache_location
-	    || cache_location + zio->slice_size <= zio->location) {
+	if (cache_location != zio->prefetch_last_location) {
+	    if (cache_location
+		== zio->prefetch_last_location + (off_t) zio->slice_size)
+		zio_prefetch_ebzip(zio, cache_location);
+	    zio->prefetch_last_location = cache_location;
+	}
 
-	    cache_zio_id = ZIO_ID_NONE;
-	    cache_location = zio->location - (zio->location % zio->slice_size);
+	/*
+	 * If the slice is neither in the cache nor being prefetched,
+	 * read data from `zio->file'.
+	 */
+	if (zio_cache_read(zio->id, cache_location,
+	    zio->location - cache_location, buffer + read_length, n) < 0
+	    && zio_read_prefetched_ebzip(zio, cache_location,
+		zio->location - cache_location, buffer + read_length, n) < 0) {
 
 	    /*
 	     * Get buffer location and size from index table in `zio->file'.
@@ -1189,30 +2258,19 @@ zio_read_ebzip(Zio *zio, char *buffer, size_t length)
 	    if (zio_lseek_raw(zio, zio->location / zio->slice_size
 		* zio->index_width + ZIO_SIZE_EBZIP_HEADER, SEEK_SET) < 0)
 		goto failed;
-	    if (zio_read_raw(zio, temporary_buffer, zio->index_width * 2)
-		!= zio->index_width * 2)
-		goto failed;
+	    index_p = zio_map_raw(zio, zio->index_width * 2);
+	    if (index_p == NULL) {
+		if (zio_read_raw(zio, temporary_buffer, zio->index_width * 2)
+		    != zio->index_width * 2)
+		    goto failed;
+		index_p = temporary_buffer;
+	    }
 
-	    switch (zio->index_width) {
-	    case 2:
-		slice_location = zio_uint2(temporary_buffer);
-		next_slice_location = zio_uint2(temporary_buffer + 2);
-		break;
-	    case 3:
-		slice_location = zio_uint3(temporary_buffer);
-		next_slice_location = zio_uint3(temporary_buffer + 3);
-		break;
-	    case 4:
-		slice_location = zio_uint4(temporary_buffer);
-		next_slice_location = zio_uint4(temporary_buffer + 4);
-		break;
-	    case 5:
-		slice_location = zio_uint5(temporary_buffer);
-		next_slice_location = zio_uint5(temporary_buffer + 5);
-		break;
-	    default:
+	    slice_location = zio_ebzip_index_entry(zio, index_p);
+	    next_slice_location = zio_ebzip_index_entry(zio,
+		index_p + zio->index_width);
+	    if (slice_location < 0 || next_slice_location < 0)
 		goto failed;
-	    }
 	    zipped_slice_size = next_slice_location - slice_location;
 
 	    if (next_slice_location <= slice_location
@@ -1224,25 +2282,20 @@ zio_read_ebzip(Zio *zio, char *buffer, size_t length)
 	     * The data is not compressed if its size is equals to
 	     * slice size.
 	     */
+	    new_entry = zio_cache_allocate(zio->slice_size);
+	    if (new_entry == NULL)
+		goto failed;
 	    if (zio_lseek_raw(zio, slice_location, SEEK_SET) < 0)
 		goto failed;
-	    if (zio_unzip_slice_ebzip1(zio, cache_buffer, zipped_slice_size)
-		< 0)
+	    if (zio_unzip_slice_ebzip1(zio, new_entry->buffer,
+		zipped_slice_size) < 0)
 		goto failed;
 
-	    cache_zio_id = zio->id;
+	    memcpy(buffer + read_length,
+		new_entry->buffer + (zio->location - cache_location), n);
+	    zio_cache_insert(new_entry, zio->id, cache_location);
+	    new_entry = NULL;
 	}
-
-	/*
-	 * Copy data from `cache_buffer' to `buffer'.
-	 */
-	n = zio->slice_size - (zio->location % zio->slice_size);
-	if (length - read_length < n)
-	    n = length - read_length;
-	if (zio->file_size - zio->location < n)
-	    n = zio->file_size - zio->location;
-	memcpy(buffer + read_length,
-	    cache_buffer + (zio->location % zio->slice_size), n);
 	read_length += n;
 	zio->location += n;
     }
@@ -1255,11 +2308,366 @@ zio_read_ebzip(Zio *zio, char *buffer, size_t length)
      * An error occurs...
      */
   failed:
+    if (new_entry != NULL)
+	free(new_entry);
     LOG(("out: zio_read_ebzip() = %ld", (long)-1));
     return -1;
 }
 
 
+/*
+ * Get the location of a compressed slice from the entry `index_p' of
+ * the index table of an EBZIP file.  -1 is returned for an invalid
+ * index width.
+ */
+static off_t
+zio_ebzip_index_entry(Zio *zio, const char *index_p)
+{
+    switch (zio->index_width) {
+    case 2:
+	return zio_uint2(index_p);
+    case 3:
+	return zio_uint3(index_p);
+    case 4:
+	return zio_uint4(index_p);
+    case 5:
+	return zio_uint5(index_p);
+    }
+
+    return -1;
+}
+
+
+/*
+ * Queue the EBZIP slices following the slice at `location' for
+ * prefetch workers, up to the configured number of slices ahead.
+ * Slices which are cached or have been queued already are skipped.
+ * Compressed slices are read here, so that workers never touch the
+ * zio.  Errors are ignored; the reader will meet them again.
+ */
+static void
+zio_prefetch_ebzip(Zio *zio, off_t location)
+{
+#ifdef ENABLE_PTHREAD
+    char index_buffer[(ZIO_MAX_PREFETCH_SLICES + 1) * 5];
+    const char *index_p;
+    Zio_Prefetch_Job *job;
+    Zio_Prefetch_Job **job_p;
+    off_t first_location;
+    off_t end_location;
+    off_t slice_location;
+    off_t next_slice_location;
+    size_t zipped_slice_size;
+    int slice_count;
+    int i;
+
+    pthread_mutex_lock(&prefetch_mutex);
+    slice_count = prefetch_slice_count;
+    pthread_mutex_unlock(&prefetch_mutex);
+    if (slice_count == 0)
+	return;
+
+    LOG(("in: zio_prefetch_ebzip(zio=%d, location=%ld)", (int)zio->id,
+	(long)location));
+
+    /*
+     * Slices up to `prefetch_end_location' have been queued by an
+     * earlier call for the same sequential read.
+     */
+    first_location = location + zio->slice_size;
+    end_location = location + (off_t) zio->slice_size * (slice_count + 1);
+    if (first_location < zio->prefetch_end_location
+	&& zio->prefetch_end_location <= end_location)
+	first_location = zio->prefetch_end_location;
+    if (zio->file_size < end_location)
+	end_location = zio->file_size;
+    if (end_location <= first_location)
+	goto succeeded;
+    zio->prefetch_end_location = end_location;
+    slice_count = (end_location - first_location + zio->slice_size - 1)
+	/ zio->slice_size;
+
+    /*
+     * Read index entries of the slices at once.
+     */
+    if (zio_lseek_raw(zio, first_location / zio->slice_size
+	* zio->index_width + ZIO_SIZE_EBZIP_HEADER, SEEK_SET) < 0)
+	goto failed;
+    index_p = zio_map_raw(zio, zio->index_width * (slice_count + 1));
+    if (index_p == NULL) {
+	if (zio_read_raw(zio, index_buffer,
+	    zio->index_width * (slice_count + 1))
+	    != zio->index_width * (slice_count + 1))
+	    goto failed;
+	index_p = index_buffer;
+    }
+
+    for (i = 0; i < slice_count; i++, index_p += zio->index_width) {
+	location = first_location + (off_t) zio->slice_size * i;
+	if (zio_cache_contains(zio->id, location))
+	    continue;
+
+	slice_location = zio_ebzip_index_entry(zio, index_p);
+	next_slice_location = zio_ebzip_index_entry(zio,
+	    index_p + zio->index_width);
+	zipped_slice_size = next_slice_location - slice_location;
+	if (slice_location < 0 || next_slice_location <= slice_location
+	    || zio->slice_size < zipped_slice_size)
+	    goto failed;
+
+	/*
+	 * Read the compressed slice.
+	 */
+	job = (Zio_Prefetch_Job *) malloc(sizeof(Zio_Prefetch_Job)
+	    + zipped_slice_size);
+	if (job == NULL)
+	    goto failed;
+	job->zio_id = zio->id;
+	job->location = location;
+	job->slice_size = zio->slice_size;
+	job->zipped_slice_size = zipped_slice_size;
+	job->zipped_buffer = (char *) (job + 1);
+	job->running = 0;
+	job->next = NULL;
+	if (zio_lseek_raw(zio, slice_location, SEEK_SET) < 0
+	    || zio_read_raw(zio, job->zipped_buffer, zipped_slice_size)
+	    != zipped_slice_size) {
+	    free(job);
+	    goto failed;
+	}
+
+	/*
+	 * Queue the job, unless the queue is full or the slice has been
+	 * queued already.
+	 */
+	pthread_mutex_lock(&prefetch_mutex);
+	for (job_p = &prefetch_jobs; *job_p != NULL;
+	     job_p = &(*job_p)->next) {
+	    if ((*job_p)->zio_id == job->zio_id
+		&& (*job_p)->location == job->location)
+		break;
+	}
+	if (*job_p != NULL || prefetch_thread_count == 0
+	    || ZIO_MAX_PREFETCH_JOBS <= prefetch_job_count) {
+	    pthread_mutex_unlock(&prefetch_mutex);
+	    free(job);
+	    continue;
+	}
+	*job_p = job;
+	prefetch_job_count++;
+	prefetch_issued++;
+	pthread_cond_signal(&prefetch_queued);
+	pthread_mutex_unlock(&prefetch_mutex);
+    }
+
+  succeeded:
+    LOG(("out: zio_prefetch_ebzip()"));
+    return;
+
+    /*
+     * An error occurs...
+     */
+  failed:
+    LOG(("out: zio_prefetch_ebzip()"));
+#endif /* ENABLE_PTHREAD */
+}
+
+
+/*
+ * If the slice at `location' of `zio' is being prefetched, copy
+ * `length' bytes at `offset' of it to `buffer'.  A slice still waiting
+ * for a worker is uncompressed here, and a slice a worker is working on
+ * is waited for.
+ * If succeeded, 0 is returned.  Otherwise -1 is returned.
+ */
+static int
+zio_read_prefetched_ebzip(Zio *zio, off_t location, size_t offset,
+    char *buffer, size_t length)
+{
+#ifdef ENABLE_PTHREAD
+    Zio_Prefetch_Job *job;
+    Zio_Cache_Entry *entry;
+
+    pthread_mutex_lock(&prefetch_mutex);
+    for (;;) {
+	for (job = prefetch_jobs; job != NULL; job = job->next) {
+	    if (job->zio_id == zio->id && job->location == location)
+		break;
+	}
+	if (job == NULL || !job->running)
+	    break;
+	pthread_cond_wait(&prefetch_finished, &prefetch_mutex);
+	job = NULL;
+	if (zio_cache_contains(zio->id, location)) {
+	    pthread_mutex_unlock(&prefetch_mutex);
+	    return zio_cache_read(zio->id, location, offset, buffer, length);
+	}
+    }
+    if (job == NULL) {
+	pthread_mutex_unlock(&prefetch_mutex);
+	return -1;
+    }
+    zio_unlink_prefetch_job(job);
+    prefetch_taken++;
+    pthread_mutex_unlock(&prefetch_mutex);
+
+    entry = zio_cache_allocate(job->slice_size);
+    if (entry == NULL)
+	goto failed;
+    if (zio_inflate_slice_ebzip1(job->zipped_buffer, job->zipped_slice_size,
+	entry->buffer, job->slice_size) < 0)
+	goto failed;
+    memcpy(buffer, entry->buffer + offset, length);
+    zio_cache_insert(entry, zio->id, location);
+    free(job);
+    return 0;
+
+    /*
+     * An error occurs...
+     */
+  failed:
+    if (entry != NULL)
+	free(entry);
+    free(job);
+#endif /* ENABLE_PTHREAD */
+    return -1;
+}
+
+
+/*
+ * Discard prefetch jobs of the zio `zio_id' waiting for workers, and
+ * wait for those workers are working on, so that no slice of the zio
+ * is put into the cache any longer.
+ */
+static void
+zio_cancel_prefetch(int zio_id)
+{
+#ifdef ENABLE_PTHREAD
+    Zio_Prefetch_Job **job_p;
+    Zio_Prefetch_Job *job;
+    int running;
+
+    pthread_mutex_lock(&prefetch_mutex);
+    for (;;) {
+	running = 0;
+	for (job_p = &prefetch_jobs; *job_p != NULL; ) {
+	    job = *job_p;
+	    if (job->zio_id != zio_id) {
+		job_p = &job->next;
+	    } else if (job->running) {
+		running = 1;
+		job_p = &job->next;
+	    } else {
+		*job_p = job->next;
+		prefetch_job_count--;
+		free(job);
+	    }
+	}
+	if (!running)
+	    break;
+	pthread_cond_wait(&prefetch_finished, &prefetch_mutex);
+    }
+    pthread_mutex_unlock(&prefetch_mutex);
+#endif /* ENABLE_PTHREAD */
+}
+
+
+#ifdef ENABLE_PTHREAD
+/*
+ * Main function of a prefetch worker.  It takes the oldest job nobody
+ * works on, and puts the uncompressed slice into the cache.
+ */
+static void *
+zio_prefetch_worker(void *argument)
+{
+    Zio_Prefetch_Job *job;
+    Zio_Cache_Entry *entry;
+
+    pthread_mutex_lock(&prefetch_mutex);
+    while (!prefetch_quit) {
+	for (job = prefetch_jobs; job != NULL; job = job->next) {
+	    if (!job->running)
+		break;
+	}
+	if (job == NULL) {
+	    pthread_cond_wait(&prefetch_queued, &prefetch_mutex);
+	    continue;
+	}
+	job->running = 1;
+	pthread_mutex_unlock(&prefetch_mutex);
+
+	entry = zio_cache_allocate(job->slice_size);
+	if (entry != NULL) {
+	    if (zio_inflate_slice_ebzip1(job->zipped_buffer,
+		job->zipped_slice_size, entry->buffer, job->slice_size) < 0) {
+		free(entry);
+	    } else {
+		entry->prefetched = 1;
+		zio_cache_insert(entry, job->zio_id, job->location);
+	    }
+	}
+
+	pthread_mutex_lock(&prefetch_mutex);
+	zio_unlink_prefetch_job(job);
+	free(job);
+	pthread_cond_broadcast(&prefetch_finished);
+    }
+    pthread_mutex_unlock(&prefetch_mutex);
+
+    return NULL;
+}
+
+
+/*
+ * Stop all prefetch workers, and discard jobs left.
+ */
+static void
+zio_stop_prefetch_workers(void)
+{
+    Zio_Prefetch_Job *job;
+    int i;
+
+    pthread_mutex_lock(&prefetch_mutex);
+    prefetch_quit = 1;
+    pthread_cond_broadcast(&prefetch_queued);
+    pthread_mutex_unlock(&prefetch_mutex);
+
+    for (i = 0; i < prefetch_thread_count; i++)
+	pthread_join(prefetch_threads[i], NULL);
+
+    pthread_mutex_lock(&prefetch_mutex);
+    while (prefetch_jobs != NULL) {
+	job = prefetch_jobs;
+	prefetch_jobs = job->next;
+	free(job);
+    }
+    prefetch_job_count = 0;
+    if (prefetch_threads != NULL)
+	free(prefetch_threads);
+    prefetch_threads = NULL;
+    prefetch_thread_count = 0;
+    prefetch_slice_count = 0;
+    pthread_cond_broadcast(&prefetch_finished);
+    pthread_mutex_unlock(&prefetch_mutex);
+}
+
+
+/*
+ * Remove `job' from the job list.  `prefetch_mutex' must be locked.
+ */
+static void
+zio_unlink_prefetch_job(Zio_Prefetch_Job *job)
+{
+    Zio_Prefetch_Job **job_p;
+
+    for (job_p = &prefetch_jobs; *job_p != job; job_p = &(*job_p)->next)
+	;
+    *job_p = job->next;
+    prefetch_job_count--;
+}
+#endif /* ENABLE_PTHREAD */
+
+
 /*
  * Read data from the `zio' file compressed with the EPWING or EPWING V6
  * compression format.
@@ -1270,6 +2678,8 @@ zio_read_epwing(Zio *zio, char *buffer, size_t length)
     char temporary_buffer[36];
     ssize_t read_length = 0;
     off_t page_location;
+    off_t cache_location;
+    Zio_Cache_Entry *new_entry = NULL;
     int n;
 
     LOG(("in: zio_read_epwing(zio=%d, length=%ld)", (int)zio->id,
@@ -1282,15 +2692,18 @@ zio_read_epwing(Zio *zio, char *buffer, size_t length)
 	if (zio->file_size <= zio->location)
 	    goto succeeded;
 
+	cache_location = zio->location - (zio->location % ZIO_SIZE_PAGE);
+	n = ZIO_SIZE_PAGE - (zio->location - cache_location);
+	if (length - read_length < n)
+	    n = length - read_length;
+	if (zio->file_size - zio->location < n)
+	    n = zio->file_size - zio->location;
+
 	/*
-	 * If data in `cache_buffer' is out of range, read data from the zio
-	 * file.
+	 * If the page is not in the cache, read data from the zio file.
 	 */
-	if (cache_zio_id != zio->id
-	    || zio->location < cache_location
-	    || cache_location + zio->slice_size <= zio->location) {
-	    cache_zio_id = ZIO_ID_NONE;
-	    cache_location = zio->location - (zio->location % zio->slice_size);
+	if (zio_cache_read(zio->id, cache_location,
+	    zio->location - cache_location, buffer + read_length, n) < 0) {
 
 	    /*
 	     * Get page location from index table in `zio->file'.
@@ -1307,29 +2720,24 @@ zio_read_epwing(Zio *zio, char *buffer, size_t length)
 	    /*
 	     * Read a compressed page from `zio->file' and uncompress it.
 	     */
+	    new_entry = zio_cache_allocate(ZIO_SIZE_PAGE);
+	    if (new_entry == NULL)
+		goto failed;
 	    if (zio_lseek_raw(zio, page_location, SEEK_SET) < 0)
 		goto failed;
 	    if (zio->code == ZIO_EPWING) {
-		if (zio_unzip_slice_epwing(zio, cache_buffer) < 0)
+		if (zio_unzip_slice_epwing(zio, new_entry->buffer) < 0)
 		    goto failed;
 	    } else {
-		if (zio_unzip_slice_epwing6(zio, cache_buffer) < 0)
+		if (zio_unzip_slice_epwing6(zio, new_entry->buffer) < 0)
 		    goto failed;
 	    }
 
-	    cache_zio_id = zio->id;
+	    memcpy(buffer + read_length,
+		new_entry->buffer + (zio->location - cache_location), n);
+	    zio_cache_insert(new_entry, zio->id, cache_location);
+	    new_entry = NULL;
 	}
-
-	/*
-	 * Copy data from `cache_buffer' to `buffer'.
-	 */
-	n = ZIO_SIZE_PAGE - (zio->location % ZIO_SIZE_PAGE);
-	if (length - read_length < n)
-	    n = length - read_length;
-	if (zio->file_size - zio->location < n)
-	    n = zio->file_size - zio->location;
-	memcpy(buffer + read_length,
-	    cache_buffer + (zio->location - cache_location), n);
 	read_length += n;
 	zio->location += n;
     }
@@ -1342,6 +2750,8 @@ zio_read_epwing(Zio *zio, char *buffer, size_t length)
      * An error occurs...
      */
   failed:
+    if (new_entry != NULL)
+	free(new_entry);
     LOG(("out: zio_read_epwing() = %ld", (long)-1));
     return -1;
 }
@@ -1359,6 +2769,8 @@ zio_read_sebxa(Zio *zio, char *buffer, size_t length)
     char temporary_buffer[4];
     ssize_t read_length = 0;
     off_t slice_location;
+    off_t cache_location;
+    Zio_Cache_Entry *new_entry = NULL;
     ssize_t n;
     int slice_index;
 
@@ -1400,17 +2812,20 @@ zio_read_sebxa(Zio *zio, char *buffer, size_t length)
 	} else {
 	    /*
 	     * Data is located in compressed text.
-	     *
-	     * If data in `cache_buffer' is out of range, read data from
-	     * `file'.
 	     */
-	    if (cache_zio_id != zio->id
-		|| zio->location < cache_location
-		|| cache_location + ZIO_SEBXA_SLICE_LENGTH <= zio->location) {
+	    cache_location = zio->location
+		- (zio->location % ZIO_SEBXA_SLICE_LENGTH);
+	    n = ZIO_SEBXA_SLICE_LENGTH - (zio->location - cache_location);
+	    if (length - read_length < n)
+		n = length - read_length;
+	    if (zio->file_size - zio->location < n)
+		n = zio->file_size - zio->location;
 
-		cache_zio_id = ZIO_ID_NONE;
-		cache_location = zio->location
-		    - (zio->location % ZIO_SEBXA_SLICE_LENGTH);
+	    /*
+	     * If the slice is not in the cache, read data from `file'.
+	     */
+	    if (zio_cache_read(zio->id, cache_location,
+		zio->location - cache_location, buffer + read_length, n) < 0) {
 
 		/*
 		 * Get buffer location and size.
@@ -1432,25 +2847,19 @@ zio_read_sebxa(Zio *zio, char *buffer, size_t length)
 		/*
 		 * Read a compressed slice from `zio->file' and uncompress it.
 		 */
+		new_entry = zio_cache_allocate(ZIO_SEBXA_SLICE_LENGTH);
+		if (new_entry == NULL)
+		    goto failed;
 		if (zio_lseek_raw(zio, slice_location, SEEK_SET) < 0)
 		    goto failed;
-		if (zio_unzip_slice_sebxa(zio, cache_buffer) < 0)
+		if (zio_unzip_slice_sebxa(zio, new_entry->buffer) < 0)
 		    goto failed;
 
-		cache_zio_id = zio->id;
+		memcpy(buffer + read_length,
+		    new_entry->buffer + (zio->location - cache_location), n);
+		zio_cache_insert(new_entry, zio->id, cache_location);
+		new_entry = NULL;
 	    }
-
-	    /*
-	     * Copy data from `cache_buffer' to `buffer'.
-	     */
-	    n = ZIO_SEBXA_SLICE_LENGTH
-		- (zio->location % ZIO_SEBXA_SLICE_LENGTH);
-	    if (length - read_length < n)
-		n = length - read_length;
-	    if (zio->file_size - zio->location < n)
-		n = zio->file_size - zio->location;
-	    memcpy(buffer + read_length,
-		cache_buffer + (zio->location - cache_location), n);
 	    read_length += n;
 	    zio->location += n;
 	}
@@ -1464,6 +2873,8 @@ zio_read_sebxa(Zio *zio, char *buffer, size_t length)
      * An error occurs...
      */
   failed:
+    if (new_entry != NULL)
+	free(new_entry);
     LOG(("out: zio_read_sebxa() = %ld", (long)-1));
     return -1;
 }
@@ -1478,6 +2889,7 @@ static int
 zio_unzip_slice_ebzip1(Zio *zio, char *out_buffer, size_t zipped_slice_size)
 {
     char in_buffer[ZIO_SIZE_PAGE];
+    const char *in_p;
     z_stream stream;
     size_t read_length;
     int z_result;
@@ -1485,7 +2897,22 @@ zio_unzip_slice_ebzip1(Zio *zio, char *out_buffer, size_t zipped_slice_size)
     LOG(("in: zio_unzip_slice_ebzip1(zio=%d, zipped_slice_size=%ld)",
 	(int)zio->id, (long)zipped_slice_size));
 
-    if (zio->slice_size == zipped_slice_size) {
+    stream.zalloc = NULL;
+    stream.zfree = NULL;
+    stream.opaque = NULL;
+    stream.state = NULL;
+
+    if (zio->slice_size != zipped_slice_size
+	&& (in_p = zio_map_raw(zio, zipped_slice_size)) != NULL) {
+	/*
+	 * The input slice is compressed and the file is mapped into
+	 * memory.  Uncompress the slice straight from the mapping.
+	 */
+	if (zio_inflate_slice_ebzip1(in_p, zipped_slice_size, out_buffer,
+	    zio->slice_size) < 0)
+	    goto failed;
+
+    } else if (zio->slice_size == zipped_slice_size) {
 	/*
 	 * The input slice is not compressed.
 	 * Read the target page in the slice.
@@ -1498,10 +2925,6 @@ zio_unzip_slice_ebzip1(Zio *zio, char *out_buffer, size_t zipped_slice_size)
 	 * The input slice is compressed.
 	 * Read and uncompress the target page in the slice.
 	 */
-	stream.zalloc = NULL;
-	stream.zfree = NULL;
-	stream.opaque = NULL;
-
 	if (inflateInit(&stream) != Z_OK)
 	    goto failed;
 
@@ -1514,42 +2937,160 @@ zio_unzip_slice_ebzip1(Zio *zio, char *out_buffer, size_t zipped_slice_size)
 	    if (0 < stream.avail_in)
 		memmove(in_buffer, stream.next_in, stream.avail_in);
 
-	    if (zipped_slice_size - stream.total_in < ZIO_SIZE_PAGE) {
-		read_length = zipped_slice_size - stream.total_in
-		    - stream.avail_in;
-	    } else {
-	        read_length = ZIO_SIZE_PAGE - stream.avail_in;
-	    }
+	    if (zipped_slice_size - stream.total_in < ZIO_SIZE_PAGE) {
+		read_length = zipped_slice_size - stream.total_in
+		    - stream.avail_in;
+	    } else {
+	        read_length = ZIO_SIZE_PAGE - stream.avail_in;
+	    }
+
+	    if (zio_read_raw(zio, in_buffer + stream.avail_in,
+		read_length) != read_length)
+		goto failed;
+
+	    stream.next_in = (Bytef *) in_buffer;
+	    stream.avail_in += read_length;
+	    stream.avail_out = zio->slice_size - stream.total_out;
+
+	    z_result = inflate(&stream, Z_SYNC_FLUSH);
+	    if (z_result == Z_STREAM_END) {
+		break;
+	    } else if (z_result != Z_OK && z_result != Z_BUF_ERROR) {
+		goto failed;
+	    }
+	}
+
+	inflateEnd(&stream);
+    }
+
+    LOG(("out: zio_unzip_slice_ebzip1() = %d", 0));
+    return 0;
+
+    /*
+     * An error occurs...
+     */
+  failed:
+    LOG(("out: zio_unzip_slice_ebzip1() = %d", -1));
+    inflateEnd(&stream);
+    return -1;
+}
+
+
+/*
+ * Uncompress the EBZIP slice of `zipped_slice_size' bytes in
+ * `in_buffer' to `out_buffer' of `slice_size' bytes.  The data is not
+ * compressed if its size is equal to the slice size.
+ * If succeeded, 0 is returned.  Otherwise -1 is returned.
+ */
+static int
+zio_inflate_slice_ebzip1(const char *in_buffer, size_t zipped_slice_size,
+    char *out_buffer, size_t slice_size)
+{
+    z_stream stream;
+    int z_result;
+    int result = 0;
+
+    if (zipped_slice_size == slice_size) {
+	memcpy(out_buffer, in_buffer, slice_size);
+	return 0;
+    }
+
+    stream.zalloc = NULL;
+    stream.zfree = NULL;
+    stream.opaque = NULL;
+    if (inflateInit(&stream) != Z_OK)
+	return -1;
+
+    stream.next_in = (Bytef *) in_buffer;
+    stream.avail_in = zipped_slice_size;
+    stream.next_out = (Bytef *) out_buffer;
+    stream.avail_out = slice_size;
+
+    z_result = inflate(&stream, Z_SYNC_FLUSH);
+    if (z_result != Z_STREAM_END && z_result != Z_OK
+	&& z_result != Z_BUF_ERROR)
+	result = -1;
+    else if (z_result != Z_STREAM_END && stream.total_out < slice_size)
+	result = -1;
+    inflateEnd(&stream);
+
+    return result;
+}
+
+
+/*
+ * Initialize `reader' to read compressed data from the current
+ * location of a zio file.
+ */
+static void
+zio_initialize_bit_reader(Zio_Bit_Reader *reader)
+{
+    reader->buffer_p = reader->buffer;
+    reader->buffer_end = reader->buffer;
+    reader->eof = 0;
+    reader->bits = 0;
+    reader->bit_count = 0;
+}
 
-	    if (zio_read_raw(zio, in_buffer + stream.avail_in,
-		read_length) != read_length)
-		goto failed;
 
-	    stream.next_in = (Bytef *) in_buffer;
-	    stream.avail_in += read_length;
-	    stream.avail_out = zio->slice_size - stream.total_out;
+/*
+ * Fill the bit buffer of `reader' with at least 57 bits, unless the end
+ * of the file is met.
+ */
+static void
+zio_fill_bit_reader(Zio *zio, Zio_Bit_Reader *reader)
+{
+    ssize_t read_length;
 
-	    z_result = inflate(&stream, Z_SYNC_FLUSH);
-	    if (z_result == Z_STREAM_END) {
-		break;
-	    } else if (z_result != Z_OK && z_result != Z_BUF_ERROR) {
-		goto failed;
+    while (reader->bit_count <= ZIO_BIT_BUFFER_WIDTH - 8) {
+	if (reader->buffer_end <= reader->buffer_p) {
+	    if (reader->eof)
+		return;
+	    read_length = zio_read_raw(zio, reader->buffer, ZIO_SIZE_PAGE);
+	    if (read_length <= 0) {
+		reader->eof = 1;
+		return;
 	    }
+	    reader->buffer_p = reader->buffer;
+	    reader->buffer_end = reader->buffer + read_length;
 	}
-
-	inflateEnd(&stream);
+	reader->bits |= (unsigned long long) *reader->buffer_p++
+	    << (ZIO_BIT_BUFFER_WIDTH - 8 - reader->bit_count);
+	reader->bit_count += 8;
     }
+}
 
-    LOG(("out: zio_unzip_slice_ebzip1() = %d", 0));
-    return 0;
 
-    /*
-     * An error occurs...
-     */
-  failed:
-    LOG(("out: zio_unzip_slice_ebzip1() = %d", -1));
-    inflateEnd(&stream);
-    return -1;
+/*
+ * Decode a code read by `reader' with the Huffman tree of `zio'.
+ * If succeeded, the leaf node of the code is returned.  Otherwise NULL
+ * is returned.
+ */
+static Zio_Huffman_Node *
+zio_decode_huffman(Zio *zio, Zio_Bit_Reader *reader)
+{
+    Zio_Huffman_Node *node_p;
+    Zio_Huffman_Entry *entry;
+
+    node_p = zio->huffman_root;
+    do {
+	if (reader->bit_count < node_p->table_bits)
+	    zio_fill_bit_reader(zio, reader);
+
+	/*
+	 * Past the end of the file, the bit buffer is padded with zeros.
+	 * It is an error only if the code takes some of them.
+	 */
+	entry = node_p->table
+	    + (reader->bits >> (ZIO_BIT_BUFFER_WIDTH - node_p->table_bits));
+	if (reader->bit_count < entry->length)
+	    return NULL;
+	reader->bits <<= entry->length;
+	reader->bit_count -= entry->length;
+	node_p = entry->node;
+    } while (node_p->type == ZIO_HUFFMAN_NODE_INTERMEDIATE);
+
+    return node_p;
 }
 
 
@@ -1564,58 +3105,23 @@ static int
 zio_unzip_slice_epwing(Zio *zio, char *out_buffer)
 {
     Zio_Huffman_Node *node_p;
-    int bit;
-    char in_buffer[ZIO_SIZE_PAGE];
-    unsigned char *in_buffer_p;
-    ssize_t in_read_length;
-    int in_bit_index;
+    Zio_Bit_Reader reader;
     unsigned char *out_buffer_p;
     size_t out_length;
 
     LOG(("in: zio_unzip_slice_epwing(zio=%d)", (int)zio->id));
 
-    in_buffer_p = (unsigned char *)in_buffer;
-    in_bit_index = 7;
-    in_read_length = 0;
+    zio_initialize_bit_reader(&reader);
     out_buffer_p = (unsigned char *)out_buffer;
     out_length = 0;
 
     for (;;) {
 	/*
-	 * Descend the huffman tree until reached to the leaf node.
+	 * Decode a leaf node.
 	 */
-	node_p = zio->huffman_root;
-	while (node_p->type == ZIO_HUFFMAN_NODE_INTERMEDIATE) {
-
-	    /*
-	     * If no data is left in the input buffer, read next chunk.
-	     */
-	    if ((unsigned char *)in_buffer + in_read_length <= in_buffer_p) {
-		in_read_length = zio_read_raw(zio, in_buffer, ZIO_SIZE_PAGE);
-		if (in_read_length <= 0)
-		    goto failed;
-		in_buffer_p = (unsigned char *)in_buffer;
-	    }
-
-	    /*
-	     * Step to a child.
-	     */
-	    bit = (*in_buffer_p >> in_bit_index) & 0x01;
-
-	    if (bit == 1)
-		node_p = node_p->left;
-	    else
-		node_p = node_p->right;
-	    if (node_p == NULL)
-		goto failed;
-
-	    if (0 < in_bit_index)
-		in_bit_index--;
-	    else {
-		in_bit_index = 7;
-		in_buffer_p++;
-	    }
-	}
+	node_p = zio_decode_huffman(zio, &reader);
+	if (node_p == NULL)
+	    goto failed;
 
 	if (node_p->type == ZIO_HUFFMAN_NODE_EOF) {
 	    /*
@@ -1678,29 +3184,23 @@ static int
 zio_unzip_slice_epwing6(Zio *zio, char *out_buffer)
 {
     Zio_Huffman_Node *node_p;
-    int bit;
-    char in_buffer[ZIO_SIZE_PAGE];
-    unsigned char *in_buffer_p;
-    ssize_t in_read_length;
-    int in_bit_index;
+    Zio_Bit_Reader reader;
     unsigned char *out_buffer_p;
     size_t out_length;
     int compression_type;
 
     LOG(("in: zio_unzip_slice_epwing6(zio=%d)", (int)zio->id));
 
-    in_buffer_p = (unsigned char *)in_buffer;
-    in_bit_index = 7;
-    in_read_length = 0;
+    zio_initialize_bit_reader(&reader);
     out_buffer_p = (unsigned char *)out_buffer;
     out_length = 0;
 
     /*
      * Get compression type.
      */
-    if (zio_read_raw(zio, in_buffer, 1) != 1)
+    if (zio_read_raw(zio, reader.buffer, 1) != 1)
 	goto failed;
-    compression_type = zio_uint1(in_buffer);
+    compression_type = zio_uint1(reader.buffer);
 
     /*
      * If compression type is not 0, this page is not compressed.
@@ -1713,40 +3213,11 @@ zio_unzip_slice_epwing6(Zio *zio, char *out_buffer)
 
     while (out_length < ZIO_SIZE_PAGE) {
 	/*
-	 * Descend the huffman tree until reached to the leaf node.
+	 * Decode a leaf node.
 	 */
-	node_p = zio->huffman_root;
-	while (node_p->type == ZIO_HUFFMAN_NODE_INTERMEDIATE) {
-
-	    /*
-	     * If no data is left in the input buffer, read next chunk.
-	     */
-	    if ((unsigned char *)in_buffer + in_read_length <= in_buffer_p) {
-		in_read_length = zio_read_raw(zio, in_buffer, ZIO_SIZE_PAGE);
-		if (in_read_length <= 0)
-		    goto failed;
-		in_buffer_p = (unsigned char *)in_buffer;
-	    }
-
-	    /*
-	     * Step to a child.
-	     */
-	    bit = (*in_buffer_p >> in_bit_index) & 0x01;
-
-	    if (bit == 1)
-		node_p = node_p->left;
-	    else
-		node_p = node_p->right;
-	    if (node_p == NULL)
-		goto failed;
-
-	    if (0 < in_bit_index)
-		in_bit_index--;
-	    else {
-		in_bit_index = 7;
-		in_buffer_p++;
-	    }
-	}
+	node_p = zio_decode_huffman(zio, &reader);
+	if (node_p == NULL)
+	    goto failed;
 
 	if (node_p->type == ZIO_HUFFMAN_NODE_EOF) {
 	    /*
@@ -1959,11 +3430,23 @@ zio_unzip_slice_sebxa(Zio *zio, char *out_buffer)
  * If `file_name' is ebnet URL, it calls ebnet_open().  Otherwise it
  * calls the open() system call.
  *
+ * If mapping is enabled by zio_set_mmap(), a local file is also mapped
+ * into memory.  When the file cannot be mapped, it is read with read()
+ * as usual.
+ *
  * Like open(), it returns file descrptor or -1.
  */
 static int
 zio_open_raw(Zio *zio, const char *file_name)
 {
+#ifdef ENABLE_MMAP
+    struct stat status;
+    void *mapping;
+    int enabled;
+#endif
+
+    zio->mapping = NULL;
+
 #ifdef ENABLE_EBNET
     if (is_ebnet_url(file_name)) {
 	zio->is_ebnet = 1;
@@ -1976,6 +3459,24 @@ zio_open_raw(Zio *zio, const char *file_name)
     zio->file = open(file_name, O_RDONLY | O_BINARY);
 #endif
 
+#ifdef ENABLE_MMAP
+    pthread_mutex_lock(&zio_mutex);
+    enabled = mmap_enabled;
+    pthread_mutex_unlock(&zio_mutex);
+
+    if (enabled && !zio->is_ebnet && 0 <= zio->file
+	&& fstat(zio->file, &status) == 0 && 0 < status.st_size
+	&& (off_t) (size_t) status.st_size == status.st_size) {
+	mapping = mmap(NULL, (size_t) status.st_size, PROT_READ, MAP_SHARED,
+	    zio->file, 0);
+	if (mapping != MAP_FAILED) {
+	    zio->mapping = (const char *) mapping;
+	    zio->mapping_length = (size_t) status.st_size;
+	    zio->mapping_location = 0;
+	}
+    }
+#endif
+
     return zio->file;
 }
 
@@ -1989,6 +3490,12 @@ zio_open_raw(Zio *zio, const char *file_name)
 static void
 zio_close_raw(Zio *zio)
 {
+#ifdef ENABLE_MMAP
+    if (zio->mapping != NULL)
+	munmap((void *) zio->mapping, zio->mapping_length);
+#endif
+    zio->mapping = NULL;
+
 #ifdef ENABLE_EBNET
     if (zio->is_ebnet)
 	ebnet_close(zio->file);
@@ -2011,7 +3518,31 @@ zio_lseek_raw(Zio *zio, off_t offset, int whence)
 {
     off_t result;
 
-    if (zio->is_ebnet) {
+    if (zio->mapping != NULL) {
+	/*
+	 * Seek in the mapped file.
+	 */
+	switch (whence) {
+	case SEEK_SET:
+	    result = offset;
+	    break;
+	case SEEK_CUR:
+	    result = zio->mapping_location + offset;
+	    break;
+	case SEEK_END:
+	    result = (off_t) zio->mapping_length + offset;
+	    break;
+	default:
+	    result = -1;
+	}
+	if (result < 0) {
+#ifdef EINVAL
+	    errno = EINVAL;
+#endif
+	    return -1;
+	}
+	zio->mapping_location = result;
+    } else if (zio->is_ebnet) {
 #ifdef ENABLE_EBNET
 	result = ebnet_lseek(zio->file, offset, whence);
 #else
@@ -2039,7 +3570,19 @@ zio_read_raw(Zio *zio, void *buffer, size_t length)
 
     LOG(("in: zio_read_raw(file=%d, length=%ld)", zio->file, (long)length));
 
-    if (zio->is_ebnet) {
+    if (zio->mapping != NULL) {
+	/*
+	 * Copy from the mapped file.
+	 */
+	if ((off_t) zio->mapping_length <= zio->mapping_location)
+	    result = 0;
+	else if (zio->mapping_length - zio->mapping_location < length)
+	    result = zio->mapping_length - zio->mapping_location;
+	else
+	    result = length;
+	memcpy(buffer, zio->mapping + zio->mapping_location, result);
+	zio->mapping_location += result;
+    } else if (zio->is_ebnet) {
 	/*
 	 * Read from a remote server.
 	 */
@@ -2085,3 +3628,358 @@ zio_read_raw(Zio *zio, void *buffer, size_t length)
 }
 
 
+/*
+ * Low-level read function without copying.
+ *
+ * If the file is mapped into memory and has `length' bytes at the
+ * current location, it returns a pointer to them and advances the
+ * location like zio_read_raw().  Otherwise it returns NULL and the
+ * caller should fall back to zio_read_raw().
+ */
+static const char *
+zio_map_raw(Zio *zio, size_t length)
+{
+    const char *result;
+
+    if (zio->mapping == NULL
+	|| (off_t) zio->mapping_length < zio->mapping_location
+	|| zio->mapping_length - zio->mapping_location < length)
+	return NULL;
+
+    result = zio->mapping + zio->mapping_location;
+    zio->mapping_location += length;
+
+    return result;
+}
+
+
+
+
+/*
+ * Hash value of the slice at `location' in the zio `zio_id'.  The low
+ * bits select a shard, the rest select a bucket in the shard.
+ */
+static size_t
+zio_cache_hash(int zio_id, off_t location)
+{
+    unsigned long long hash;
+
+    hash = ((unsigned long long) zio_id << 40) ^ (unsigned long long) location;
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+
+    return (size_t) hash;
+}
+
+#define zio_cache_shard(hash) \
+	(cache_shards + ((hash) & (ZIO_CACHE_SHARD_COUNT - 1)))
+
+#define zio_cache_bucket(shard, hash) \
+	(((hash) / ZIO_CACHE_SHARD_COUNT) & ((shard)->bucket_count - 1))
+
+/*
+ * Reallocate hash buckets of `shard' so that the number of buckets is
+ * not less than the number of pages fitting in the size limit of the
+ * shard.
+ */
+static int
+zio_cache_resize_buckets(Zio_Cache_Shard *shard)
+{
+    Zio_Cache_Entry **old_buckets = shard->buckets;
+    Zio_Cache_Entry *entry;
+    size_t bucket_count;
+    size_t bucket;
+
+    LOG(("in: zio_cache_resize_buckets(size_limit=%ld)",
+	(long)shard->size_limit));
+
+    bucket_count = ZIO_MIN_CACHE_BUCKETS;
+    while (bucket_count < shard->size_limit / ZIO_SIZE_PAGE)
+	bucket_count <<= 1;
+    if (bucket_count == shard->bucket_count)
+	goto succeeded;
+
+    shard->buckets = (Zio_Cache_Entry **)
+	calloc(bucket_count, sizeof(Zio_Cache_Entry *));
+    if (shard->buckets == NULL) {
+	shard->buckets = old_buckets;
+	goto failed;
+    }
+    shard->bucket_count = bucket_count;
+
+    /*
+     * Rehash cached slices.
+     */
+    for (entry = shard->lru_head; entry != NULL; entry = entry->lru_next) {
+	bucket = zio_cache_bucket(shard,
+	    zio_cache_hash(entry->zio_id, entry->location));
+	entry->hash_next = shard->buckets[bucket];
+	shard->buckets[bucket] = entry;
+    }
+    if (old_buckets != NULL)
+	free(old_buckets);
+
+  succeeded:
+    LOG(("out: zio_cache_resize_buckets() = %d", 0));
+    return 0;
+
+    /*
+     * An error occurs...
+     */
+  failed:
+    LOG(("out: zio_cache_resize_buckets() = %d", -1));
+    return -1;
+}
+
+
+/*
+ * Find the slice at `location' in the zio `zio_id' in `shard', whose
+ * hash value is `hash'.  The shard must be locked.
+ */
+static Zio_Cache_Entry *
+zio_cache_find(Zio_Cache_Shard *shard, size_t hash, int zio_id,
+    off_t location)
+{
+    Zio_Cache_Entry *entry;
+
+    if (shard->buckets == NULL)
+	return NULL;
+
+    entry = shard->buckets[zio_cache_bucket(shard, hash)];
+    while (entry != NULL) {
+	if (entry->zio_id == zio_id && entry->location == location)
+	    break;
+	entry = entry->hash_next;
+    }
+
+    return entry;
+}
+
+
+/*
+ * Test whether the slice at `location' in the zio `zio_id' is cached.
+ * Unlike zio_cache_read(), it neither counts a hit or a miss nor
+ * changes the LRU order.
+ */
+static int
+zio_cache_contains(int zio_id, off_t location)
+{
+    Zio_Cache_Shard *shard;
+    size_t hash;
+    int result;
+
+    if (!cache_initialized)
+	return 0;
+
+    hash = zio_cache_hash(zio_id, location);
+    shard = zio_cache_shard(hash);
+
+    pthread_mutex_lock(&shard->mutex);
+    result = zio_cache_find(shard, hash, zio_id, location) != NULL;
+    pthread_mutex_unlock(&shard->mutex);
+
+    return result;
+}
+
+
+/*
+ * Copy `length' bytes at `offset' of the slice at `location' in the
+ * zio `zio_id' to `buffer', and mark the slice as the most recently
+ * used one in its shard.  Return -1 if the slice is not cached.
+ *
+ * The data is copied while the shard is locked, since another thread
+ * may discard the slice as soon as the lock is released.
+ */
+static int
+zio_cache_read(int zio_id, off_t location, size_t offset, char *buffer,
+    size_t length)
+{
+    Zio_Cache_Shard *shard;
+    Zio_Cache_Entry *entry;
+    size_t hash;
+
+    if (!cache_initialized)
+	return -1;
+
+    hash = zio_cache_hash(zio_id, location);
+    shard = zio_cache_shard(hash);
+
+    pthread_mutex_lock(&shard->mutex);
+    entry = zio_cache_find(shard, hash, zio_id, location);
+    if (entry == NULL) {
+	shard->misses++;
+	pthread_mutex_unlock(&shard->mutex);
+	return -1;
+    }
+    shard->hits++;
+    if (entry->prefetched) {
+	entry->prefetched = 0;
+	shard->prefetch_used++;
+    }
+
+    /*
+     * Move the entry to the head of the LRU list.
+     */
+    if (entry != shard->lru_head) {
+	entry->lru_prev->lru_next = entry->lru_next;
+	if (entry->lru_next != NULL)
+	    entry->lru_next->lru_prev = entry->lru_prev;
+	else
+	    shard->lru_tail = entry->lru_prev;
+	entry->lru_prev = NULL;
+	entry->lru_next = shard->lru_head;
+	shard->lru_head->lru_prev = entry;
+	shard->lru_head = entry;
+    }
+
+    memcpy(buffer, entry->buffer + offset, length);
+    pthread_mutex_unlock(&shard->mutex);
+
+    return 0;
+}
+
+
+/*
+ * Allocate a cache entry with a buffer of `size' bytes.  The entry is
+ * private to the caller until it is passed to zio_cache_insert().
+ */
+static Zio_Cache_Entry *
+zio_cache_allocate(size_t size)
+{
+    Zio_Cache_Entry *entry;
+
+    entry = (Zio_Cache_Entry *) malloc(sizeof(Zio_Cache_Entry) + size);
+    if (entry == NULL)
+	return NULL;
+    entry->size = size;
+    entry->buffer = (char *) (entry + 1);
+    entry->prefetched = 0;
+
+    return entry;
+}
+
+
+/*
+ * Put `entry' holding the slice at `location' in the zio `zio_id' to
+ * the cache as the most recently used slice of its shard, discarding
+ * the least recently used slices to make room for it.  If the slice is
+ * cached already, the old copy is replaced.  The cache takes ownership
+ * of `entry'.
+ */
+static void
+zio_cache_insert(Zio_Cache_Entry *entry, int zio_id, off_t location)
+{
+    Zio_Cache_Shard *shard;
+    Zio_Cache_Entry *old_entry;
+    size_t hash;
+    size_t bucket;
+
+    if (!cache_initialized) {
+	free(entry);
+	return;
+    }
+
+    hash = zio_cache_hash(zio_id, location);
+    shard = zio_cache_shard(hash);
+
+    pthread_mutex_lock(&shard->mutex);
+    if (shard->buckets == NULL) {
+	pthread_mutex_unlock(&shard->mutex);
+	free(entry);
+	return;
+    }
+
+    old_entry = zio_cache_find(shard, hash, zio_id, location);
+    if (old_entry != NULL)
+	zio_cache_remove(shard, old_entry);
+
+    if (entry->size < shard->size_limit)
+	zio_cache_evict(shard, shard->size_limit - entry->size);
+    else
+	zio_cache_evict(shard, 0);
+
+    entry->zio_id = zio_id;
+    entry->location = location;
+    bucket = zio_cache_bucket(shard, hash);
+    entry->hash_next = shard->buckets[bucket];
+    shard->buckets[bucket] = entry;
+
+    entry->lru_prev = NULL;
+    entry->lru_next = shard->lru_head;
+    if (shard->lru_head != NULL)
+	shard->lru_head->lru_prev = entry;
+    else
+	shard->lru_tail = entry;
+    shard->lru_head = entry;
+
+    shard->size += entry->size;
+    pthread_mutex_unlock(&shard->mutex);
+}
+
+
+/*
+ * Remove `entry' from `shard' and free it.  The shard must be locked.
+ */
+static void
+zio_cache_remove(Zio_Cache_Shard *shard, Zio_Cache_Entry *entry)
+{
+    Zio_Cache_Entry **link;
+
+    link = &shard->buckets[zio_cache_bucket(shard,
+	zio_cache_hash(entry->zio_id, entry->location))];
+    while (*link != entry)
+	link = &(*link)->hash_next;
+    *link = entry->hash_next;
+
+    if (entry->lru_prev != NULL)
+	entry->lru_prev->lru_next = entry->lru_next;
+    else
+	shard->lru_head = entry->lru_next;
+    if (entry->lru_next != NULL)
+	entry->lru_next->lru_prev = entry->lru_prev;
+    else
+	shard->lru_tail = entry->lru_prev;
+
+    shard->size -= entry->size;
+    free(entry);
+}
+
+
+/*
+ * Discard the least recently used slices until `shard' holds no more
+ * than `size_limit' bytes.  The shard must be locked.
+ */
+static void
+zio_cache_evict(Zio_Cache_Shard *shard, size_t size_limit)
+{
+    while (shard->lru_tail != NULL && size_limit < shard->size)
+	zio_cache_remove(shard, shard->lru_tail);
+}
+
+
+/*
+ * Discard all slices of the zio `zio_id'.
+ */
+static void
+zio_cache_purge(int zio_id)
+{
+    Zio_Cache_Shard *shard;
+    Zio_Cache_Entry *entry;
+    Zio_Cache_Entry *next_entry;
+    int i;
+
+    if (!cache_initialized)
+	return;
+
+    for (i = 0, shard = cache_shards; i < ZIO_CACHE_SHARD_COUNT;
+	 i++, shard++) {
+	pthread_mutex_lock(&shard->mutex);
+	for (entry = shard->lru_head; entry != NULL; entry = next_entry) {
+	    next_entry = entry->lru_next;
+	    if (entry->zio_id == zio_id)
+		zio_cache_remove(shard, entry);
+	}
+	pthread_mutex_unlock(&shard->mutex);
+    }
+}
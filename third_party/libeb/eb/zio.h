@@ -83,6 +83,13 @@ typedef int Zio_Code;
  */
 typedef struct Zio_Huffman_Node_Struct Zio_Huffman_Node;
 
+/*
+ * An entry of a Huffman decode table.
+ */
+typedef struct Zio_Huffman_Entry_Struct Zio_Huffman_Entry;
+
+typedef struct Zio_Huffman_Tree_Struct Zio_Huffman_Tree;
+
 struct Zio_Huffman_Node_Struct {
     /*
      * node type (ITNERMEDIATE, LEAF8, LEAF16, LEAF32 or EOF).
@@ -108,6 +115,26 @@ struct Zio_Huffman_Node_Struct {
      * Right child.
      */
     Zio_Huffman_Node *right;
+
+    /*
+     * Decode table indexed by the next `table_bits' bits of input.
+     * (root and some other intermediate nodes only)
+     */
+    Zio_Huffman_Entry *table;
+    int table_bits;
+};
+
+struct Zio_Huffman_Entry_Struct {
+    /*
+     * The leaf the code decodes to, or an intermediate node whose table
+     * decodes the rest of the code.
+     */
+    Zio_Huffman_Node *node;
+
+    /*
+     * The number of bits of the code to get to `node'.
+     */
+    int length;
 };
 
 /*
@@ -196,6 +223,18 @@ struct Zio_Struct {
      */
     Zio_Huffman_Node *huffman_root;
 
+    /*
+     * Decode tables of the Huffman tree. (EPWING compression only)
+     */
+    Zio_Huffman_Entry *huffman_tables;
+
+    /*
+     * Huffman tree shared with other zios opening the same file, which
+     * owns `huffman_nodes' and `huffman_tables'.  NULL if they are
+     * owned by this zio.  (EPWING compression only)
+     */
+    Zio_Huffman_Tree *huffman_tree;
+
     /*
      * Region of compressed pages. (S-EBXA compression only)
      */
@@ -207,10 +246,26 @@ struct Zio_Struct {
      */
     off_t index_base;
 
+    /*
+     * Location of the slice read last, and the end of the slices queued
+     * for prefetching after it.  (EBZIP compression only)
+     */
+    off_t prefetch_last_location;
+    off_t prefetch_end_location;
+
     /*
      * ebnet mode flag.
      */
     int is_ebnet;
+
+    /*
+     * The whole file mapped into memory, its length, and the current
+     * location in it.  `mapping' is NULL if the file is read with
+     * read().
+     */
+    const char *mapping;
+    size_t mapping_length;
+    off_t mapping_location;
 };
 
 /*
@@ -219,6 +274,11 @@ struct Zio_Struct {
 /* zio.c */
 int zio_initialize_library(void);
 void zio_finalize_library(void);
+int zio_set_cache_size(size_t size);
+void zio_cache_statistics(unsigned long *hits, unsigned long *misses);
+void zio_set_mmap(int enable);
+int zio_set_prefetch(int thread_count, int slice_count);
+void zio_prefetch_statistics(unsigned long *issued, unsigned long *used);
 void zio_initialize(Zio *zio);
 void zio_finalize(Zio *zio);
 int zio_set_sebxa_mode(Zio *zio, off_t index_location, off_t index_base,
@@ -0,0 +1,230 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * simplify-backlinks reads every text of a book and writes an index of
+ * the references between them, inverted so that simplify can tell which
+ * texts refer to a given one. See simplify/epwing/backlink-index.hh for
+ * the format. Bind the index to a dictionary with the "backlinks" state
+ * key.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <iostream>
+#include <string>
+#include <system_error>
+
+#include <eb/eb.h>
+#include <eb/error.h>
+#include <eb/text.h>
+
+#include <simplify/epwing/backlink-index.hh>
+
+#include "text-walker.hh"
+
+namespace tools {
+
+namespace {
+
+struct Options {
+    bool verbose = false;
+    std::string book_dir;
+    std::string output_path;
+};
+
+/// Argument of the reference hook.
+struct WalkContext {
+    simplify::BacklinkIndex::Builder *builder;
+    int subbook;
+    uint64_t source;
+    size_t reference_count;
+};
+
+EB_Error_Code HandleEndReference(EB_Book *, EB_Appendix *, void *container,
+                                 EB_Hook_Code, int argc,
+                                 const unsigned int *argv)
+{
+    auto context = static_cast<WalkContext *>(container);
+    if (argc < 3)
+        return EB_SUCCESS;
+
+    uint64_t target = simplify::BacklinkIndex::MakeKey(
+        context->subbook, static_cast<int>(argv[1]), static_cast<int>(argv[2]));
+    if (target != context->source) {
+        context->builder->Add(target, context->source);
+        ++context->reference_count;
+    }
+    return EB_SUCCESS;
+}
+
+/**
+ * Adds references of all texts of the current sub-book to @context.
+ */
+EB_Error_Code WalkSubBook(EB_Book &book, WalkContext &context)
+{
+    EB_Hookset hookset;
+    EB_Hook hooks[] = {
+        { EB_HOOK_END_REFERENCE, &HandleEndReference },
+        { EB_HOOK_NULL, NULL }
+    };
+
+    eb_initialize_hookset(&hookset);
+    EB_Error_Code eb_code = eb_set_hooks(&hookset, hooks);
+    if (eb_code == EB_SUCCESS) {
+        // The text itself is of no interest.
+        eb_code = WalkTexts(book, hookset, &context,
+            [&context](const EB_Position &position) {
+                context.source = simplify::BacklinkIndex::MakeKey(
+                    context.subbook, position.page, position.offset);
+            },
+            [](const char *, size_t) {});
+    }
+
+    eb_finalize_hookset(&hookset);
+    return eb_code;
+}
+
+void PrintHelpAndExit(int status)
+{
+    std::cout << R"#(
+Usage: simplify-backlinks [options] BOOK-DIR OUTPUT
+
+Reads every text of the book in BOOK-DIR and writes the index of texts
+referring to each text to OUTPUT.
+
+  -v, --verbose
+      Print the number of references found in each sub-book.
+
+  -h, --help
+      Print this help text and exit.
+)#" << std::endl;
+    exit(status);
+}
+
+bool ParseCommandLine(int argc, char *argv[], Options &options)
+{
+    static option g_options[] = {
+        { "verbose", 0, 0, 'v' },
+        { "help", 0, 0, 'h' },
+        { 0, 0, 0, 0 }
+    };
+
+    while (true) {
+        int argv_index;
+        int c = getopt_long(argc, argv, "vh", g_options, &argv_index);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 'v': {
+                options.verbose = true;
+                break;
+            }
+            case 'h': {
+                PrintHelpAndExit(0);
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+
+    if (optind + 2 != argc)
+        PrintHelpAndExit(1);
+    options.book_dir = argv[optind];
+    options.output_path = argv[optind + 1];
+    return true;
+}
+
+std::error_code EbError(EB_Error_Code code)
+{
+    return simplify::make_error_code(static_cast<simplify::eb_error>(code));
+}
+
+std::error_code IndexBook(const Options &options, EB_Book &book)
+{
+    EB_Subbook_Code subbooks[EB_MAX_SUBBOOKS];
+    int subbook_count;
+    EB_Error_Code eb_code = eb_subbook_list(&book, subbooks, &subbook_count);
+    if (eb_code != EB_SUCCESS)
+        return EbError(eb_code);
+
+    simplify::BacklinkIndex::Builder builder(subbook_count);
+    for (int i = 0; i < subbook_count; ++i) {
+        eb_code = eb_set_subbook(&book, subbooks[i]);
+        if (eb_code != EB_SUCCESS)
+            return EbError(eb_code);
+        if (!eb_have_text(&book))
+            continue;
+
+        WalkContext context = { &builder, i, 0, 0 };
+        eb_code = WalkSubBook(book, context);
+        if (eb_code != EB_SUCCESS)
+            return EbError(eb_code);
+
+        if (options.verbose) {
+            std::cout << "Sub-book " << i << ": " << context.reference_count
+                      << " references." << std::endl;
+        }
+    }
+
+    return builder.Write(options.output_path.c_str());
+}
+
+}  // namespace
+
+}  // namespace tools
+
+int main(int argc, char *argv[])
+{
+    tools::Options options;
+    if (!tools::ParseCommandLine(argc, argv, options))
+        return 1;
+
+    EB_Book book;
+    EB_Error_Code eb_error;
+
+    eb_initialize_library();
+    eb_initialize_book(&book);
+
+    eb_error = eb_bind(&book, options.book_dir.c_str());
+    if (eb_error != EB_SUCCESS) {
+        std::cerr << "Unable to open book in '" << options.book_dir
+                  << "': " << eb_error_message(eb_error) << "." << std::endl;
+        eb_finalize_book(&book);
+        eb_finalize_library();
+        return 1;
+    }
+
+    std::error_code error = tools::IndexBook(options, book);
+    eb_finalize_book(&book);
+    eb_finalize_library();
+
+    if (error) {
+        std::cerr << "Unable to index book: " << error.message() << "."
+                  << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,45 @@
+// ====================================================================
+// User script used by simplify-bench.
+//
+// The script does roughly the same amount of work per heading and per
+// article as the scripts bundled with simplify: a few regular expression
+// passes over the text, character mapping and HTML decoration.
+// ====================================================================
+
+var latinRe = /[０-ｚ]/g;
+var latinFun = function($0) {
+  return String.fromCharCode($0.charCodeAt(0) - 0xfee0);
+};
+
+function Indent(amount) {
+  return '<span class="a-indent"></span>';
+}
+
+function Newline() {
+  return '</p><p>';
+}
+
+ProcessHeading = function(text) {
+  return text.replace(latinRe, latinFun);
+};
+
+ProcessTags = function(text) {
+  var first = text.replace(latinRe, latinFun).charAt(0);
+  return first !== '' ? '[' + first.toUpperCase() + ']'
+                      : '';
+};
+
+ProcessText = (function() {
+  var titleRe = /^\s*(.+?)<\/p>/;
+  var punctuationRe = /([、。])/g;
+
+  return function(text) {
+    text = '<p>' + text + '</p>';
+    text = text.replace(titleRe, '<div class="article-title">$1</div>');
+    text = text.replace(latinRe, latinFun);
+    text = text.replace(punctuationRe, '<span class="a-p">$1</span>');
+    text = _LinkifyReferences(text);
+
+    return text;
+  };
+})();
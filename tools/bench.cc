@@ -0,0 +1,592 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * simplify-bench measures EpwingDictionary against a book generated by
+ * simplify-mkbook (or any other book accompanied by a list of words). Each
+ * pass runs the same query mix, once with the built-in script only and
+ * once with a user script loaded, and reports search latency, hit, heading
+ * and article throughput. Books generated by simplify-mkbook also get
+ * their keyword and multi search results checked against the topics of
+ * their entries. Every book is checked to survive opening binary data at
+ * a position it doesn't have.
+ */
+
+#include <getopt.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <simplify/error.hh>
+#include <simplify/simplify.hh>
+#include <simplify/epwing/epwing-dictionary.hh>
+
+namespace tools {
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options {
+    std::string book_path;
+    std::string words_path;
+    std::string script_path = SIMPLIFY_BENCH_SCRIPT;
+    size_t query_count = 2000;
+    size_t warmup_count = 200;
+    size_t result_limit = 800;
+    size_t articles_per_query = 1;
+    uint64_t seed = 1;
+};
+
+struct PassStats {
+    std::vector<double> search_us;
+    size_t errors = 0;
+    size_t hits = 0;
+    size_t headings = 0;
+    size_t articles = 0;
+    size_t article_bytes = 0;
+    Clock::duration search_time{};
+    Clock::duration seek_time{};
+    Clock::duration heading_time{};
+    Clock::duration article_time{};
+};
+
+/**
+ * Same generator as in simplify-mkbook, it keeps the query mix identical
+ * between platforms.
+ */
+class Random {
+public:
+    explicit Random(uint64_t seed) : state_(seed * 2 + 1) {}
+
+    uint32_t Next()
+    {
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return (state_ * 2685821657736338717ULL) >> 32;
+    }
+
+private:
+    uint64_t state_;
+};
+
+double ToSeconds(Clock::duration d)
+{
+    return std::chrono::duration<double>(d).count();
+}
+
+double PerSecond(size_t count, Clock::duration d)
+{
+    double seconds = ToSeconds(d);
+    return seconds > 0 ? count / seconds : 0;
+}
+
+double Percentile(const std::vector<double> &sorted, double p)
+{
+    if (sorted.empty())
+        return 0;
+    return sorted[static_cast<size_t>(p * (sorted.size() - 1))];
+}
+
+/**
+ * Builds the query mix: half of the queries are complete headwords, the
+ * other half are prefixes of at least two characters, which typically
+ * produce many more hits.
+ */
+std::vector<std::string> MakeQueries(const std::vector<std::string> &words,
+                                     size_t count, uint64_t seed)
+{
+    Random random(seed);
+    std::vector<std::string> queries;
+
+    queries.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        const std::string &word = words[random.Next() % words.size()];
+
+        if (word.size() > 2 && random.Next() % 2 == 0)
+            queries.push_back(
+                word.substr(0, 2 + random.Next() % (word.size() - 2)));
+        else
+            queries.push_back(word);
+    }
+
+    return queries;
+}
+
+void RunQuery(simplify::Dictionary &dict, const std::string &query,
+              const Options &options, PassStats *stats)
+{
+    Clock::time_point start = Clock::now();
+    auto likely_results = dict.Search(query.c_str(), options.result_limit);
+    Clock::time_point end = Clock::now();
+
+    if (stats != nullptr) {
+        stats->search_time += end - start;
+        stats->search_us.push_back(
+            std::chrono::duration<double, std::micro>(end - start).count());
+    }
+
+    if (!likely_results) {
+        if (stats != nullptr)
+            ++stats->errors;
+        return;
+    }
+
+    std::unique_ptr<simplify::Dictionary::SearchResults>
+        results(likely_results.value_checked());
+    std::vector<std::string> guids;
+    char guid[4 * 1024];
+
+    while (true) {
+        start = Clock::now();
+        std::error_code seek_error = results->SeekNext();
+        end = Clock::now();
+        if (seek_error) {
+            if (stats != nullptr
+                && seek_error != simplify::simplify_error::no_more_results)
+                ++stats->errors;
+            break;
+        }
+
+        size_t length = 0;
+        auto likely_length = results->FetchGuid(guid, sizeof(guid));
+        auto likely_heading = results->FetchHeading(&length);
+        auto likely_tags = results->FetchTags(&length);
+        Clock::time_point heading_end = Clock::now();
+
+        if (stats == nullptr)
+            continue;
+
+        stats->seek_time += end - start;
+        stats->heading_time += heading_end - end;
+        ++stats->hits;
+
+        // Scripts may legitimately reject results by returning a value of
+        // unexpected type from ProcessHeading.
+        if (likely_length && likely_heading && likely_tags) {
+            ++stats->headings;
+            if (guids.size() < options.articles_per_query)
+                guids.emplace_back(guid, likely_length.value_checked());
+        } else if (likely_heading.error_code()
+                   != simplify::simplify_error::unexpected_result_type) {
+            ++stats->errors;
+        }
+    }
+
+    for (const std::string &g : guids) {
+        size_t length = 0;
+
+        start = Clock::now();
+        auto likely_text = dict.ReadText(g.c_str(), &length);
+        end = Clock::now();
+
+        stats->article_time += end - start;
+        if (likely_text) {
+            ++stats->articles;
+            stats->article_bytes += length;
+        } else {
+            ++stats->errors;
+        }
+    }
+}
+
+void PrintStats(const char *pass, PassStats &stats)
+{
+    std::vector<double> &latency = stats.search_us;
+    std::sort(latency.begin(), latency.end());
+
+    std::cout << std::fixed << std::setprecision(1)
+              << "[" << pass << "] search:   " << latency.size()
+              << " queries, " << PerSecond(latency.size(), stats.search_time)
+              << " queries/s, p50 " << Percentile(latency, 0.50)
+              << " us, p90 " << Percentile(latency, 0.90)
+              << " us, p99 " << Percentile(latency, 0.99)
+              << " us, max " << Percentile(latency, 1.0) << " us\n"
+              << "[" << pass << "] hits:     " << stats.hits << " hits, "
+              << PerSecond(stats.hits, stats.seek_time) << " hits/s\n"
+              << "[" << pass << "] headings: " << stats.headings
+              << " headings, "
+              << PerSecond(stats.headings, stats.heading_time)
+              << " headings/s\n"
+              << "[" << pass << "] articles: " << stats.articles
+              << " articles, "
+              << PerSecond(stats.articles, stats.article_time)
+              << " articles/s, "
+              << PerSecond(stats.article_bytes, stats.article_time) / 1e6
+              << " MB/s\n"
+              << "[" << pass << "] errors:   " << stats.errors << std::endl;
+}
+
+bool RunPass(const char *pass, const char *script_path,
+             const std::vector<std::string> &queries, const Options &options)
+{
+    auto likely_dict = simplify::EpwingDictionary::New(
+        pass, options.book_path.c_str(), script_path);
+    if (!likely_dict) {
+        std::cerr << "Unable to open dictionary '" << options.book_path
+                  << "': " << likely_dict.error_code().message() << "."
+                  << std::endl;
+        return false;
+    }
+    std::unique_ptr<simplify::EpwingDictionary>
+        dict(likely_dict.value_checked());
+
+    // Warm up the page cache, libeb caches and the JIT before measuring.
+    size_t warmup_count = std::min(options.warmup_count, queries.size());
+    for (size_t i = 0; i < warmup_count; ++i)
+        RunQuery(*dict, queries[i], options, nullptr);
+
+    PassStats stats;
+    stats.search_us.reserve(queries.size());
+    for (const std::string &query : queries)
+        RunQuery(*dict, query, options, &stats);
+
+    PrintStats(pass, stats);
+    return true;
+}
+
+/**
+ * Returns the number of results of @query, or -1 if the search fails.
+ */
+long CountResults(simplify::Dictionary &dict, const std::string &query,
+                  size_t limit)
+{
+    auto likely_results = dict.Search(query.c_str(), limit);
+    if (!likely_results)
+        return -1;
+
+    std::unique_ptr<simplify::Dictionary::SearchResults>
+        results(likely_results.value_checked());
+    std::error_code error;
+    long count = 0;
+
+    while (!(error = results->SeekNext()))
+        ++count;
+    return error == simplify::simplify_error::no_more_results ? count : -1;
+}
+
+/**
+ * Searches every pair of topics listed in @topics_path with keyword (`a &
+ * b`) and multi (`#0: a & b`) search expressions and compares the number
+ * of results with the number of entries having both topics. Returns
+ * true if the book has no topics.
+ */
+bool CheckTopics(const std::string &topics_path, const Options &options)
+{
+    std::ifstream stream(topics_path);
+    if (!stream)
+        return true;
+
+    std::vector<std::set<std::string>> entries;
+    std::set<std::string> topics;
+    std::string line;
+    while (std::getline(stream, line)) {
+        std::istringstream words(line);
+        std::set<std::string> entry_topics;
+        std::string topic;
+
+        while (words >> topic)
+            entry_topics.insert(topic);
+        topics.insert(entry_topics.begin(), entry_topics.end());
+        entries.push_back(std::move(entry_topics));
+    }
+
+    auto likely_dict = simplify::EpwingDictionary::New(
+        "topics", options.book_path.c_str(), nullptr);
+    if (!likely_dict) {
+        std::cerr << "Unable to open dictionary '" << options.book_path
+                  << "': " << likely_dict.error_code().message() << "."
+                  << std::endl;
+        return false;
+    }
+    std::unique_ptr<simplify::EpwingDictionary>
+        dict(likely_dict.value_checked());
+
+    size_t query_count = 0;
+    size_t mismatches = 0;
+    long max_count = 0;
+
+    for (auto a = topics.begin(); a != topics.end(); ++a) {
+        for (auto b = std::next(a); b != topics.end(); ++b) {
+            long expected = 0;
+            for (const std::set<std::string> &entry : entries)
+                expected += entry.count(*a) && entry.count(*b);
+
+            for (const char *prefix : { "", "#0: " }) {
+                std::string query = prefix + *a + " & " + *b;
+                long count = CountResults(*dict, query, entries.size());
+
+                ++query_count;
+                max_count = std::max(max_count, count);
+                if (count != expected) {
+                    std::cerr << "'" << query << "': " << count
+                              << " results, expected " << expected << "."
+                              << std::endl;
+                    ++mismatches;
+                }
+            }
+        }
+    }
+
+    std::cout << "[topics] " << query_count << " queries, up to "
+              << max_count << " results, " << mismatches << " mismatches"
+              << std::endl;
+    return mismatches == 0;
+}
+
+/**
+ * Opens sound and color graphics past the end of the book, which must
+ * fail, and searches the book afterwards. A failed open used to leave
+ * the dictionary locked, so both are given a deadline.
+ */
+bool CheckBadBinary(const Options &options)
+{
+    auto likely_dict = simplify::EpwingDictionary::New(
+        "binary", options.book_path.c_str(), nullptr);
+    if (!likely_dict) {
+        std::cerr << "Unable to open dictionary '" << options.book_path
+                  << "': " << likely_dict.error_code().message() << "."
+                  << std::endl;
+        return false;
+    }
+    std::unique_ptr<simplify::EpwingDictionary>
+        dict(likely_dict.value_checked());
+
+    auto check = std::async(std::launch::async, [&dict]() {
+        const char kBadPosition[] = "99999999:0";
+        const simplify::Dictionary::BinaryType types[] = {
+            simplify::Dictionary::BinaryType::Sound,
+            simplify::Dictionary::BinaryType::ColorGraphic,
+        };
+        size_t opened = 0;
+
+        for (auto type : types) {
+            simplify::Dictionary::BinaryLocation location{
+                type, kBadPosition, kBadPosition, 0, 0};
+            auto likely_stream = dict->OpenBinary(location);
+            if (likely_stream) {
+                delete likely_stream.value_checked();
+                ++opened;
+            }
+        }
+
+        // Any outcome will do, as long as the search returns.
+        auto likely_results = dict->Search("a", 1);
+        if (likely_results)
+            delete likely_results.value_checked();
+        return opened;
+    });
+
+    if (check.wait_for(std::chrono::seconds(10))
+        == std::future_status::timeout) {
+        std::cerr << "[binary] dictionary hangs after opening binary data "
+                  << "at a bad position." << std::endl;
+        // The future would wait for the hung thread.
+        _Exit(1);
+    }
+
+    size_t opened = check.get();
+    std::cout << "[binary] " << opened
+              << " binaries opened at a bad position" << std::endl;
+    return opened == 0;
+}
+
+void PrintHelpAndExit(int status)
+{
+    Options default_options{};
+
+    std::cout << R"#(
+Usage: simplify-bench [options] BOOK-DIR
+
+Benchmarks search and article rendering of an EPWING book.
+
+  -w WORDS-FILE, --words WORDS-FILE
+      File with one headword per line used to build queries.
+      Default: BOOK-DIR/words.txt.
+
+  -s SCRIPT, --script SCRIPT
+      User script for the scripted pass. An empty string disables the
+      pass. Default: )#" << default_options.script_path << R"#(
+
+  -n COUNT, --queries COUNT
+      Number of measured queries per pass. Default: )#"
+        << default_options.query_count << R"#(.
+
+  -W COUNT, --warmup COUNT
+      Number of queries run before measuring. Default: )#"
+        << default_options.warmup_count << R"#(.
+
+  -l LIMIT, --limit LIMIT
+      Maximum number of results per query. Default: )#"
+        << default_options.result_limit << R"#(.
+
+  -a COUNT, --articles COUNT
+      Number of articles read per query. Default: )#"
+        << default_options.articles_per_query << R"#(.
+
+  -S SEED, --seed SEED
+      Seed of the query mix. Default: )#" << default_options.seed << R"#(.
+
+  -h, --help
+      Print this help text and exit.
+)#" << std::endl;
+    exit(status);
+}
+
+bool ParseSize(const char *s, size_t *value)
+{
+    char *endptr;
+    *value = strtoul(s, &endptr, 10);
+    return *s != '\0' && *endptr == '\0';
+}
+
+bool ParseCommandLine(int argc, char *argv[], Options &options)
+{
+    static option g_options[] = {
+        { "words", 1, 0, 'w' },
+        { "script", 1, 0, 's' },
+        { "queries", 1, 0, 'n' },
+        { "warmup", 1, 0, 'W' },
+        { "limit", 1, 0, 'l' },
+        { "articles", 1, 0, 'a' },
+        { "seed", 1, 0, 'S' },
+        { "help", 0, 0, 'h' },
+        { 0, 0, 0, 0 }
+    };
+
+    while (true) {
+        int argv_index;
+        int c = getopt_long(argc, argv, "w:s:n:W:l:a:S:h", g_options,
+                            &argv_index);
+        if (c == -1)
+            break;
+
+        bool valid = true;
+        switch (c) {
+            case 'w':
+                options.words_path = optarg;
+                break;
+            case 's':
+                options.script_path = optarg;
+                break;
+            case 'n':
+                valid = ParseSize(optarg, &options.query_count)
+                    && options.query_count > 0;
+                break;
+            case 'W':
+                valid = ParseSize(optarg, &options.warmup_count);
+                break;
+            case 'l':
+                valid = ParseSize(optarg, &options.result_limit)
+                    && options.result_limit > 0;
+                break;
+            case 'a':
+                valid = ParseSize(optarg, &options.articles_per_query);
+                break;
+            case 'S': {
+                size_t seed;
+                valid = ParseSize(optarg, &seed);
+                options.seed = seed;
+                break;
+            }
+            case 'h':
+                PrintHelpAndExit(0);
+                break;
+            default:
+                return false;
+        }
+
+        if (!valid) {
+            std::cerr << "Invalid value of option -" << static_cast<char>(c)
+                      << "." << std::endl;
+            return false;
+        }
+    }
+
+    if (optind + 1 != argc)
+        PrintHelpAndExit(1);
+    options.book_path = argv[optind];
+    if (options.words_path.empty())
+        options.words_path = options.book_path + "/words.txt";
+
+    return true;
+}
+
+}  // namespace
+
+}  // namespace tools
+
+int main(int argc, char *argv[])
+{
+    tools::Options options;
+    if (!tools::ParseCommandLine(argc, argv, options))
+        return 1;
+
+    std::vector<std::string> words;
+    {
+        std::ifstream stream(options.words_path);
+        std::string word;
+        while (std::getline(stream, word)) {
+            if (!word.empty())
+                words.push_back(word);
+        }
+    }
+    if (words.empty()) {
+        std::cerr << "No words in '" << options.words_path << "'."
+                  << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> queries =
+        tools::MakeQueries(words, options.query_count, options.seed);
+
+    simplify::Initialize();
+
+    int return_code = 0;
+    if (!tools::RunPass("builtin", nullptr, queries, options))
+        return_code = 1;
+    if (return_code == 0 && !options.script_path.empty()
+        && !tools::RunPass("script", options.script_path.c_str(), queries,
+                           options)) {
+        return_code = 1;
+    }
+    if (return_code == 0
+        && !tools::CheckTopics(options.book_path + "/topics.txt", options)) {
+        return_code = 1;
+    }
+    if (return_code == 0 && !tools::CheckBadBinary(options))
+        return_code = 1;
+
+    simplify::TearDown();
+    return return_code;
+}
@@ -0,0 +1,201 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <zlib.h>
+
+#include "ebzip-writer.hh"
+
+namespace tools {
+
+namespace {
+
+const size_t kHeaderSize = 22;
+const size_t kPageSize = 2048;
+
+typedef std::unique_ptr<FILE, decltype(&::fclose)> file_ptr;
+
+void AppendBigEndian(std::string &out, uint64_t value, int width)
+{
+    for (int i = width - 1; i >= 0; --i)
+        out.push_back(static_cast<char>((value >> (i * 8)) & 0xff));
+}
+
+/**
+ * Returns width of a slice location in the index table. libeb derives it
+ * from the size of the uncompressed file, so must we.
+ */
+int GetIndexWidth(uint64_t file_size)
+{
+    if (file_size < (uint64_t) 1 << 16)
+        return 2;
+    else if (file_size < (uint64_t) 1 << 24)
+        return 3;
+    else if (file_size < (uint64_t) 1 << 32)
+        return 4;
+    else
+        return 5;
+}
+
+/**
+ * Compresses a single slice into @out. The slice is stored as is if
+ * compression doesn't make it any smaller, libeb recognizes such slices
+ * by their size.
+ */
+bool CompressSlice(const char *slice, size_t slice_size, int level,
+                   std::vector<Bytef> &buffer, std::string &out)
+{
+    uLongf length = buffer.size();
+    int z_result = compress2(buffer.data(), &length,
+                             reinterpret_cast<const Bytef *>(slice),
+                             slice_size, level);
+    if (z_result != Z_OK)
+        return false;
+
+    if (length < slice_size)
+        out.assign(reinterpret_cast<const char *>(buffer.data()), length);
+    else
+        out.assign(slice, slice_size);
+    return true;
+}
+
+/**
+ * Compresses all slices of @data into @slices on @thread_count threads.
+ * Threads take slices in order one at a time, which keeps them busy
+ * even if some parts of the data compress slower than others.
+ */
+bool CompressSlices(const std::string &data, size_t slice_size, int level,
+                    int thread_count, std::vector<std::string> &slices)
+{
+    std::atomic<size_t> next_slice(0);
+    std::atomic<bool> failed(false);
+
+    auto compress = [&]() {
+        std::vector<Bytef> buffer(compressBound(slice_size));
+        std::string slice(slice_size, '\0');
+
+        while (!failed) {
+            size_t i = next_slice++;
+            if (i >= slices.size())
+                break;
+
+            // The last slice is padded with zeros.
+            size_t offset = i * slice_size;
+            size_t length = std::min(slice_size, data.size() - offset);
+            slice.replace(0, length, data, offset, length);
+            if (length < slice_size)
+                std::fill(slice.begin() + length, slice.end(), '\0');
+
+            if (!CompressSlice(slice.data(), slice_size, level, buffer,
+                               slices[i])) {
+                failed = true;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < thread_count; ++i)
+        threads.emplace_back(compress);
+    compress();
+    for (std::thread &thread : threads)
+        thread.join();
+
+    return !failed;
+}
+
+}  // namespace
+
+std::error_code WriteEbzipFile(const char *path,
+                               const std::string &data,
+                               const EbzipOptions &options)
+{
+    if (options.zip_level < 0 || options.zip_level > kMaxEbzipLevel)
+        return std::make_error_code(std::errc::invalid_argument);
+
+    const size_t slice_size = kPageSize << options.zip_level;
+    const size_t slice_count = (data.size() + slice_size - 1) / slice_size;
+    const int index_width = GetIndexWidth(data.size());
+
+    file_ptr file(fopen(path, "wb"), &::fclose);
+    if (!file)
+        return std::error_code(errno, std::generic_category());
+
+    // The header and the index table are written last, when locations and
+    // the checksum are known. Reserve space for them for now.
+    std::string index;
+    index.reserve((slice_count + 1) * index_width);
+
+    uint64_t location = kHeaderSize + (slice_count + 1) * index_width;
+    if (fseek(file.get(), location, SEEK_SET) != 0)
+        return std::error_code(errno, std::generic_category());
+
+    int thread_count = options.thread_count;
+    if (thread_count <= 0)
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<std::string> slices(slice_count);
+    if (!CompressSlices(data, slice_size, options.compression_level,
+                        thread_count, slices)) {
+        return std::make_error_code(std::errc::invalid_argument);
+    }
+
+    uLong adler = adler32(0, Z_NULL, 0);
+    for (size_t i = 0; i < slice_count; ++i) {
+        size_t offset = i * slice_size;
+        size_t length = std::min(slice_size, data.size() - offset);
+        adler = adler32(adler,
+                        reinterpret_cast<const Bytef *>(data.data() + offset),
+                        length);
+
+        AppendBigEndian(index, location, index_width);
+        if (fwrite(slices[i].data(), 1, slices[i].size(), file.get())
+            != slices[i].size()) {
+            return std::error_code(errno, std::generic_category());
+        }
+        location += slices[i].size();
+    }
+    AppendBigEndian(index, location, index_width);
+
+    std::string header("EBZip", 5);
+    header.push_back(static_cast<char>(0x10 | options.zip_level));
+    header.append(3, '\0');
+    AppendBigEndian(header, data.size(), 5);
+    AppendBigEndian(header, adler, 4);
+    AppendBigEndian(header, options.mtime, 4);
+
+    if (fseek(file.get(), 0, SEEK_SET) != 0
+        || fwrite(header.data(), 1, header.size(), file.get()) != header.size()
+        || fwrite(index.data(), 1, index.size(), file.get()) != index.size()
+        || fflush(file.get()) != 0) {
+        return std::error_code(errno, std::generic_category());
+    }
+
+    return std::error_code();
+}
+
+}  // namespace tools
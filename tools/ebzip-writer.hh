@@ -0,0 +1,58 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#ifndef TOOLS_EBZIP_WRITER_HH_
+#define TOOLS_EBZIP_WRITER_HH_
+
+#include <cstdint>
+#include <string>
+#include <system_error>
+
+namespace tools {
+
+/**
+ * Largest EBZIP level understood by libeb. Level N means that the data is
+ * split into slices of 2048 << N bytes, each compressed independently.
+ */
+const int kMaxEbzipLevel = 5;
+
+struct EbzipOptions {
+    /// Slice size exponent, the slice size is 2048 << @zip_level bytes.
+    int zip_level = 0;
+    /// zlib compression level, -1 selects the zlib default.
+    int compression_level = -1;
+    /// Modification time stored in the header.
+    uint32_t mtime = 0;
+    /// Number of threads compressing slices, 0 selects one per core.
+    int thread_count = 1;
+};
+
+/**
+ * Compresses @data using the EBZIP1 format and writes the result to the
+ * file at @path. Slices are compressed independently, so the output
+ * doesn't depend on @options.thread_count.
+ */
+std::error_code WriteEbzipFile(const char *path,
+                               const std::string &data,
+                               const EbzipOptions &options);
+
+}  // namespace tools
+
+#endif  // TOOLS_EBZIP_WRITER_HH_
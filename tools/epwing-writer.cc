@@ -0,0 +1,447 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "epwing-writer.hh"
+
+namespace tools {
+
+namespace {
+
+const size_t kPageSize = 2048;
+const size_t kPagesPerGroup = 16;
+const size_t kIndexRecordSize = 36;
+const size_t kHeaderSize5 = 32;
+const size_t kHeaderSize6 = 48;
+/// Number of two byte leaves, fixed by the format in version 6.
+const size_t kLeaf16Count5 = 2048;
+const size_t kLeaf16Count6 = 0x400;
+const size_t kLeaf32Count6 = 256;
+const uint32_t kMaxFrequency = 0xffff;
+
+typedef std::unique_ptr<FILE, decltype(&::fclose)> file_ptr;
+
+enum NodeType {
+    kIntermediate,
+    kEof,
+    kLeaf8,
+    kLeaf16,
+    kLeaf32,
+};
+
+struct Node {
+    NodeType type;
+    uint32_t value;
+    uint64_t frequency;
+    int left;
+    int right;
+};
+
+struct Code {
+    uint64_t bits;
+    int length;
+};
+
+void AppendBigEndian(std::string &out, uint64_t value, int width)
+{
+    for (int i = width - 1; i >= 0; --i)
+        out.push_back(static_cast<char>((value >> (i * 8)) & 0xff));
+}
+
+uint32_t GetBigEndian(const std::string &data, size_t offset, int width)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < width; ++i)
+        value = (value << 8) | static_cast<unsigned char>(data[offset + i]);
+    return value;
+}
+
+/**
+ * Returns up to @count values of width @width that occur most often at
+ * offsets aligned to two bytes within pages of @data.
+ */
+std::vector<uint32_t> FindFrequentValues(const std::string &data, int width,
+                                         size_t count)
+{
+    std::unordered_map<uint32_t, uint64_t> counts;
+    for (size_t page = 0; page < data.size(); page += kPageSize) {
+        for (size_t i = 0; i + width <= kPageSize; i += 2)
+            ++counts[GetBigEndian(data, page + i, width)];
+    }
+
+    std::vector<std::pair<uint64_t, uint32_t>> sorted;
+    sorted.reserve(counts.size());
+    for (const auto &item : counts)
+        sorted.emplace_back(item.second, item.first);
+    std::sort(sorted.begin(), sorted.end(),
+              [](const std::pair<uint64_t, uint32_t> &a,
+                 const std::pair<uint64_t, uint32_t> &b) {
+                  return a.first != b.first ? a.first > b.first
+                                            : a.second < b.second;
+              });
+
+    std::vector<uint32_t> values;
+    for (size_t i = 0; i < sorted.size() && i < count; ++i)
+        values.push_back(sorted[i].second);
+    std::sort(values.begin(), values.end());
+    return values;
+}
+
+/**
+ * Splits a page into indexes of leaves. Longest leaves are preferred.
+ */
+void TokenizePage(const char *page,
+                  const std::unordered_map<uint32_t, int> &leaf32,
+                  const std::unordered_map<uint32_t, int> &leaf16,
+                  int leaf8_base, std::vector<int> &tokens)
+{
+    tokens.clear();
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(page);
+
+    for (size_t i = 0; i < kPageSize;) {
+        if (!leaf32.empty() && i + 4 <= kPageSize) {
+            uint32_t value = (p[i] << 24) | (p[i + 1] << 16)
+                | (p[i + 2] << 8) | p[i + 3];
+            auto it = leaf32.find(value);
+            if (it != leaf32.end()) {
+                tokens.push_back(it->second);
+                i += 4;
+                continue;
+            }
+        }
+        if (i + 2 <= kPageSize) {
+            auto it = leaf16.find((p[i] << 8) | p[i + 1]);
+            if (it != leaf16.end()) {
+                tokens.push_back(it->second);
+                i += 2;
+                continue;
+            }
+        }
+        tokens.push_back(leaf8_base + p[i]);
+        i += 1;
+    }
+}
+
+/**
+ * Builds a Huffman tree from the leaves in @nodes the same way libeb does
+ * it when it opens a file. Decoding depends on the exact shape of the
+ * tree, so the order of leaves of equal frequency matters. Returns the
+ * index of the root node.
+ */
+int BuildTree(std::vector<Node> &nodes)
+{
+    const size_t leaf_count = nodes.size();
+
+    // Stable for equal frequencies in the same way the selection sort of
+    // libeb is.
+    for (size_t i = 0; i + 1 < leaf_count; ++i) {
+        size_t most = i;
+        for (size_t j = i + 1; j < leaf_count; ++j) {
+            if (nodes[most].frequency < nodes[j].frequency)
+                most = j;
+        }
+        std::swap(nodes[i], nodes[most]);
+    }
+
+    std::vector<uint64_t> weights;
+    for (const Node &node : nodes)
+        weights.push_back(node.frequency);
+
+    auto take_least = [&weights]() {
+        int least = -1;
+        for (size_t i = 0; i < weights.size(); ++i) {
+            if (weights[i] == 0)
+                continue;
+            if (least < 0 || weights[i] <= weights[least])
+                least = i;
+        }
+        return least;
+    };
+
+    for (size_t i = 1; i < leaf_count; ++i) {
+        Node node{kIntermediate, 0, 0, -1, -1};
+        node.left = take_least();
+        node.frequency = weights[node.left];
+        weights[node.left] = 0;
+        node.right = take_least();
+        node.frequency += weights[node.right];
+        weights[node.right] = 0;
+        nodes.push_back(node);
+        weights.push_back(node.frequency);
+    }
+
+    return nodes.size() - 1;
+}
+
+/**
+ * Assigns codes to leaves of the tree. A set bit selects the left child.
+ */
+bool AssignCodes(const std::vector<Node> &nodes, int root,
+                 std::vector<Code> &codes)
+{
+    codes.assign(nodes.size(), Code{0, 0});
+
+    std::vector<std::pair<int, Code>> stack{{root, Code{0, 0}}};
+    while (!stack.empty()) {
+        int index = stack.back().first;
+        Code code = stack.back().second;
+        stack.pop_back();
+
+        const Node &node = nodes[index];
+        if (node.type != kIntermediate) {
+            codes[index] = code;
+            continue;
+        }
+        if (code.length == 64)
+            return false;
+        stack.push_back({node.left,
+                         Code{(code.bits << 1) | 1, code.length + 1}});
+        stack.push_back({node.right,
+                         Code{code.bits << 1, code.length + 1}});
+    }
+    return true;
+}
+
+class BitWriter {
+public:
+    explicit BitWriter(std::string &out) : out_(out) {}
+
+    void Write(const Code &code)
+    {
+        for (int i = code.length - 1; i >= 0; --i) {
+            byte_ = (byte_ << 1) | ((code.bits >> i) & 1);
+            if (++bit_count_ == 8) {
+                out_.push_back(static_cast<char>(byte_));
+                byte_ = 0;
+                bit_count_ = 0;
+            }
+        }
+    }
+
+    void Flush()
+    {
+        if (bit_count_ > 0) {
+            out_.push_back(static_cast<char>(byte_ << (8 - bit_count_)));
+            byte_ = 0;
+            bit_count_ = 0;
+        }
+    }
+
+private:
+    std::string &out_;
+    unsigned byte_ = 0;
+    int bit_count_ = 0;
+};
+
+}  // namespace
+
+int GetEpwingCatalogHint(const EpwingOptions &options)
+{
+    return options.version == 6 ? 0x12 : 0x11;
+}
+
+std::error_code WriteEpwingFile(const char *path,
+                                const std::string &data,
+                                const EpwingOptions &options)
+{
+    if ((options.version != 5 && options.version != 6)
+        || data.empty() || data.size() % kPageSize != 0) {
+        return std::make_error_code(std::errc::invalid_argument);
+    }
+
+    const bool v6 = options.version == 6;
+
+    // Leaves are kept in the order they're stored in the frequency table,
+    // libeb builds its tree from the same order.
+    std::vector<uint32_t> values32;
+    if (v6)
+        values32 = FindFrequentValues(data, 4, kLeaf32Count6);
+    std::vector<uint32_t> values16 =
+        FindFrequentValues(data, 2, v6 ? kLeaf16Count6 : kLeaf16Count5);
+    if (v6) {
+        // The number of two byte leaves is fixed, fill it up with values
+        // which haven't been picked.
+        std::vector<bool> picked(0x10000);
+        for (uint32_t value : values16)
+            picked[value] = true;
+        for (uint32_t value = 0; values16.size() < kLeaf16Count6; ++value) {
+            if (!picked[value])
+                values16.push_back(value);
+        }
+    }
+
+    std::vector<Node> nodes;
+    std::unordered_map<uint32_t, int> leaf32;
+    std::unordered_map<uint32_t, int> leaf16;
+    for (uint32_t value : values32) {
+        leaf32[value] = nodes.size();
+        nodes.push_back(Node{kLeaf32, value, 0, -1, -1});
+    }
+    for (uint32_t value : values16) {
+        if (leaf16.count(value) == 0)
+            leaf16[value] = nodes.size();
+        nodes.push_back(Node{kLeaf16, value, 0, -1, -1});
+    }
+    const int leaf8_base = nodes.size();
+    for (uint32_t value = 0; value < 256; ++value)
+        nodes.push_back(Node{kLeaf8, value, 0, -1, -1});
+    const int eof = nodes.size();
+    nodes.push_back(Node{kEof, 256, 0, -1, -1});
+
+    // Count how often each leaf is used and scale counts to the 16 bits
+    // of the frequency table. Every leaf needs a non-zero frequency,
+    // libeb fails to build the tree otherwise.
+    const size_t page_count = data.size() / kPageSize;
+    std::vector<int> tokens;
+    for (size_t i = 0; i < page_count; ++i) {
+        TokenizePage(data.data() + i * kPageSize, leaf32, leaf16,
+                     leaf8_base, tokens);
+        for (int token : tokens)
+            ++nodes[token].frequency;
+    }
+
+    uint64_t max_count = 1;
+    for (const Node &node : nodes)
+        max_count = std::max(max_count, node.frequency);
+    for (Node &node : nodes) {
+        node.frequency = std::max<uint64_t>(
+            1, node.frequency * kMaxFrequency / max_count);
+    }
+    nodes[eof].frequency = 1;
+
+    std::string frequencies;
+    for (int i = 0; i < leaf8_base; ++i) {
+        AppendBigEndian(frequencies, nodes[i].value,
+                        nodes[i].type == kLeaf32 ? 4 : 2);
+        AppendBigEndian(frequencies, nodes[i].frequency, 2);
+    }
+    for (int i = leaf8_base; i < eof; ++i)
+        AppendBigEndian(frequencies, nodes[i].frequency, 2);
+
+    // Remember which leaf each token refers to before BuildTree() sorts
+    // the nodes.
+    std::vector<std::pair<NodeType, uint32_t>> keys;
+    for (const Node &node : nodes)
+        keys.emplace_back(node.type, node.value);
+
+    std::vector<Node> tree(nodes);
+    int root = BuildTree(tree);
+    std::vector<Code> tree_codes;
+    if (!AssignCodes(tree, root, tree_codes))
+        return std::make_error_code(std::errc::value_too_large);
+
+    std::vector<Code> codes(nodes.size());
+    {
+        std::unordered_map<uint64_t, Code> by_key;
+        for (size_t i = 0; i < tree.size(); ++i) {
+            if (tree[i].type != kIntermediate) {
+                by_key[(static_cast<uint64_t>(tree[i].type) << 32)
+                       | tree[i].value] = tree_codes[i];
+            }
+        }
+        for (size_t i = 0; i < keys.size(); ++i) {
+            codes[i] = by_key[(static_cast<uint64_t>(keys[i].first) << 32)
+                              | keys[i].second];
+        }
+    }
+
+    // File layout: header, frequency table, index table and pages.
+    const size_t group_count = (page_count + kPagesPerGroup - 1)
+        / kPagesPerGroup;
+    const size_t header_size = v6 ? kHeaderSize6 : kHeaderSize5;
+    const uint64_t frequencies_location = header_size;
+    const uint64_t index_location = frequencies_location + frequencies.size();
+    uint64_t location = index_location + group_count * kIndexRecordSize;
+
+    std::string index;
+    std::string pages;
+    std::string page;
+    for (size_t group = 0; group < group_count; ++group) {
+        const uint64_t group_location = location;
+        std::string offsets;
+
+        for (size_t i = 0; i < kPagesPerGroup; ++i) {
+            size_t page_index = group * kPagesPerGroup + i;
+            if (page_index >= page_count) {
+                AppendBigEndian(offsets, 0, 2);
+                continue;
+            }
+            if (location - group_location > 0xffff)
+                return std::make_error_code(std::errc::value_too_large);
+            AppendBigEndian(offsets, location - group_location, 2);
+
+            const char *source = data.data() + page_index * kPageSize;
+            TokenizePage(source, leaf32, leaf16, leaf8_base, tokens);
+
+            page.clear();
+            if (v6)
+                page.push_back('\0');
+            BitWriter writer(page);
+            for (int token : tokens)
+                writer.Write(codes[token]);
+            if (!v6)
+                writer.Write(codes[eof]);
+            writer.Flush();
+
+            // Version 6 can store pages that don't compress as they are.
+            if (v6 && page.size() > kPageSize) {
+                page.assign(1, '\x01');
+                page.append(source, kPageSize);
+            }
+
+            pages.append(page);
+            location += page.size();
+        }
+
+        AppendBigEndian(index, group_location, 4);
+        index.append(offsets);
+    }
+
+    std::string header;
+    AppendBigEndian(header, index_location, 4);
+    AppendBigEndian(header, index.size(), 4);
+    AppendBigEndian(header, frequencies_location, 4);
+    AppendBigEndian(header, frequencies.size(), 4);
+    header.resize(header_size, '\0');
+
+    file_ptr file(fopen(path, "wb"), &::fclose);
+    if (!file)
+        return std::error_code(errno, std::generic_category());
+
+    for (const std::string *part : {&header, &frequencies, &index, &pages}) {
+        if (fwrite(part->data(), 1, part->size(), file.get()) != part->size())
+            return std::error_code(errno, std::generic_category());
+    }
+    if (fflush(file.get()) != 0)
+        return std::error_code(errno, std::generic_category());
+
+    return std::error_code();
+}
+
+}  // namespace tools
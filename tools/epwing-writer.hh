@@ -0,0 +1,52 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#ifndef TOOLS_EPWING_WRITER_HH_
+#define TOOLS_EPWING_WRITER_HH_
+
+#include <string>
+#include <system_error>
+
+namespace tools {
+
+struct EpwingOptions {
+    /// Format version, 5 for the format of EPWING V4 and V5 and 6 for the
+    /// one of EPWING V6.
+    int version = 5;
+};
+
+/**
+ * Returns the compression hint a CATALOGS file must give for a text file
+ * written with @options.
+ */
+int GetEpwingCatalogHint(const EpwingOptions &options);
+
+/**
+ * Compresses @data with the static Huffman coding of EPWING and writes
+ * the result to the file at @path. The size of @data must be a multiple
+ * of the page size.
+ */
+std::error_code WriteEpwingFile(const char *path,
+                                const std::string &data,
+                                const EpwingOptions &options);
+
+}  // namespace tools
+
+#endif  // TOOLS_EPWING_WRITER_HH_
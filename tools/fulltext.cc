@@ -0,0 +1,260 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * simplify-fulltext reads every text of a book and writes an index of
+ * the character bigrams they contain, which simplify uses to find texts
+ * containing a phrase. See simplify/epwing/fulltext-index.hh for the
+ * format. Bind the index to a dictionary with the "fulltext" state key.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <iostream>
+#include <string>
+#include <system_error>
+
+#include <eb/eb.h>
+#include <eb/error.h>
+#include <eb/text.h>
+
+#include <simplify/epwing/backlink-index.hh>
+#include <simplify/epwing/eucjp_ucs2.hh>
+#include <simplify/epwing/fulltext-index.hh>
+
+#include "text-walker.hh"
+
+namespace tools {
+
+namespace {
+
+struct Options {
+    bool verbose = false;
+    std::string book_dir;
+    std::string output_path;
+};
+
+/**
+ * Converts text read by libeb with the default hookset to UTF-16.
+ * Characters which have no Unicode equivalent are dropped.
+ */
+std::u16string TextToUtf16(const std::string &text, EB_Character_Code charset)
+{
+    const unsigned char *p =
+        reinterpret_cast<const unsigned char *>(text.data());
+    const unsigned char *end = p + text.size();
+    std::u16string result;
+    result.reserve(text.size());
+
+    while (p < end) {
+        if (charset == EB_CHARCODE_ISO8859_1 || *p < 0x80) {
+            result.push_back(*p++);
+            continue;
+        }
+        if (p + 1 == end)
+            break;
+
+        ConversionEntry *entry = nullptr;
+        if (p[0] >= 0xa1 && p[0] <= 0xfe && p[1] >= 0xa1 && p[1] <= 0xfe)
+            entry = &g_eucjp_to_ucs2_codeset1_ranges[p[0] - 0xa1][p[1] - 0xa1];
+        else if (p[0] == 0x8e && p[1] >= 0xa1 && p[1] <= 0xdf)
+            entry = &g_eucjp_to_ucs2_codeset2[p[1] - 0xa1];
+
+        if (entry != nullptr && entry->ucs2 != nullptr) {
+            char16_t c;
+            memcpy(&c, entry->ucs2, sizeof(c));
+            result.push_back(c);
+        }
+        p += 2;
+    }
+
+    return result;
+}
+
+std::error_code EbError(EB_Error_Code code)
+{
+    return simplify::make_error_code(static_cast<simplify::eb_error>(code));
+}
+
+/**
+ * Adds all texts of the current sub-book to @builder.
+ */
+EB_Error_Code IndexSubBook(EB_Book &book, int subbook,
+                           simplify::FullTextIndex::Builder &builder,
+                           size_t &text_count)
+{
+    EB_Character_Code charset;
+    EB_Hookset hookset;
+    uint64_t key = 0;
+    bool in_text = false;
+    std::string text;
+
+    EB_Error_Code eb_code = eb_character_code(&book, &charset);
+    if (eb_code != EB_SUCCESS)
+        return eb_code;
+
+    auto add_text = [&]() {
+        if (in_text) {
+            builder.AddText(key, TextToUtf16(text, charset));
+            ++text_count;
+        }
+        text.clear();
+    };
+
+    eb_initialize_hookset(&hookset);
+    eb_code = WalkTexts(book, hookset, NULL,
+        [&](const EB_Position &position) {
+            add_text();
+            key = simplify::BacklinkIndex::MakeKey(subbook, position.page,
+                                                   position.offset);
+            in_text = true;
+        },
+        [&text](const char *data, size_t length) {
+            text.append(data, length);
+        });
+    if (eb_code == EB_SUCCESS)
+        add_text();
+
+    eb_finalize_hookset(&hookset);
+    return eb_code;
+}
+
+void PrintHelpAndExit(int status)
+{
+    std::cout << R"#(
+Usage: simplify-fulltext [options] BOOK-DIR OUTPUT
+
+Reads every text of the book in BOOK-DIR and writes the full-text index
+of the book to OUTPUT.
+
+  -v, --verbose
+      Print the number of texts indexed in each sub-book.
+
+  -h, --help
+      Print this help text and exit.
+)#" << std::endl;
+    exit(status);
+}
+
+bool ParseCommandLine(int argc, char *argv[], Options &options)
+{
+    static option g_options[] = {
+        { "verbose", 0, 0, 'v' },
+        { "help", 0, 0, 'h' },
+        { 0, 0, 0, 0 }
+    };
+
+    while (true) {
+        int argv_index;
+        int c = getopt_long(argc, argv, "vh", g_options, &argv_index);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 'v': {
+                options.verbose = true;
+                break;
+            }
+            case 'h': {
+                PrintHelpAndExit(0);
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+
+    if (optind + 2 != argc)
+        PrintHelpAndExit(1);
+    options.book_dir = argv[optind];
+    options.output_path = argv[optind + 1];
+    return true;
+}
+
+std::error_code IndexBook(const Options &options, EB_Book &book)
+{
+    EB_Subbook_Code subbooks[EB_MAX_SUBBOOKS];
+    int subbook_count;
+    EB_Error_Code eb_code = eb_subbook_list(&book, subbooks, &subbook_count);
+    if (eb_code != EB_SUCCESS)
+        return EbError(eb_code);
+
+    simplify::FullTextIndex::Builder builder(subbook_count);
+    for (int i = 0; i < subbook_count; ++i) {
+        eb_code = eb_set_subbook(&book, subbooks[i]);
+        if (eb_code != EB_SUCCESS)
+            return EbError(eb_code);
+        if (!eb_have_text(&book))
+            continue;
+
+        size_t text_count = 0;
+        eb_code = IndexSubBook(book, i, builder, text_count);
+        if (eb_code != EB_SUCCESS)
+            return EbError(eb_code);
+
+        if (options.verbose) {
+            std::cout << "Sub-book " << i << ": " << text_count
+                      << " texts." << std::endl;
+        }
+    }
+
+    return builder.Write(options.output_path.c_str());
+}
+
+}  // namespace
+
+}  // namespace tools
+
+int main(int argc, char *argv[])
+{
+    tools::Options options;
+    if (!tools::ParseCommandLine(argc, argv, options))
+        return 1;
+
+    EB_Book book;
+    EB_Error_Code eb_error;
+
+    eb_initialize_library();
+    eb_initialize_book(&book);
+
+    eb_error = eb_bind(&book, options.book_dir.c_str());
+    if (eb_error != EB_SUCCESS) {
+        std::cerr << "Unable to open book in '" << options.book_dir
+                  << "': " << eb_error_message(eb_error) << "." << std::endl;
+        eb_finalize_book(&book);
+        eb_finalize_library();
+        return 1;
+    }
+
+    std::error_code error = tools::IndexBook(options, book);
+    eb_finalize_book(&book);
+    eb_finalize_library();
+
+    if (error) {
+        std::cerr << "Unable to index book: " << error.message() << "."
+                  << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
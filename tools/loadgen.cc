@@ -0,0 +1,880 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * simplify-loadgen generates HTTP load against a running simplifyd. It
+ * either replays a request log or synthesizes a query mix in which words
+ * are drawn from a Zipf distribution, and drives it at a fixed
+ * concurrency (closed loop) or at a fixed rate (open loop). Latency
+ * percentiles and error counts are reported per route.
+ *
+ * In the open loop mode latency is measured from the moment the request
+ * was scheduled to be sent, so time spent queueing behind slow requests is
+ * accounted for.
+ */
+
+#include <getopt.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace tools {
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options {
+    std::string host = "127.0.0.1";
+    std::string port = "8000";
+    std::string log_path;
+    std::string words_path;
+    std::string record_path;
+    std::string dict_id = "0";
+    bool search_all = false;
+    size_t concurrency = 8;
+    double rate = 0;
+    double duration = 10;
+    size_t request_count = 0;
+    double zipf_exponent = 1.0;
+    double article_ratio = 0.3;
+    uint64_t seed = 1;
+};
+
+/**
+ * xorshift64* generator, one instance per worker thread.
+ */
+class Random {
+public:
+    explicit Random(uint64_t seed) : state_(seed * 2 + 1) {}
+
+    uint32_t Next()
+    {
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return (state_ * 2685821657736338717ULL) >> 32;
+    }
+
+    /// Returns a number in [0, 1).
+    double NextDouble() { return Next() / 4294967296.0; }
+
+private:
+    uint64_t state_;
+};
+
+std::string UrlEncode(const std::string &s)
+{
+    static const char kHex[] = "0123456789ABCDEF";
+    std::string out;
+
+    for (unsigned char c : s) {
+        if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+            out.push_back(c);
+        } else {
+            out.push_back('%');
+            out.push_back(kHex[c >> 4]);
+            out.push_back(kHex[c & 0x0f]);
+        }
+    }
+
+    return out;
+}
+
+/**
+ * Produces targets (path and query) of requests.
+ */
+class RequestSource {
+public:
+    virtual ~RequestSource() = default;
+
+    /**
+     * Stores the target of the next request in @target. Returns false if
+     * there are no more requests. Must be thread-safe.
+     */
+    virtual bool Next(Random &random, std::string &target) = 0;
+
+    /**
+     * Called with the body of each successful response.
+     */
+    virtual void OnResponse(const std::string &target,
+                            const std::string &body) {}
+};
+
+/**
+ * Replays targets from a log. Lines may either contain a bare target
+ * ("/search?q=...") or be in the common log format, in which case the
+ * target is taken from the request line.
+ */
+class LogSource : public RequestSource {
+public:
+    bool Load(const std::string &path)
+    {
+        std::ifstream stream(path);
+        std::string line;
+
+        while (std::getline(stream, line)) {
+            size_t start = line.find("\"GET ");
+            if (start != std::string::npos) {
+                start += 5;
+                size_t end = line.find(' ', start);
+                if (end != std::string::npos)
+                    targets_.push_back(line.substr(start, end - start));
+            } else if (!line.empty() && line[0] == '/') {
+                targets_.push_back(line);
+            }
+        }
+
+        return !targets_.empty();
+    }
+
+    bool Next(Random &, std::string &target) override
+    {
+        // The log is replayed over and over until the run is over.
+        size_t index = next_.fetch_add(1, std::memory_order_relaxed);
+        target = targets_[index % targets_.size()];
+        return true;
+    }
+
+private:
+    std::vector<std::string> targets_;
+    std::atomic<size_t> next_{0};
+};
+
+/**
+ * Synthesizes a mix of searches and article reads. Search terms are drawn
+ * from a Zipf distribution over the word list, half of them are cut down
+ * to prefixes. Articles are read by GUIDs seen in earlier search results,
+ * just like a user clicking on a search result.
+ */
+class SyntheticSource : public RequestSource {
+public:
+    explicit SyntheticSource(const Options &options) : options_(options) {}
+
+    bool Load(const std::string &path)
+    {
+        std::ifstream stream(path);
+        std::string word;
+
+        while (std::getline(stream, word)) {
+            if (!word.empty())
+                words_.push_back(word);
+        }
+        if (words_.empty())
+            return false;
+
+        // Cumulative distribution, a word's rank is its position in the
+        // file.
+        cdf_.resize(words_.size());
+        double sum = 0;
+        for (size_t i = 0; i < words_.size(); ++i) {
+            sum += 1.0 / std::pow(i + 1, options_.zipf_exponent);
+            cdf_[i] = sum;
+        }
+        for (double &p : cdf_)
+            p /= sum;
+
+        return true;
+    }
+
+    bool Next(Random &random, std::string &target) override
+    {
+        if (random.NextDouble() < options_.article_ratio) {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            if (!guids_.empty()) {
+                target = "/article?id=" + options_.dict_id + "&guid="
+                    + UrlEncode(guids_[random.Next() % guids_.size()]);
+                return true;
+            }
+        }
+
+        size_t rank = std::lower_bound(cdf_.begin(), cdf_.end(),
+                                       random.NextDouble()) - cdf_.begin();
+        std::string word = words_[std::min(rank, words_.size() - 1)];
+        if (word.size() > 2 && random.Next() % 2 == 0)
+            word.resize(2 + random.Next() % (word.size() - 2));
+
+        target = "/search?q=" + UrlEncode(word);
+        if (!options_.search_all)
+            target.append("&id=").append(options_.dict_id);
+        return true;
+    }
+
+    void OnResponse(const std::string &target,
+                    const std::string &body) override
+    {
+        if (target.compare(0, 8, "/search?") != 0)
+            return;
+
+        // Results are formatted as ["GUID","heading",...], pick out
+        // things that look like GUIDs.
+        std::vector<std::string> guids;
+        for (size_t pos = body.find("[\""); pos != std::string::npos;
+             pos = body.find("[\"", pos)) {
+            pos += 2;
+            size_t end = body.find('"', pos);
+            if (end == std::string::npos)
+                break;
+            std::string guid = body.substr(pos, end - pos);
+            if (guid.find_first_not_of("0123456789:") == std::string::npos
+                && guid.find(':') != std::string::npos)
+                guids.push_back(guid);
+        }
+
+        if (guids.empty())
+            return;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (std::string &guid : guids) {
+            if (guids_.size() < kMaxGuids)
+                guids_.push_back(std::move(guid));
+            else
+                guids_[next_guid_++ % kMaxGuids] = std::move(guid);
+        }
+    }
+
+private:
+    static const size_t kMaxGuids = 4096;
+
+    const Options &options_;
+    std::vector<std::string> words_;
+    std::vector<double> cdf_;
+    std::mutex mutex_;
+    std::vector<std::string> guids_;
+    size_t next_guid_ = 0;
+};
+
+/**
+ * Minimal blocking HTTP/1.1 client. Connections are kept alive if the
+ * server allows it.
+ */
+class HttpClient {
+public:
+    explicit HttpClient(const Options &options) : options_(options) {}
+
+    ~HttpClient() { Close(); }
+
+    /**
+     * Performs a GET request. Returns the status code of the response, or
+     * -1 if the request failed.
+     */
+    int Get(const std::string &target, std::string &body)
+    {
+        // A kept alive connection may have been closed by the server in
+        // the meantime. Retry once with a fresh connection in that case.
+        for (int attempt = 0; attempt < 2; ++attempt) {
+            bool reused = fd_ >= 0;
+            if (!reused && !Connect())
+                return -1;
+
+            int status = Exchange(target, body);
+            if (status >= 0)
+                return status;
+
+            Close();
+            if (!reused)
+                break;
+        }
+
+        return -1;
+    }
+
+private:
+    bool Connect()
+    {
+        addrinfo hints;
+        addrinfo *result;
+
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(options_.host.c_str(), options_.port.c_str(), &hints,
+                        &result) != 0) {
+            return false;
+        }
+
+        for (addrinfo *ai = result; ai != nullptr; ai = ai->ai_next) {
+            fd_ = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (fd_ < 0)
+                continue;
+            if (connect(fd_, ai->ai_addr, ai->ai_addrlen) == 0)
+                break;
+            close(fd_);
+            fd_ = -1;
+        }
+        freeaddrinfo(result);
+
+        if (fd_ < 0)
+            return false;
+
+        int flag = 1;
+        setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+        buffer_.clear();
+        return true;
+    }
+
+    void Close()
+    {
+        if (fd_ >= 0) {
+            close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    bool Fill()
+    {
+        char chunk[64 * 1024];
+        ssize_t n;
+
+        do {
+            n = recv(fd_, chunk, sizeof(chunk), 0);
+        } while (n < 0 && errno == EINTR);
+
+        if (n <= 0)
+            return false;
+        buffer_.append(chunk, n);
+        return true;
+    }
+
+    /**
+     * Reads the line at the start of the buffer without its CRLF.
+     */
+    bool ReadLine(std::string &line)
+    {
+        size_t line_end;
+        while ((line_end = buffer_.find("\r\n")) == std::string::npos) {
+            if (!Fill())
+                return false;
+        }
+
+        line.assign(buffer_, 0, line_end);
+        buffer_.erase(0, line_end + 2);
+        return true;
+    }
+
+    /**
+     * Reads a body sent with chunked transfer encoding. Chunk extensions
+     * and trailers are skipped.
+     */
+    bool ReadChunkedBody(std::string &body)
+    {
+        std::string line;
+
+        body.clear();
+        while (true) {
+            if (!ReadLine(line))
+                return false;
+
+            char *endptr;
+            size_t size = strtoul(line.c_str(), &endptr, 16);
+            if (endptr == line.c_str())
+                return false;
+
+            if (size == 0) {
+                // The trailers end with an empty line.
+                do {
+                    if (!ReadLine(line))
+                        return false;
+                } while (!line.empty());
+                return true;
+            }
+
+            while (buffer_.size() < size + 2) {
+                if (!Fill())
+                    return false;
+            }
+            body.append(buffer_, 0, size);
+            buffer_.erase(0, size + 2);
+        }
+    }
+
+    int Exchange(const std::string &target, std::string &body)
+    {
+        std::string request = "GET " + target + " HTTP/1.1\r\nHost: "
+            + options_.host + "\r\nConnection: keep-alive\r\n\r\n";
+
+        for (size_t sent = 0; sent < request.size();) {
+            ssize_t n = send(fd_, request.data() + sent,
+                             request.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return -1;
+            sent += n;
+        }
+
+        size_t header_end;
+        while ((header_end = buffer_.find("\r\n\r\n")) == std::string::npos) {
+            if (!Fill())
+                return -1;
+        }
+
+        std::string headers = buffer_.substr(0, header_end + 2);
+        buffer_.erase(0, header_end + 4);
+        for (char &c : headers)
+            c = tolower(c);
+
+        // Status-Line: HTTP/1.1 200 OK
+        size_t space = headers.find(' ');
+        if (space == std::string::npos)
+            return -1;
+        int status = atoi(headers.c_str() + space + 1);
+
+        bool keep_alive = headers.compare(0, 8, "http/1.1") == 0;
+        if (headers.find("\r\nconnection: close") != std::string::npos)
+            keep_alive = false;
+
+        size_t length_pos = headers.find("\r\ncontent-length:");
+        if (headers.find("\r\ntransfer-encoding: chunked")
+            != std::string::npos) {
+            // Search results are streamed in chunks.
+            if (!ReadChunkedBody(body))
+                return -1;
+        } else if (length_pos != std::string::npos) {
+            size_t length = strtoul(headers.c_str() + length_pos + 17,
+                                    nullptr, 10);
+            while (buffer_.size() < length) {
+                if (!Fill())
+                    return -1;
+            }
+            body.assign(buffer_, 0, length);
+            buffer_.erase(0, length);
+        } else {
+            // No length, the body ends when the connection is closed.
+            while (Fill()) {}
+            body.swap(buffer_);
+            buffer_.clear();
+            keep_alive = false;
+        }
+
+        if (!keep_alive)
+            Close();
+        return status;
+    }
+
+    const Options &options_;
+    int fd_ = -1;
+    std::string buffer_;
+};
+
+struct RouteStats {
+    std::vector<double> latency_ms;
+    size_t errors = 0;
+    size_t app_errors = 0;
+};
+
+typedef std::map<std::string, RouteStats> StatsMap;
+
+struct Worker {
+    StatsMap stats;
+    std::vector<std::string> targets;
+};
+
+class LoadGenerator {
+public:
+    LoadGenerator(const Options &options, RequestSource &source)
+      : options_(options),
+        source_(source)
+    {
+    }
+
+    void Run()
+    {
+        std::vector<Worker> workers(options_.concurrency);
+        std::vector<std::thread> threads;
+
+        start_ = Clock::now();
+        deadline_ = start_ + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(options_.duration));
+
+        for (size_t i = 0; i < workers.size(); ++i) {
+            threads.emplace_back([this, &workers, i]() {
+                RunWorker(i, workers[i]);
+            });
+        }
+        for (std::thread &thread : threads)
+            thread.join();
+        elapsed_ = Clock::now() - start_;
+
+        for (Worker &worker : workers) {
+            for (auto &item : worker.stats) {
+                RouteStats &route = stats_[item.first];
+                route.latency_ms.insert(route.latency_ms.end(),
+                                        item.second.latency_ms.begin(),
+                                        item.second.latency_ms.end());
+                route.errors += item.second.errors;
+                route.app_errors += item.second.app_errors;
+                error_count_ += item.second.errors;
+            }
+            targets_.insert(targets_.end(), worker.targets.begin(),
+                            worker.targets.end());
+        }
+    }
+
+    void PrintReport()
+    {
+        double seconds = std::chrono::duration<double>(elapsed_).count();
+        RouteStats total;
+
+        std::cout << std::left << std::setw(12) << "route" << std::right
+                  << std::setw(10) << "requests" << std::setw(10) << "req/s"
+                  << std::setw(8) << "errors" << std::setw(8) << "app-err"
+                  << std::setw(10) << "p50 ms" << std::setw(10) << "p99 ms"
+                  << std::setw(10) << "p999 ms" << std::setw(10) << "max ms"
+                  << std::endl;
+
+        for (auto &item : stats_) {
+            PrintRow(item.first, item.second, seconds);
+            total.latency_ms.insert(total.latency_ms.end(),
+                                    item.second.latency_ms.begin(),
+                                    item.second.latency_ms.end());
+            total.errors += item.second.errors;
+            total.app_errors += item.second.app_errors;
+        }
+        PrintRow("total", total, seconds);
+    }
+
+    const std::vector<std::string> &GetTargets() const { return targets_; }
+
+    /**
+     * Returns the number of requests that failed at the transport level or
+     * with a non-2xx status.
+     */
+    size_t GetErrorCount() const { return error_count_; }
+
+private:
+    static double Percentile(const std::vector<double> &sorted, double p)
+    {
+        if (sorted.empty())
+            return 0;
+        return sorted[static_cast<size_t>(p * (sorted.size() - 1))];
+    }
+
+    static void PrintRow(const std::string &name, RouteStats &stats,
+                         double seconds)
+    {
+        std::vector<double> &latency = stats.latency_ms;
+        std::sort(latency.begin(), latency.end());
+
+        std::cout << std::fixed << std::setprecision(2) << std::left
+                  << std::setw(12) << name << std::right
+                  << std::setw(10) << latency.size()
+                  << std::setw(10) << std::setprecision(1)
+                  << (seconds > 0 ? latency.size() / seconds : 0)
+                  << std::setw(8) << stats.errors
+                  << std::setw(8) << stats.app_errors
+                  << std::setprecision(2)
+                  << std::setw(10) << Percentile(latency, 0.50)
+                  << std::setw(10) << Percentile(latency, 0.99)
+                  << std::setw(10) << Percentile(latency, 0.999)
+                  << std::setw(10) << Percentile(latency, 1.0)
+                  << std::endl;
+    }
+
+    /**
+     * Claims the next request. Returns false when the run is over.
+     */
+    bool Claim(Clock::time_point *scheduled)
+    {
+        size_t index = issued_.fetch_add(1, std::memory_order_relaxed);
+        if (options_.request_count > 0 && index >= options_.request_count)
+            return false;
+
+        if (options_.rate > 0) {
+            *scheduled = start_ + std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(index / options_.rate));
+            std::this_thread::sleep_until(*scheduled);
+        } else {
+            *scheduled = Clock::now();
+        }
+
+        return options_.request_count > 0 || *scheduled < deadline_;
+    }
+
+    void RunWorker(size_t index, Worker &worker)
+    {
+        Random random(options_.seed + index * 7919);
+        HttpClient client(options_);
+        std::string target;
+        std::string body;
+        Clock::time_point scheduled;
+
+        while (Claim(&scheduled) && source_.Next(random, target)) {
+            int status = client.Get(target, body);
+            double latency = std::chrono::duration<double, std::milli>(
+                Clock::now() - scheduled).count();
+
+            RouteStats &stats = worker.stats[target.substr(
+                0, target.find('?'))];
+            stats.latency_ms.push_back(latency);
+
+            if (status < 200 || status >= 300) {
+                ++stats.errors;
+            } else {
+                // simplifyd reports failures in the body with a 200 status.
+                if (body.find("{\"error\":") != std::string::npos)
+                    ++stats.app_errors;
+                source_.OnResponse(target, body);
+            }
+
+            if (!options_.record_path.empty())
+                worker.targets.push_back(target);
+        }
+    }
+
+    const Options &options_;
+    RequestSource &source_;
+    Clock::time_point start_;
+    Clock::time_point deadline_;
+    Clock::duration elapsed_{};
+    std::atomic<size_t> issued_{0};
+    size_t error_count_ = 0;
+    StatsMap stats_;
+    std::vector<std::string> targets_;
+};
+
+void PrintHelpAndExit(int status)
+{
+    Options default_options{};
+
+    std::cout << R"#(
+Usage: simplify-loadgen [options] (-l LOG-FILE | -w WORDS-FILE)
+
+Generates HTTP load against a running simplifyd. Exits with a non-zero
+status if any request failed or returned a non-2xx status.
+
+  -H HOST, --host HOST
+      Server host. Default: )#" << default_options.host << R"#(.
+
+  -p PORT, --port PORT
+      Server port. Default: )#" << default_options.port << R"#(.
+
+  -l LOG-FILE, --log LOG-FILE
+      Replay request targets from LOG-FILE. Each line is either a target
+      ("/search?q=...") or a line in the common log format.
+
+  -w WORDS-FILE, --words WORDS-FILE
+      Synthesize a query mix from a list of words, one per line. Words
+      are ranked by their position in the file.
+
+  -Z EXPONENT, --zipf EXPONENT
+      Exponent of the Zipf distribution of words. Default: )#"
+        << default_options.zipf_exponent << R"#(.
+
+  -A RATIO, --article-ratio RATIO
+      Fraction of synthetic requests that read an article found by an
+      earlier search. Default: )#" << default_options.article_ratio << R"#(.
+
+  -i ID, --dict ID
+      Dictionary ID used by synthetic requests. Default: )#"
+        << default_options.dict_id << R"#(.
+
+  -a, --search-all
+      Search all dictionaries instead of the one given by --dict.
+
+  -c COUNT, --concurrency COUNT
+      Number of connections. Default: )#"
+        << default_options.concurrency << R"#(.
+
+  -r RATE, --rate RATE
+      Send requests at a fixed rate (requests per second) instead of as
+      fast as the connections allow.
+
+  -d SECONDS, --duration SECONDS
+      Duration of the run. Default: )#" << default_options.duration << R"#(.
+
+  -n COUNT, --requests COUNT
+      Stop after COUNT requests instead of after a fixed duration.
+
+  -R FILE, --record FILE
+      Save targets of all sent requests to FILE for later replay.
+
+  -S SEED, --seed SEED
+      Seed of the query mix. Default: )#" << default_options.seed << R"#(.
+
+  -h, --help
+      Print this help text and exit.
+)#" << std::endl;
+    exit(status);
+}
+
+bool ParseCommandLine(int argc, char *argv[], Options &options)
+{
+    static option g_options[] = {
+        { "host", 1, 0, 'H' },
+        { "port", 1, 0, 'p' },
+        { "log", 1, 0, 'l' },
+        { "words", 1, 0, 'w' },
+        { "zipf", 1, 0, 'Z' },
+        { "article-ratio", 1, 0, 'A' },
+        { "dict", 1, 0, 'i' },
+        { "search-all", 0, 0, 'a' },
+        { "concurrency", 1, 0, 'c' },
+        { "rate", 1, 0, 'r' },
+        { "duration", 1, 0, 'd' },
+        { "requests", 1, 0, 'n' },
+        { "record", 1, 0, 'R' },
+        { "seed", 1, 0, 'S' },
+        { "help", 0, 0, 'h' },
+        { 0, 0, 0, 0 }
+    };
+
+    while (true) {
+        int argv_index;
+        int c = getopt_long(argc, argv, "H:p:l:w:Z:A:i:ac:r:d:n:R:S:h",
+                            g_options, &argv_index);
+        if (c == -1)
+            break;
+
+        char *endptr = nullptr;
+        switch (c) {
+            case 'H':
+                options.host = optarg;
+                break;
+            case 'p':
+                options.port = optarg;
+                break;
+            case 'l':
+                options.log_path = optarg;
+                break;
+            case 'w':
+                options.words_path = optarg;
+                break;
+            case 'Z':
+                options.zipf_exponent = strtod(optarg, &endptr);
+                break;
+            case 'A':
+                options.article_ratio = strtod(optarg, &endptr);
+                break;
+            case 'i':
+                options.dict_id = optarg;
+                break;
+            case 'a':
+                options.search_all = true;
+                break;
+            case 'c':
+                options.concurrency = strtoul(optarg, &endptr, 10);
+                if (options.concurrency == 0)
+                    endptr = optarg;
+                break;
+            case 'r':
+                options.rate = strtod(optarg, &endptr);
+                break;
+            case 'd':
+                options.duration = strtod(optarg, &endptr);
+                break;
+            case 'n':
+                options.request_count = strtoul(optarg, &endptr, 10);
+                break;
+            case 'R':
+                options.record_path = optarg;
+                break;
+            case 'S':
+                options.seed = strtoull(optarg, &endptr, 10);
+                break;
+            case 'h':
+                PrintHelpAndExit(0);
+                break;
+            default:
+                return false;
+        }
+
+        if (endptr != nullptr && (endptr == optarg || *endptr != '\0')) {
+            std::cerr << "Invalid value of option -" << static_cast<char>(c)
+                      << "." << std::endl;
+            return false;
+        }
+    }
+
+    if (options.log_path.empty() == options.words_path.empty())
+        PrintHelpAndExit(1);
+
+    return true;
+}
+
+}  // namespace
+
+}  // namespace tools
+
+int main(int argc, char *argv[])
+{
+    tools::Options options;
+    if (!tools::ParseCommandLine(argc, argv, options))
+        return 1;
+
+    std::unique_ptr<tools::RequestSource> source;
+    if (!options.log_path.empty()) {
+        auto log_source = new tools::LogSource();
+        source.reset(log_source);
+        if (!log_source->Load(options.log_path)) {
+            std::cerr << "No requests in '" << options.log_path << "'."
+                      << std::endl;
+            return 1;
+        }
+    } else {
+        auto synthetic_source = new tools::SyntheticSource(options);
+        source.reset(synthetic_source);
+        if (!synthetic_source->Load(options.words_path)) {
+            std::cerr << "No words in '" << options.words_path << "'."
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    tools::LoadGenerator generator(options, *source);
+    generator.Run();
+    generator.PrintReport();
+
+    if (!options.record_path.empty()) {
+        std::ofstream stream(options.record_path);
+        for (const std::string &target : generator.GetTargets())
+            stream << target << '\n';
+        if (!stream) {
+            std::cerr << "Unable to save requests to '"
+                      << options.record_path << "'." << std::endl;
+            return 1;
+        }
+    }
+
+    return generator.GetErrorCount() == 0 ? 0 : 1;
+}
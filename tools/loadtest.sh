@@ -0,0 +1,37 @@
+#!/bin/sh
+#
+# Starts simplifyd with the synthetic fixtures, runs simplify-loadgen
+# against it and stops the server.
+#
+# Usage: loadtest.sh SIMPLIFYD LOADGEN FIXTURES-DIR [LOADGEN-OPTIONS...]
+#
+# The server listens on $SIMPLIFY_LOADTEST_PORT (default: 18000).
+
+set -e
+
+simplifyd=$1
+loadgen=$2
+fixtures=$3
+shift 3
+
+port=${SIMPLIFY_LOADTEST_PORT:-18000}
+words="$fixtures/plain/words.txt"
+html_dir="$(dirname "$0")/../simplifyd/html"
+
+"$simplifyd" -p "$port" -r "$fixtures/repository.js" -d "$html_dir" \
+    >/dev/null &
+pid=$!
+trap 'kill $pid 2>/dev/null; wait $pid 2>/dev/null || true' EXIT
+
+# Wait until the server starts accepting requests.
+tries=0
+until "$loadgen" -p "$port" -w "$words" -A 0 -c 1 -n 1 >/dev/null 2>&1; do
+    tries=$((tries + 1))
+    if [ $tries -ge 100 ] || ! kill -0 $pid 2>/dev/null; then
+        echo "simplifyd did not start." >&2
+        exit 1
+    fi
+    sleep 0.1
+done
+
+"$loadgen" -p "$port" -w "$words" "$@"
@@ -0,0 +1,349 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * simplify-matchtest compares the index key comparators of libeb using
+ * SSE2 and AVX2 with the same comparators using the byte-by-byte loops
+ * alone. Every comparator gets the same random key pairs at every level
+ * of vector code and must return the same result.
+ */
+
+#include <getopt.h>
+#include <stdlib.h>
+
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <eb/eb.h>
+#include <eb/error.h>
+
+// Internal to libeb, declared in eb/build-post.h.
+extern "C" {
+int eb_set_match_level(int level);
+int eb_match_word(const char *, const char *, size_t);
+int eb_pre_match_word(const char *, const char *, size_t);
+int eb_exact_match_word_jis(const char *, const char *, size_t);
+int eb_exact_pre_match_word_jis(const char *, const char *, size_t);
+int eb_exact_match_word_latin(const char *, const char *, size_t);
+int eb_exact_pre_match_word_latin(const char *, const char *, size_t);
+int eb_match_word_kana_single(const char *, const char *, size_t);
+int eb_match_word_kana_group(const char *, const char *, size_t);
+int eb_exact_match_word_kana_single(const char *, const char *, size_t);
+int eb_exact_match_word_kana_group(const char *, const char *, size_t);
+}
+
+namespace tools {
+
+namespace {
+
+// Same as EB_MATCH_LEVEL_* in eb/build-post.h.
+enum MatchLevel { kScalar = 0, kSse2 = 1, kAvx2 = 2 };
+
+const char *const kLevelNames[] = { "scalar", "SSE2", "AVX2" };
+
+struct Comparator {
+    const char *name;
+    int (*compare)(const char *, const char *, size_t);
+};
+
+const Comparator kComparators[] = {
+    { "eb_match_word", eb_match_word },
+    { "eb_pre_match_word", eb_pre_match_word },
+    { "eb_exact_match_word_jis", eb_exact_match_word_jis },
+    { "eb_exact_pre_match_word_jis", eb_exact_pre_match_word_jis },
+    { "eb_exact_match_word_latin", eb_exact_match_word_latin },
+    { "eb_exact_pre_match_word_latin", eb_exact_pre_match_word_latin },
+    { "eb_match_word_kana_single", eb_match_word_kana_single },
+    { "eb_match_word_kana_group", eb_match_word_kana_group },
+    { "eb_exact_match_word_kana_single", eb_exact_match_word_kana_single },
+    { "eb_exact_match_word_kana_group", eb_exact_match_word_kana_group },
+};
+
+const size_t kComparatorCount = sizeof(kComparators) / sizeof(*kComparators);
+
+// Lengths around the 16 and 32 byte blocks of the vector code. Lengths
+// past the last one are random.
+const size_t kLengths[] = { 14, 15, 16, 17, 30, 31, 32, 33, 34 };
+const size_t kMaxLength = 100;
+
+// Keys are longer than any pattern so that a word can outlast it.
+const size_t kKeySize = kMaxLength * 2 + 1;
+
+struct Options {
+    size_t pair_count = 1000000;
+    uint64_t seed = 1;
+};
+
+/**
+ * Same generator as in simplify-mkbook.
+ */
+class Random {
+public:
+    explicit Random(uint64_t seed) : state_(seed * 2 + 1) {}
+
+    uint32_t Next()
+    {
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return (state_ * 2685821657736338717ULL) >> 32;
+    }
+
+    uint32_t Below(uint32_t n) { return Next() % n; }
+
+private:
+    uint64_t state_;
+};
+
+struct KeyPair {
+    char word[kKeySize];
+    char pattern[kKeySize];
+    size_t length;
+};
+
+/**
+ * Fills @key with @length bytes of JIS X 0208 kana, mostly hiragana and
+ * katakana rows, or with bytes of a small alphabet, which makes long
+ * common prefixes likely.
+ */
+void FillKey(Random &random, bool kana, char *key, size_t length)
+{
+    for (size_t i = 0; i < length; ++i) {
+        if (kana && i % 2 == 0) {
+            uint32_t row = random.Below(8);
+            key[i] = row < 3 ? 0x24 : row < 6 ? 0x25 : 0x21 + row;
+        } else if (kana) {
+            key[i] = 0x21 + random.Below(4);
+        } else {
+            key[i] = 'a' + random.Below(3);
+        }
+    }
+}
+
+/**
+ * Makes a pattern and a word which is a copy of it changed in a few
+ * places: bytes replaced, kana switched between hiragana and katakana,
+ * the word cut short with a NUL or made longer, and the pattern padded
+ * with spaces or NULs.
+ */
+void MakeKeyPair(Random &random, KeyPair *pair)
+{
+    size_t length_index = random.Below(sizeof(kLengths) / sizeof(*kLengths));
+    size_t length = kLengths[length_index];
+    if (length_index + 1 == sizeof(kLengths) / sizeof(*kLengths))
+        length += random.Below(kMaxLength - length + 1);
+    bool kana = random.Below(2) == 0;
+
+    memset(pair->word, 0, sizeof(pair->word));
+    memset(pair->pattern, 0, sizeof(pair->pattern));
+    pair->length = length;
+
+    FillKey(random, kana, pair->pattern, length);
+    memcpy(pair->word, pair->pattern, length);
+
+    // A longer word.
+    if (random.Below(4) == 0)
+        FillKey(random, kana, pair->word + length, random.Below(length) + 1);
+
+    for (uint32_t n = random.Below(3); n > 0; --n) {
+        size_t i = random.Below(length);
+        switch (random.Below(4)) {
+            case 0:
+                pair->word[i] ^= 1 << random.Below(8);
+                break;
+            case 1:
+                pair->word[i & ~1] ^= 0x24 ^ 0x25;
+                break;
+            case 2:
+                pair->word[i] = '\0';
+                break;
+            case 3:
+                memset(pair->pattern + i, random.Below(2) ? ' ' : '\0',
+                       length - i);
+                break;
+        }
+    }
+
+    // Make sure the word ends within the key, whatever was changed.
+    pair->word[kKeySize - 1] = '\0';
+}
+
+std::string Hex(const char *key, size_t length)
+{
+    std::ostringstream out;
+    out << std::hex << std::setfill('0');
+    for (size_t i = 0; i < length; ++i)
+        out << std::setw(2) << (static_cast<unsigned>(key[i]) & 0xff);
+    return out.str();
+}
+
+void PrintHelpAndExit(int status)
+{
+    Options default_options{};
+
+    std::cout << R"#(
+Usage: simplify-matchtest [options]
+
+Compares the vector key comparison of libeb with the scalar one.
+
+  -n COUNT, --pairs COUNT
+      Number of key pairs. Default: )#"
+        << default_options.pair_count << R"#(.
+
+  -S SEED, --seed SEED
+      Seed of the key pairs. Default: )#" << default_options.seed << R"#(.
+
+  -h, --help
+      Print this help text and exit.
+)#" << std::endl;
+    exit(status);
+}
+
+bool ParseSize(const char *s, size_t *value)
+{
+    char *endptr;
+    *value = strtoul(s, &endptr, 10);
+    return *s != '\0' && *endptr == '\0';
+}
+
+bool ParseCommandLine(int argc, char *argv[], Options &options)
+{
+    static option g_options[] = {
+        { "pairs", 1, 0, 'n' },
+        { "seed", 1, 0, 'S' },
+        { "help", 0, 0, 'h' },
+        { 0, 0, 0, 0 }
+    };
+
+    while (true) {
+        int argv_index;
+        int c = getopt_long(argc, argv, "n:S:h", g_options, &argv_index);
+        if (c == -1)
+            break;
+
+        bool valid = true;
+        switch (c) {
+            case 'n':
+                valid = ParseSize(optarg, &options.pair_count)
+                    && options.pair_count > 0;
+                break;
+            case 'S': {
+                size_t seed;
+                valid = ParseSize(optarg, &seed);
+                options.seed = seed;
+                break;
+            }
+            case 'h':
+                PrintHelpAndExit(0);
+                break;
+            default:
+                return false;
+        }
+
+        if (!valid) {
+            std::cerr << "Invalid value of option -" << static_cast<char>(c)
+                      << "." << std::endl;
+            return false;
+        }
+    }
+
+    if (optind != argc)
+        PrintHelpAndExit(1);
+
+    return true;
+}
+
+}  // namespace
+
+}  // namespace tools
+
+int main(int argc, char *argv[])
+{
+    tools::Options options;
+    if (!tools::ParseCommandLine(argc, argv, options))
+        return 1;
+
+    if (eb_initialize_library() != EB_SUCCESS) {
+        std::cerr << "Unable to initialize libeb." << std::endl;
+        return 1;
+    }
+
+    int max_level = eb_set_match_level(tools::kAvx2);
+    for (int level = tools::kSse2; level <= tools::kAvx2; ++level) {
+        if (max_level < level) {
+            std::cout << tools::kLevelNames[level]
+                      << " is not supported, skipped." << std::endl;
+        }
+    }
+
+    tools::Random random(options.seed);
+    tools::KeyPair pair;
+    size_t mismatches[tools::kComparatorCount] = {};
+    size_t total_mismatches = 0;
+
+    for (size_t n = 0; n < options.pair_count; ++n) {
+        tools::MakeKeyPair(random, &pair);
+
+        for (size_t c = 0; c < tools::kComparatorCount; ++c) {
+            const tools::Comparator &comparator = tools::kComparators[c];
+
+            eb_set_match_level(tools::kScalar);
+            int expected = comparator.compare(pair.word, pair.pattern,
+                                              pair.length);
+
+            for (int level = tools::kSse2; level <= max_level; ++level) {
+                eb_set_match_level(level);
+                int result = comparator.compare(pair.word, pair.pattern,
+                                                pair.length);
+                if (result == expected)
+                    continue;
+
+                // A few examples are enough.
+                if (mismatches[c]++ < 5) {
+                    std::cout << comparator.name << " "
+                              << tools::kLevelNames[level] << ": " << result
+                              << ", scalar: " << expected << ", word "
+                              << tools::Hex(pair.word, pair.length)
+                              << ", pattern "
+                              << tools::Hex(pair.pattern, pair.length)
+                              << std::endl;
+                }
+                ++total_mismatches;
+            }
+        }
+    }
+
+    eb_set_match_level(tools::kAvx2);
+    eb_finalize_library();
+
+    for (size_t c = 0; c < tools::kComparatorCount; ++c) {
+        std::cout << std::left << std::setw(34)
+                  << tools::kComparators[c].name << mismatches[c]
+                  << " mismatches" << std::endl;
+    }
+    std::cout << options.pair_count << " key pairs, up to "
+              << tools::kLevelNames[max_level] << "." << std::endl;
+
+    return total_mismatches == 0 ? 0 : 1;
+}
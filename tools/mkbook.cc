@@ -0,0 +1,787 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * simplify-mkbook generates synthetic EPWING books. The books mimic the
+ * layout of real dictionaries closely enough to exercise every code path
+ * used by EpwingDictionary: a CATALOGS file, a HONMON file with an index
+ * page, main text with keywords, references and narrow runs, a heading
+ * area, a multi-level word index and keyword and multi search indexes of
+ * topics assigned to entries. The output is fully determined by
+ * the command line, so benchmark numbers are comparable between runs and
+ * machines.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "ebzip-writer.hh"
+#include "epwing-writer.hh"
+
+namespace tools {
+
+namespace {
+
+const size_t kPageSize = 2048;
+const size_t kCatalogRecordSize = 164;
+const size_t kTitleLength = 80;
+const size_t kDirectoryNameLength = 8;
+const size_t kMaxWordLength = 16;
+const char kSubbookDirectory[] = "SYNTH";
+const size_t kMultiLabelLength = 30;
+
+// Keywords of the keyword and multi search indexes. Every entry has one
+// to three of them, so that any two topics have plenty of entries in
+// common. None is a prefix of another.
+const char *const kTopics[] = {
+    "sora", "umi", "yama", "kawa", "mori", "hana", "kaze", "yuki",
+};
+const size_t kTopicCount = sizeof(kTopics) / sizeof(kTopics[0]);
+
+struct Options {
+    size_t entry_count = 20000;
+    uint64_t seed = 1;
+    int zip_level = -1;
+    int epwing_version = 0;
+    std::string title = "Synthetic Dictionary";
+    std::string output_dir;
+};
+
+/**
+ * Deterministic pseudo-random number generator (xorshift64*). Distributions
+ * from <random> are implementation-defined, so we can't use them without
+ * making fixtures differ from one standard library to another.
+ */
+class Random {
+public:
+    explicit Random(uint64_t seed) : state_(seed * 2 + 1) {}
+
+    uint32_t Next()
+    {
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return (state_ * 2685821657736338717ULL) >> 32;
+    }
+
+    /// Returns a number in [@min, @max].
+    uint32_t Range(uint32_t min, uint32_t max)
+    {
+        return min + Next() % (max - min + 1);
+    }
+
+    /// Returns true with the probability of 1/@n.
+    bool OneIn(uint32_t n) { return Next() % n == 0; }
+
+private:
+    uint64_t state_;
+};
+
+struct Entry {
+    /// ASCII headword.
+    std::string word;
+    /// Word index key in JIS X 0208.
+    std::string key;
+    /// Heading in JIS X 0208.
+    std::string heading;
+    /// Main text including escape sequences.
+    std::string text;
+    /// Locations of unresolved reference targets within @text paired with
+    /// indexes of target entries.
+    std::vector<std::pair<size_t, size_t>> references;
+    /// Indexes of the entry's topics in kTopics.
+    std::vector<size_t> topics;
+    uint64_t text_position = 0;
+    uint64_t heading_position = 0;
+};
+
+struct IndexRecord {
+    /// Key in JIS X 0208.
+    std::string key;
+    uint64_t text_position;
+    uint64_t heading_position;
+};
+
+void AppendUInt(std::string &out, uint64_t value, int width)
+{
+    for (int i = width - 1; i >= 0; --i)
+        out.push_back(static_cast<char>((value >> (i * 8)) & 0xff));
+}
+
+void PutUInt(std::string &out, size_t offset, uint64_t value, int width)
+{
+    for (int i = width - 1; i >= 0; --i, ++offset)
+        out[offset] = static_cast<char>((value >> (i * 8)) & 0xff);
+}
+
+void PutBcd(std::string &out, size_t offset, unsigned value, int width)
+{
+    for (int i = width - 1; i >= 0; --i) {
+        unsigned low = value % 10;
+        value /= 10;
+        unsigned high = value % 10;
+        value /= 10;
+        out[offset + i] = static_cast<char>((high << 4) | low);
+    }
+}
+
+void PadToPage(std::string &out)
+{
+    if (out.size() % kPageSize != 0)
+        out.append(kPageSize - out.size() % kPageSize, '\0');
+}
+
+uint32_t PositionToPage(uint64_t position)
+{
+    return position / kPageSize + 1;
+}
+
+uint32_t PositionToOffset(uint64_t position)
+{
+    return position % kPageSize;
+}
+
+/**
+ * Appends full-width variant of an ASCII string in JIS X 0208. Only
+ * letters, digits and spaces are supported.
+ */
+void AppendJisAscii(std::string &out, const std::string &s, bool upper)
+{
+    for (char c : s) {
+        if (c == ' ') {
+            out.append("\x21\x21", 2);
+        } else {
+            out.push_back(0x23);
+            out.push_back(upper && c >= 'a' && c <= 'z' ? c - 0x20 : c);
+        }
+    }
+}
+
+std::string MakeWord(Random &random)
+{
+    static const char kConsonants[] = "kstnhmyrwgzdbp";
+    static const char kVowels[] = "aeiou";
+    const size_t consonant_count = sizeof(kConsonants) - 1;
+    const size_t vowel_count = sizeof(kVowels) - 1;
+
+    std::string word;
+    size_t syllables = random.Range(2, 5);
+
+    for (size_t i = 0; i < syllables; ++i) {
+        if (!random.OneIn(5))
+            word.push_back(kConsonants[random.Next() % consonant_count]);
+        word.push_back(kVowels[random.Next() % vowel_count]);
+        if (random.OneIn(8))
+            word.push_back('n');
+    }
+
+    if (word.size() > kMaxWordLength)
+        word.resize(kMaxWordLength);
+    return word;
+}
+
+void AppendKana(std::string &out, Random &random, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        out.push_back(0x24);
+        out.push_back(static_cast<char>(random.Range(0x21, 0x73)));
+    }
+}
+
+void AppendKanji(std::string &out, Random &random, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        out.push_back(static_cast<char>(random.Range(0x30, 0x4e)));
+        out.push_back(static_cast<char>(random.Range(0x21, 0x7e)));
+    }
+}
+
+/**
+ * Generates the main text of entry @index. Reference targets are chosen
+ * among @entries but their locations are filled in later, when the layout
+ * of the text is known.
+ */
+void MakeText(std::vector<Entry> &entries, size_t index, Random &random)
+{
+    Entry &entry = entries[index];
+    std::string &text = entry.text;
+
+    // Keywords at the start of entries double as stop codes, libeb stops
+    // reading text when it finds the next one.
+    text.append("\x1f\x41\x01\x00", 4);
+    text.append(entry.heading);
+    text.append("\x1f\x61\x1f\x0a", 4);
+
+    size_t line_count = random.Range(1, 6);
+    for (size_t line = 0; line < line_count; ++line) {
+        text.append("\x1f\x09\x00\x02", 4);
+
+        size_t token_count = random.Range(4, 24);
+        for (size_t token = 0; token < token_count; ++token) {
+            uint32_t kind = random.Next() % 16;
+
+            if (kind < 6) {
+                AppendKana(text, random, random.Range(1, 6));
+            } else if (kind < 11) {
+                AppendKanji(text, random, random.Range(1, 3));
+            } else if (kind < 13) {
+                const Entry &other = entries[random.Next() % entries.size()];
+
+                text.append("\x21\x21", 2);
+                AppendJisAscii(text, other.word, false);
+                text.append("\x21\x21", 2);
+            } else if (kind < 14) {
+                text.append("\x1f\x04", 2);
+                AppendJisAscii(text, std::to_string(random.Range(1, 9999)),
+                               false);
+                text.append("\x1f\x05", 2);
+            } else if (kind < 15) {
+                size_t target = random.Next() % entries.size();
+
+                text.append("\x1f\x42", 2);
+                text.append(entries[target].heading);
+                text.append("\x1f\x62", 2);
+                entry.references.emplace_back(text.size(), target);
+                text.append(6, '\0');
+            } else {
+                // Punctuation: 、 or 。
+                text.push_back(0x21);
+                text.push_back(random.OneIn(2) ? 0x22 : 0x23);
+            }
+        }
+
+        text.append("\x1f\x0a", 2);
+    }
+}
+
+void AssignTopics(Entry &entry, Random &random)
+{
+    size_t count = random.Range(1, 3);
+
+    while (entry.topics.size() < count) {
+        size_t topic = random.Next() % kTopicCount;
+        if (std::find(entry.topics.begin(), entry.topics.end(), topic)
+            == entry.topics.end())
+            entry.topics.push_back(topic);
+    }
+}
+
+/**
+ * Builds a word index of @records, the same layout serves word, keyword
+ * and multi searches. Levels are laid out starting from the root so that
+ * the first page of the index is the one libeb starts the search from.
+ * Leaf pages come last and are contiguous, libeb walks them sequentially
+ * when a run of matching entries crosses a page boundary.
+ */
+std::string MakeWordIndex(const std::vector<IndexRecord> &records,
+                          uint32_t first_page)
+{
+    std::vector<size_t> order(records.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return records[a].key < records[b].key;
+    });
+
+    // Leaf pages use variable-length records.
+    std::vector<std::string> leaves;
+    std::vector<std::string> leaf_keys;
+    std::string page;
+    size_t page_count = 0;
+
+    auto flush_leaf = [&](const std::string &last_key) {
+        std::string header;
+        AppendUInt(header, 0x80, 1);
+        AppendUInt(header, 0, 1);
+        AppendUInt(header, page_count, 2);
+        leaves.push_back(header + page);
+        leaf_keys.push_back(last_key);
+        page.clear();
+        page_count = 0;
+    };
+
+    size_t key_length = 0;
+    for (size_t i = 0; i < order.size(); ++i) {
+        const IndexRecord &entry = records[order[i]];
+        std::string record;
+
+        AppendUInt(record, entry.key.size(), 1);
+        record.append(entry.key);
+        AppendUInt(record, PositionToPage(entry.text_position), 4);
+        AppendUInt(record, PositionToOffset(entry.text_position), 2);
+        AppendUInt(record, PositionToPage(entry.heading_position), 4);
+        AppendUInt(record, PositionToOffset(entry.heading_position), 2);
+
+        if (4 + page.size() + record.size() > kPageSize)
+            flush_leaf(records[order[i - 1]].key);
+        page.append(record);
+        ++page_count;
+        key_length = std::max(key_length, entry.key.size());
+    }
+    if (page_count > 0 || leaves.empty())
+        flush_leaf(order.empty() ? std::string() : records[order.back()].key);
+
+    // Upper levels use fixed-length records: a key padded with zeros to
+    // @key_length bytes followed by the page number of the child page.
+    std::vector<std::vector<std::string>> levels{leaves};
+    std::vector<std::vector<std::string>> level_keys{leaf_keys};
+    const size_t fanout = (kPageSize - 4) / (key_length + 4);
+
+    while (levels.back().size() > 1) {
+        const std::vector<std::string> &keys = level_keys.back();
+        std::vector<std::string> pages;
+        std::vector<std::string> last_keys;
+
+        for (size_t i = 0; i < keys.size(); i += fanout)
+            last_keys.push_back(keys[std::min(i + fanout, keys.size()) - 1]);
+        pages.resize(last_keys.size());
+        levels.push_back(std::move(pages));
+        level_keys.push_back(std::move(last_keys));
+    }
+
+    // Now that the number of pages on each level is known, assign page
+    // numbers and fill in the upper levels.
+    std::vector<uint32_t> level_first_page(levels.size());
+    uint32_t next_page = first_page;
+    for (size_t level = levels.size(); level-- > 0;) {
+        level_first_page[level] = next_page;
+        next_page += levels[level].size();
+    }
+
+    for (size_t level = 1; level < levels.size(); ++level) {
+        const std::vector<std::string> &child_keys = level_keys[level - 1];
+
+        for (size_t i = 0; i < levels[level].size(); ++i) {
+            size_t first_child = i * fanout;
+            size_t end_child = std::min(first_child + fanout,
+                                        child_keys.size());
+            std::string &upper = levels[level][i];
+
+            AppendUInt(upper, 0x00, 1);
+            AppendUInt(upper, key_length, 1);
+            AppendUInt(upper, end_child - first_child, 2);
+            for (size_t child = first_child; child < end_child; ++child) {
+                std::string key = child_keys[child];
+                key.resize(key_length, '\0');
+                upper.append(key);
+                AppendUInt(upper, level_first_page[level - 1] + child, 4);
+            }
+        }
+    }
+
+    std::string index;
+    for (size_t level = levels.size(); level-- > 0;) {
+        std::vector<std::string> &pages = levels[level];
+
+        for (size_t i = 0; i < pages.size(); ++i) {
+            // Mark the first and the last page of the layer.
+            pages[i][0] |= (i == 0 ? 0x40 : 0x00)
+                | (i + 1 == pages.size() ? 0x20 : 0x00);
+            index.append(pages[i]);
+            PadToPage(index);
+        }
+    }
+
+    return index;
+}
+
+std::string MakeHonmon(std::vector<Entry> &entries)
+{
+    // The first page holds the index table, it's filled in at the end.
+    std::string honmon(kPageSize, '\0');
+
+    const uint32_t text_page = PositionToPage(honmon.size());
+    for (Entry &entry : entries) {
+        entry.text_position = honmon.size();
+        honmon.append(entry.text);
+    }
+    honmon.append("\x1f\x03", 2);
+    PadToPage(honmon);
+    const uint32_t text_page_count =
+        PositionToPage(honmon.size()) - text_page;
+
+    for (Entry &entry : entries) {
+        entry.heading_position = honmon.size();
+        honmon.append(entry.heading);
+        honmon.append("\x1f\x0a", 2);
+    }
+    PadToPage(honmon);
+
+    for (const Entry &entry : entries) {
+        for (const auto &reference : entry.references) {
+            uint64_t target = entries[reference.second].text_position;
+            size_t offset = entry.text_position + reference.first;
+
+            PutBcd(honmon, offset, PositionToPage(target), 4);
+            PutBcd(honmon, offset + 4, PositionToOffset(target), 2);
+        }
+    }
+
+    std::vector<IndexRecord> word_records;
+    std::vector<IndexRecord> topic_records;
+    for (const Entry &entry : entries) {
+        word_records.push_back(IndexRecord{
+            entry.key, entry.text_position, entry.heading_position});
+
+        for (size_t topic : entry.topics) {
+            IndexRecord record{
+                std::string(), entry.text_position, entry.heading_position};
+            AppendJisAscii(record.key, kTopics[topic], true);
+            topic_records.push_back(std::move(record));
+        }
+    }
+
+    const uint32_t word_page = PositionToPage(honmon.size());
+    honmon.append(MakeWordIndex(word_records, word_page));
+    const uint32_t word_page_count = PositionToPage(honmon.size()) - word_page;
+
+    const uint32_t keyword_page = PositionToPage(honmon.size());
+    honmon.append(MakeWordIndex(topic_records, keyword_page));
+    const uint32_t keyword_page_count =
+        PositionToPage(honmon.size()) - keyword_page;
+
+    // A multi search with two entries, which both look up topics in the
+    // keyword index, so `#0: a & b` finds the same entries as `a & b`.
+    // Each entry is a label followed by the indexes it searches.
+    const uint32_t multi_page = PositionToPage(honmon.size());
+    {
+        const char *const labels[] = { "Topic", "Another topic" };
+        const size_t label_count = sizeof(labels) / sizeof(labels[0]);
+        std::string page(16, '\0');
+
+        PutUInt(page, 0, label_count, 2);
+        for (size_t i = 0; i < label_count; ++i) {
+            std::string label;
+            AppendJisAscii(label, labels[i], false);
+            label.resize(kMultiLabelLength, '\0');
+
+            AppendUInt(page, 1, 1);
+            AppendUInt(page, 0, 1);
+            page.append(label);
+
+            std::string index(16, '\0');
+            PutUInt(index, 0, 0x91, 1);
+            PutUInt(index, 2, keyword_page, 4);
+            PutUInt(index, 6, keyword_page_count, 4);
+            page.append(index);
+        }
+        honmon.append(page);
+        PadToPage(honmon);
+    }
+
+    // Index table: the main text (0x00), the word index (0x91), the
+    // keyword index (0x80) and the multi search (0xff). With the global
+    // availability flag cleared libeb converts lower case letters to upper
+    // case and deletes spaces in queries, the keys are stored the same
+    // way.
+    const struct {
+        int id;
+        uint32_t page;
+        uint32_t page_count;
+    } indexes[] = {
+        { 0x00, text_page, text_page_count },
+        { 0x91, word_page, word_page_count },
+        { 0x80, keyword_page, keyword_page_count },
+        { 0xff, multi_page, 1 },
+    };
+    const size_t index_count = sizeof(indexes) / sizeof(indexes[0]);
+
+    PutUInt(honmon, 1, index_count, 1);
+    for (size_t i = 0; i < index_count; ++i) {
+        size_t offset = 16 + i * 16;
+        PutUInt(honmon, offset, indexes[i].id, 1);
+        PutUInt(honmon, offset + 2, indexes[i].page, 4);
+        PutUInt(honmon, offset + 6, indexes[i].page_count, 4);
+    }
+
+    return honmon;
+}
+
+std::string MakeCatalogs(const std::string &title, const char *text_file,
+                         int text_hint)
+{
+    std::string catalogs;
+
+    AppendUInt(catalogs, 1, 2);  // Subbook count.
+    AppendUInt(catalogs, 2, 2);  // EPWING version.
+    catalogs.append(12, '\0');
+
+    std::string record(kCatalogRecordSize, '\0');
+    std::string jis_title;
+    AppendJisAscii(jis_title, title.substr(0, kTitleLength / 2), false);
+    record.replace(2, jis_title.size(), jis_title);
+
+    std::string directory(kSubbookDirectory);
+    directory.resize(kDirectoryNameLength, ' ');
+    record.replace(2 + kTitleLength, kDirectoryNameLength, directory);
+    PutUInt(record, 2 + kTitleLength + kDirectoryNameLength + 4, 1, 2);
+    catalogs.append(record);
+
+    // Extended record: the text file name and its compression hint.
+    // EBZIP'ed files are detected by their suffix, the hint only covers
+    // EPWING's native compression.
+    std::string extra(kCatalogRecordSize, '\0');
+    std::string file_name(text_file);
+    file_name.resize(kDirectoryNameLength, ' ');
+    extra.replace(4, kDirectoryNameLength, file_name);
+    extra[55] = static_cast<char>(text_hint);
+    catalogs.append(extra);
+
+    return catalogs;
+}
+
+std::error_code WriteFile(const std::filesystem::path &path,
+                          const std::string &data)
+{
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    if (!stream.write(data.data(), data.size()) || !stream.flush())
+        return std::make_error_code(std::errc::io_error);
+    return std::error_code();
+}
+
+std::error_code MakeBook(const Options &options)
+{
+    Random random(options.seed);
+    std::vector<Entry> entries(options.entry_count);
+
+    for (Entry &entry : entries) {
+        entry.word = MakeWord(random);
+        AppendJisAscii(entry.key, entry.word, true);
+        AppendJisAscii(entry.heading, entry.word, false);
+    }
+    for (size_t i = 0; i < entries.size(); ++i)
+        MakeText(entries, i, random);
+
+    // Topics come from a generator of their own, so that the rest of the
+    // book is the same as before there were any.
+    Random topic_random(options.seed ^ 0x746f70696373ULL);
+    for (Entry &entry : entries)
+        AssignTopics(entry, topic_random);
+
+    std::string honmon = MakeHonmon(entries);
+
+    std::error_code error;
+    std::filesystem::path root(options.output_dir);
+    std::filesystem::path data_dir = root / kSubbookDirectory / "DATA";
+
+    std::filesystem::create_directories(data_dir, error);
+    if (error)
+        return error;
+
+    EpwingOptions epwing_options;
+    epwing_options.version = options.epwing_version;
+
+    std::string catalogs;
+    if (options.epwing_version != 0) {
+        catalogs = MakeCatalogs(options.title, "HONMON2",
+                                GetEpwingCatalogHint(epwing_options));
+    } else {
+        catalogs = MakeCatalogs(options.title, "HONMON", 0);
+    }
+    error = WriteFile(root / "CATALOGS", catalogs);
+    if (error)
+        return error;
+
+    // Remove leftovers of other formats, libeb would pick either.
+    std::filesystem::remove(data_dir / "HONMON", error);
+    std::filesystem::remove(data_dir / "HONMON.ebz", error);
+    std::filesystem::remove(data_dir / "HONMON2", error);
+
+    if (options.epwing_version != 0) {
+        error = WriteEpwingFile((data_dir / "HONMON2").c_str(), honmon,
+                                epwing_options);
+    } else if (options.zip_level >= 0) {
+        EbzipOptions ebzip_options;
+        ebzip_options.zip_level = options.zip_level;
+        ebzip_options.thread_count = 0;
+        error = WriteEbzipFile((data_dir / "HONMON.ebz").c_str(), honmon,
+                               ebzip_options);
+    } else {
+        error = WriteFile(data_dir / "HONMON", honmon);
+    }
+    if (error)
+        return error;
+
+    // The list of headwords is used by the benchmark to build queries.
+    std::string words;
+    for (const Entry &entry : entries)
+        words.append(entry.word).append(1, '\n');
+    error = WriteFile(root / "words.txt", words);
+    if (error)
+        return error;
+
+    // The topics of every entry, one line per entry, let the benchmark
+    // check keyword and multi search results.
+    std::string topics;
+    for (const Entry &entry : entries) {
+        for (size_t i = 0; i < entry.topics.size(); ++i) {
+            topics.append(i == 0 ? "" : " ");
+            topics.append(kTopics[entry.topics[i]]);
+        }
+        topics.append(1, '\n');
+    }
+    return WriteFile(root / "topics.txt", topics);
+}
+
+void PrintHelpAndExit(int status)
+{
+    Options default_options{};
+
+    std::cout << R"#(
+Usage: simplify-mkbook [options] OUTPUT-DIR
+
+Generates a synthetic EPWING book in OUTPUT-DIR.
+
+  -n COUNT, --entries COUNT
+      Number of dictionary entries. Default: )#"
+        << default_options.entry_count << R"#(.
+
+  -s SEED, --seed SEED
+      Seed of the random number generator. Default: )#"
+        << default_options.seed << R"#(.
+
+  -z LEVEL, --ebzip LEVEL
+      Compress the text file using EBZIP with the given level (0-5).
+      Default: no compression.
+
+  -e VERSION, --epwing VERSION
+      Compress the text file using the Huffman coding of EPWING. VERSION
+      selects the format, 5 for EPWING V4 and V5 or 6 for EPWING V6.
+      Default: no compression.
+
+  -t TITLE, --title TITLE
+      Title of the subbook. Default: )#" << default_options.title << R"#(.
+
+  -h, --help
+      Print this help text and exit.
+)#" << std::endl;
+    exit(status);
+}
+
+bool ParseCommandLine(int argc, char *argv[], Options &options)
+{
+    static option g_options[] = {
+        { "entries", 1, 0, 'n' },
+        { "seed", 1, 0, 's' },
+        { "ebzip", 1, 0, 'z' },
+        { "epwing", 1, 0, 'e' },
+        { "title", 1, 0, 't' },
+        { "help", 0, 0, 'h' },
+        { 0, 0, 0, 0 }
+    };
+
+    while (true) {
+        int argv_index;
+        int c = getopt_long(argc, argv, "n:s:z:e:t:h", g_options, &argv_index);
+        if (c == -1)
+            break;
+
+        char *endptr;
+        switch (c) {
+            case 'n': {
+                options.entry_count = strtoul(optarg, &endptr, 10);
+                if (*endptr != '\0' || options.entry_count == 0) {
+                    std::cerr << "Entry count is invalid." << std::endl;
+                    return false;
+                }
+                break;
+            }
+            case 's': {
+                options.seed = strtoull(optarg, &endptr, 10);
+                if (*endptr != '\0') {
+                    std::cerr << "Seed is invalid." << std::endl;
+                    return false;
+                }
+                break;
+            }
+            case 'z': {
+                options.zip_level = strtol(optarg, &endptr, 10);
+                if (*endptr != '\0' || options.zip_level < 0
+                    || options.zip_level > kMaxEbzipLevel) {
+                    std::cerr << "EBZIP level is invalid." << std::endl;
+                    return false;
+                }
+                break;
+            }
+            case 'e': {
+                options.epwing_version = strtol(optarg, &endptr, 10);
+                if (*endptr != '\0' || (options.epwing_version != 5
+                                        && options.epwing_version != 6)) {
+                    std::cerr << "EPWING version is invalid." << std::endl;
+                    return false;
+                }
+                break;
+            }
+            case 't': {
+                options.title = optarg;
+                break;
+            }
+            case 'h': {
+                PrintHelpAndExit(0);
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+
+    if (options.zip_level >= 0 && options.epwing_version != 0) {
+        std::cerr << "EBZIP and EPWING compression are exclusive."
+                  << std::endl;
+        return false;
+    }
+
+    if (optind + 1 != argc)
+        PrintHelpAndExit(1);
+    options.output_dir = argv[optind];
+
+    return true;
+}
+
+}  // namespace
+
+}  // namespace tools
+
+int main(int argc, char *argv[])
+{
+    tools::Options options;
+    if (!tools::ParseCommandLine(argc, argv, options))
+        return 1;
+
+    std::error_code error = tools::MakeBook(options);
+    if (error) {
+        std::cerr << "Unable to generate book in '" << options.output_dir
+                  << "': " << error.message() << "." << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
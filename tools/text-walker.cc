@@ -0,0 +1,71 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#include <eb/error.h>
+#include <eb/text.h>
+
+#include "text-walker.hh"
+
+namespace tools {
+
+EB_Error_Code WalkTexts(EB_Book &book, EB_Hookset &hookset, void *container,
+                        const std::function<void(const EB_Position &)>
+                            &begin_text,
+                        const std::function<void(const char *, size_t)>
+                            &write)
+{
+    EB_Position position;
+    EB_Error_Code eb_code;
+
+    eb_code = eb_text(&book, &position);
+    if (eb_code == EB_SUCCESS)
+        eb_code = eb_seek_text(&book, &position);
+
+    char buffer[EB_SIZE_PAGE];
+    EB_Position last_position = { -1, -1 };
+
+    while (eb_code == EB_SUCCESS) {
+        eb_code = eb_tell_text(&book, &position);
+        if (eb_code != EB_SUCCESS)
+            break;
+
+        // libeb doesn't move past a text which it can't tell the end of.
+        if (position.page == last_position.page
+            && position.offset == last_position.offset)
+            break;
+        last_position = position;
+        begin_text(position);
+
+        do {
+            ssize_t length;
+            eb_code = eb_read_text(&book, NULL, &hookset, container,
+                                   sizeof(buffer), buffer, &length);
+            if (eb_code == EB_SUCCESS && length > 0)
+                write(buffer, static_cast<size_t>(length));
+        } while (eb_code == EB_SUCCESS && !eb_is_text_stopped(&book));
+
+        if (eb_code == EB_SUCCESS)
+            eb_code = eb_forward_text(&book, NULL);
+    }
+
+    return eb_code == EB_ERR_END_OF_CONTENT ? EB_SUCCESS : eb_code;
+}
+
+}  // namespace tools
@@ -0,0 +1,47 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#ifndef TOOLS_TEXT_WALKER_HH_
+#define TOOLS_TEXT_WALKER_HH_
+
+#include <cstddef>
+#include <functional>
+
+#include <eb/eb.h>
+
+namespace tools {
+
+/**
+ * Reads texts of the current sub-book of @book one after another from
+ * its start. @begin_text is called with the position of each text
+ * before it's read, and @write with the parts of the text as they're
+ * read. @container is passed to the hooks of @hookset.
+ *
+ * Returns EB_SUCCESS once the end of the sub-book's text is reached.
+ */
+EB_Error_Code WalkTexts(EB_Book &book, EB_Hookset &hookset, void *container,
+                        const std::function<void(const EB_Position &)>
+                            &begin_text,
+                        const std::function<void(const char *, size_t)>
+                            &write);
+
+}  // namespace tools
+
+#endif  // TOOLS_TEXT_WALKER_HH_
@@ -0,0 +1,504 @@
+/*
+   Copyright (C) 2010 Anton Mihalyov <anton@bytepaper.com>
+
+   This  library is  free software;  you can  redistribute it  and/or
+   modify  it under  the  terms  of the  GNU  Library General  Public
+   License  (LGPL)  as published  by  the  Free Software  Foundation;
+   either version  2 of the  License, or  (at your option)  any later
+   version.
+
+   This library  is distributed in the  hope that it will  be useful,
+   but WITHOUT  ANY WARRANTY;  without even  the implied  warranty of
+   MERCHANTABILITY or FITNESS  FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy  of the GNU Library General Public
+   License along with this library; see the file COPYING.LIB. If not,
+   write to the  Free Software Foundation, Inc.,  51 Franklin Street,
+   Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * simplify-transcode copies a book and rewrites its text, graphic and
+ * sound files either uncompressed, which is the fastest layout to read
+ * and to map into memory, or EBZIP compressed with a slice size chosen
+ * for random access. Files are decoded with libeb itself, so any format
+ * libeb reads (EBZIP, EPWING V4/V5 and V6 compression) can be converted.
+ * Compression hints in CATALOGS are cleared for the rewritten files, the
+ * result binds with eb_bind() like the original book.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <cctype>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+#include <system_error>
+
+#include <eb/eb.h>
+#include <eb/error.h>
+
+#include "ebzip-writer.hh"
+
+namespace tools {
+
+namespace {
+
+const size_t kCatalogHeaderSize = 16;
+const size_t kCatalogRecordSize = 164;
+
+struct Options {
+    int zip_level = -1;
+    int compression_level = -1;
+    int thread_count = 0;
+    bool verbose = false;
+    std::string book_dir;
+    std::string output_dir;
+};
+
+/// Compression hints of a subbook to clear in CATALOGS.
+struct CatalogHints {
+    bool text = false;
+    bool graphic = false;
+    bool sound = false;
+};
+
+std::error_code WriteFile(const std::filesystem::path &path,
+                          const std::string &data)
+{
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    if (!stream.write(data.data(), data.size()) || !stream.flush())
+        return std::make_error_code(std::errc::io_error);
+    return std::error_code();
+}
+
+/**
+ * Returns @file_name without the suffixes libeb accepts on book files,
+ * i.e. `.ebz', `.org' and the `;1' version number of ISO 9660.
+ */
+std::string BaseFileName(const std::string &file_name)
+{
+    return file_name.substr(0, file_name.find_first_of(".;"));
+}
+
+/**
+ * Reads the whole decoded contents of @zio.
+ */
+bool ReadZio(Zio *zio, std::string &data)
+{
+    char buffer[64 * 1024];
+
+    if (zio_lseek(zio, 0, SEEK_SET) < 0)
+        return false;
+
+    data.clear();
+    while (true) {
+        ssize_t read_length = zio_read(zio, buffer, sizeof(buffer));
+        if (read_length < 0)
+            return false;
+        if (read_length == 0)
+            break;
+        data.append(buffer, read_length);
+    }
+
+    return true;
+}
+
+/**
+ * Reads the file at @path back through libeb and compares it with @data.
+ */
+bool VerifyFile(const std::filesystem::path &path, Zio_Code code,
+                const std::string &data)
+{
+    Zio zio;
+    std::string read_data;
+
+    zio_initialize(&zio);
+    if (zio_open(&zio, path.c_str(), code) < 0) {
+        zio_finalize(&zio);
+        return false;
+    }
+    bool read = ReadZio(&zio, read_data);
+    zio_close(&zio);
+    zio_finalize(&zio);
+
+    return read && read_data == data;
+}
+
+/**
+ * Rewrites the book file at @relative_path (relative to the book
+ * directory), whose contents are decoded by @zio, in the output
+ * directory. Returns false in @transcoded if the file has been left as
+ * it is.
+ */
+std::error_code TranscodeFile(const Options &options,
+                              Zio *zio,
+                              const std::filesystem::path &relative_path,
+                              bool &transcoded)
+{
+    transcoded = false;
+
+    Zio_Code code = zio_mode(zio);
+    // S-EBXA compressed text is described by the index of the text file
+    // itself, plain data would be mistaken for compressed one.
+    if (code == ZIO_SEBXA || code == ZIO_INVALID)
+        return std::error_code();
+    if (code == ZIO_PLAIN && options.zip_level < 0)
+        return std::error_code();
+
+    std::string data;
+    if (!ReadZio(zio, data))
+        return std::make_error_code(std::errc::io_error);
+
+    std::filesystem::path output_dir = options.output_dir;
+    std::filesystem::path original_path = output_dir / relative_path;
+    std::filesystem::path base_path = original_path.parent_path()
+        / BaseFileName(relative_path.filename().string());
+    Zio_Code output_code = options.zip_level >= 0 ? ZIO_EBZIP1 : ZIO_PLAIN;
+    std::error_code error;
+
+    std::filesystem::remove(original_path, error);
+    if (error)
+        return error;
+
+    if (output_code == ZIO_EBZIP1) {
+        EbzipOptions ebzip_options;
+        ebzip_options.zip_level = options.zip_level;
+        ebzip_options.compression_level = options.compression_level;
+        ebzip_options.mtime = code == ZIO_EBZIP1 ? zio->mtime : 0;
+        ebzip_options.thread_count = options.thread_count;
+        base_path += ".ebz";
+        error = WriteEbzipFile(base_path.c_str(), data, ebzip_options);
+    } else {
+        error = WriteFile(base_path, data);
+    }
+    if (error)
+        return error;
+
+    if (!VerifyFile(base_path, output_code, data)) {
+        std::cerr << "Transcoded file '" << base_path.string()
+                  << "' doesn't match the original." << std::endl;
+        return std::make_error_code(std::errc::io_error);
+    }
+
+    if (options.verbose) {
+        std::cout << relative_path.string() << " -> "
+                  << base_path.lexically_relative(output_dir).string()
+                  << " (" << data.size() << " bytes)" << std::endl;
+    }
+
+    transcoded = true;
+    return std::error_code();
+}
+
+/**
+ * Finds CATALOGS (or CATALOG) in @dir regardless of the case and the
+ * suffix of its name.
+ */
+std::filesystem::path FindCatalog(const std::filesystem::path &dir)
+{
+    std::error_code error;
+
+    for (const auto &entry : std::filesystem::directory_iterator(dir, error)) {
+        std::string name = BaseFileName(entry.path().filename().string());
+        for (char &c : name)
+            c = tolower(static_cast<unsigned char>(c));
+        if (name == "catalogs" || name == "catalog")
+            return entry.path();
+    }
+
+    return std::filesystem::path();
+}
+
+/**
+ * Clears compression hints of the transcoded files in CATALOGS of the
+ * output book. libeb detects EBZIP compression by the suffix of a file
+ * name, so the hint of both plain and EBZIP files is 0.
+ */
+std::error_code UpdateCatalogs(const Options &options,
+                               const EB_Book &book,
+                               const CatalogHints *hints)
+{
+    std::filesystem::path path = FindCatalog(options.output_dir);
+    if (path.empty())
+        return std::make_error_code(std::errc::no_such_file_or_directory);
+
+    std::string extension = path.extension().string();
+    for (char &c : extension)
+        c = tolower(static_cast<unsigned char>(c));
+
+    Zio zio;
+    Zio_Code code = extension == ".ebz" ? ZIO_EBZIP1 : ZIO_PLAIN;
+    std::string catalogs;
+
+    zio_initialize(&zio);
+    if (zio_open(&zio, path.c_str(), code) < 0) {
+        zio_finalize(&zio);
+        return std::make_error_code(std::errc::io_error);
+    }
+    bool read = ReadZio(&zio, catalogs);
+    zio_close(&zio);
+    zio_finalize(&zio);
+    if (!read)
+        return std::make_error_code(std::errc::io_error);
+
+    // EPWING V1 catalogs have no extended records and no hints.
+    if (catalogs.size() < kCatalogHeaderSize)
+        return std::make_error_code(std::errc::io_error);
+    unsigned epwing_version = static_cast<unsigned char>(catalogs[2]) << 8
+        | static_cast<unsigned char>(catalogs[3]);
+    if (epwing_version == 1)
+        return std::error_code();
+
+    size_t extra_offset = kCatalogHeaderSize
+        + book.subbook_count * kCatalogRecordSize;
+
+    for (int i = 0; i < book.subbook_count; ++i) {
+        size_t offset = extra_offset + i * kCatalogRecordSize;
+        if (offset + kCatalogRecordSize > catalogs.size())
+            break;
+        if (catalogs[offset + 4] == '\0')
+            continue;
+
+        // Graphic and sound files each take one of the two file name
+        // slots depending on data types, see eb_load_catalog_epwing().
+        unsigned data_types = static_cast<unsigned char>(catalogs[offset + 41])
+            << 8 | static_cast<unsigned char>(catalogs[offset + 42]);
+
+        if (hints[i].text)
+            catalogs[offset + 55] = 0;
+        if (hints[i].graphic)
+            catalogs[offset + ((data_types & 0x03) == 0x02 ? 54 : 53)] = 0;
+        if (hints[i].sound)
+            catalogs[offset + ((data_types & 0x03) == 0x01 ? 54 : 53)] = 0;
+    }
+
+    std::error_code error;
+    std::filesystem::remove(path, error);
+    if (error)
+        return error;
+    return WriteFile(path.parent_path()
+                     / BaseFileName(path.filename().string()), catalogs);
+}
+
+std::error_code TranscodeBook(const Options &options, EB_Book &book)
+{
+    std::error_code error;
+
+    std::filesystem::copy(options.book_dir, options.output_dir,
+                          std::filesystem::copy_options::recursive, error);
+    if (error)
+        return error;
+
+    EB_Subbook_Code subbook_list[EB_MAX_SUBBOOKS];
+    int subbook_count;
+    if (eb_subbook_list(&book, subbook_list, &subbook_count) != EB_SUCCESS)
+        return std::make_error_code(std::errc::io_error);
+
+    CatalogHints hints[EB_MAX_SUBBOOKS];
+    // Subbooks may share data directories, rewrite each file once.
+    std::set<std::filesystem::path> done;
+
+    for (int i = 0; i < subbook_count; ++i) {
+        EB_Error_Code eb_error = eb_set_subbook(&book, subbook_list[i]);
+        if (eb_error != EB_SUCCESS) {
+            std::cerr << "Unable to open subbook " << subbook_list[i]
+                      << ": " << eb_error_message(eb_error) << "."
+                      << std::endl;
+            return std::make_error_code(std::errc::io_error);
+        }
+
+        EB_Subbook *subbook = book.subbook_current;
+        std::filesystem::path dir = subbook->directory_name;
+        if (book.disc_code == EB_DISC_EPWING)
+            dir /= subbook->data_directory_name;
+
+        const struct {
+            Zio *zio;
+            const char *file_name;
+            bool *hint;
+        } files[] = {
+            { &subbook->text_zio, subbook->text_file_name,
+              &hints[subbook_list[i]].text },
+            { &subbook->graphic_zio, subbook->graphic_file_name,
+              &hints[subbook_list[i]].graphic },
+            { &subbook->sound_zio, subbook->sound_file_name,
+              &hints[subbook_list[i]].sound },
+        };
+
+        for (const auto &file : files) {
+            if (zio_mode(file.zio) == ZIO_INVALID)
+                continue;
+
+            std::filesystem::path relative_path = dir / file.file_name;
+            if (done.count(relative_path) != 0) {
+                *file.hint = true;
+                continue;
+            }
+
+            bool transcoded;
+            error = TranscodeFile(options, file.zio, relative_path,
+                                  transcoded);
+            if (error)
+                return error;
+            if (transcoded)
+                done.insert(relative_path);
+            *file.hint = transcoded;
+        }
+    }
+
+    if (book.disc_code == EB_DISC_EPWING)
+        return UpdateCatalogs(options, book, hints);
+    return std::error_code();
+}
+
+void PrintHelpAndExit(int status)
+{
+    std::cout << R"#(
+Usage: simplify-transcode [options] BOOK-DIR OUTPUT-DIR
+
+Copies the book in BOOK-DIR to OUTPUT-DIR and rewrites its text, graphic
+and sound files in a layout which is fast to read. Every rewritten file
+is read back through libeb and compared with the original. OUTPUT-DIR
+must not exist.
+
+  -z LEVEL, --ebzip LEVEL
+      Compress the files using EBZIP with the given level (0-5). Slices
+      are 2048 << LEVEL bytes long, the smaller the slice, the less is
+      decompressed to serve a random read. Default: no compression.
+
+  -c LEVEL, --compression LEVEL
+      zlib compression level (1-9) used with --ebzip. Default: zlib's
+      default.
+
+  -j THREADS, --jobs THREADS
+      Compress slices on THREADS threads, 0 starts one per core.
+      Default: 0.
+
+  -v, --verbose
+      Print the files which have been rewritten.
+
+  -h, --help
+      Print this help text and exit.
+)#" << std::endl;
+    exit(status);
+}
+
+bool ParseCommandLine(int argc, char *argv[], Options &options)
+{
+    static option g_options[] = {
+        { "ebzip", 1, 0, 'z' },
+        { "compression", 1, 0, 'c' },
+        { "jobs", 1, 0, 'j' },
+        { "verbose", 0, 0, 'v' },
+        { "help", 0, 0, 'h' },
+        { 0, 0, 0, 0 }
+    };
+
+    while (true) {
+        int argv_index;
+        int c = getopt_long(argc, argv, "z:c:j:vh", g_options, &argv_index);
+        if (c == -1)
+            break;
+
+        char *endptr;
+        switch (c) {
+            case 'z': {
+                options.zip_level = strtol(optarg, &endptr, 10);
+                if (*endptr != '\0' || options.zip_level < 0
+                    || options.zip_level > kMaxEbzipLevel) {
+                    std::cerr << "EBZIP level is invalid." << std::endl;
+                    return false;
+                }
+                break;
+            }
+            case 'c': {
+                options.compression_level = strtol(optarg, &endptr, 10);
+                if (*endptr != '\0' || options.compression_level < 1
+                    || options.compression_level > 9) {
+                    std::cerr << "Compression level is invalid."
+                              << std::endl;
+                    return false;
+                }
+                break;
+            }
+            case 'j': {
+                options.thread_count = strtol(optarg, &endptr, 10);
+                if (*endptr != '\0' || options.thread_count < 0) {
+                    std::cerr << "Number of threads is invalid."
+                              << std::endl;
+                    return false;
+                }
+                break;
+            }
+            case 'v': {
+                options.verbose = true;
+                break;
+            }
+            case 'h': {
+                PrintHelpAndExit(0);
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+
+    if (optind + 2 != argc)
+        PrintHelpAndExit(1);
+    options.book_dir = argv[optind];
+    options.output_dir = argv[optind + 1];
+
+    std::error_code error;
+    if (std::filesystem::exists(options.output_dir, error)) {
+        std::cerr << "Output directory '" << options.output_dir
+                  << "' already exists." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+}  // namespace
+
+}  // namespace tools
+
+int main(int argc, char *argv[])
+{
+    tools::Options options;
+    if (!tools::ParseCommandLine(argc, argv, options))
+        return 1;
+
+    EB_Book book;
+    EB_Error_Code eb_error;
+
+    eb_initialize_library();
+    eb_initialize_book(&book);
+
+    eb_error = eb_bind(&book, options.book_dir.c_str());
+    if (eb_error != EB_SUCCESS) {
+        std::cerr << "Unable to open book in '" << options.book_dir
+                  << "': " << eb_error_message(eb_error) << "." << std::endl;
+        eb_finalize_book(&book);
+        eb_finalize_library();
+        return 1;
+    }
+
+    std::error_code error = tools::TranscodeBook(options, book);
+    eb_finalize_book(&book);
+    eb_finalize_library();
+
+    if (error) {
+        std::cerr << "Unable to transcode book to '" << options.output_dir
+                  << "': " << error.message() << "." << std::endl;
+        return 1;
+    }
+
+    return 0;
+}